@@ -54,6 +54,13 @@ typedef struct
     int *    rankMap;
 } cti_binaryList_t;
 
+typedef struct
+{
+    const char *         fstr;
+    const char * const * args;
+    const char * const * env;
+} cti_toolDaemon_t;
+
 typedef int64_t cti_app_id_t;
 typedef int64_t cti_session_id_t;
 typedef int64_t cti_manifest_id_t;
@@ -262,6 +269,34 @@ int cti_setAttribute(cti_attr_type_t attrib, const char *value);
  */
 const char * cti_getAttribute(cti_attr_type_t attrib);
 
+/*
+ * cti_getMetrics - Returns request metrics for the frontend daemon
+ *
+ * Detail
+ *      This function returns a JSON object describing requests made to the
+ *      frontend daemon so far. The "frontend" member has the latency of each
+ *      request as seen by this process, the "daemon" member has the time the
+ *      daemon took to handle each request, or null if it could not be
+ *      reached. Both are keyed by request type, with launch requests also
+ *      keyed by the launched binary, such as "ForkExecvpUtil_Sync(sbcast)".
+ *      Each entry has the request count, the number of requests in flight and
+ *      the maximum in flight, and the total, minimum, median, 95th percentile,
+ *      99th percentile and maximum latency in milliseconds. Percentiles are
+ *      accurate to within 12.5%.
+ *
+ *      The same metrics are written to the debug log when CTI exits, and to
+ *      the file named by the CTI_METRICS_FILE environment variable if set.
+ *
+ * Arguments
+ *      None.
+ *
+ * Returns
+ *      A string containing the JSON object that must be freed by the caller,
+ *      or else a null string on error.
+ *
+ */
+char * cti_getMetrics(void);
+
 /******************************************************************************
  * The following functions require the application to be started or registered
  * with the interface before calling. All API calls require a cti_app_id_t
@@ -1412,6 +1447,36 @@ int cti_execToolDaemon( cti_manifest_id_t   mid,
                         const char * const  args[],
                         const char * const  env[]);
 
+/*
+ * cti_execToolDaemons - Launch several tool daemons onto all the compute
+ *                       nodes associated with the provided manifest session.
+ *
+ * Detail
+ *      This function behaves as cti_execToolDaemon, but starts every tool
+ *      daemon in the provided list with a single launch. Each compute node
+ *      extracts the manifest and waits for dependencies once, then starts one
+ *      process for each tool daemon. This avoids an additional launch for
+ *      tools that start a helper alongside their main tool daemon.
+ *
+ *      Each tool daemon receives only its own arguments and environment
+ *      variables, in the same format as the args and env arguments of
+ *      cti_execToolDaemon. Either may be NULL. The manifest will become
+ *      invalid for future use upon calling this function.
+ *
+ * Arguments
+ *      mid -         The cti_manifest_id_t of the manifest.
+ *      daemons -     The list of tool daemon binaries with their arguments
+ *                    and environment variables.
+ *      num_daemons - The number of tool daemons in the list.
+ *
+ * Returns
+ *      0 on success, or else 1 on failure.
+ *
+ */
+int cti_execToolDaemons(cti_manifest_id_t       mid,
+                        const cti_toolDaemon_t  daemons[],
+                        int                     num_daemons);
+
 /*
  * cti_getSessionLockFiles - Get the name(s) of instance dependency lock files.
  *
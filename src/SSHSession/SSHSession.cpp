@@ -12,6 +12,9 @@
 #include <assert.h>
 #include <netdb.h>
 
+#include <algorithm>
+#include <atomic>
+
 #include "SSHSession.hpp"
 
 #include "useful/cti_argv.hpp"
@@ -575,7 +578,7 @@ SSHSession::UniqueChannel SSHSession::startRemoteCommand(const char* const argv[
     auto argvStream = std::stringstream{};
 
     // Add environment settings used by daemon
-    for (auto&& arg : {"CTI_DEBUG", "CTI_LOG_DIR", "PATH", "LD_LIBRARY_PATH"}) {
+    for (auto&& arg : {"CTI_DEBUG", "CTI_LOG_DIR", BE_AGENT_RSH_VAR, "PATH", "LD_LIBRARY_PATH"}) {
         if (auto val = ::getenv(arg)) {
             argvStream << arg << "=" << val << " ";
         }
@@ -668,6 +671,28 @@ static auto channel_writer(LIBSSH2_CHANNEL* channel)
     };
 }
 
+// Requests to the remote daemon are made one at a time, so the response
+// header will always match the last request
+template <typename Func>
+static void writeRequest(Func&& writer, FE_daemon::ReqType type, std::string const& reqData = {})
+{
+    // Requests may be written from multiple threads
+    static auto nextReqId = std::atomic<FE_daemon::ReqId>{1};
+    writeLoop(writer, FE_daemon::ReqHeader
+        { .id = nextReqId.fetch_add(1)
+        , .type = type
+        , .length = reqData.length()
+        , .num_fds = 0
+    });
+    writeLoop(writer, reqData.c_str(), reqData.length());
+}
+
+template <typename Func>
+static void readRespHeader(Func&& reader)
+{
+    (void)readLoop<FE_daemon::RespHeader>(std::forward<Func>(reader));
+}
+
 FE_daemon::MPIRResult SSHSession::attachMPIR(std::string const& daemonPath, std::string const& launcherName,
     pid_t launcher_pid)
 {
@@ -691,15 +716,18 @@ FE_daemon::MPIRResult SSHSession::attachMPIR(std::string const& daemonPath, std:
     [[maybe_unused]] auto const remote_pid = readLoop<pid_t>(channel_reader);
 
     // Write MPIR attach request to channel
-    writeLoop(channel_writer, FE_daemon::ReqType::AttachMPIR);
-    writeLoop(channel_writer, launcherName.c_str(), launcherName.length() + 1);
-    writeLoop(channel_writer, launcher_pid);
+    auto reqData = std::string{};
+    appendString(reqData, launcherName.c_str());
+    appendData(reqData, launcher_pid);
+    writeRequest(channel_writer, FE_daemon::ReqType::AttachMPIR, reqData);
 
     // Read MPIR attach request from relay pipe
+    readRespHeader(channel_reader);
     auto mpirResult = FE_daemon::readMPIRResp(channel_reader);
 
     // Shut down remote daemon
-    writeLoop(channel_writer, FE_daemon::ReqType::Shutdown);
+    writeRequest(channel_writer, FE_daemon::ReqType::Shutdown);
+    readRespHeader(channel_reader);
     auto const okResp = readLoop<FE_daemon::OKResp>(channel_reader);
     if (okResp.type != FE_daemon::RespType::OK) {
         fprintf(stderr, "warning: daemon shutdown failed\n");
@@ -729,43 +757,16 @@ std::tuple<SSHSession::UniqueChannel, pid_t> SSHSession::startRemoteDaemon(std::
 
 FE_daemon::MPIRResult SSHSession::launchMPIR(LIBSSH2_CHANNEL* channel, char const* const* launcher_argv, char const* const* env)
 {
-    // Write MPIR launch request to channel
-    writeLoop(channel_writer(channel), FE_daemon::ReqType::LaunchMPIR);
+    auto reqData = std::string{};
 
-    // Launcher binary or name
-    writeLoop(channel_writer(channel), launcher_argv[0], strlen(launcher_argv[0]) + 1);
+    // Launcher binary or name, arguments, environment settings
+    FE_daemon::appendLaunchData(reqData, launcher_argv[0], launcher_argv, env);
 
-    // Launcher argc
-    size_t launcher_argc = 0;
-    { for (auto arg = launcher_argv; *arg != nullptr; arg++) { launcher_argc++; };
-        auto launcherArgcStr = std::to_string(launcher_argc);
-        writeLoop(channel_writer(channel), launcherArgcStr.c_str(), launcherArgcStr.length() + 1);
-    }
-
-    // Launcher argv
-    for (size_t i = 0; i < launcher_argc; i++) {
-        writeLoop(channel_writer(channel), launcher_argv[i], ::strlen(launcher_argv[i]) + 1);
-    }
-
-    // Environment settings
-    if (env) {
-
-        // Environment count
-        size_t envc = 0;
-        for (auto var = env; *var != nullptr; var++) { envc++; }
-        auto envcStr = std::to_string(envc);
-        writeLoop(channel_writer(channel), envcStr.c_str(), envcStr.length() + 1);
-
-        // Environment
-        for (size_t i = 0; i < envc; i++) {
-            writeLoop(channel_writer(channel), env[i], strlen(env[i]) + 1);
-        }
-
-    } else {
-        writeLoop(channel_writer(channel), "0", 2);
-    }
+    // Write MPIR launch request to channel
+    writeRequest(channel_writer(channel), FE_daemon::ReqType::LaunchMPIR, reqData);
 
     // Read MPIR attach request from relay pipe
+    readRespHeader(channel_reader(channel));
     auto mpirResult = FE_daemon::readMPIRResp(channel_reader(channel));
 
     return mpirResult;
@@ -773,11 +774,13 @@ FE_daemon::MPIRResult SSHSession::launchMPIR(LIBSSH2_CHANNEL* channel, char cons
 
 std::string SSHSession::readStringMPIR(LIBSSH2_CHANNEL* channel, FE_daemon::DaemonAppId mpir_id, std::string const& var)
 {
-    writeLoop(channel_writer(channel), FE_daemon::ReqType::ReadStringMPIR);
-    writeLoop(channel_writer(channel), mpir_id);
-    writeLoop(channel_writer(channel), var.c_str(), var.length() + 1);
+    auto reqData = std::string{};
+    appendData(reqData, mpir_id);
+    appendString(reqData, var.c_str());
+    writeRequest(channel_writer(channel), FE_daemon::ReqType::ReadStringMPIR, reqData);
 
      // read basic response information
+    readRespHeader(channel_reader(channel));
     auto stringResp = readLoop<FE_daemon::StringResp>(channel_reader(channel));
     if (stringResp.type != FE_daemon::RespType::String) {
         throw std::runtime_error("daemon did not send expected String response type");
@@ -796,8 +799,10 @@ std::string SSHSession::readStringMPIR(LIBSSH2_CHANNEL* channel, FE_daemon::Daem
 
 void SSHSession::releaseMPIR(LIBSSH2_CHANNEL* channel, FE_daemon::DaemonAppId mpir_id)
 {
-    writeLoop(channel_writer(channel), FE_daemon::ReqType::ReleaseMPIR);
-    writeLoop(channel_writer(channel), mpir_id);
+    auto reqData = std::string{};
+    appendData(reqData, mpir_id);
+    writeRequest(channel_writer(channel), FE_daemon::ReqType::ReleaseMPIR, reqData);
+    readRespHeader(channel_reader(channel));
     auto okResp = readLoop<FE_daemon::OKResp>(channel_reader(channel));
     if (okResp.type != FE_daemon::RespType::OK) {
         throw std::runtime_error("warning: remote daemon failed to release from barrier");
@@ -806,24 +811,30 @@ void SSHSession::releaseMPIR(LIBSSH2_CHANNEL* channel, FE_daemon::DaemonAppId mp
 
 bool SSHSession::waitMPIR(LIBSSH2_CHANNEL* channel, FE_daemon::DaemonAppId mpir_id)
 {
-    writeLoop(channel_writer(channel), FE_daemon::ReqType::WaitMPIR);
-    writeLoop(channel_writer(channel), mpir_id);
+    auto reqData = std::string{};
+    appendData(reqData, mpir_id);
+    writeRequest(channel_writer(channel), FE_daemon::ReqType::WaitMPIR, reqData);
+    readRespHeader(channel_reader(channel));
     auto okResp = readLoop<FE_daemon::OKResp>(channel_reader(channel));
     return (okResp.type == FE_daemon::RespType::OK);
 }
 
 bool SSHSession::checkApp(LIBSSH2_CHANNEL* channel, FE_daemon::DaemonAppId mpir_id)
 {
-    writeLoop(channel_writer(channel), FE_daemon::ReqType::CheckApp);
-    writeLoop(channel_writer(channel), mpir_id);
+    auto reqData = std::string{};
+    appendData(reqData, mpir_id);
+    writeRequest(channel_writer(channel), FE_daemon::ReqType::CheckApp, reqData);
+    readRespHeader(channel_reader(channel));
     auto okResp = readLoop<FE_daemon::OKResp>(channel_reader(channel));
     return (okResp.type == FE_daemon::RespType::OK);
 }
 
 void SSHSession::deregisterApp(LIBSSH2_CHANNEL* channel, FE_daemon::DaemonAppId mpir_id)
 {
-    writeLoop(channel_writer(channel), FE_daemon::ReqType::DeregisterApp);
-    writeLoop(channel_writer(channel), mpir_id);
+    auto reqData = std::string{};
+    appendData(reqData, mpir_id);
+    writeRequest(channel_writer(channel), FE_daemon::ReqType::DeregisterApp, reqData);
+    readRespHeader(channel_reader(channel));
     auto okResp = readLoop<FE_daemon::OKResp>(channel_reader(channel));
     if (okResp.type != FE_daemon::RespType::OK) {
         throw std::runtime_error("warning: remote daemon failed to deregister application");
@@ -833,7 +844,8 @@ void SSHSession::deregisterApp(LIBSSH2_CHANNEL* channel, FE_daemon::DaemonAppId
 void SSHSession::stopRemoteDaemon(SSHSession::UniqueChannel&& channel, pid_t daemon_pid)
 {
     // Shut down remote daemon
-    writeLoop(channel_writer(channel.get()), FE_daemon::ReqType::Shutdown);
+    writeRequest(channel_writer(channel.get()), FE_daemon::ReqType::Shutdown);
+    readRespHeader(channel_reader(channel.get()));
     auto okResp = readLoop<FE_daemon::OKResp>(channel_reader(channel.get()));
     if (okResp.type != FE_daemon::RespType::OK) {
         throw std::runtime_error("remote daemon shutdown failed (has PID "
@@ -897,3 +909,86 @@ void RemoteDaemon::deregisterApp(FE_daemon::DaemonAppId mpir_id)
 {
     m_session.deregisterApp(m_channel.get(), mpir_id);
 }
+
+RemoteBEAgent::RemoteBEAgent(SSHSession&& session, char const* const* agentArgv, uint32_t numNodes)
+    : m_session{std::move(session)}
+    , m_channel{m_session.startRemoteCommand(agentArgv)}
+    , m_numNodes{numNodes}
+    , m_responded{false}
+{}
+
+RemoteBEAgent::Response RemoteBEAgent::readResponse()
+{
+    // Agent closes channel if it failed to start or could not run daemon
+    auto reader = channel_reader(m_channel.get());
+    auto header = cti_beAgentResponse_t{};
+    if (readLoop(reinterpret_cast<char*>(&header), sizeof(header), reader) != sizeof(header)) {
+        throw std::runtime_error("backend daemon agent exited");
+    }
+    if (header.numMissed > m_numNodes) {
+        throw std::runtime_error("backend daemon agent missed " + std::to_string(header.numMissed)
+            + " of " + std::to_string(m_numNodes) + " nodes");
+    }
+
+    auto response = Response{header.status, header.numNodes, std::vector<uint32_t>(header.numMissed)};
+    auto const missedLength = ssize_t(header.numMissed * sizeof(uint32_t));
+    if (readLoop(reinterpret_cast<char*>(response.missedNodes.data()), missedLength, reader) != missedLength) {
+        throw std::runtime_error("backend daemon agent exited");
+    }
+
+    return response;
+}
+
+RemoteBEAgent::Response RemoteBEAgent::runDaemon(char const* const* args, bool synchronous)
+{
+    auto argsData = std::string{};
+    auto argc = uint32_t{0};
+    for (auto arg = args; *arg != nullptr; arg++) {
+        argsData.append(*arg);
+        argsData.push_back('\0');
+        argc++;
+    }
+
+    auto writer = channel_writer(m_channel.get());
+    writeLoop(writer, cti_beAgentRequest_t
+        { .synchronous = synchronous
+        , .argc = argc
+        , .argsLength = uint32_t(argsData.length())
+    });
+    writeLoop(writer, argsData.c_str(), argsData.length());
+
+    return readResponse();
+}
+
+RemoteBEAgent::Response RemoteBEAgent::sendFile(char const* sourcePath, std::string const& name)
+{
+    auto source = cti::file::open(sourcePath, "rb");
+    struct stat stbuf;
+    if ((fstat(fileno(source.get()), &stbuf) != 0) || (!S_ISREG(stbuf.st_mode))) {
+        throw std::runtime_error("Could not fstat file to send: " + std::string{sourcePath});
+    }
+
+    auto writer = channel_writer(m_channel.get());
+    writeLoop(writer, cti_beAgentRequest_t
+        { .synchronous = true
+        , .argc = 1
+        , .argsLength = uint32_t(name.length() + 1)
+        , .sendFile = true
+        , .fileLength = uint64_t(stbuf.st_size)
+    });
+    writeLoop(writer, name.c_str(), name.length() + 1);
+
+    // Agent expects exactly the file length announced in the header
+    auto remaining = uint64_t(stbuf.st_size);
+    char buf[65536];
+    while (remaining > 0) {
+        auto const len = cti::file::read(buf, sizeof(char), std::min(remaining, uint64_t{sizeof(buf)}), source.get());
+        if (len == 0) {
+            throw std::runtime_error("Error reading file to send: " + std::string{sourcePath});
+        }
+        writeLoop(writer, buf, len);
+        remaining -= len;
+    }
+
+    return readResponse();
+}
@@ -11,6 +11,8 @@
 
 #include <libssh2.h>
 
+#include "cti_defs.h"
+
 #include "frontend/daemon/cti_fe_daemon_iface.hpp"
 
 #include "useful/cti_wrappers.hpp"
@@ -130,3 +132,35 @@ struct RemoteDaemon
     bool checkApp(FE_daemon::DaemonAppId mpir_id);
     void deregisterApp(FE_daemon::DaemonAppId mpir_id);
 };
+
+// Backend daemon agent running on a remote host. Daemon invocations are sent over a
+// single SSH channel instead of executing a new remote command for each one
+struct RemoteBEAgent
+{
+    SSHSession m_session;
+    SSHSession::UniqueChannel m_channel;
+    uint32_t m_numNodes; // nodes served by agent and its child agents
+    bool m_responded; // agent has successfully run a daemon
+
+    // Aggregated response from the agent's tree. Missed nodes are given by their index
+    // in the tree, where the agent's own node is 0
+    struct Response {
+        int32_t status;
+        uint32_t numNodes;
+        std::vector<uint32_t> missedNodes;
+    };
+
+    RemoteBEAgent(SSHSession&& session, char const* const* agentArgv, uint32_t numNodes = 1);
+
+    // Run backend daemon with arguments, not including argv[0], on every node in the
+    // agent's tree. Response status is the first nonzero daemon exit status if
+    // synchronous, otherwise 0 once started
+    Response runDaemon(char const* const* args, bool synchronous);
+
+    // Write file to the tool path under name on every node in the agent's tree.
+    // Response status is nonzero if any node failed to write the file
+    Response sendFile(char const* sourcePath, std::string const& name);
+
+private:
+    Response readResponse();
+};
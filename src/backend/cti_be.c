@@ -11,10 +11,16 @@
 // This pulls in config.h
 #include "cti_defs.h"
 
+#include <ctype.h>
+#include <fcntl.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "cti_be.h"
 
@@ -277,6 +283,108 @@ _cti_be_getAttribsDir()
     return strdup(attribs_str);
 }
 
+// Map the named file from the file directory read-only. Set size and return the
+// mapping, or NULL on error. Only the pages that are accessed are read from disk
+void *
+_cti_be_mapFile(char const* name, size_t* size)
+{
+    void *      result = NULL;
+    char *      file_dir = NULL;
+    char *      path = NULL;
+    int         fd = -1;
+    struct stat st;
+
+    // get the file directory were we can find the file
+    if ((file_dir = cti_be_getFileDir()) == NULL) {
+        fprintf(stderr, "cti_be_getFileDir failed.\n");
+        goto cleanup__cti_be_mapFile;
+    }
+
+    // create the path to the file
+    if (asprintf(&path, "%s/%s", file_dir, name) <= 0) {
+        fprintf(stderr, "asprintf failed.\n");
+        path = NULL;
+        goto cleanup__cti_be_mapFile;
+    }
+
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+        fprintf(stderr, "Could not open %s for reading\n", path);
+        goto cleanup__cti_be_mapFile;
+    }
+
+    if ((fstat(fd, &st) < 0) || (st.st_size == 0)) {
+        fprintf(stderr, "Could not read %s\n", path);
+        goto cleanup__cti_be_mapFile;
+    }
+
+    result = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (result == MAP_FAILED) {
+        fprintf(stderr, "mmap of %s failed\n", path);
+        result = NULL;
+        goto cleanup__cti_be_mapFile;
+    }
+
+    *size = st.st_size;
+
+cleanup__cti_be_mapFile:
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    if (path != NULL) {
+        free(path);
+        path = NULL;
+    }
+    if (file_dir != NULL) {
+        free(file_dir);
+        file_dir = NULL;
+    }
+
+    return result;
+}
+
+// Find the entry for hostname in an array of entries sorted by host, where each
+// entry begins with its host name. An entry matches if it is hostname, or hostname
+// followed by a domain or other non-alphanumeric suffix. Return NULL if not found
+void const *
+_cti_be_findLayoutEntry(void const* entries, size_t num_entries, size_t entry_size,
+    char const* hostname)
+{
+    char const* base = entries;
+    size_t hostname_len = strlen(hostname);
+    size_t lo = 0;
+    size_t hi = num_entries;
+
+    if (hostname_len >= HOST_NAME_MAX) {
+        return NULL;
+    }
+
+    // Find the first entry not less than hostname. Any entries beginning with
+    // hostname sort together starting here
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strncmp(base + mid * entry_size, hostname, HOST_NAME_MAX) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    for (; lo < num_entries; lo++) {
+        char const* host = base + lo * entry_size;
+        if (strncmp(host, hostname, hostname_len) != 0) {
+            break;
+        }
+
+        // Reject other hosts that share a prefix, such as nid1 and nid10
+        if (!isalnum((unsigned char)host[hostname_len])) {
+            return host;
+        }
+    }
+
+    return NULL;
+}
+
 char *
 cti_be_getRootDir()
 {
@@ -33,6 +33,8 @@ typedef struct
 /* internal function prototypes */
 char *              _cti_be_getToolDir(void);
 char *              _cti_be_getAttribsDir(void);
+void *              _cti_be_mapFile(char const* name, size_t* size);
+void const *        _cti_be_findLayoutEntry(void const* entries, size_t num_entries, size_t entry_size, char const* hostname);
 
 /* Noneness functions for wlm proto - Use these if your wlm proto doesn't define the function */
 int                 _cti_be_wlm_init_none(void);
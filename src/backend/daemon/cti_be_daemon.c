@@ -16,20 +16,30 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <limits.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <poll.h>
+#include <pthread.h>
 
+#include <sys/inotify.h>
+#include <sys/mman.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
 #include <sys/wait.h>
+#include <time.h>
 
 #include <archive.h>
 #include <archive_entry.h>
@@ -38,6 +48,16 @@
 #include "cti_useful.h"
 
 static int      debug_flag = 0;
+static int      agent_flag = 0;
+
+// Options without short forms
+#define AGENT_FANOUT_OPT    3
+#define AGENT_TREE_OPT      4
+#define BINARY_ARGC_OPT     5
+#define BINARY_ENV_OPT      6
+#define CLEAN_THREADS_OPT   7
+#define CLEAN_DEFER_OPT     8
+#define FILE_DATA_OPT       9
 
 const struct option long_opts[] = {
             {"apid",        required_argument,  0, 'a'},
@@ -46,6 +66,7 @@ const struct option long_opts[] = {
             {"directory",   required_argument,  0, 'd'},
             {"env",         required_argument,  0, 'e'},
             {"file",        required_argument,  0, 'f'},
+            {"files",       required_argument,  0, 'F'},
             {"inst",        required_argument,  0, 'i'},
             {"manifest",    required_argument,  0, 'm'},
             {"path",        required_argument,  0, 'p'},
@@ -54,15 +75,29 @@ const struct option long_opts[] = {
             {"wlm",         required_argument,  0, 'w'},
             {"help",        no_argument,        0, 'h'},
             {"debug",       no_argument,        &debug_flag, 1},
+            {"agent",       no_argument,        &agent_flag, 1},
+            {"fanout",      required_argument,  0, AGENT_FANOUT_OPT},
+            {"tree",        required_argument,  0, AGENT_TREE_OPT},
+            {"argc",        required_argument,  0, BINARY_ARGC_OPT},
+            {"binenv",      required_argument,  0, BINARY_ENV_OPT},
+            {"threads",     required_argument,  0, CLEAN_THREADS_OPT},
+            {"defer",       no_argument,        0, CLEAN_DEFER_OPT},
+            {"filedata",    required_argument,  0, FILE_DATA_OPT},
             {0, 0, 0, 0}
             };
 
-struct cti_pids
+// Layout of the pid file. Tool daemons claim slots by atomically incrementing count
+// in the shared mapping, so registering and reading pids takes no record locks. The
+// file only grows, under a record lock, when claimed slots run past its end
+#define PID_REGISTRY_MAGIC          0x43544950
+#define PID_REGISTRY_INITIAL_SLOTS  1024
+
+typedef struct
 {
-    pid_t               pids[32];
-    unsigned int        idx;
-    struct cti_pids *   next;
-};
+    uint32_t            magic;
+    uint32_t            count;  // slots claimed, may run past the end of the file while it grows
+    pid_t               pids[]; // 0 until the slot is written
+} cti_pid_registry_t;
 
 /* wlm specific proto objects defined elsewhere */
 extern cti_wlm_proto_t  _cti_slurm_wlmProto;
@@ -93,6 +128,11 @@ static cti_wlm_proto_t  _cti_nonenessProto =
 /* global wlm proto object - this is initialized to noneness by default */
 cti_wlm_proto_t *   _cti_wlmProto   = &_cti_nonenessProto;
 
+// Manifest extraction read block sizes
+#define DEFAULT_EXTRACT_BLOCK_SIZE  (1024 * 1024)
+#define MIN_EXTRACT_BLOCK_SIZE      10240
+#define MAX_EXTRACT_BLOCK_SIZE      (64 * 1024 * 1024)
+
 static void
 usage(void)
 {
@@ -102,14 +142,27 @@ usage(void)
     fprintf(stdout, "specified variables in the environment of the process.\n\n");
 
     fprintf(stdout, "\t-a, --apid      Application id\n");
-    fprintf(stdout, "\t-b, --binary    Binary file to execute\n");
+    fprintf(stdout, "\t-b, --binary    Binary file to execute. May be repeated to start several\n");
+    fprintf(stdout, "\t                tool daemons after a single extraction and lock wait\n");
+    fprintf(stdout, "\t    --argc      Number of arguments after -- for each binary in order.\n");
+    fprintf(stdout, "\t                The last binary receives any remaining arguments\n");
+    fprintf(stdout, "\t    --binenv    Environment variable for one binary, as index:var=val\n");
     fprintf(stdout, "\t-c, --clean     Terminate existing tool daemons and cleanup session\n");
+    fprintf(stdout, "\t    --threads   Number of threads removing files during cleanup\n");
+    fprintf(stdout, "\t    --defer     Detach the session directory during cleanup and remove\n");
+    fprintf(stdout, "\t                it after returning\n");
     fprintf(stdout, "\t-d, --directory Use named directory for CWD\n");
     fprintf(stdout, "\t-e, --env       Specify an environment variable to set\n");
     fprintf(stdout, "\t                The argument provided to this option must be issued\n");
     fprintf(stdout, "\t                with var=val, for example: -e myVar=myVal\n");
     fprintf(stdout, "\t-f, --file      If this file exists on the node, its path will be\n");
     fprintf(stdout, "\t                printed to stdout\n");
+    fprintf(stdout, "\t    --files     Print a hex bitmap of the files in this list that exist\n");
+    fprintf(stdout, "\t                with matching size and modification time. The list\n");
+    fprintf(stdout, "\t                is removed after it is read\n");
+    fprintf(stdout, "\t    --filedata  As --files, with the list given as newline-separated\n");
+    fprintf(stdout, "\t                records in the argument. May be repeated to pass a\n");
+    fprintf(stdout, "\t                long list, records of all arguments are checked together\n");
     fprintf(stdout, "\t-i, --inst      Instance of tool daemon. Used in conjunction with sessions\n");
     fprintf(stdout, "\t-m, --manifest  Manifest tarball to extract/set as CWD if -d omitted\n");
     fprintf(stdout, "\t-p, --path      PWD path where tool daemon should be started\n");
@@ -117,9 +170,289 @@ usage(void)
     fprintf(stdout, "\t-l, --ldlibpath What to set as LD_LIBRARY_PATH\n");
     fprintf(stdout, "\t-w, --wlm       Workload Manager in use\n");
     fprintf(stdout, "\t    --debug     Turn on debug logging to a file. (STDERR/STDOUT to file)\n");
+    fprintf(stdout, "\t    --agent     Run daemon invocations sent on stdin or the agent socket in\n");
+    fprintf(stdout, "\t                the tool path until stdin is closed. Requires -a and -p\n");
+    fprintf(stdout, "\t    --tree      Comma-separated hosts for which the agent starts child\n");
+    fprintf(stdout, "\t                agents and forwards invocations from stdin\n");
+    fprintf(stdout, "\t    --fanout    Maximum number of child agents started by each agent\n");
     fprintf(stdout, "\t-h, --help      Display this text and exit\n");
 }
 
+// Return read block size for manifest extraction
+static size_t
+get_extract_block_size(void)
+{
+    char const* block_size_str = getenv(BE_EXTRACT_BLOCK_SIZE_VAR);
+    if (block_size_str != NULL) {
+        char *end = NULL;
+        errno = 0;
+        unsigned long block_size = strtoul(block_size_str, &end, 10);
+        if ((errno == 0) && (end != block_size_str) && (*end == '\0')
+         && (block_size >= MIN_EXTRACT_BLOCK_SIZE) && (block_size <= MAX_EXTRACT_BLOCK_SIZE)) {
+            return block_size;
+        }
+        fprintf(stderr, "%s: invalid %s value %s, using default\n", CTI_BE_DAEMON_BINARY, BE_EXTRACT_BLOCK_SIZE_VAR, block_size_str);
+    }
+
+    return DEFAULT_EXTRACT_BLOCK_SIZE;
+}
+
+// Set each "index:var=val" environment variable whose index matches that of a tool
+// daemon binary. Return 0 on success, 1 on error
+static int
+set_binary_env(cti_stack_t *binary_env_args, size_t index)
+{
+    unsigned int i;
+    char *spec, *end, *eq, *var;
+    unsigned long spec_index;
+
+    if (binary_env_args == NULL)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < binary_env_args->idx; i++)
+    {
+        spec = (char *)binary_env_args->elems[i];
+        spec_index = strtoul(spec, &end, 10);
+        if ((end == spec) || (*end != ':') || ((eq = strchr(end + 1, '=')) == NULL) || (eq == (end + 1)))
+        {
+            fprintf(stderr, "%s: Unrecognized binenv argument %s\n", CTI_BE_DAEMON_BINARY, spec);
+            return 1;
+        }
+        if (spec_index != index)
+        {
+            continue;
+        }
+
+        if ((var = strndup(end + 1, eq - (end + 1))) == NULL)
+        {
+            fprintf(stderr, "%s: strndup failed\n", CTI_BE_DAEMON_BINARY);
+            return 1;
+        }
+        if (setenv(var, eq + 1, 1) < 0)
+        {
+            fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
+            free(var);
+            return 1;
+        }
+        free(var);
+    }
+
+    return 0;
+}
+
+// Check each NUL-terminated "<size> <mtime> <path>" record in list, where an attribute
+// of -1 is not checked, and print a line with a hex bitmap of the paths that are
+// present with matching attributes. Return 0 on success, 1 on error
+static int
+check_file_records(char const* list, size_t list_len)
+{
+    int rc = 1;
+    unsigned char *bitmap = NULL;
+    size_t num_paths = 0;
+    char *line = NULL;
+    char const* record;
+    size_t i;
+
+    for (i = 0; i < list_len; i++) {
+        num_paths += (list[i] == '\0');
+    }
+    if ((bitmap = calloc((num_paths + 7) / 8, 1)) == NULL) {
+        perror("malloc");
+        goto cleanup_check_file_records;
+    }
+
+    i = 0;
+    for (record = list; record < (list + list_len); record += strlen(record) + 1, i++) {
+        char *end;
+        long long size, mtime;
+        struct stat path_st;
+
+        size = strtoll(record, &end, 10);
+        if (*end != ' ') { continue; }
+        mtime = strtoll(end + 1, &end, 10);
+        if (*end != ' ') { continue; }
+
+        if ((stat(end + 1, &path_st) == 0)
+         && ((size < 0) || (size == (long long)path_st.st_size))
+         && ((mtime < 0) || (mtime == (long long)path_st.st_mtime))) {
+            bitmap[i / 8] |= 1 << (i % 8);
+        }
+    }
+
+    // Write bitmap as a single line so that it is not interleaved with other nodes
+    if ((line = malloc(((num_paths + 7) / 8) * 2 + 2)) == NULL) {
+        perror("malloc");
+        goto cleanup_check_file_records;
+    }
+    for (i = 0; i < (num_paths + 7) / 8; i++) {
+        sprintf(line + (2 * i), "%02x", bitmap[i]);
+    }
+    strcpy(line + (2 * i), "\n");
+    fputs(line, stdout);
+    fflush(stdout);
+
+    rc = 0;
+
+cleanup_check_file_records:
+    free(line);
+    free(bitmap);
+
+    return rc;
+}
+
+// Check the records in the list file, then remove it, as it is shipped for a single
+// check. Return 0 on success, 1 on error
+static int
+check_file_list(char const* list_path)
+{
+    int rc = 1;
+    int fd = -1;
+    struct stat st;
+    char *list = NULL;
+    size_t list_len = 0;
+
+    // Read whole list
+    if (((fd = open(list_path, O_RDONLY | O_CLOEXEC)) < 0) || (fstat(fd, &st) < 0)) {
+        fprintf(stderr, "%s: failed to open file list %s: %s\n", CTI_BE_DAEMON_BINARY, list_path, strerror(errno));
+        goto cleanup_check_file_list;
+    }
+    if ((list = malloc(st.st_size + 1)) == NULL) {
+        perror("malloc");
+        goto cleanup_check_file_list;
+    }
+    while (list_len < (size_t)st.st_size) {
+        ssize_t num_read = read(fd, list + list_len, st.st_size - list_len);
+        if (num_read < 0) {
+            if (errno == EINTR) { continue; }
+            perror("read");
+            goto cleanup_check_file_list;
+        } else if (num_read == 0) {
+            break;
+        }
+        list_len += num_read;
+    }
+    list[list_len] = '\0';
+
+    unlink(list_path);
+
+    rc = check_file_records(list, list_len);
+
+cleanup_check_file_list:
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(list);
+
+    return rc;
+}
+
+// Check the newline-terminated records in list_data, passed as an argument where the
+// list can't be shipped. Return 0 on success, 1 on error
+static int
+check_file_data(char *list_data)
+{
+    size_t list_len = strlen(list_data);
+    size_t i;
+
+    // Records are checked in place with NUL terminators
+    for (i = 0; i < list_len; i++) {
+        if (list_data[i] == '\n') {
+            list_data[i] = '\0';
+        }
+    }
+
+    return check_file_records(list_data, list_len);
+}
+
+// Write a regular file entry directly, allocating its full size up front so that
+// the file system does not grow it block by block. An existing file is unlinked
+// and recreated as archive_write_disk does, never rewritten in place, as it may be
+// mapped or executed by a running tool daemon. Return 0 on success, 1 if the
+// entry should be extracted by archive_write_disk instead, -1 on error
+static int
+write_regular_file(struct archive *ar, struct archive_entry *entry)
+{
+    int rc = -1;
+    int fd = -1;
+    char const* pathname = archive_entry_pathname(entry);
+    int64_t size = archive_entry_size(entry);
+
+    // Leave links, special files, and any paths that need checking to libarchive
+    if ((archive_entry_filetype(entry) != AE_IFREG) || (archive_entry_hardlink(entry) != NULL)
+     || !archive_entry_size_is_set(entry) || (pathname == NULL) || (pathname[0] == '/')
+     || (strstr(pathname, "..") != NULL)) {
+        return 1;
+    }
+
+    // Parent directory may not exist yet, or existing path may not be removable,
+    // which libarchive will handle
+    if ((fd = open(pathname, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR)) < 0) {
+        if ((errno != EEXIST) || (unlink(pathname) < 0)) {
+            return 1;
+        }
+        if ((fd = open(pathname, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR)) < 0) {
+            return 1;
+        }
+    }
+
+    // Not all file systems support preallocation, the file is still written if not
+    if (size > 0) {
+        (void)fallocate(fd, 0, 0, size);
+    }
+
+    for (;;)
+    {
+        const void *buff;
+        size_t len;
+        off_t offset;
+
+        int r = archive_read_data_block(ar, &buff, &len, &offset);
+        if (r == ARCHIVE_EOF) {
+            break;
+        }
+        if (r != ARCHIVE_OK) {
+            fprintf(stderr, "%s: archive_read_data_block(): %s\n", CTI_BE_DAEMON_BINARY, archive_error_string(ar));
+            goto cleanup_write_regular_file;
+        }
+
+        while (len > 0) {
+            ssize_t written = pwrite(fd, buff, len, offset);
+            if (written < 0) {
+                if (errno == EINTR) { continue; }
+                fprintf(stderr, "%s: write %s: %s\n", CTI_BE_DAEMON_BINARY, pathname, strerror(errno));
+                goto cleanup_write_regular_file;
+            }
+            buff = (char const*)buff + written;
+            len -= written;
+            offset += written;
+        }
+    }
+
+    // Trailing sparse regions are not written, so set final size
+    if (ftruncate(fd, size) < 0) {
+        fprintf(stderr, "%s: ftruncate %s: %s\n", CTI_BE_DAEMON_BINARY, pathname, strerror(errno));
+        goto cleanup_write_regular_file;
+    }
+
+    // Set permissions from archive without applying umask
+    if (fchmod(fd, archive_entry_perm(entry)) < 0) {
+        fprintf(stderr, "%s: fchmod %s: %s\n", CTI_BE_DAEMON_BINARY, pathname, strerror(errno));
+        goto cleanup_write_regular_file;
+    }
+
+    rc = 0;
+
+cleanup_write_regular_file:
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+
+    return rc;
+}
+
 static int
 copy_data(struct archive *ar, struct archive *aw)
 {
@@ -162,377 +495,812 @@ do_lock(int fd, int cmd, int type, off_t offset, int whence, off_t len)
 #define FLOCK(fd)       do_lock((fd), F_SETLK, F_WRLCK, 0, SEEK_SET, 0)
 #define UNFLOCK(fd) do_lock((fd), F_SETLK, F_UNLCK, 0, SEEK_SET, 0)
 
-void
-remove_dir(char *path)
+// Grow the pid registry file to hold at least num_slots, doubling to amortize growth.
+// Return the size of the file, or 0 on failure
+static size_t
+grow_pid_registry(int fd, size_t num_slots)
 {
-    DIR *               dir;
-    struct dirent *     d;
-    char *              file = NULL;
+    struct stat     st;
+    size_t          size = 0;
+    size_t          new_size;
+    uint32_t        magic = PID_REGISTRY_MAGIC;
 
-    if ((dir = opendir(path)) == NULL)
+    // wait for other writers that are growing the file
+    if (do_lock(fd, F_SETLKW, F_WRLCK, 0, SEEK_SET, 0) < 0)
     {
-        return;
+        perror("fcntl");
+        return 0;
     }
 
-    while ((d = readdir(dir)) != NULL)
+    if (fstat(fd, &st) < 0)
     {
-        // ensure this isn't the . or .. file
-        switch (strlen(d->d_name))
-        {
-            case 1:
-                if (d->d_name[0] == '.')
-                {
-                    // continue to the outer while loop
-                    continue;
-                }
-                break;
+        perror("fstat");
+        goto cleanup_grow_pid_registry;
+    }
 
-            case 2:
-                if (strcmp(d->d_name, "..") == 0)
-                {
-                    // continue to the outer while loop
-                    continue;
-                }
-                break;
+    new_size = offsetof(cti_pid_registry_t, pids) + num_slots * sizeof(pid_t);
+    if ((size_t)st.st_size >= new_size)
+    {
+        size = st.st_size;
+        goto cleanup_grow_pid_registry;
+    }
+    if (((size_t)st.st_size * 2) > new_size)
+    {
+        new_size = st.st_size * 2;
+    }
 
-            default:
-                break;
-        }
+    // new slots are zero filled
+    if (ftruncate(fd, new_size) < 0)
+    {
+        perror("ftruncate");
+        goto cleanup_grow_pid_registry;
+    }
+    if ((st.st_size == 0) && (pwrite(fd, &magic, sizeof(magic), 0) != sizeof(magic)))
+    {
+        perror("pwrite");
+        goto cleanup_grow_pid_registry;
+    }
+    size = new_size;
+
+cleanup_grow_pid_registry:
+    UNFLOCK(fd);
+
+    return size;
+}
+
+// Add pids to the pid registry file for cleanup. Return 0 on success, 1 on failure
+static int
+register_pids(char const* pid_path, pid_t const* pids, size_t num_pids)
+{
+    int                     fd;
+    size_t                  size;
+    cti_pid_registry_t *    registry = MAP_FAILED;
+    uint32_t                idx;
+    size_t                  i;
+    int                     rc = 1;
+
+    if ((fd = open(pid_path, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR)) < 0)
+    {
+        fprintf(stderr, "%s: open failed\n", CTI_BE_DAEMON_BINARY);
+        perror("open");
+        return 1;
+    }
 
-        if (asprintf(&file, "%s/%s", path, d->d_name) <= 0)
+    // create the file if this is the first registration
+    if ((size = grow_pid_registry(fd, PID_REGISTRY_INITIAL_SLOTS)) == 0)
+    {
+        goto cleanup_register_pids;
+    }
+    if ((registry = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        perror("mmap");
+        goto cleanup_register_pids;
+    }
+
+    // claim slots, then grow the file if they are past its end
+    idx = __atomic_fetch_add(&registry->count, (uint32_t)num_pids, __ATOMIC_ACQ_REL);
+    if ((offsetof(cti_pid_registry_t, pids) + (idx + num_pids) * sizeof(pid_t)) > size)
+    {
+        munmap(registry, size);
+        registry = MAP_FAILED;
+        if ((size = grow_pid_registry(fd, idx + num_pids)) == 0)
         {
-            fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
-            continue;
+            goto cleanup_register_pids;
         }
-
-        if (d->d_type == DT_DIR)
+        if ((registry = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
         {
-            remove_dir(file);
+            perror("mmap");
+            goto cleanup_register_pids;
         }
+    }
+
+    for (i = 0; i < num_pids; i++)
+    {
+        __atomic_store_n(&registry->pids[idx + i], pids[i], __ATOMIC_RELEASE);
+    }
+    rc = 0;
 
-        remove(file);
-        free(file);
-        file = NULL;
+cleanup_register_pids:
+    if (registry != MAP_FAILED)
+    {
+        munmap(registry, size);
     }
+    close(fd);
 
-    closedir(dir);
-    remove(path);
+    return rc;
 }
 
-// Check directory bin and lib files for any in use
-// On failure, assume directory is in use
-static int
-session_files_in_use(char const* directory)
+// Read a snapshot of the pids in the pid registry file. Slots that were claimed but
+// not yet written are skipped. Return a malloc'd array, or NULL on failure
+static pid_t *
+read_pids(char const* pid_path, size_t *num_pids)
 {
-    int rc = 1;
-
-    char *lsof_cmd = NULL;
-    pid_t lsof_pid = -1;
+    int                     fd;
+    struct stat             st;
+    cti_pid_registry_t *    registry = MAP_FAILED;
+    size_t                  num_slots = 0;
+    pid_t *                 pids = NULL;
+    pid_t                   pid;
+    size_t                  i;
 
-    // Create lsof command
-    char const* lsof_argv[] = {"lsof", "-t", directory, NULL};
+    *num_pids = 0;
 
-    // Fork / exec lsof
-    lsof_pid = fork();
-    if (lsof_pid < 0) {
-        perror("fork");
-        goto cleanup_session_files_in_use;
+    if ((fd = open(pid_path, O_RDONLY | O_CLOEXEC)) < 0)
+    {
+        fprintf(stderr, "%s: open failed\n", CTI_BE_DAEMON_BINARY);
+        perror("open");
+        return NULL;
     }
 
-    // Subprocess case, exec lsof
-    if (lsof_pid == 0) {
-        execvp("lsof", (char* const*)lsof_argv);
-        perror("execvp");
-        _exit(-1);
+    if (fstat(fd, &st) < 0)
+    {
+        perror("fstat");
+        goto cleanup_read_pids;
     }
 
-cleanup_session_files_in_use:
+    if ((size_t)st.st_size >= offsetof(cti_pid_registry_t, pids))
+    {
+        if ((registry = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+        {
+            perror("mmap");
+            goto cleanup_read_pids;
+        }
+        if (registry->magic != PID_REGISTRY_MAGIC)
+        {
+            fprintf(stderr, "%s: %s is not a pid registry\n", CTI_BE_DAEMON_BINARY, pid_path);
+            goto cleanup_read_pids;
+        }
 
-    // Wait for lsof and set return code
-    if (lsof_pid > 0) {
+        // slots past the end of the mapping belong to a writer that is growing the file
+        num_slots = (st.st_size - offsetof(cti_pid_registry_t, pids)) / sizeof(pid_t);
+        if (__atomic_load_n(&registry->count, __ATOMIC_ACQUIRE) < num_slots)
+        {
+            num_slots = registry->count;
+        }
+    }
 
-        int lsof_status;
-        while (1) {
-            int waitpid_rc = waitpid(lsof_pid, &lsof_status, 0);
-            if (waitpid_rc < 0) {
-                if (errno == EINTR) { continue; }
-                else if (errno == ECHILD) { break; }
-                perror("waitpid");
-                break;
-            }
-            if (WIFEXITED(lsof_status) && (WEXITSTATUS(lsof_status) == 1)) {
-                rc = 0;
-            }
-            break;
+    if ((pids = malloc((num_slots + 1) * sizeof(pid_t))) == NULL)
+    {
+        fprintf(stderr, "%s: malloc failed\n", CTI_BE_DAEMON_BINARY);
+        goto cleanup_read_pids;
+    }
+    for (i = 0; i < num_slots; i++)
+    {
+        if ((pid = __atomic_load_n(&registry->pids[i], __ATOMIC_ACQUIRE)) > 0)
+        {
+            pids[(*num_pids)++] = pid;
         }
-        lsof_pid = -1;
     }
 
-    // Free generated lsof command
-    if (lsof_cmd != NULL) {
-        free(lsof_cmd);
-        lsof_cmd = NULL;
+cleanup_read_pids:
+    if (registry != MAP_FAILED)
+    {
+        munmap(registry, st.st_size);
     }
+    close(fd);
 
-    return rc;
+    return pids;
 }
 
-// Return 0 if directory exists, 1 if succeeded, -1 on error
-int recursive_mkdir(char const* path)
+// Interval to recheck lock files while waiting on inotify, in case events are missed
+#define LOCK_RECHECK_MS 1000
+
+// Return true if name is the . or .. entry
+static bool
+is_dot_entry(char const* name)
 {
-    if (path == NULL) {
-        return -1;
+    return (name[0] == '.') && ((name[1] == '\0') || ((name[1] == '.') && (name[2] == '\0')));
+}
+
+// Remove the entry name in directory parent_fd and everything below it. Entries are
+// opened and unlinked relative to their parent directory, so no paths are built
+static void
+remove_dir_at(int parent_fd, char const* name)
+{
+    int                 dir_fd;
+    DIR *               dir;
+    struct dirent *     d;
+
+    if ((dir_fd = openat(parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)) < 0)
+    {
+        // not a directory
+        unlinkat(parent_fd, name, 0);
+        return;
     }
 
-    // Check directory
-    struct stat st;
-    if ((stat(path, &st) == 0) && S_ISDIR(st.st_mode)) {
-        return 0;
+    if ((dir = fdopendir(dir_fd)) == NULL)
+    {
+        close(dir_fd);
+        unlinkat(parent_fd, name, AT_REMOVEDIR);
+        return;
     }
 
-    // Run mkdir command
-    char const* mkdir_argv[] = {"mkdir", "-p", path, NULL};
-    pid_t mkdir_pid = fork();
-    if (mkdir_pid < 0) {
-        return -1;
-    } else if (mkdir_pid == 0) {
-        execvp("mkdir", (char* const*)mkdir_argv);
-        exit(-1);
-    }
-    int mkdir_status = -1;
-    while (1) {
-        int waitpid_rc = waitpid(mkdir_pid, &mkdir_status, 0);
-        if (waitpid_rc < 0) {
-            if (errno == EINTR) {
-                continue;
-            } else {
-                return waitpid_rc;
-            }
-        } else {
-            return (mkdir_status == 0) ? 1 : -1;
+    while ((d = readdir(dir)) != NULL)
+    {
+        if (is_dot_entry(d->d_name))
+        {
+            continue;
+        }
+
+        if (d->d_type == DT_DIR)
+        {
+            remove_dir_at(dir_fd, d->d_name);
+        }
+        else if ((unlinkat(dir_fd, d->d_name, 0) < 0) && (errno == EISDIR))
+        {
+            // file system did not report the entry type
+            remove_dir_at(dir_fd, d->d_name);
         }
     }
+
+    closedir(dir);
+    unlinkat(parent_fd, name, AT_REMOVEDIR);
 }
 
-int
-main(int argc, char **argv)
+// Entries to remove in parallel, each relative to its parent directory
+struct remove_work
 {
-    struct rlimit   rl;
-    int             opt_ind = 0;
-    int             c, i, sCnt;
-    bool            cleanup = false;
-    int             wlm_arg = CTI_WLM_NONE;
-    char *          wlm_str;
-    char *          apid_str = NULL;
-    char *          tool_path = NULL;
-    char *          attribs_path = NULL;
-    char *          ld_lib_path = NULL;
-    FILE *          log = NULL;
-    struct stat     statbuf;
-    char *          binary = NULL;
-    char *          binary_path;
-    char *          directory = NULL;
-    char *          manifest = NULL;
-    int             inst = 1;   // default to 1 if no instance argument is provided
-    char *          manifest_path = NULL;
-    int             o_fd;
-    char *          lock_path = NULL;
-    FILE *          lock_file;
-    pid_t           mypid = -1;
-    char *          pid_path = NULL;
-    char *          bin_path = NULL;
-    char *          lib_path = NULL;
-    char *          file_path = NULL;
-    cti_stack_t *   env_args = NULL;
-    char            *env, *val, *t;
-    char *          old_env_path = NULL;
-    char *          env_path = NULL;
-    int                     r, flags = 0;
-    struct archive *        a;
-    struct archive *        ext;
-    struct archive_entry *  entry;
-    char *                  cwd;
-    int file_check_mode = 0;
+    int *               parent_fds;
+    char **             names;
+    int *               dir_fds;    // fd of each directory entry expanded into its contents, or -1
+    size_t              num_entries;
+    size_t              next;
+};
 
-    // we require at least 1 argument beyond argv[0]
-    if (argc < 2)
+static void *
+remove_worker(void *arg)
+{
+    struct remove_work *work = arg;
+    size_t              idx;
+
+    while ((idx = __atomic_fetch_add(&work->next, 1, __ATOMIC_RELAXED)) < work->num_entries)
     {
-        usage();
-        return 1;
+        if (work->dir_fds[idx] < 0)
+        {
+            remove_dir_at(work->parent_fds[idx], work->names[idx]);
+        }
     }
 
-    chmod(argv[0], S_IRUSR|S_IWUSR|S_IXUSR|S_IRGRP|S_IWGRP|S_IXGRP|S_IROTH|S_IWOTH|S_IXOTH);
+    return NULL;
+}
 
-    // We want to do as little as possible while parsing the opts. This is because
-    // we do not create a log file until after the opts are parsed, and there will
-    // be no valid output until after the log is created on most systems.
-    while ((c = getopt_long(argc, argv, "a:b:cd:e:i:m:p:t:l:w:h", long_opts, &opt_ind)) != -1)
+// Append entries of directory dir_fd to the work list. Return 0 on success, -1 on failure
+static int
+add_remove_work(struct remove_work *work, size_t *capacity, int dir_fd)
+{
+    int                 list_fd;
+    DIR *               dir;
+    struct dirent *     d;
+
+    if (((list_fd = dup(dir_fd)) < 0) || ((dir = fdopendir(list_fd)) == NULL))
     {
-        switch (c)
+        if (list_fd >= 0)
         {
-            case 0:
-                // if this is a flag, do nothing
-                break;
-
-            case 'a':
-                // strip leading whitespace
-                while (*optarg == ' ')
-                {
-                    ++optarg;
-                }
+            close(list_fd);
+        }
+        return -1;
+    }
 
-                // this is the application id that is WLM specific
-                apid_str = strdup(optarg);
+    while ((d = readdir(dir)) != NULL)
+    {
+        if (is_dot_entry(d->d_name))
+        {
+            continue;
+        }
 
-                break;
+        if (work->num_entries == *capacity)
+        {
+            size_t new_capacity = (*capacity > 0) ? (*capacity * 2) : 64;
+            int *new_fds = realloc(work->parent_fds, new_capacity * sizeof(int));
+            if (new_fds != NULL)
+            {
+                work->parent_fds = new_fds;
+            }
+            char **new_names = realloc(work->names, new_capacity * sizeof(char*));
+            if (new_names != NULL)
+            {
+                work->names = new_names;
+            }
+            int *new_dir_fds = realloc(work->dir_fds, new_capacity * sizeof(int));
+            if (new_dir_fds != NULL)
+            {
+                work->dir_fds = new_dir_fds;
+            }
+            if ((new_fds == NULL) || (new_names == NULL) || (new_dir_fds == NULL))
+            {
+                closedir(dir);
+                return -1;
+            }
+            *capacity = new_capacity;
+        }
 
-            case 'b':
-                // strip leading whitespace
-                while (*optarg == ' ')
-                {
-                    ++optarg;
-                }
+        if ((work->names[work->num_entries] = strdup(d->d_name)) == NULL)
+        {
+            closedir(dir);
+            return -1;
+        }
+        work->dir_fds[work->num_entries] = -1;
+        work->parent_fds[work->num_entries++] = dir_fd;
+    }
 
-                // this is the name of the binary we will exec
-                binary = strdup(optarg);
+    closedir(dir);
+    return 0;
+}
 
-                break;
+// Remove path and everything below it. With more than one thread, subdirectories are
+// expanded breadth first until there are a few entries per thread, then the entries
+// are removed by a pool of threads and the expanded directories removed afterwards
+void
+remove_dir(char const* path, int num_threads)
+{
+    struct remove_work  work = {NULL, NULL, NULL, 0, 0};
+    size_t              capacity = 0;
+    size_t              num_expanded = 0;
+    pthread_t *         threads = NULL;
+    int                 num_started = 0;
+    int                 root_fd = -1;
+    size_t              i;
+
+    if (num_threads <= 1)
+    {
+        remove_dir_at(AT_FDCWD, path);
+        return;
+    }
 
-            case 'c':
-                // set cleanup to true
-                cleanup = true;
+    if ((root_fd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)) < 0)
+    {
+        unlink(path);
+        return;
+    }
 
-                break;
+    if (add_remove_work(&work, &capacity, root_fd) < 0)
+    {
+        goto cleanup_remove_dir;
+    }
 
-            case 'd':
-                // strip leading whitespace
-                while (*optarg == ' ')
-                {
-                    ++optarg;
-                }
+    // Replace directory entries with their contents while there are too few to share.
+    // Expanded directories keep their fd open as the parent of their entries
+    for (i = 0; (i < work.num_entries) && ((work.num_entries - num_expanded) < (size_t)num_threads * 4); i++)
+    {
+        if ((work.dir_fds[i] = openat(work.parent_fds[i], work.names[i],
+            O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)) < 0)
+        {
+            // not a directory, leave it for the pool
+            continue;
+        }
 
-                // this is the name of the existing directory we should cd to
-                directory = strdup(optarg);
+        num_expanded++;
+        if (add_remove_work(&work, &capacity, work.dir_fds[i]) < 0)
+        {
+            break;
+        }
+    }
 
+    // Run the pool, with this thread as one of the workers
+    if ((threads = calloc(num_threads - 1, sizeof(pthread_t))) != NULL)
+    {
+        for (num_started = 0; num_started < num_threads - 1; num_started++)
+        {
+            if (pthread_create(&threads[num_started], NULL, remove_worker, &work) != 0)
+            {
                 break;
+            }
+        }
+    }
+    remove_worker(&work);
+    for (i = 0; i < (size_t)num_started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
 
-            case 'e':
-                // strip leading whitespace
-                while (*optarg == ' ')
-                {
-                    ++optarg;
-                }
-
-                // this is an optional option to set user defined environment variables
-                if (env_args == NULL)
-                {
-                    // create the string list
-                    if ((env_args = _cti_newStack()) == NULL)
-                    {
-                        // failed to create stack - shouldn't happen
-                        fprintf(stderr, "%s: _cti_newStack() failed.\n", CTI_BE_DAEMON_BINARY);
-                        return 1;
-                    }
-                }
+cleanup_remove_dir:
+    // Remove expanded directories, deepest first, and anything the pool did not reach
+    for (i = work.num_entries; i > 0; i--)
+    {
+        if (work.dir_fds[i - 1] >= 0)
+        {
+            close(work.dir_fds[i - 1]);
+            unlinkat(work.parent_fds[i - 1], work.names[i - 1], AT_REMOVEDIR);
+        }
+        else if (work.next < i)
+        {
+            remove_dir_at(work.parent_fds[i - 1], work.names[i - 1]);
+        }
+        free(work.names[i - 1]);
+    }
+    free(work.names);
+    free(work.parent_fds);
+    free(work.dir_fds);
+    free(threads);
+    close(root_fd);
 
-                if (_cti_push(env_args, strdup(optarg)))
-                {
-                    // failed to push the string - shouldn't happen
-                    fprintf(stderr, "%s: _cti_push() failed.\n", CTI_BE_DAEMON_BINARY);
-                    return 1;
-                }
+    // Fall back to a single thread if any entries were left behind
+    if ((rmdir(path) < 0) && ((errno == ENOTEMPTY) || (errno == EEXIST)))
+    {
+        remove_dir_at(AT_FDCWD, path);
+    }
+}
 
-                break;
+// Mark each directory whose path is a prefix of path
+static void
+mark_path_in_use(char const* path, char **dirs, size_t *dir_lens, bool *in_use, size_t num_dirs)
+{
+    size_t i;
+    for (i = 0; i < num_dirs; i++) {
+        if (!in_use[i] && (strncmp(path, dirs[i], dir_lens[i]) == 0)
+         && ((path[dir_lens[i]] == '/') || (path[dir_lens[i]] == '\0'))) {
+            in_use[i] = true;
+        }
+    }
+}
 
-            case 'f':
-                if (access(optarg, F_OK) == 0) {
-                    fprintf(stdout, "%s\n", optarg);
-                }
-                file_check_mode = 1;
-                break;
+// Mark directories containing files that are open, mapped, or used as the
+// working directory or executable by any process this user can inspect. Only
+// processes owned by this user are checked, as with running lsof unprivileged.
+// Directories must be canonical paths. Return 0 on success, -1 on failure
+static int
+mark_dirs_in_use(char **dirs, bool *in_use, size_t num_dirs)
+{
+    DIR *proc_dir = NULL;
+    struct dirent *proc_ent;
+    uid_t uid = geteuid();
+    size_t *dir_lens = NULL;
+    char *line = NULL;
+    size_t line_len = 0;
+    size_t i;
+
+    if (num_dirs == 0) {
+        return 0;
+    }
 
-            case 'i':
-                // This is our instance number. We need to wait for all those
-                // before us to finish their work before proceeding.
-                inst = atoi(optarg);
+    if ((dir_lens = malloc(num_dirs * sizeof(size_t))) == NULL) {
+        return -1;
+    }
+    for (i = 0; i < num_dirs; i++) {
+        dir_lens[i] = strlen(dirs[i]);
+    }
 
-                break;
+    if ((proc_dir = opendir("/proc")) == NULL) {
+        perror("opendir");
+        free(dir_lens);
+        return -1;
+    }
 
-            case 'm':
-                // strip leading whitespace
-                while (*optarg == ' ')
-                {
-                    ++optarg;
-                }
+    while ((proc_ent = readdir(proc_dir)) != NULL) {
+        char target[PATH_MAX];
+        struct stat st;
+        ssize_t target_len;
+        int pid_fd;
 
-                // this is the name of the manifest tarball we will extract
-                manifest = strdup(optarg);
+        // Process directories are numeric
+        if ((proc_ent->d_name[0] < '0') || (proc_ent->d_name[0] > '9')) {
+            continue;
+        }
 
-                break;
+        // Processes may exit while scanning, skip them along with other users' processes
+        if (((pid_fd = openat(dirfd(proc_dir), proc_ent->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)) {
+            continue;
+        }
+        if ((fstat(pid_fd, &st) < 0) || (st.st_uid != uid)) {
+            close(pid_fd);
+            continue;
+        }
 
-            case 'p':
-                // strip leading whitespace
-                while (*optarg == ' ')
-                {
-                    ++optarg;
-                }
+        // Working directory and executable
+        if ((target_len = readlinkat(pid_fd, "cwd", target, sizeof(target) - 1)) > 0) {
+            target[target_len] = '\0';
+            mark_path_in_use(target, dirs, dir_lens, in_use, num_dirs);
+        }
+        if ((target_len = readlinkat(pid_fd, "exe", target, sizeof(target) - 1)) > 0) {
+            target[target_len] = '\0';
+            mark_path_in_use(target, dirs, dir_lens, in_use, num_dirs);
+        }
 
-                // this is the tool path argument where we should cd to
-                tool_path = strdup(optarg);
+        // Open files
+        { int fd_dir_fd;
+            DIR *fd_dir;
+            struct dirent *fd_ent;
 
-                break;
+            if (((fd_dir_fd = openat(pid_fd, "fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) >= 0)
+             && ((fd_dir = fdopendir(fd_dir_fd)) != NULL)) {
+                while ((fd_ent = readdir(fd_dir)) != NULL) {
+                    if (fd_ent->d_name[0] == '.') {
+                        continue;
+                    }
+                    if ((target_len = readlinkat(fd_dir_fd, fd_ent->d_name, target, sizeof(target) - 1)) > 0) {
+                        target[target_len] = '\0';
+                        mark_path_in_use(target, dirs, dir_lens, in_use, num_dirs);
+                    }
+                }
+                closedir(fd_dir);
+            } else if (fd_dir_fd >= 0) {
+                close(fd_dir_fd);
+            }
+        }
 
-            case 't':
-                // strip leading whitespace
-                while (*optarg == ' ')
-                {
-                    ++optarg;
+        // Mapped files, such as loaded libraries. The paths in map_files can only be
+        // read with CAP_SYS_ADMIN, but maps is readable for the user's own processes
+        { int maps_fd;
+            FILE *maps_file;
+
+            if (((maps_fd = openat(pid_fd, "maps", O_RDONLY | O_CLOEXEC)) >= 0)
+             && ((maps_file = fdopen(maps_fd, "r")) != NULL)) {
+                while (getline(&line, &line_len, maps_file) > 0) {
+                    char *map_path = strchr(line, '/');
+                    char *newline;
+                    if (map_path == NULL) {
+                        continue;
+                    }
+                    if ((newline = strchr(map_path, '\n')) != NULL) {
+                        *newline = '\0';
+                    }
+                    mark_path_in_use(map_path, dirs, dir_lens, in_use, num_dirs);
                 }
+                fclose(maps_file);
+            } else if (maps_fd >= 0) {
+                close(maps_fd);
+            }
+        }
 
-                // this is the pmi_attribs path argument to find the attribs file
-                // This is optional, some implementations might not use it.
-                attribs_path = strdup(optarg);
+        close(pid_fd);
+    }
 
-                break;
+    closedir(proc_dir);
+    free(line);
+    free(dir_lens);
 
-            case 'l':
-                // strip leading whitespace
-                while (*optarg == ' ')
-                {
-                    ++optarg;
-                }
+    return 0;
+}
 
-                // this is the argument to set LD_LIBRARY_PATH envvar
-                // This is optional, some implementations might not use it.
-                ld_lib_path = strdup(optarg);
+// Remove directories detached by cleanup, and directories of past sessions that are
+// no longer in use
+static void
+remove_unused_dirs(char const* tool_path, int inst, int num_threads)
+{
+    struct dirent *dir_ent = NULL;
+    DIR *dir_ptr = NULL;
+    size_t prefix_len = strlen(STAGE_DIR_PREFIX);
+    size_t trash_prefix_len = strlen(TRASH_DIR_PREFIX);
+    char **dirs = NULL;
+    bool *in_use = NULL;
+    size_t num_dirs = 0;
+    size_t i;
+
+    // Collect all cti_daemon directories in tool_path this user can remove
+    if ((dir_ptr = opendir(tool_path)) == NULL) {
+        perror("opendir");
+    }
+    while ((dir_ptr != NULL) && ((dir_ent = readdir(dir_ptr)) != NULL)) {
+        char* full_path = NULL;
+        char** new_dirs = NULL;
+
+        // Directories detached by a previous cleanup are no longer in use
+        if (strncmp(dir_ent->d_name, TRASH_DIR_PREFIX, trash_prefix_len) == 0) {
+            if (asprintf(&full_path, "%s/%s", tool_path, dir_ent->d_name) <= 0) {
+                perror("asprintf");
+                continue;
+            }
+            fprintf(stderr, "%s: inst %d: Removing detached directory %s.\n", CTI_BE_DAEMON_BINARY, inst, full_path);
+            remove_dir(full_path, num_threads);
+            free(full_path);
+            continue;
+        }
 
-                break;
+        // Check to see if directory starts with session prefix
+        if (strncmp(dir_ent->d_name, STAGE_DIR_PREFIX, prefix_len)) {
+            continue;
+        }
 
-            case 'w':
-                // this is the wlm value that we should use
-                wlm_arg = atoi(optarg);
+        // Create full directory path
+        if (asprintf(&full_path, "%s/%s", tool_path, dir_ent->d_name) <= 0) {
+            perror("asprintf");
+            continue;
+        }
 
-                break;
+        // Check to see if user has write access to directory
+        if (access(full_path, W_OK)) {
+            free(full_path);
+            continue;
+        }
 
-            case 'h':
-                usage();
-                return 0;
-            default:
-                usage();
-                return 1;
+        // Compare against canonical paths reported by /proc
+        { char *canonical_path = realpath(full_path, NULL);
+            free(full_path);
+            if (canonical_path == NULL) {
+                continue;
+            }
+            full_path = canonical_path;
         }
-    }
 
-    // If started in file check mode, don't start daemon
-    if (file_check_mode) {
-        fprintf(stdout, "\n");
-        return 0;
+        if ((new_dirs = realloc(dirs, (num_dirs + 1) * sizeof(char*))) == NULL) {
+            perror("realloc");
+            free(full_path);
+            continue;
+        }
+        dirs = new_dirs;
+        dirs[num_dirs++] = full_path;
+    }
+    if (dir_ptr != NULL) {
+        closedir(dir_ptr);
     }
 
-    // Start becoming a daemon
-
-    // clear file creation mask
-    umask(0);
+    // Check all directories for usage in a single pass over running processes
+    if ((num_dirs > 0) && ((in_use = calloc(num_dirs, sizeof(bool))) != NULL)
+     && (mark_dirs_in_use(dirs, in_use, num_dirs) == 0)) {
+
+        for (i = 0; i < num_dirs; i++) {
+            if (in_use[i]) {
+                continue;
+            }
+
+            // Remove unused directory
+            fprintf(stderr, "%s: inst %d: Removing unused directory %s.\n", CTI_BE_DAEMON_BINARY, inst, dirs[i]);
+            remove_dir(dirs[i], num_threads);
+        }
+    }
+
+    // On failure, assume directories are in use
+    for (i = 0; i < num_dirs; i++) {
+        free(dirs[i]);
+    }
+    free(dirs);
+    free(in_use);
+}
+
+// Return 0 if directory exists, 1 if succeeded, -1 on error
+int recursive_mkdir(char const* path)
+{
+    if ((path == NULL) || (path[0] == '\0')) {
+        return -1;
+    }
+
+    // Check directory
+    struct stat st;
+    if ((stat(path, &st) == 0) && S_ISDIR(st.st_mode)) {
+        return 0;
+    }
+
+    // Create each missing component in turn, as with mkdir -p
+    char *dir_path = strdup(path);
+    if (dir_path == NULL) {
+        return -1;
+    }
+    char *end = dir_path;
+    do {
+        end++;
+        if ((*end != '/') && (*end != '\0')) {
+            continue;
+        }
+
+        char const saved = *end;
+        *end = '\0';
+        if ((mkdir(dir_path, S_IRWXU | S_IRWXG | S_IRWXO) < 0) && (errno != EEXIST)) {
+            free(dir_path);
+            return -1;
+        }
+        *end = saved;
+    } while (*end != '\0');
+    free(dir_path);
+
+    return ((stat(path, &st) == 0) && S_ISDIR(st.st_mode)) ? 1 : -1;
+}
+
+// Wait until the lock files of all previous instances exist. Lock files are
+// created in tool_path, so its creation events are watched with inotify and
+// this instance sleeps until one arrives. Falls back to polling if inotify is
+// not available. Return 0 on success, -1 on error
+static int
+wait_for_lock_files(char const* tool_path, char const* directory, int inst, FILE* log, bool debug_flag)
+{
+    int rc = -1;
+    int inotify_fd = -1;
+    char *lock_path = NULL;
+    int next = inst - 1; // highest instance not yet known to have a lock file
+    bool logged = false;
+
+    if (next < 1) {
+        return 0;
+    }
+
+    // Start watching before checking, so that a lock file created after it is
+    // checked will still generate an event
+    inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if ((inotify_fd >= 0) && (inotify_add_watch(inotify_fd, tool_path, IN_CREATE | IN_MOVED_TO) < 0)) {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+    if ((inotify_fd < 0) && debug_flag) {
+        _cti_write_log(log, "%s: inst %d: inotify unavailable (%s), polling for lock files\n", CTI_BE_DAEMON_BINARY, inst, strerror(errno));
+    }
+
+    while (next > 0) {
+
+        // create the path to the next lock file to check
+        if (asprintf(&lock_path, "%s/.lock_%s_%d", tool_path, directory, next) <= 0)
+        {
+            fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
+            lock_path = NULL;
+            goto cleanup_wait_for_lock_files;
+        }
+
+        if (access(lock_path, F_OK) == 0) {
+            free(lock_path);
+            lock_path = NULL;
+            next--;
+            logged = false;
+            continue;
+        }
+
+        if (debug_flag && !logged) {
+            _cti_write_log(log, "%s: inst %d: Lock file %s not found. Waiting...\n", CTI_BE_DAEMON_BINARY, inst, lock_path);
+            logged = true;
+        }
+        free(lock_path);
+        lock_path = NULL;
+
+        // Without inotify, sleep until the file is created
+        if (inotify_fd < 0) {
+            usleep(10000);
+            continue;
+        }
+
+        // Wait for a file to be created in the tool directory, then drain events
+        // and recheck. Any event may be the lock file this instance is waiting on
+        struct pollfd pfd = { inotify_fd, POLLIN, 0 };
+        if ((poll(&pfd, 1, LOCK_RECHECK_MS) < 0) && (errno != EINTR)) {
+            perror("poll");
+            close(inotify_fd);
+            inotify_fd = -1;
+            continue;
+        }
+        if (pfd.revents & POLLIN) {
+            char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+            while (read(inotify_fd, events, sizeof(events)) > 0) {}
+        }
+    }
+
+    rc = 0;
+
+cleanup_wait_for_lock_files:
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+
+    return rc;
+}
+
+// Close every file descriptor starting at first_fd
+static void
+close_fds_from(int first_fd)
+{
+    struct rlimit   rl;
+    DIR *           dir;
+    struct dirent * d;
+    int             fd;
+    rlim_t          i;
+
+#ifdef SYS_close_range
+    if (syscall(SYS_close_range, first_fd, ~0U, 0) == 0)
+    {
+        return;
+    }
+#endif
+
+    // Without close_range, close only the descriptors listed as open
+    if ((dir = opendir("/proc/self/fd")) != NULL)
+    {
+        while ((d = readdir(dir)) != NULL)
+        {
+            fd = atoi(d->d_name);
+            if ((d->d_name[0] != '.') && (fd >= first_fd) && (fd != dirfd(dir)))
+            {
+                close(fd);
+            }
+        }
+        closedir(dir);
+        return;
+    }
 
     // get max number of file descriptors
     if (getrlimit(RLIMIT_NOFILE, &rl) < 0)
@@ -546,871 +1314,2226 @@ main(int argc, char **argv)
         rl.rlim_max = 1024;
     }
 
-    // Ensure every file descriptor is closed
-    for (i=0; i < rl.rlim_max; ++i)
+    for (i = first_fd; i < rl.rlim_max; ++i)
     {
         close(i);
     }
+}
 
-    /*
-    * We close channels 0-2 to keep things "clean".
-    * Unfortuantely, that means that any file opens that I do will
-    * have them available. If I open my log file, for instance, it
-    * will get channel 0 and that just doesn't seem safe. So, the lines
-    * below open (and waste) three channels such that I am guaranteed
-    * that future opens will not get them 0-2. Note that the opens may
-    * or may not get all/any of 0-2, but should they be available, they
-    * will be gotten.
-    * This, of course, must happen "early" before any other opens.
-    *
-    */
-    open("/dev/null", O_RDONLY);
-    open("/dev/null", O_WRONLY);
-    open("/dev/null", O_WRONLY);
+// Startup phases timed for the debug log, each ending at its timestamp
+enum startup_phase
+{
+    STARTUP_BEGIN,
+    STARTUP_ARGS,
+    STARTUP_FD_CLOSE,
+    STARTUP_CHDIR,
+    STARTUP_EXTRACT,
+    STARTUP_LOCK_WAIT,
+    STARTUP_EXEC,
+    NUM_STARTUP_PHASES
+};
 
-    // Setup the wlm arg without error checking so that we can create a debug
-    // log if asked to. We will error check below.
-    switch (wlm_arg)
-    {
-#ifdef HAVE_ALPS
-        case CTI_WLM_ALPS:
-            _cti_wlmProto = &_cti_alps_wlmProto;
-            break;
-#endif
+static char const* startup_phase_names[NUM_STARTUP_PHASES] =
+    { "begin", "args", "fd close", "chdir", "extract", "lock wait", "exec" };
 
-#ifdef HAVE_PALS
-        case CTI_WLM_PALS:
-            _cti_wlmProto = &_cti_pals_wlmProto;
-            break;
-#endif
+static void
+mark_startup_phase(struct timespec *startup_times, enum startup_phase phase)
+{
+    clock_gettime(CLOCK_MONOTONIC, &startup_times[phase]);
+}
 
-        case CTI_WLM_SLURM:
-            _cti_wlmProto = &_cti_slurm_wlmProto;
-            break;
+// Log the time spent in each phase that was reached since the previous one
+static void
+log_startup_times(FILE *log, int inst, struct timespec const* startup_times)
+{
+    char            buf[256];
+    size_t          len = 0;
+    int             prev = STARTUP_BEGIN;
+    int             phase;
+    double          ms;
+
+    buf[0] = '\0';
+    for (phase = STARTUP_BEGIN + 1; (phase < NUM_STARTUP_PHASES) && (len < sizeof(buf)); phase++)
+    {
+        if ((startup_times[phase].tv_sec == 0) && (startup_times[phase].tv_nsec == 0))
+        {
+            continue;
+        }
+        ms = (startup_times[phase].tv_sec - startup_times[prev].tv_sec) * 1e3
+           + (startup_times[phase].tv_nsec - startup_times[prev].tv_nsec) / 1e6;
+        len += snprintf(buf + len, sizeof(buf) - len, " %s %.3f", startup_phase_names[phase], ms);
+        prev = phase;
+    }
 
-        case CTI_WLM_SSH:
-            _cti_wlmProto = &_cti_generic_ssh_wlmProto;
-            break;
+    _cti_write_log(log, "%s: inst %d: Startup times (ms):%s\n", CTI_BE_DAEMON_BINARY, inst, buf);
+}
 
-#ifdef HAVE_FLUX
-        case CTI_WLM_FLUX:
-            _cti_wlmProto = &_cti_flux_wlmProto;
-            break;
-#endif
+// Fork a process through an intermediate one that exits, so that the new process is
+// reparented instead of remaining a child of whatever program this one execs. Return
+// 1 in the new process, 0 in this process with the new pid in detached_pid, or -1
+// on error
+static int
+fork_detached(pid_t *detached_pid)
+{
+    int             rc = -1;
+    int             pid_pipe[2] = {-1, -1};
+    pid_t           fork_pid;
+    int             status;
 
-        case CTI_WLM_LOCALHOST:
-            _cti_wlmProto = &_cti_localhost_wlmProto;
-            break;
-            
-        case CTI_WLM_NONE:
-        default:
-            // the wlmProto defaults to noneness, so break
-            break;
+    if (pipe2(pid_pipe, O_CLOEXEC) < 0)
+    {
+        perror("pipe2");
+        return -1;
     }
 
-    // process the env args
-    if (env_args != NULL)
+    if ((fork_pid = fork()) < 0)
     {
-        // pop the top element
-        val = (char *)_cti_pop(env_args);
-
-        while (val != NULL)
+        perror("fork");
+        goto cleanup_fork_detached;
+    }
+    else if (fork_pid == 0)
+    {
+        // intermediate process reports the new pid and exits
+        if ((fork_pid = fork()) != 0)
         {
-            // we need to strsep the string at the "=" character
-            // we expect the user to pass in the -e argument as envVar=val
-            // Note that env will now point at the start and val will point at
-            // the value argument
-            if ((env = strsep(&val, "=")) == NULL)
+            if (fork_pid < 0)
             {
-                //error
-                fprintf(stderr, "%s: strsep failed\n", CTI_BE_DAEMON_BINARY);
-                return 1;
+                perror("fork");
             }
+            _exit((write(pid_pipe[1], &fork_pid, sizeof(fork_pid)) == sizeof(fork_pid)) ? 0 : 1);
+        }
+        close(pid_pipe[0]);
+        close(pid_pipe[1]);
+        return 1;
+    }
 
-            // ensure the user didn't pass us something stupid i.e. non-conforming
-            if ((*env == '\0') || (val == NULL))
-            {
-                // they passed us something stupid
-                fprintf(stderr, "%s: Unrecognized env argument.\n", CTI_BE_DAEMON_BINARY);
-                return 1;
-            }
+    close(pid_pipe[1]);
+    pid_pipe[1] = -1;
+    while (waitpid(fork_pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            perror("waitpid");
+            goto cleanup_fork_detached;
+        }
+    }
+    if ((read(pid_pipe[0], detached_pid, sizeof(*detached_pid)) != sizeof(*detached_pid))
+     || (*detached_pid < 0))
+    {
+        fprintf(stderr, "%s: failed to start detached process\n", CTI_BE_DAEMON_BINARY);
+        goto cleanup_fork_detached;
+    }
 
-            // set the actual environment variable
-            if (setenv(env, val, 1) < 0)
-            {
-                // failure
-                fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
-                return 1;
-            }
+    rc = 0;
 
-            // free this element
-            free(env);
+cleanup_fork_detached:
+    if (pid_pipe[0] >= 0)
+    {
+        close(pid_pipe[0]);
+    }
+    if (pid_pipe[1] >= 0)
+    {
+        close(pid_pipe[1]);
+    }
 
-            // pop the next element
-            val = (char *)_cti_pop(env_args);
-        }
+    return rc;
+}
 
-        // Done with the env_args
-        _cti_consumeStack(env_args);
+// Run a single daemon invocation
+static int
+run_daemon(int argc, char **argv)
+{
+    struct timespec startup_times[NUM_STARTUP_PHASES] = {{0}};
+    int             opt_ind = 0;
+    int             c, i;
+    bool            cleanup = false;
+    bool            defer_clean = false;
+    int             clean_threads = 1;
+    pid_t           clean_pid;
+    char *          trash_path = NULL;
+    int             wlm_arg = CTI_WLM_NONE;
+    char *          wlm_str;
+    char *          apid_str = NULL;
+    char *          tool_path = NULL;
+    char *          attribs_path = NULL;
+    char *          ld_lib_path = NULL;
+    FILE *          log = NULL;
+    struct stat     statbuf;
+    char **         binaries = NULL;
+    size_t          num_binaries = 0;
+    int *           binary_argcs = NULL;
+    size_t          num_binary_argcs = 0;
+    cti_stack_t *   binary_env_args = NULL;
+    char *          binary_path = NULL;
+    pid_t *         binary_pids = NULL;
+    size_t          binary_idx = 0;
+    bool            main_process = true;
+    int             ready_pipe[2] = {-1, -1};
+    char            ready = 0;
+    sighandler_t    prev_sigpipe;
+    int             arg_idx;
+    int             binary_argc;
+    char *          directory = NULL;
+    char *          manifest = NULL;
+    int             inst = 1;   // default to 1 if no instance argument is provided
+    char *          manifest_path = NULL;
+    char *          lock_path = NULL;
+    FILE *          lock_file;
+    pid_t           mypid = -1;
+    char *          pid_path = NULL;
+    char *          bin_path = NULL;
+    char *          lib_path = NULL;
+    char *          file_path = NULL;
+    cti_stack_t *   env_args = NULL;
+    char            *env, *val, *t;
+    char *          old_env_path = NULL;
+    char *          env_path = NULL;
+    int                     r, flags = 0;
+    struct archive *        a;
+    struct archive *        ext;
+    struct archive_entry *  entry;
+    char *                  cwd;
+    int file_check_mode = 0;
+    char *          file_data = NULL;
+    size_t          file_data_len = 0;
+
+    mark_startup_phase(startup_times, STARTUP_BEGIN);
+
+    // we require at least 1 argument beyond argv[0]
+    if (argc < 2)
+    {
+        usage();
+        return 1;
     }
 
-    // if debug mode is turned on, redirect stdout/stderr to a log file
-    if (debug_flag)
+    chmod(argv[0], S_IRUSR|S_IWUSR|S_IXUSR|S_IRGRP|S_IWGRP|S_IXGRP|S_IROTH|S_IWOTH|S_IXOTH);
+
+    // We want to do as little as possible while parsing the opts. This is because
+    // we do not create a log file until after the opts are parsed, and there will
+    // be no valid output until after the log is created on most systems.
+    while ((c = getopt_long(argc, argv, "a:b:cd:e:i:m:p:t:l:w:h", long_opts, &opt_ind)) != -1)
     {
-        int null_apid = 0;
+        switch (c)
+        {
+            case 0:
+                // if this is a flag, do nothing
+                break;
+
+            case 'a':
+                // strip leading whitespace
+                while (*optarg == ' ')
+                {
+                    ++optarg;
+                }
+
+                // this is the application id that is WLM specific
+                apid_str = strdup(optarg);
+
+                break;
+
+            case 'b':
+                // strip leading whitespace
+                while (*optarg == ' ')
+                {
+                    ++optarg;
+                }
+
+                // this is the name of a binary we will exec. Additional binaries are
+                // started as separate tool daemons
+                { char **new_binaries = realloc(binaries, (num_binaries + 1) * sizeof(char*));
+                    if (new_binaries == NULL)
+                    {
+                        fprintf(stderr, "%s: realloc failed\n", CTI_BE_DAEMON_BINARY);
+                        return 1;
+                    }
+                    binaries = new_binaries;
+                    binaries[num_binaries++] = strdup(optarg);
+                }
+
+                break;
+
+            case BINARY_ARGC_OPT:
+                // this is the number of arguments after "--" for the next binary
+                { int *new_argcs = realloc(binary_argcs, (num_binary_argcs + 1) * sizeof(int));
+                    if (new_argcs == NULL)
+                    {
+                        fprintf(stderr, "%s: realloc failed\n", CTI_BE_DAEMON_BINARY);
+                        return 1;
+                    }
+                    binary_argcs = new_argcs;
+                    binary_argcs[num_binary_argcs] = atoi(optarg);
+                    if (binary_argcs[num_binary_argcs] < 0)
+                    {
+                        fprintf(stderr, "%s: Invalid argument count %s\n", CTI_BE_DAEMON_BINARY, optarg);
+                        return 1;
+                    }
+                    num_binary_argcs++;
+                }
+
+                break;
+
+            case BINARY_ENV_OPT:
+                // this is an environment variable set only for one binary, applied
+                // when that binary is started
+                if ((binary_env_args == NULL) && ((binary_env_args = _cti_newStack()) == NULL))
+                {
+                    fprintf(stderr, "%s: _cti_newStack() failed.\n", CTI_BE_DAEMON_BINARY);
+                    return 1;
+                }
+                if (_cti_push(binary_env_args, strdup(optarg)))
+                {
+                    fprintf(stderr, "%s: _cti_push() failed.\n", CTI_BE_DAEMON_BINARY);
+                    return 1;
+                }
+
+                break;
+
+            case 'c':
+                // set cleanup to true
+                cleanup = true;
+
+                break;
+
+            case CLEAN_THREADS_OPT:
+                // number of threads removing files during cleanup
+                clean_threads = atoi(optarg);
+                if (clean_threads < 1)
+                {
+                    clean_threads = 1;
+                }
+
+                break;
+
+            case CLEAN_DEFER_OPT:
+                // remove session directories after returning from cleanup
+                defer_clean = true;
+
+                break;
+
+            case 'd':
+                // strip leading whitespace
+                while (*optarg == ' ')
+                {
+                    ++optarg;
+                }
+
+                // this is the name of the existing directory we should cd to
+                directory = strdup(optarg);
+
+                break;
+
+            case 'e':
+                // strip leading whitespace
+                while (*optarg == ' ')
+                {
+                    ++optarg;
+                }
+
+                // this is an optional option to set user defined environment variables
+                if (env_args == NULL)
+                {
+                    // create the string list
+                    if ((env_args = _cti_newStack()) == NULL)
+                    {
+                        // failed to create stack - shouldn't happen
+                        fprintf(stderr, "%s: _cti_newStack() failed.\n", CTI_BE_DAEMON_BINARY);
+                        return 1;
+                    }
+                }
+
+                if (_cti_push(env_args, strdup(optarg)))
+                {
+                    // failed to push the string - shouldn't happen
+                    fprintf(stderr, "%s: _cti_push() failed.\n", CTI_BE_DAEMON_BINARY);
+                    return 1;
+                }
+
+                break;
+
+            case 'f':
+                if (access(optarg, F_OK) == 0) {
+                    fprintf(stdout, "%s\n", optarg);
+                }
+                file_check_mode = 1;
+                break;
+
+            case 'F':
+                // strip leading whitespace
+                while (*optarg == ' ')
+                {
+                    ++optarg;
+                }
+
+                // bitmap response is the only output, without a trailing empty line
+                return check_file_list(optarg);
+
+            case FILE_DATA_OPT:
+                // records may be split across several arguments to stay under the
+                // per-argument length limit, checked together once all are parsed
+                { size_t const optarg_len = strlen(optarg);
+                    char *new_file_data = realloc(file_data, file_data_len + optarg_len + 1);
+                    if (new_file_data == NULL)
+                    {
+                        fprintf(stderr, "%s: realloc failed\n", CTI_BE_DAEMON_BINARY);
+                        return 1;
+                    }
+                    file_data = new_file_data;
+                    memcpy(file_data + file_data_len, optarg, optarg_len + 1);
+                    file_data_len += optarg_len;
+                }
+
+                break;
+
+            case 'i':
+                // This is our instance number. We need to wait for all those
+                // before us to finish their work before proceeding.
+                inst = atoi(optarg);
+
+                break;
+
+            case 'm':
+                // strip leading whitespace
+                while (*optarg == ' ')
+                {
+                    ++optarg;
+                }
+
+                // this is the name of the manifest tarball we will extract
+                manifest = strdup(optarg);
+
+                break;
+
+            case 'p':
+                // strip leading whitespace
+                while (*optarg == ' ')
+                {
+                    ++optarg;
+                }
+
+                // this is the tool path argument where we should cd to
+                tool_path = strdup(optarg);
+
+                break;
+
+            case 't':
+                // strip leading whitespace
+                while (*optarg == ' ')
+                {
+                    ++optarg;
+                }
+
+                // this is the pmi_attribs path argument to find the attribs file
+                // This is optional, some implementations might not use it.
+                attribs_path = strdup(optarg);
+
+                break;
+
+            case 'l':
+                // strip leading whitespace
+                while (*optarg == ' ')
+                {
+                    ++optarg;
+                }
+
+                // this is the argument to set LD_LIBRARY_PATH envvar
+                // This is optional, some implementations might not use it.
+                ld_lib_path = strdup(optarg);
+
+                break;
+
+            case 'w':
+                // this is the wlm value that we should use
+                wlm_arg = atoi(optarg);
+
+                break;
+
+            case 'h':
+                usage();
+                return 0;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    mark_startup_phase(startup_times, STARTUP_ARGS);
+
+    // bitmap response is the only output, without a trailing empty line
+    if (file_data != NULL) {
+        return check_file_data(file_data);
+    }
+
+    // If started in file check mode, don't start daemon
+    if (file_check_mode) {
+        fprintf(stdout, "\n");
+        return 0;
+    }
+
+    // Start becoming a daemon
+
+    // clear file creation mask
+    umask(0);
+
+    // Ensure every file descriptor is closed
+    close_fds_from(STDIN_FILENO);
+
+    /*
+    * We close channels 0-2 to keep things "clean".
+    * Unfortuantely, that means that any file opens that I do will
+    * have them available. If I open my log file, for instance, it
+    * will get channel 0 and that just doesn't seem safe. So, the lines
+    * below open (and waste) three channels such that I am guaranteed
+    * that future opens will not get them 0-2. Note that the opens may
+    * or may not get all/any of 0-2, but should they be available, they
+    * will be gotten.
+    * This, of course, must happen "early" before any other opens.
+    *
+    */
+    open("/dev/null", O_RDONLY);
+    open("/dev/null", O_WRONLY);
+    open("/dev/null", O_WRONLY);
+    mark_startup_phase(startup_times, STARTUP_FD_CLOSE);
+
+    // Setup the wlm arg without error checking so that we can create a debug
+    // log if asked to. We will error check below.
+    switch (wlm_arg)
+    {
+#ifdef HAVE_ALPS
+        case CTI_WLM_ALPS:
+            _cti_wlmProto = &_cti_alps_wlmProto;
+            break;
+#endif
+
+#ifdef HAVE_PALS
+        case CTI_WLM_PALS:
+            _cti_wlmProto = &_cti_pals_wlmProto;
+            break;
+#endif
+
+        case CTI_WLM_SLURM:
+            _cti_wlmProto = &_cti_slurm_wlmProto;
+            break;
+
+        case CTI_WLM_SSH:
+            _cti_wlmProto = &_cti_generic_ssh_wlmProto;
+            break;
+
+#ifdef HAVE_FLUX
+        case CTI_WLM_FLUX:
+            _cti_wlmProto = &_cti_flux_wlmProto;
+            break;
+#endif
+
+        case CTI_WLM_LOCALHOST:
+            _cti_wlmProto = &_cti_localhost_wlmProto;
+            break;
+            
+        case CTI_WLM_NONE:
+        default:
+            // the wlmProto defaults to noneness, so break
+            break;
+    }
+
+    // process the env args
+    if (env_args != NULL)
+    {
+        // pop the top element
+        val = (char *)_cti_pop(env_args);
+
+        while (val != NULL)
+        {
+            // we need to strsep the string at the "=" character
+            // we expect the user to pass in the -e argument as envVar=val
+            // Note that env will now point at the start and val will point at
+            // the value argument
+            if ((env = strsep(&val, "=")) == NULL)
+            {
+                //error
+                fprintf(stderr, "%s: strsep failed\n", CTI_BE_DAEMON_BINARY);
+                return 1;
+            }
+
+            // ensure the user didn't pass us something stupid i.e. non-conforming
+            if ((*env == '\0') || (val == NULL))
+            {
+                // they passed us something stupid
+                fprintf(stderr, "%s: Unrecognized env argument.\n", CTI_BE_DAEMON_BINARY);
+                return 1;
+            }
+
+            // set the actual environment variable
+            if (setenv(env, val, 1) < 0)
+            {
+                // failure
+                fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
+                return 1;
+            }
+
+            // free this element
+            free(env);
+
+            // pop the next element
+            val = (char *)_cti_pop(env_args);
+        }
+
+        // Done with the env_args
+        _cti_consumeStack(env_args);
+    }
+
+    // if debug mode is turned on, redirect stdout/stderr to a log file
+    if (debug_flag)
+    {
+        int null_apid = 0;
+
+        // sanity so that we can write something if we are missing the apid string
+        if (apid_str == NULL)
+        {
+            ++null_apid;
+            apid_str = strdup("NOAPID");
+        }
+
+        // Get the log dir env var
+        char *envDir = getenv(CTI_LOG_DIR_ENV_VAR);
+
+        // Create the logging directory
+        if (recursive_mkdir(envDir) >= 0) {
+
+            // setup the log
+            log = _cti_create_log(envDir, apid_str, _cti_wlmProto->wlm_getNodeID());
+            _cti_hook_stdoe(log);
+        }
+
+        // cleanup the apid string if it was missing
+        if (null_apid)
+        {
+            free(apid_str);
+            apid_str = NULL;
+        }
+    }
+
+    /* It is NOW safe to write to stdout/stderr, the log file has been setup */
+
+    // print out argv array if debug is turned on
+    if (debug_flag)
+    {
+        for (i=0; i < argc; ++i)
+        {
+            fprintf(stderr, "%s ", argv[i]);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    // Now ensure the user provided a valid wlm argument.
+    switch (wlm_arg)
+    {
+        case CTI_WLM_ALPS:
+        case CTI_WLM_PALS:
+        case CTI_WLM_SLURM:
+        case CTI_WLM_SSH:
+        case CTI_WLM_FLUX:
+        case CTI_WLM_LOCALHOST:
+            // These wlm are valid
+            break;
+
+        case CTI_WLM_NONE:
+            // These wlm are not supported
+            fprintf(stderr, "%s: WLM provided by wlm argument is not yet supported!\n", CTI_BE_DAEMON_BINARY);
+            return 1;
+
+        default:
+            fprintf(stderr, "%s: Invalid wlm argument.\n", CTI_BE_DAEMON_BINARY);
+            return 1;
+    }
+
+    // Ensure the user provided an apid argument
+    if (apid_str == NULL)
+    {
+        // failure
+        fprintf(stderr, "%s: Missing apid argument!\n", CTI_BE_DAEMON_BINARY);
+        return 1;
+    }
+
+    // Ensure the user provided a directory or manifest option
+    if (directory == NULL && manifest == NULL)
+    {
+        // failure
+        fprintf(stderr, "%s: Missing either directory or manifest argument!\n", CTI_BE_DAEMON_BINARY);
+        return 1;
+    }
+
+    // Ensure the user provided a toolpath option
+    if (tool_path == NULL)
+    {
+        // failure
+        fprintf(stderr, "%s: Missing path argument!\n", CTI_BE_DAEMON_BINARY);
+        return 1;
+    }
+
+    // call the wlm specific init function
+    if (_cti_wlmProto->wlm_init())
+    {
+        // failure
+        fprintf(stderr, "%s: wlm_init() failed.\n", CTI_BE_DAEMON_BINARY);
+        return 1;
+    }
+
+    // save the old cwd value into the environment
+    if ((cwd = getcwd(NULL, 0)) != NULL)
+    {
+        if (setenv(OLD_CWD_ENV_VAR, cwd, 1) < 0)
+        {
+            // failure
+            fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
+            return 1;
+        }
+        free(cwd);
+    }
+
+    // set the APID_ENV_VAR environment variable to the apid
+    if (setenv(APID_ENV_VAR, apid_str, 1) < 0)
+    {
+        // failure
+        fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
+        return 1;
+    }
+
+    // set the WLM_ENV_VAR environment variable to the wlm
+    if (asprintf(&wlm_str, "%d", _cti_wlmProto->wlm_type) <= 0)
+    {
+        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
+        return 1;
+    }
+    if (setenv(WLM_ENV_VAR, wlm_str, 1) < 0)
+    {
+        // failure
+        fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
+        return 1;
+    }
+    free(wlm_str);
+
+    // cd to the tool_path and relax the permissions
+    if (debug_flag)
+    {
+        _cti_write_log(log, "%s: inst %d: Toolhelper path: %s\n", CTI_BE_DAEMON_BINARY, inst, tool_path);
+    }
+
+    if (stat(tool_path, &statbuf) == -1)
+    {
+        fprintf(stderr, "%s: Could not stat %s\n", CTI_BE_DAEMON_BINARY, tool_path);
+        return 1;
+    }
+
+    // Ensure we can write into this directory, otherwise try to relax the permissions
+    if (getuid() == statbuf.st_uid)
+    {
+        // we are the owner - check for RWX
+        if ((statbuf.st_mode & S_IRWXU) ^ S_IRWXU)
+        {
+            // missing perms, so chmod since we are owner
+            if (chmod(tool_path, statbuf.st_mode | S_IRWXU) != 0)
+            {
+                fprintf(stderr, "%s: Could not chmod %s\n", CTI_BE_DAEMON_BINARY, tool_path);
+                return 1;
+            }
+        }
+    } else
+    {
+        // here we cannot chmod, so we need to check for perms on the directory
+        // and fail if we don't have the setup properly for us. In that case, the
+        // system is misconfigured.
+        int     ngrps;
+        gid_t * grps;
+        int     i,chk=0;
+
+        if ((ngrps = getgroups(0, NULL)) < 0)
+        {
+            fprintf(stderr, "%s: ", CTI_BE_DAEMON_BINARY);
+            perror("getgroups");
+            return 1;
+        }
+        if ((grps = malloc(ngrps * sizeof(gid_t))) == NULL)
+        {
+            fprintf(stderr, "%s: malloc failed.", CTI_BE_DAEMON_BINARY);
+            return 1;
+        }
+        if ((ngrps = getgroups(ngrps, grps)) < 0)
+        {
+            fprintf(stderr, "%s: ", CTI_BE_DAEMON_BINARY);
+            perror("getgroups");
+            return 1;
+        }
+
+        // check to see if we are in the group
+        for (i=0; i < ngrps; ++i)
+        {
+            if (grps[i] == statbuf.st_gid)
+            {
+                // we are in the group - check for RWX
+                if ((statbuf.st_mode & S_IRWXG) ^ S_IRWXG)
+                {
+                    // missing perms, no way to recover
+                    fprintf(stderr, "%s: Missing group perms in %s\n", CTI_BE_DAEMON_BINARY, tool_path);
+                    return 1;
+                }
+                // break from the for loop
+                ++chk;
+                break;
+            }
+        }
+
+        // if chk is true, we are in the group and have proper perms, otherwise check other
+        if (!chk)
+        {
+            if ((statbuf.st_mode & S_IRWXO) ^ S_IRWXO)
+            {
+                // missing perms, no way to recover
+                fprintf(stderr, "%s: Missing others perms in %s\n", CTI_BE_DAEMON_BINARY, tool_path);
+                return 1;
+            }
+        }
+    }
+
+    // change the working directory to path
+    if (chdir(tool_path) != 0)
+    {
+        fprintf(stderr, "%s: Could not chdir to %s\n", CTI_BE_DAEMON_BINARY, tool_path);
+        return 1;
+    }
+    mark_startup_phase(startup_times, STARTUP_CHDIR);
+
+    // Now unpack the manifest
+    if (manifest != NULL)
+    {
+        if (debug_flag)
+        {
+            _cti_write_log(log, "%s: inst %d: Manifest provided: %s\n", CTI_BE_DAEMON_BINARY, inst, manifest);
+        }
+
+        // create the manifest path string
+        if (asprintf(&manifest_path, "%s/%s", tool_path, manifest) <= 0)
+        {
+            fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
+            return 1;
+        }
+
+        // ensure the manifest tarball exists
+        if (stat(manifest_path, &statbuf) == -1)
+        {
+            fprintf(stderr, "%s: Could not stat manifest tarball %s\n", CTI_BE_DAEMON_BINARY, manifest_path);
+            return 1;
+        }
+
+        // ensure it is a regular file
+        if (!S_ISREG(statbuf.st_mode))
+        {
+            fprintf(stderr, "%s: %s is not a regular file!\n", CTI_BE_DAEMON_BINARY, manifest_path);
+            return 1;
+        }
+
+        // set the flags. ACLs and file flags are not used for staged tool files,
+        // and restoring them costs extra system calls per file
+        flags |= ARCHIVE_EXTRACT_PERM;
+
+        a = archive_read_new();
+        ext = archive_write_disk_new();
+        archive_write_disk_set_options(ext, flags);
+        archive_read_support_format_tar(a);
+
+        if ((r = archive_read_open_filename(a, manifest_path, get_extract_block_size())))
+        {
+            fprintf(stderr, "%s: archive_read_open_filename(): %s\n", CTI_BE_DAEMON_BINARY, archive_error_string(a));
+            return r;
+        }
+
+        for (;;)
+        {
+            r = archive_read_next_header(a, &entry);
+            if (r == ARCHIVE_EOF)
+                break;
+            if (r != ARCHIVE_OK)
+            {
+                fprintf(stderr, "%s: archive_read_next_header(): %s\n", CTI_BE_DAEMON_BINARY, archive_error_string(a));
+                return 1;
+            }
+
+            // write regular files directly if possible
+            r = write_regular_file(a, entry);
+            if (r < 0)
+            {
+                return 1;
+            } else if (r == 0)
+            {
+                continue;
+            }
+
+            r = archive_write_header(ext, entry);
+            if (r != ARCHIVE_OK)
+            {
+                fprintf(stderr, "%s: archive_write_header(): %s\n", CTI_BE_DAEMON_BINARY, archive_error_string(ext));
+                return 1;
+            }
+
+            copy_data(a, ext);
+
+            r = archive_write_finish_entry(ext);
+            if (r != ARCHIVE_OK)
+            {
+                fprintf(stderr, "%s: archive_write_finish_entry(): %s\n", CTI_BE_DAEMON_BINARY, archive_error_string(ext));
+                return 1;
+            }
+        }
+
+        archive_read_close(a);
+        archive_read_free(a);
+        archive_write_close(ext);
+        archive_write_free(ext);
+
+        // The manifest should be extracted at this point.
+
+        // We are done with the tarball, so remove it - if this fails just ignore it since it won't
+        // break things
+        remove(manifest_path);
+
+        // Modify manifest_path to point at the directory, not the ".tar" bits
+        if ((t = strstr(manifest_path, ".tar")) != NULL)
+        {
+            // set it to a null terminator
+            *t = '\0';
+        }
+        mark_startup_phase(startup_times, STARTUP_EXTRACT);
+    }
+
+    // handle the directory option
+    if (directory != NULL)
+    {
+        if (debug_flag)
+        {
+            _cti_write_log(log, "%s: inst %d: Directory provided: %s\n", CTI_BE_DAEMON_BINARY, inst, directory);
+        }
+
+        // create the manifest path string
+        if (manifest_path != NULL)
+        {
+            free(manifest_path);
+            manifest_path = NULL;
+        }
+        if (asprintf(&manifest_path, "%s/%s", tool_path, directory) <= 0)
+        {
+            fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
+            return 1;
+        }
+    }
+
+    // ensure the manifest directory exists
+    if (stat(manifest_path, &statbuf) == -1)
+    {
+        fprintf(stderr, "%s: Could not stat root directory %s\n", CTI_BE_DAEMON_BINARY, manifest_path);
+        return 1;
+    }
+
+    // ensure it is a directory
+    if (!S_ISDIR(statbuf.st_mode))
+    {
+        fprintf(stderr, "%s: %s is not a directory!\n", CTI_BE_DAEMON_BINARY, manifest_path);
+        return 1;
+    }
+
+    // At this point we are done untar'ing stuff into the directory. We need
+    // to create our hidden file corresponding to our instance so that other
+    // tool daemons will know that their dependencies included with our manifest
+    // are ready for them to use. This prevents race conditions where a later
+    // tool daemon depends on files included in an earlier tool daemons manifest
+    // but the later tool daemon executes first.
+
+    // first ensure the directory string exists, otherwise create it
+    if (directory == NULL)
+    {
+        // grab the directory part based on the manifest string
+        directory = strdup(manifest);
+
+        // Modify t1 to point at the directory, not the ".tar" bits
+        if ((t = strstr(directory, ".tar")) != NULL)
+        {
+            // set it to a null terminator
+            *t = '\0';
+        }
+    }
+
+    // create the path to the pid file
+    if (asprintf(&pid_path, "%s/%s", manifest_path, PID_FILE) <= 0)
+    {
+        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
+        return 1;
+    }
+
+    // Run cleanup and terminate
+    if (cleanup)
+    {
+        pid_t * tool_pids;
+        size_t num_tool_pids;
+
+        // read the pids of all tool daemons started in this session
+        if ((tool_pids = read_pids(pid_path, &num_tool_pids)) == NULL)
+        {
+            return 1;
+        }
+
+        // send a SIGKILL to each pid
+        for (i=0; i < (int)num_tool_pids; ++i)
+        {
+            if (kill(tool_pids[i], 0))
+                continue;
+            fprintf(stderr, "%s: inst %d: Sending SIGKILL to %d\n", CTI_BE_DAEMON_BINARY, inst, tool_pids[i]);
+            kill(tool_pids[i], SIGKILL);
+        }
+        free(tool_pids);
+
+        // remove the manifest directory, or detach it by renaming it to a trash
+        // directory so that it can be removed after returning
+        r = -1;
+        if (defer_clean)
+        {
+            if (asprintf(&trash_path, "%s/%s%s_%d", tool_path, TRASH_DIR_PREFIX, directory, getpid()) <= 0)
+            {
+                fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
+                return 1;
+            }
+#ifdef RENAME_NOREPLACE
+            r = renameat2(AT_FDCWD, manifest_path, AT_FDCWD, trash_path, RENAME_NOREPLACE);
+#else
+            r = rename(manifest_path, trash_path);
+#endif
+            if ((r < 0) && (errno != ENOENT))
+            {
+                perror("rename");
+            }
+            else if (r == 0)
+            {
+                fprintf(stderr, "%s: inst %d: Moved directory %s to %s.\n", CTI_BE_DAEMON_BINARY, inst, manifest_path, trash_path);
+            }
+            free(trash_path);
+            trash_path = NULL;
+        }
+        if (r < 0)
+        {
+            fprintf(stderr, "%s: inst %d: Removing directory %s.\n", CTI_BE_DAEMON_BINARY, inst, manifest_path);
+            remove_dir(manifest_path, clean_threads);
+        }
+
+        // remove the lock files
+        for (i = inst-1; i > 0; --i)
+        {
+            // create the path to this instances lock file
+            if (asprintf(&lock_path, "%s/.lock_%s_%d", tool_path, directory, i) <= 0)
+            {
+                fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
+                return 1;
+            }
 
-        // sanity so that we can write something if we are missing the apid string
-        if (apid_str == NULL)
-        {
-            ++null_apid;
-            apid_str = strdup("NOAPID");
+            unlink(lock_path);
+            free(lock_path);
         }
 
-        // Get the log dir env var
-        char *envDir = getenv(CTI_LOG_DIR_ENV_VAR);
+        // Detached directories and those of past sessions are removed after returning,
+        // in a process that is not a child of this one
+        if (defer_clean)
+        {
+            if ((r = fork_detached(&clean_pid)) < 0)
+            {
+                // remove them now instead
+                fprintf(stderr, "%s: inst %d: Removing directories before returning.\n", CTI_BE_DAEMON_BINARY, inst);
+            }
+            else if (r == 0)
+            {
+                fprintf(stderr, "%s: inst %d: Cleanup complete, removing directories in process %d.\n", CTI_BE_DAEMON_BINARY, inst, clean_pid);
+                return 0;
+            }
+            else
+            {
+                int null_fd;
 
-        // Create the logging directory
-        if (recursive_mkdir(envDir) >= 0) {
+                setsid();
 
-            // setup the log
-            log = _cti_create_log(envDir, apid_str, _cti_wlmProto->wlm_getNodeID());
-            _cti_hook_stdoe(log);
+                // The launcher that started cleanup waits for its output to close, so
+                // the remover only writes to the debug log
+                if ((null_fd = open("/dev/null", O_RDWR)) >= 0)
+                {
+                    dup2(null_fd, STDIN_FILENO);
+                    if (log == NULL)
+                    {
+                        dup2(null_fd, STDOUT_FILENO);
+                        dup2(null_fd, STDERR_FILENO);
+                    }
+                    if (null_fd > STDERR_FILENO)
+                    {
+                        close(null_fd);
+                    }
+                }
+            }
         }
 
-        // cleanup the apid string if it was missing
-        if (null_apid)
-        {
-            free(apid_str);
-            apid_str = NULL;
-        }
+        remove_unused_dirs(tool_path, inst, clean_threads);
+
+        fprintf(stderr, "%s: inst %d: Cleanup complete.\n", CTI_BE_DAEMON_BINARY, inst);
+
+        return 0;
     }
 
-    /* It is NOW safe to write to stdout/stderr, the log file has been setup */
+    // We want to write the pid of this process into the pid file for cleanup
+    // later. Note that if the destroy session function is called, it will need
+    // to wait for this instances lock file to get created, which happens below.
+    // That way we are guaranteed to not miss any tool daemons that were started.
 
-    // print out argv array if debug is turned on
-    if (debug_flag)
+    // With multiple binaries, fork a process for each additional tool daemon now,
+    // so that their pids are written along with ours. This process execs the last
+    // binary, waits for dependencies, then releases the others through the ready pipe.
+    // The others are detached, so that the last binary doesn't inherit them as children
+    binary_idx = (num_binaries > 0) ? (num_binaries - 1) : 0;
+    if ((binary_pids = calloc(num_binaries + 1, sizeof(pid_t))) == NULL)
     {
-        for (i=0; i < argc; ++i)
+        fprintf(stderr, "%s: calloc failed\n", CTI_BE_DAEMON_BINARY);
+        return 1;
+    }
+    binary_pids[0] = mypid = getpid();
+    if (num_binaries > 1)
+    {
+        if (pipe2(ready_pipe, O_CLOEXEC) < 0)
         {
-            fprintf(stderr, "%s ", argv[i]);
+            perror("pipe2");
+            return 1;
+        }
+        for (i = 0; i < (int)num_binaries - 1; i++)
+        {
+            if ((r = fork_detached(&binary_pids[i + 1])) < 0)
+            {
+                return 1;
+            }
+            else if (r > 0)
+            {
+                binary_idx = i;
+                main_process = false;
+                break;
+            }
+        }
+        if (main_process)
+        {
+            close(ready_pipe[0]);
+        } else
+        {
+            close(ready_pipe[1]);
         }
-        fprintf(stderr, "\n");
     }
 
-    // Now ensure the user provided a valid wlm argument.
-    switch (wlm_arg)
+    // Write this pid and those of any other tool daemons into the pid file for cleanup
+    if (main_process && register_pids(pid_path, binary_pids, (num_binaries > 1) ? num_binaries : 1))
     {
-        case CTI_WLM_ALPS:
-        case CTI_WLM_PALS:
-        case CTI_WLM_SLURM:
-        case CTI_WLM_SSH:
-        case CTI_WLM_FLUX:
-        case CTI_WLM_LOCALHOST:
-            // These wlm are valid
-            break;
-
-        case CTI_WLM_NONE:
-            // These wlm are not supported
-            fprintf(stderr, "%s: WLM provided by wlm argument is not yet supported!\n", CTI_BE_DAEMON_BINARY);
-            return 1;
-
-        default:
-            fprintf(stderr, "%s: Invalid wlm argument.\n", CTI_BE_DAEMON_BINARY);
-            return 1;
+        return 1;
     }
 
-    // Ensure the user provided an apid argument
-    if (apid_str == NULL)
+    // create the path to the lock file
+    if (asprintf(&lock_path, "%s/.lock_%s_%d", tool_path, directory, inst) <= 0)
     {
-        // failure
-        fprintf(stderr, "%s: Missing apid argument!\n", CTI_BE_DAEMON_BINARY);
+        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
         return 1;
     }
 
-    // Ensure the user provided a directory or manifest option
-    if (directory == NULL && manifest == NULL)
+    // try to fopen the lock file, other tool daemons of this instance leave it to us
+    if (!main_process)
     {
-        // failure
-        fprintf(stderr, "%s: Missing either directory or manifest argument!\n", CTI_BE_DAEMON_BINARY);
-        return 1;
+        // lock file is created by the main process
+    } else if ((lock_file = fopen(lock_path, "w")) == NULL)
+    {
+        fprintf(stderr, "%s: fopen on %s failed\n", CTI_BE_DAEMON_BINARY, lock_path);
+        // don't exit here, this will break future tool daemons though so its pretty
+        // bad to have a failure at this point. But it shouldn't screw this instance
+        // up at the very least.
+    } else
+    {
+        // close the file, it has been created
+        fclose(lock_file);
     }
 
-    // Ensure the user provided a toolpath option
-    if (tool_path == NULL)
+    // Set the BE_GUARD_ENV_VAR environment variable to signal that we are running
+    // on the backend
+    if (setenv(BE_GUARD_ENV_VAR, "1", 1) < 0)
     {
         // failure
-        fprintf(stderr, "%s: Missing path argument!\n", CTI_BE_DAEMON_BINARY);
+        fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
         return 1;
     }
 
-    // call the wlm specific init function
-    if (_cti_wlmProto->wlm_init())
+    // Set the ROOT_DIR_VAR environment variable to the manifest directory.
+    if (setenv(ROOT_DIR_VAR, manifest_path, 1) < 0)
     {
         // failure
-        fprintf(stderr, "%s: wlm_init() failed.\n", CTI_BE_DAEMON_BINARY);
+        fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
         return 1;
     }
 
-    // save the old cwd value into the environment
-    if ((cwd = getcwd(NULL, 0)) != NULL)
+    // Get the current value of the SCRATCH_ENV_VAR environment variable and set
+    // it to OLD_SCRATCH_ENV_VAR in case the tool daemon needs access to it.
+    if ((old_env_path = getenv(SCRATCH_ENV_VAR)) != NULL)
     {
-        if (setenv(OLD_CWD_ENV_VAR, cwd, 1) < 0)
+        if (setenv(OLD_SCRATCH_ENV_VAR, old_env_path, 1) < 0)
         {
             // failure
             fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
             return 1;
         }
-        free(cwd);
     }
 
-    // set the APID_ENV_VAR environment variable to the apid
-    if (setenv(APID_ENV_VAR, apid_str, 1) < 0)
+    // set the SCRATCH_ENV_VAR environment variable to the toolhelper directory.
+    if (asprintf(&env_path, "%s/tmp", manifest_path) <= 0)
+    {
+        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
+        return 1;
+    }
+    if (setenv(SCRATCH_ENV_VAR, env_path, 1) < 0)
     {
         // failure
         fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
         return 1;
     }
 
-    // set the WLM_ENV_VAR environment variable to the wlm
-    if (asprintf(&wlm_str, "%d", _cti_wlmProto->wlm_type) <= 0)
+    // set the BIN_DIR_VAR environment variable to the toolhelper directory.
+    if (asprintf(&bin_path, "%s/bin", manifest_path) <= 0)
     {
         fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
         return 1;
     }
-    if (setenv(WLM_ENV_VAR, wlm_str, 1) < 0)
+    if (setenv(BIN_DIR_VAR, bin_path, 1) < 0)
     {
         // failure
         fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
         return 1;
     }
-    free(wlm_str);
 
-    // cd to the tool_path and relax the permissions
-    if (debug_flag)
+    // set the LIB_DIR_VAR environment variable to the toolhelper directory.
+    if (asprintf(&lib_path, "%s/lib", manifest_path) <= 0)
     {
-        _cti_write_log(log, "%s: inst %d: Toolhelper path: %s\n", CTI_BE_DAEMON_BINARY, inst, tool_path);
+        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
+        return 1;
     }
-
-    if (stat(tool_path, &statbuf) == -1)
+    if (setenv(LIB_DIR_VAR, lib_path, 1) < 0)
     {
-        fprintf(stderr, "%s: Could not stat %s\n", CTI_BE_DAEMON_BINARY, tool_path);
+        // failure
+        fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
         return 1;
     }
 
-    // Ensure we can write into this directory, otherwise try to relax the permissions
-    if (getuid() == statbuf.st_uid)
-    {
-        // we are the owner - check for RWX
-        if ((statbuf.st_mode & S_IRWXU) ^ S_IRWXU)
-        {
-            // missing perms, so chmod since we are owner
-            if (chmod(tool_path, statbuf.st_mode | S_IRWXU) != 0)
-            {
-                fprintf(stderr, "%s: Could not chmod %s\n", CTI_BE_DAEMON_BINARY, tool_path);
-                return 1;
-            }
-        }
-    } else
+    // set FILE_DIR_VAR environment variable to the toolhelper directory
+    if (asprintf(&file_path, "%s", manifest_path) <= 0)
     {
-        // here we cannot chmod, so we need to check for perms on the directory
-        // and fail if we don't have the setup properly for us. In that case, the
-        // system is misconfigured.
-        int     ngrps;
-        gid_t * grps;
-        int     i,chk=0;
-
-        if ((ngrps = getgroups(0, NULL)) < 0)
-        {
-            fprintf(stderr, "%s: ", CTI_BE_DAEMON_BINARY);
-            perror("getgroups");
-            return 1;
-        }
-        if ((grps = malloc(ngrps * sizeof(gid_t))) == NULL)
-        {
-            fprintf(stderr, "%s: malloc failed.", CTI_BE_DAEMON_BINARY);
-            return 1;
-        }
-        if ((ngrps = getgroups(ngrps, grps)) < 0)
-        {
-            fprintf(stderr, "%s: ", CTI_BE_DAEMON_BINARY);
-            perror("getgroups");
-            return 1;
-        }
-
-        // check to see if we are in the group
-        for (i=0; i < ngrps; ++i)
-        {
-            if (grps[i] == statbuf.st_gid)
-            {
-                // we are in the group - check for RWX
-                if ((statbuf.st_mode & S_IRWXG) ^ S_IRWXG)
-                {
-                    // missing perms, no way to recover
-                    fprintf(stderr, "%s: Missing group perms in %s\n", CTI_BE_DAEMON_BINARY, tool_path);
-                    return 1;
-                }
-                // break from the for loop
-                ++chk;
-                break;
-            }
-        }
-
-        // if chk is true, we are in the group and have proper perms, otherwise check other
-        if (!chk)
-        {
-            if ((statbuf.st_mode & S_IRWXO) ^ S_IRWXO)
-            {
-                // missing perms, no way to recover
-                fprintf(stderr, "%s: Missing others perms in %s\n", CTI_BE_DAEMON_BINARY, tool_path);
-                return 1;
-            }
-        }
+        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
+        return 1;
     }
-
-    // change the working directory to path
-    if (chdir(tool_path) != 0)
+    if (setenv(FILE_DIR_VAR, file_path, 1) < 0)
     {
-        fprintf(stderr, "%s: Could not chdir to %s\n", CTI_BE_DAEMON_BINARY, tool_path);
+        // failure
+        fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
         return 1;
     }
 
-    // Now unpack the manifest
-    if (manifest != NULL)
+    // set TOOL_DIR_VAR to tool_path - This should remain hidden from the user and only used by internal library calls
+    if (setenv(TOOL_DIR_VAR, tool_path, 1) < 0)
     {
-        if (debug_flag)
-        {
-            _cti_write_log(log, "%s: inst %d: Manifest provided: %s\n", CTI_BE_DAEMON_BINARY, inst, manifest);
-        }
-
-        // create the manifest path string
-        if (asprintf(&manifest_path, "%s/%s", tool_path, manifest) <= 0)
-        {
-            fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
-            return 1;
-        }
+        // failure
+        fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
+        return 1;
+    }
 
-        // ensure the manifest tarball exists
-        if (stat(manifest_path, &statbuf) == -1)
+    // set PMI_ATTRIBS_DIR_VAR to attribs_path if there is one. This is optional.
+    if (attribs_path != NULL)
+    {
+        if (setenv(PMI_ATTRIBS_DIR_VAR, attribs_path, 1) < 0)
         {
-            fprintf(stderr, "%s: Could not stat manifest tarball %s\n", CTI_BE_DAEMON_BINARY, manifest_path);
+            // failure
+            fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
             return 1;
         }
+    }
 
-        // ensure it is a regular file
-        if (!S_ISREG(statbuf.st_mode))
+    // call _cti_adjustPaths so that we chdir to where we shipped stuff over to and setup PATH/LD_LIBRARY_PATH
+    if (_cti_adjustPaths(manifest_path, ld_lib_path))
+    {
+        fprintf(stderr, "%s: Could not adjust paths.\n", CTI_BE_DAEMON_BINARY);
+        free(tool_path);
+        return 1;
+    }
+
+    // ensure that binary was provided, otherwise just exit - the caller wanted to stage stuff.
+    if (num_binaries == 0)
+    {
+        fprintf(stderr, "%s: inst %d: No binary provided. Stage to %s complete.\n", CTI_BE_DAEMON_BINARY, inst, manifest_path);
+        if (debug_flag)
         {
-            fprintf(stderr, "%s: %s is not a regular file!\n", CTI_BE_DAEMON_BINARY, manifest_path);
-            return 1;
+            log_startup_times(log, inst, startup_times);
         }
+        return 0;
+    }
 
-        // set the flags
-        flags |= ARCHIVE_EXTRACT_PERM;
-        flags |= ARCHIVE_EXTRACT_ACL;
-        flags |= ARCHIVE_EXTRACT_FFLAGS;
+    // create the full path to the binary we are going to exec
+    if (asprintf(&binary_path, "%s/bin/%s", manifest_path, binaries[binary_idx]) <= 0)
+    {
+        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
+        return 1;
+    }
 
-        a = archive_read_new();
-        ext = archive_write_disk_new();
-        archive_write_disk_set_options(ext, flags);
-        archive_read_support_format_tar(a);
+    if (debug_flag)
+    {
+        _cti_write_log(log, "%s: inst %d: Binary path: %s\n", CTI_BE_DAEMON_BINARY, inst, binary_path);
+    }
 
-        if ((r = archive_read_open_filename(a, manifest_path, 10240)))
+    // At this point we need to wait on any other previous tool daemons that may
+    // or may not contain depedencies this instance needs. We will make sure each
+    // previous instance has a lock file, otherwise we wait until it gets created.
+    // We have no way of knowing for sure if the previous manifest contains
+    // dependencies that we need. This information is not tracked.
+    free(lock_path);
+    lock_path = NULL;
+    if (!main_process)
+    {
+        // Other tool daemons of this instance wait for the main process to release them.
+        // End of file without a byte means the main process failed
+        if (read(ready_pipe[0], &ready, sizeof(ready)) != sizeof(ready))
         {
-            fprintf(stderr, "%s: archive_read_open_filename(): %s\n", CTI_BE_DAEMON_BINARY, archive_error_string(a));
-            return r;
+            fprintf(stderr, "%s: inst %d: main tool daemon exited before dependencies were ready\n", CTI_BE_DAEMON_BINARY, inst);
+            return 1;
         }
-
-        for (;;)
+        close(ready_pipe[0]);
+    }
+    else if (wait_for_lock_files(tool_path, directory, inst, log, debug_flag))
+    {
+        fprintf(stderr, "%s: failed to wait for previous instance lock files\n", CTI_BE_DAEMON_BINARY);
+        return 1;
+    }
+    else if (num_binaries > 1)
+    {
+        // other tool daemons are blocked on the ready pipe until released, so any
+        // that has already exited failed during startup
+        for (i = 0; i < (int)num_binaries - 1; i++)
         {
-            r = archive_read_next_header(a, &entry);
-            if (r == ARCHIVE_EOF)
-                break;
-            if (r != ARCHIVE_OK)
-            {
-                fprintf(stderr, "%s: archive_read_next_header(): %s\n", CTI_BE_DAEMON_BINARY, archive_error_string(a));
-                return 1;
-            }
-
-            r = archive_write_header(ext, entry);
-            if (r != ARCHIVE_OK)
+            if ((kill(binary_pids[i + 1], 0) < 0) && (errno == ESRCH))
             {
-                fprintf(stderr, "%s: archive_write_header(): %s\n", CTI_BE_DAEMON_BINARY, archive_error_string(ext));
-                return 1;
+                fprintf(stderr, "%s: inst %d: tool daemon %s (pid %d) exited before dependencies were ready\n", CTI_BE_DAEMON_BINARY, inst, binaries[i], binary_pids[i + 1]);
             }
+        }
 
-            copy_data(a, ext);
-
-            r = archive_write_finish_entry(ext);
-            if (r != ARCHIVE_OK)
+        // release the other tool daemons of this instance. If all of them have exited,
+        // the write fails with EPIPE instead of killing this tool daemon with SIGPIPE
+        prev_sigpipe = signal(SIGPIPE, SIG_IGN);
+        for (i = 0; i < (int)num_binaries - 1; i++)
+        {
+            if (write(ready_pipe[1], &ready, sizeof(ready)) != sizeof(ready))
             {
-                fprintf(stderr, "%s: archive_write_finish_entry(): %s\n", CTI_BE_DAEMON_BINARY, archive_error_string(ext));
-                return 1;
+                fprintf(stderr, "%s: inst %d: failed to release other tool daemons: %s\n", CTI_BE_DAEMON_BINARY, inst, strerror(errno));
+                break;
             }
         }
+        signal(SIGPIPE, prev_sigpipe);
+        close(ready_pipe[1]);
+    }
 
-        archive_read_close(a);
-        archive_read_free(a);
+    mark_startup_phase(startup_times, STARTUP_LOCK_WAIT);
 
-        // The manifest should be extracted at this point.
+    if (debug_flag)
+    {
+        _cti_write_log(log, "%s: inst %d: All dependency locks acquired. Ready to exec.\n", CTI_BE_DAEMON_BINARY, inst);
+    }
 
-        // We are done with the tarball, so remove it - if this fails just ignore it since it won't
-        // break things
-        remove(manifest_path);
+    // At this point it is safe to assume we have all our dependencies.
 
-        // Modify manifest_path to point at the directory, not the ".tar" bits
-        if ((t = strstr(manifest_path, ".tar")) != NULL)
-        {
-            // set it to a null terminator
-            *t = '\0';
-        }
+    // ensure the binary exists
+    if (stat(binary_path, &statbuf) == -1)
+    {
+        fprintf(stderr, "%s: Could not stat %s\n", CTI_BE_DAEMON_BINARY, binary_path);
+        return 1;
     }
 
-    // handle the directory option
-    if (directory != NULL)
+    // ensure it is a regular file
+    if (!S_ISREG(statbuf.st_mode))
     {
-        if (debug_flag)
-        {
-            _cti_write_log(log, "%s: inst %d: Directory provided: %s\n", CTI_BE_DAEMON_BINARY, inst, directory);
-        }
+        fprintf(stderr, "%s: %s is not a regular file!\n", CTI_BE_DAEMON_BINARY, binary_path);
+        return 1;
+    }
 
-        // create the manifest path string
-        if (manifest_path != NULL)
-        {
-            free(manifest_path);
-            manifest_path = NULL;
-        }
-        if (asprintf(&manifest_path, "%s/%s", tool_path, directory) <= 0)
+    // Anything after the final "--" in the options string is passed to the exec'ed
+    // binaries. It is split between binaries by count, and the last binary receives
+    // the rest. Note that argv[optind] is the first argument that appears after the
+    // "--" terminator
+    arg_idx = optind;
+    for (i = 0; i < (int)binary_idx; i++)
+    {
+        arg_idx += (i < (int)num_binary_argcs) ? binary_argcs[i] : 0;
+    }
+    if (arg_idx > argc)
+    {
+        fprintf(stderr, "%s: Not enough arguments for %s\n", CTI_BE_DAEMON_BINARY, binaries[binary_idx]);
+        return 1;
+    }
+    if (binary_idx < (num_binaries - 1))
+    {
+        binary_argc = (binary_idx < num_binary_argcs) ? binary_argcs[binary_idx] : 0;
+        if ((arg_idx + binary_argc) > argc)
         {
-            fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
+            fprintf(stderr, "%s: Not enough arguments for %s\n", CTI_BE_DAEMON_BINARY, binaries[binary_idx]);
             return 1;
         }
+        // terminate this binary's arguments
+        argv[arg_idx + binary_argc] = NULL;
     }
 
-    // ensure the manifest directory exists
-    if (stat(manifest_path, &statbuf) == -1)
+    if (set_binary_env(binary_env_args, binary_idx))
     {
-        fprintf(stderr, "%s: Could not stat root directory %s\n", CTI_BE_DAEMON_BINARY, manifest_path);
         return 1;
     }
 
-    // ensure it is a directory
-    if (!S_ISDIR(statbuf.st_mode))
+    // setup the new argv array
+    // We need to modify what argv[arg_idx - 1] points to so that it follows the standard argv[0]
+    // nomenclature.
+    argv[arg_idx - 1] = binary_path;
+
+    mark_startup_phase(startup_times, STARTUP_EXEC);
+    if (debug_flag)
     {
-        fprintf(stderr, "%s: %s is not a directory!\n", CTI_BE_DAEMON_BINARY, manifest_path);
-        return 1;
+        log_startup_times(log, inst, startup_times);
     }
 
-    // At this point we are done untar'ing stuff into the directory. We need
-    // to create our hidden file corresponding to our instance so that other
-    // tool daemons will know that their dependencies included with our manifest
-    // are ready for them to use. This prevents race conditions where a later
-    // tool daemon depends on files included in an earlier tool daemons manifest
-    // but the later tool daemon executes first.
+    // now we can exec our program
+    execv(binary_path, &argv[arg_idx - 1]);
 
-    // first ensure the directory string exists, otherwise create it
-    if (directory == NULL)
-    {
-        // grab the directory part based on the manifest string
-        directory = strdup(manifest);
+    fprintf(stderr, "%s: inst %d: Return from exec!\n", CTI_BE_DAEMON_BINARY, inst);
 
-        // Modify t1 to point at the directory, not the ".tar" bits
-        if ((t = strstr(directory, ".tar")) != NULL)
-        {
-            // set it to a null terminator
-            *t = '\0';
+
+    perror("execv");
+
+    return 1;
+}
+
+/* Backend daemon agent */
+
+// Maximum size of agent requests
+#define AGENT_MAX_ARGC          65536
+#define AGENT_MAX_ARGS_LENGTH   (16 * 1024 * 1024)
+
+// Maximum number of node-local clients connected to the agent socket at once
+#define AGENT_MAX_CLIENTS       64
+
+// Seconds a node-local client may stall while sending a request or reading a response
+#define AGENT_CLIENT_TIMEOUT    10
+
+// Remote shell used to start child agents if not set in the environment
+#define AGENT_DEFAULT_RSH       "ssh -T -o BatchMode=yes"
+
+// Written to by the SIGCHLD handler, so that synchronous daemons are waited on in the
+// poll loop
+static int agent_sigchld_pipe[2] = {-1, -1};
+
+static void
+agent_sigchld_handler(int sig)
+{
+    int saved_errno = errno;
+    // Write will be dropped if pipe is full, loop is already woken up
+    (void)write(agent_sigchld_pipe[1], "", 1);
+    errno = saved_errno;
+}
+
+// Read or write entire buffer. Return 0 on success, -1 on error or end of file
+static int
+agent_read(int fd, void* buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t rc = read(fd, buf, len);
+        if (rc < 0) {
+            if (errno == EINTR) { continue; }
+            return -1;
+        } else if (rc == 0) {
+            return -1;
         }
+        buf = (char*)buf + rc;
+        len -= rc;
     }
+    return 0;
+}
 
-    // create the path to the pid file
-    if (asprintf(&pid_path, "%s/%s", manifest_path, PID_FILE) <= 0)
-    {
-        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
-        return 1;
+static int
+agent_write(int fd, void const* buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t rc = write(fd, buf, len);
+        if (rc < 0) {
+            if (errno == EINTR) { continue; }
+            return -1;
+        }
+        buf = (char const*)buf + rc;
+        len -= rc;
     }
+    return 0;
+}
 
-    // Run cleanup and terminate
-    if (cleanup)
-    {
-        struct cti_pids tool_pid = {{0}};
-        struct cti_pids * pid_ptr = &tool_pid;
-        pid_t pid;
-        ssize_t nr;
+// Child agent started on another node, connected through a remote shell
+typedef struct
+{
+    pid_t pid;
+    int to_fd;          // child agent's stdin, or -1 if it has exited
+    int from_fd;        // child agent's stdout
+    uint32_t firstNode; // index of the child's node in the parent's subtree
+    uint32_t numNodes;  // nodes in the child's subtree, including itself
+    int responding;     // response to the pending request has not been read
+} agent_child_t;
 
-        if ((o_fd = open(pid_path, O_RDONLY)) < 0)
-        {
-            fprintf(stderr, "%s: open failed\n", CTI_BE_DAEMON_BINARY);
-            perror("open");
-            return 1;
+static void
+close_agent_child(agent_child_t *child)
+{
+    if (child->to_fd >= 0) {
+        close(child->to_fd);
+        close(child->from_fd);
+        child->to_fd = child->from_fd = -1;
+    }
+}
+
+// Start a child agent on the first host in hosts, responsible for the remaining
+// hosts. Return 0 on success, -1 on error
+static int
+start_agent_child(agent_child_t *child, char *daemon_name, char const* apid_str,
+    char const* tool_path, int fanout, char **hosts, size_t num_hosts)
+{
+    int rc = -1;
+    char *rsh = NULL;
+    char **child_argv = NULL;
+    size_t child_argc = 0;
+    char *apid_arg = NULL, *path_arg = NULL, *fanout_arg = NULL, *tree_arg = NULL;
+    int to_pipe[2] = {-1, -1};
+    int from_pipe[2] = {-1, -1};
+    size_t i, tree_len = 0;
+
+    child->pid = -1;
+    child->to_fd = child->from_fd = -1;
+    child->numNodes = num_hosts;
+
+    // Remote shell command may include arguments
+    rsh = strdup((getenv(BE_AGENT_RSH_VAR) != NULL) ? getenv(BE_AGENT_RSH_VAR) : AGENT_DEFAULT_RSH);
+    if ((rsh == NULL) || ((child_argv = calloc(strlen(rsh) + 10, sizeof(char*))) == NULL)) {
+        perror("malloc");
+        goto cleanup_start_agent_child;
+    }
+    { char *save = NULL;
+        char *word;
+        for (word = strtok_r(rsh, " ", &save); word != NULL; word = strtok_r(NULL, " ", &save)) {
+            child_argv[child_argc++] = word;
         }
+    }
+    if (child_argc == 0) {
+        fprintf(stderr, "%s: %s is empty\n", CTI_BE_DAEMON_BINARY, BE_AGENT_RSH_VAR);
+        goto cleanup_start_agent_child;
+    }
 
-        // lock the file
-        FLOCK(o_fd);
+    // Child agent's subtree
+    for (i = 1; i < num_hosts; i++) {
+        tree_len += strlen(hosts[i]) + 1;
+    }
+    if ((tree_arg = malloc(strlen("--tree=") + tree_len + 1)) == NULL) {
+        perror("malloc");
+        goto cleanup_start_agent_child;
+    }
+    strcpy(tree_arg, "--tree=");
+    for (i = 1; i < num_hosts; i++) {
+        if (i > 1) {
+            strcat(tree_arg, ",");
+        }
+        strcat(tree_arg, hosts[i]);
+    }
 
-        do {
-            nr = read(o_fd, &pid, sizeof(pid));
-            if (nr < 0)
-            {
-                fprintf(stderr, "%s: read failed\n", CTI_BE_DAEMON_BINARY);
-                perror("read");
-                return 1;
-            }
-            if (nr > 0)
-            {
-                pid_ptr->pids[pid_ptr->idx] = pid;
+    if ((asprintf(&apid_arg, "--apid=%s", apid_str) <= 0)
+     || (asprintf(&path_arg, "--path=%s", tool_path) <= 0)
+     || (asprintf(&fanout_arg, "--fanout=%d", fanout) <= 0)) {
+        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
+        goto cleanup_start_agent_child;
+    }
 
-                pid_ptr->idx = nr / sizeof(pid_ptr->pids[0]);
-                if (pid_ptr->idx >= sizeof(pid_ptr->pids)/sizeof(pid_ptr->pids[0]))
-                {
-                    // need to grow
-                    if ((pid_ptr->next = malloc(sizeof(struct cti_pids))) == NULL)
-                    {
-                        fprintf(stderr, "%s: malloc failed\n", CTI_BE_DAEMON_BINARY);
-                        return 1;
-                    }
-                    memset(pid_ptr->next, 0, sizeof(struct cti_pids));
-                    pid_ptr = pid_ptr->next;
-                }
-            }
-        } while (nr != 0);
+    child_argv[child_argc++] = hosts[0];
+    child_argv[child_argc++] = daemon_name;
+    child_argv[child_argc++] = "--agent";
+    child_argv[child_argc++] = apid_arg;
+    child_argv[child_argc++] = path_arg;
+    child_argv[child_argc++] = fanout_arg;
+    if (num_hosts > 1) {
+        child_argv[child_argc++] = tree_arg;
+    }
+    child_argv[child_argc] = NULL;
 
-        // send a SIGKILL to each pid
-        pid_ptr = &tool_pid;
-        while (pid_ptr != NULL)
-        {
-            for (i=0; i < pid_ptr->idx; ++i)
-            {
-                if (kill(pid_ptr->pids[i], 0))
-                    continue;
-                fprintf(stderr, "%s: inst %d: Sending SIGKILL to %d\n", CTI_BE_DAEMON_BINARY, inst, pid_ptr->pids[i]);
-                kill(pid_ptr->pids[i], SIGKILL);
-            }
-            pid_ptr = pid_ptr->next;
-        }
+    if ((pipe2(to_pipe, O_CLOEXEC) < 0) || (pipe2(from_pipe, O_CLOEXEC) < 0)) {
+        perror("pipe2");
+        goto cleanup_start_agent_child;
+    }
 
-        // remove the manifest directory
-        fprintf(stderr, "%s: inst %d: Removing directory %s.\n", CTI_BE_DAEMON_BINARY, inst, manifest_path);
-        remove_dir(manifest_path);
+    if ((child->pid = fork()) < 0) {
+        perror("fork");
+        goto cleanup_start_agent_child;
 
-        // remove the lock files
-        for (i = inst-1; i > 0; --i)
-        {
-            // reset sCnt
-            sCnt = 0;
+    } else if (child->pid == 0) {
+        dup2(to_pipe[0], STDIN_FILENO);
+        dup2(from_pipe[1], STDOUT_FILENO);
+        signal(SIGPIPE, SIG_DFL);
+        execvp(child_argv[0], child_argv);
+        perror("execvp");
+        _exit(1);
+    }
 
-            // create the path to this instances lock file
-            if (asprintf(&lock_path, "%s/.lock_%s_%d", tool_path, directory, i) <= 0)
-            {
-                fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
-                return 1;
-            }
+    child->to_fd = to_pipe[1];
+    child->from_fd = from_pipe[0];
+    to_pipe[1] = from_pipe[0] = -1;
 
-            unlink(lock_path);
-            free(lock_path);
-        }
+    rc = 0;
 
-        // Run directory cleanup for possible past sessions
-        { struct dirent *dir_ent = NULL;
-            DIR *dir_ptr = NULL;
-            size_t prefix_len = strlen(STAGE_DIR_PREFIX);
-            char* full_path = NULL;
+cleanup_start_agent_child:
+    for (i = 0; i < 2; i++) {
+        if (to_pipe[i] >= 0) { close(to_pipe[i]); }
+        if (from_pipe[i] >= 0) { close(from_pipe[i]); }
+    }
+    free(tree_arg);
+    free(fanout_arg);
+    free(path_arg);
+    free(apid_arg);
+    free(child_argv);
+    free(rsh);
 
-            // Check all cti_daemon directories in tool_path for usage
-            dir_ptr = opendir(tool_path);
-            while ((dir_ent = readdir(dir_ptr)) != NULL) {
+    return rc;
+}
 
-                // Check to see if directory starts with session prefix
-                if (strncmp(dir_ent->d_name, STAGE_DIR_PREFIX, prefix_len)) {
-                    continue;
-                }
+// Split comma-separated tree hosts into up to fanout contiguous subtrees of nearly
+// equal size, and start a child agent at the head of each. Return number of
+// subtrees. Children that fail to start are kept without input, so that responses
+// report their subtrees as missed
+static size_t
+start_agent_children(agent_child_t **children, char *daemon_name, char const* apid_str,
+    char const* tool_path, int fanout, char *tree)
+{
+    char **hosts = NULL;
+    size_t num_hosts = 0;
+    size_t num_children = 0;
+    size_t i;
+    char *host, *save = NULL;
+
+    *children = NULL;
+    if ((tree == NULL) || (fanout < 1)) {
+        return 0;
+    }
 
-                // Free directory entry if set
-                if (full_path != NULL) {
-                    free(full_path);
-                    full_path = NULL;
-                }
+    for (i = 0; tree[i] != '\0'; i++) {
+        num_hosts += (tree[i] == ',');
+    }
+    if (((hosts = calloc(num_hosts + 1, sizeof(char*))) == NULL)
+     || ((*children = calloc(fanout, sizeof(agent_child_t))) == NULL)) {
+        perror("malloc");
+        free(hosts);
+        return 0;
+    }
+    num_hosts = 0;
+    for (host = strtok_r(tree, ",", &save); host != NULL; host = strtok_r(NULL, ",", &save)) {
+        hosts[num_hosts++] = host;
+    }
 
-                // Create full directory path
-                if (asprintf(&full_path, "%s/%s", tool_path, dir_ent->d_name) <= 0) {
-                    perror("asprintf");
-                    continue;
-                }
+    for (i = 0; i < (size_t)fanout; i++) {
+        size_t begin = (i * num_hosts) / fanout;
+        size_t end = ((i + 1) * num_hosts) / fanout;
+        if (begin == end) {
+            continue;
+        }
+        (*children)[num_children].firstNode = begin + 1;
+        if (start_agent_child(&(*children)[num_children], daemon_name, apid_str, tool_path,
+            fanout, &hosts[begin], end - begin)) {
+            fprintf(stderr, "%s: failed to start child agent on %s\n", CTI_BE_DAEMON_BINARY, hosts[begin]);
+        }
+        num_children++;
+    }
 
-                // Check to see if user has write access to directory
-                if (access(full_path, W_OK)) {
-                    continue;
-                }
+    free(hosts);
 
-                // Check to see if directory is in use
-                if (session_files_in_use(full_path)) {
-                    continue;
-                }
+    return num_children;
+}
 
-                // Remove unused directory
-                fprintf(stderr, "%s: inst %d: Removing unused directory %s.\n", CTI_BE_DAEMON_BINARY, inst, full_path);
-                remove_dir(full_path);
+// Read file data following a file request from in_fd, forwarding it to each child agent
+// as it is read, and write it to name in the tool path. The file is replaced by rename,
+// as it may be in use by a running tool daemon. Return 0 on success, 1 if the file could
+// not be written, -1 on error or end of file
+static int
+receive_agent_file(int in_fd, char const* tool_path, char const* name, uint64_t file_length,
+    agent_child_t *children, size_t num_children)
+{
+    int rc = -1;
+    int status = 0;
+    int fd = -1;
+    char *path = NULL;
+    char *temp_path = NULL;
+    char buf[65536];
+    size_t i;
+
+    // Files are only written directly in the tool path
+    if ((name[0] == '\0') || (strchr(name, '/') != NULL)
+     || (strcmp(name, ".") == 0) || (strcmp(name, "..") == 0)) {
+        fprintf(stderr, "%s: invalid agent file name %s\n", CTI_BE_DAEMON_BINARY, name);
+        status = 1;
+    } else if ((asprintf(&path, "%s/%s", tool_path, name) <= 0)
+     || (asprintf(&temp_path, "%s.XXXXXX", path) <= 0)) {
+        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
+        path = temp_path = NULL;
+        status = 1;
+    } else if ((fd = mkostemp(temp_path, O_CLOEXEC)) < 0) {
+        fprintf(stderr, "%s: mkostemp %s: %s\n", CTI_BE_DAEMON_BINARY, temp_path, strerror(errno));
+        status = 1;
+    }
+
+    // File data is always read in full to keep the request stream in sync
+    while (file_length > 0) {
+        size_t len = (file_length < sizeof(buf)) ? file_length : sizeof(buf);
+        if (agent_read(in_fd, buf, len)) {
+            goto cleanup_receive_agent_file;
+        }
+        for (i = 0; i < num_children; i++) {
+            if ((children[i].to_fd >= 0) && agent_write(children[i].to_fd, buf, len)) {
+                close_agent_child(&children[i]);
             }
+        }
+        if ((fd >= 0) && agent_write(fd, buf, len)) {
+            fprintf(stderr, "%s: write %s: %s\n", CTI_BE_DAEMON_BINARY, temp_path, strerror(errno));
+            close(fd);
+            fd = -1;
+            unlink(temp_path);
+            status = 1;
+        }
+        file_length -= len;
+    }
 
-            if (full_path != NULL) {
-                free(full_path);
-                full_path = NULL;
-            }
+    if (fd >= 0) {
+        if ((fchmod(fd, S_IRWXU | S_IRWXG | S_IRWXO) < 0) || (close(fd) < 0)
+         || (rename(temp_path, path) < 0)) {
+            fprintf(stderr, "%s: write %s: %s\n", CTI_BE_DAEMON_BINARY, path, strerror(errno));
+            unlink(temp_path);
+            status = 1;
         }
+        fd = -1;
+    }
 
-        fprintf(stderr, "%s: inst %d: Cleanup complete.\n", CTI_BE_DAEMON_BINARY, inst);
+    rc = status;
 
-        return 0;
+cleanup_receive_agent_file:
+    if (fd >= 0) {
+        close(fd);
+        unlink(temp_path);
     }
+    free(temp_path);
+    free(path);
 
-    // We want to write the pid of this process into the pid file for cleanup
-    // later. Note that if the destroy session function is called, it will need
-    // to wait for this instances lock file to get created, which happens below.
-    // That way we are guaranteed to not miss any tool daemons that were started.
+    return rc;
+}
 
-    // Write this pid into the pid file for cleanup
-    if ((o_fd = open(pid_path, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR)) < 0)
-    {
-        fprintf(stderr, "%s: open failed\n", CTI_BE_DAEMON_BINARY);
-        perror("open");
-        return 1;
+// Request waiting on its synchronous daemon or on child agent responses before the
+// aggregated response is written
+typedef struct
+{
+    int out_fd;             // -1 if no request is pending
+    pid_t pid;              // synchronous daemon, or 0 once it has exited
+    size_t children_left;   // child agents that have not yet responded
+    uint32_t num_nodes;     // nodes in the subtree the request was sent to
+    uint32_t *missed;
+    cti_beAgentResponse_t resp;
+} agent_pending_t;
+
+// Add every node in the child agent's subtree to the pending request's missed nodes
+static void
+miss_agent_child(agent_pending_t *pending, agent_child_t *child)
+{
+    uint32_t j;
+    for (j = 0; j < child->numNodes; j++) {
+        pending->missed[pending->resp.numMissed++] = child->firstNode + j;
     }
+}
 
-    // lock the file
-    FLOCK(o_fd);
-
-    // get our pid and write it
-    mypid = getpid();
-    if (write(o_fd, &mypid, sizeof(mypid)) < sizeof(mypid))
-    {
-        fprintf(stderr, "%s: write failed\n", CTI_BE_DAEMON_BINARY);
-        perror("write");
-        return 1;
+// Read the response of a child agent to the pending request, offsetting its missed nodes
+// by the position of its subtree. Every node in the subtree of an agent that has exited
+// is missed
+static void
+read_agent_child_response(agent_pending_t *pending, agent_child_t *child)
+{
+    cti_beAgentResponse_t child_resp;
+    uint32_t *missed = &pending->missed[pending->resp.numMissed];
+    uint32_t j;
+
+    child->responding = 0;
+    pending->children_left--;
+
+    if (agent_read(child->from_fd, &child_resp, sizeof(child_resp))
+     || (child_resp.numMissed > child->numNodes)
+     || agent_read(child->from_fd, missed, child_resp.numMissed * sizeof(uint32_t))) {
+        fprintf(stderr, "%s: child agent %d exited\n", CTI_BE_DAEMON_BINARY, child->pid);
+        close_agent_child(child);
+        miss_agent_child(pending, child);
+        return;
+    }
+    for (j = 0; j < child_resp.numMissed; j++) {
+        missed[j] += child->firstNode;
+    }
+    pending->resp.numMissed += child_resp.numMissed;
+    if (pending->resp.status == 0) {
+        pending->resp.status = child_resp.status;
     }
+}
 
-    // done
-    UNFLOCK(o_fd);
-    close(o_fd);
+// Write the aggregated response once the pending request's daemon has exited and every
+// child agent has responded. Return 0 on success or if still pending, -1 if the response
+// could not be written
+static int
+finish_agent_request(agent_pending_t *pending)
+{
+    int rc = 0;
 
-    // create the path to the lock file
-    if (asprintf(&lock_path, "%s/.lock_%s_%d", tool_path, directory, inst) <= 0)
-    {
-        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
-        return 1;
+    if ((pending->out_fd < 0) || (pending->pid > 0) || (pending->children_left > 0)) {
+        return 0;
     }
 
-    // try to fopen the lock file
-    if ((lock_file = fopen(lock_path, "w")) == NULL)
-    {
-        fprintf(stderr, "%s: fopen on %s failed\n", CTI_BE_DAEMON_BINARY, lock_path);
-        // don't exit here, this will break future tool daemons though so its pretty
-        // bad to have a failure at this point. But it shouldn't screw this instance
-        // up at the very least.
-    } else
-    {
-        // close the file, it has been created
-        fclose(lock_file);
+    pending->resp.numNodes = pending->num_nodes - pending->resp.numMissed;
+    if (agent_write(pending->out_fd, &pending->resp, sizeof(pending->resp))
+     || agent_write(pending->out_fd, pending->missed, pending->resp.numMissed * sizeof(uint32_t))) {
+        rc = -1;
     }
 
-    // Set the BE_GUARD_ENV_VAR environment variable to signal that we are running
-    // on the backend
-    if (setenv(BE_GUARD_ENV_VAR, "1", 1) < 0)
-    {
-        // failure
-        fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
-        return 1;
-    }
+    free(pending->missed);
+    pending->missed = NULL;
+    pending->out_fd = -1;
 
-    // Set the ROOT_DIR_VAR environment variable to the manifest directory.
-    if (setenv(ROOT_DIR_VAR, manifest_path, 1) < 0)
-    {
-        // failure
-        fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
-        return 1;
-    }
+    return rc;
+}
 
-    // Get the current value of the SCRATCH_ENV_VAR environment variable and set
-    // it to OLD_SCRATCH_ENV_VAR in case the tool daemon needs access to it.
-    if ((old_env_path = getenv(SCRATCH_ENV_VAR)) != NULL)
-    {
-        if (setenv(OLD_SCRATCH_ENV_VAR, old_env_path, 1) < 0)
-        {
-            // failure
-            fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
-            return 1;
+// Read one request from in_fd and forward it to each child agent. Run the daemon
+// invocation in a child process, or write the file sent with the request to the tool
+// path. The response is left pending in pending until any synchronous daemon has
+// exited and every child agent has responded. Return 0 on success, -1 on error or end
+// of file
+static int
+handle_agent_request(int in_fd, int out_fd, int listen_fd, char *daemon_name,
+    char const* tool_path, agent_child_t *children, size_t num_children,
+    agent_pending_t *pending)
+{
+    int rc = -1;
+    cti_beAgentRequest_t req;
+    cti_beAgentResponse_t resp = { 0, 0, 0 };
+    uint32_t *missed = NULL;
+    uint32_t num_nodes = 1;
+    char *args = NULL;
+    char **child_argv = NULL;
+    pid_t child_pid = 0;
+    uint32_t i;
+
+    if (agent_read(in_fd, &req, sizeof(req))) {
+        goto cleanup_handle_agent_request;
+    }
+    if ((req.argc > AGENT_MAX_ARGC) || (req.argsLength > AGENT_MAX_ARGS_LENGTH)) {
+        fprintf(stderr, "%s: agent request too large\n", CTI_BE_DAEMON_BINARY);
+        goto cleanup_handle_agent_request;
+    }
+
+    // At most every node in the subtree is missed
+    for (i = 0; i < num_children; i++) {
+        num_nodes += children[i].numNodes;
+    }
+
+    // Read arguments and build argv
+    if (((args = malloc(req.argsLength + 1)) == NULL)
+     || ((child_argv = calloc(req.argc + 2, sizeof(char*))) == NULL)
+     || ((missed = calloc(num_nodes, sizeof(uint32_t))) == NULL)) {
+        perror("malloc");
+        goto cleanup_handle_agent_request;
+    }
+    if (agent_read(in_fd, args, req.argsLength)) {
+        goto cleanup_handle_agent_request;
+    }
+    args[req.argsLength] = '\0';
+    child_argv[0] = daemon_name;
+    { char *arg = args;
+        for (i = 0; i < req.argc; i++) {
+            if (arg >= (args + req.argsLength)) {
+                fprintf(stderr, "%s: agent request arguments truncated\n", CTI_BE_DAEMON_BINARY);
+                goto cleanup_handle_agent_request;
+            }
+            child_argv[i + 1] = arg;
+            arg += strlen(arg) + 1;
         }
     }
 
-    // set the SCRATCH_ENV_VAR environment variable to the toolhelper directory.
-    if (asprintf(&env_path, "%s/tmp", manifest_path) <= 0)
-    {
-        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
-        return 1;
-    }
-    if (setenv(SCRATCH_ENV_VAR, env_path, 1) < 0)
-    {
-        // failure
-        fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
-        return 1;
+    // Forward request down the tree first, so that subtrees run in parallel
+    for (i = 0; i < num_children; i++) {
+        if ((children[i].to_fd >= 0)
+         && (agent_write(children[i].to_fd, &req, sizeof(req))
+          || agent_write(children[i].to_fd, args, req.argsLength))) {
+            close_agent_child(&children[i]);
+        }
     }
 
-    // set the BIN_DIR_VAR environment variable to the toolhelper directory.
-    if (asprintf(&bin_path, "%s/bin", manifest_path) <= 0)
-    {
-        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
-        return 1;
+    if (req.sendFile) {
+        if (req.argc != 1) {
+            fprintf(stderr, "%s: agent file request requires file name\n", CTI_BE_DAEMON_BINARY);
+            goto cleanup_handle_agent_request;
+        }
+        if ((resp.status = receive_agent_file(in_fd, tool_path, child_argv[1], req.fileLength,
+            children, num_children)) < 0) {
+            goto cleanup_handle_agent_request;
+        } else if (resp.status != 0) {
+            missed[resp.numMissed++] = 0;
+        }
+
+    } else if ((child_pid = fork()) < 0) {
+        perror("fork");
+        resp.status = -1;
+        missed[resp.numMissed++] = 0;
+        child_pid = 0;
+
+    } else if (child_pid == 0) {
+        int null_fd;
+
+        // Asynchronous daemons outlive the request, as with nohup
+        if (!req.synchronous) {
+            setsid();
+        }
+
+        // Daemon output is discarded, as for a daemon started by a remote command
+        if ((null_fd = open("/dev/null", O_RDWR)) >= 0) {
+            dup2(null_fd, STDIN_FILENO);
+            dup2(null_fd, STDOUT_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+            if (null_fd > STDERR_FILENO) {
+                close(null_fd);
+            }
+        }
+        if (listen_fd > STDERR_FILENO) {
+            close(listen_fd);
+        }
+        if (in_fd > STDERR_FILENO) {
+            close(in_fd);
+        }
+        if ((out_fd > STDERR_FILENO) && (out_fd != in_fd)) {
+            close(out_fd);
+        }
+        close(agent_sigchld_pipe[0]);
+        close(agent_sigchld_pipe[1]);
+        signal(SIGCHLD, SIG_DFL);
+        signal(SIGPIPE, SIG_DFL);
+
+        // Reinitialize option parsing for the new invocation
+        optind = 0;
+        _exit(run_daemon(req.argc + 1, child_argv));
+
+    } else if (!req.synchronous) {
+        child_pid = 0;
+    }
+
+    // Respond once the synchronous daemon has exited and every child agent that is still
+    // running has responded. Every node in a subtree whose agent has exited is missed
+    *pending = (agent_pending_t){ out_fd, child_pid, 0, num_nodes, missed, resp };
+    missed = NULL;
+    for (i = 0; i < num_children; i++) {
+        if (children[i].to_fd >= 0) {
+            children[i].responding = 1;
+            pending->children_left++;
+        } else {
+            miss_agent_child(pending, &children[i]);
+        }
     }
-    if (setenv(BIN_DIR_VAR, bin_path, 1) < 0)
-    {
-        // failure
-        fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
-        return 1;
+
+    rc = 0;
+
+cleanup_handle_agent_request:
+    free(missed);
+    free(child_argv);
+    free(args);
+
+    return rc;
+}
+
+// Record the exit status of each exited synchronous daemon in its pending request, and
+// reap finished asynchronous daemons and child agents
+static void
+reap_agent_daemons(agent_pending_t *pending, size_t num_pending)
+{
+    pid_t pid;
+    int status;
+    size_t i;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (i = 0; i < num_pending; i++) {
+            if ((pending[i].out_fd >= 0) && (pending[i].pid == pid)) {
+                pending[i].pid = 0;
+                // Status of the daemon on this node takes precedence over its subtree
+                if (!WIFEXITED(status)) {
+                    pending[i].resp.status = -1;
+                } else if (WEXITSTATUS(status) != 0) {
+                    pending[i].resp.status = WEXITSTATUS(status);
+                }
+            }
+        }
     }
+}
 
-    // set the LIB_DIR_VAR environment variable to the toolhelper directory.
-    if (asprintf(&lib_path, "%s/lib", manifest_path) <= 0)
-    {
-        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
-        return 1;
+// Listen on the agent socket at socket_path. Return listening socket, -1 if the
+// socket could not be created, or -2 if a running agent is already listening on it
+static int
+listen_agent_socket(char const* socket_path)
+{
+    int listen_fd = -1;
+    int probe_fd = -1;
+    struct sockaddr_un addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: agent socket path %s too long, only serving stdin\n", CTI_BE_DAEMON_BINARY, socket_path);
+        return -1;
     }
-    if (setenv(LIB_DIR_VAR, lib_path, 1) < 0)
-    {
-        // failure
-        fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
-        return 1;
+    strcpy(addr.sun_path, socket_path);
+
+    // Only remove a socket left behind by an agent that has exited
+    if ((probe_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) >= 0) {
+        if (connect(probe_fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+            close(probe_fd);
+            return -2;
+        }
+        close(probe_fd);
+        if (errno == ECONNREFUSED) {
+            unlink(socket_path);
+        }
     }
 
-    // set FILE_DIR_VAR environment variable to the toolhelper directory
-    if (asprintf(&file_path, "%s", manifest_path) <= 0)
-    {
-        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
-        return 1;
+    if ((listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+        perror("socket");
+        return -1;
     }
-    if (setenv(FILE_DIR_VAR, file_path, 1) < 0)
-    {
-        // failure
-        fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
-        return 1;
+    if ((bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) || (listen(listen_fd, 16) < 0)) {
+        perror("bind");
+        close(listen_fd);
+        return -1;
     }
 
-    // set TOOL_DIR_VAR to tool_path - This should remain hidden from the user and only used by internal library calls
-    if (setenv(TOOL_DIR_VAR, tool_path, 1) < 0)
-    {
-        // failure
-        fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
-        return 1;
-    }
+    return listen_fd;
+}
 
-    // set PMI_ATTRIBS_DIR_VAR to attribs_path if there is one. This is optional.
-    if (attribs_path != NULL)
+// Serve daemon invocations until stdin is closed. Invocations are read from stdin,
+// and from node-local clients owned by this user on the agent socket, so that a
+// frontend can drive staging and tool launches over one long-lived channel. If a
+// tree of hosts is provided, child agents are started on those hosts through a
+// remote shell and every invocation read from stdin is forwarded to them
+static int
+run_agent(int argc, char **argv)
+{
+    int rc = 1;
+    int c;
+    int opt_ind = 0;
+    char *apid_str = NULL;
+    char *tool_path = NULL;
+    char *tree = NULL;
+    int fanout = 0;
+    char *socket_path = NULL;
+    int listen_fd = -1;
+    int client_fds[AGENT_MAX_CLIENTS];
+    size_t num_clients = 0;
+    agent_pending_t pending[1 + AGENT_MAX_CLIENTS] = {{ 0 }};
+    struct pollfd *pfds = NULL;
+    nfds_t num_pfds = 0;
+    agent_child_t *children = NULL;
+    size_t num_children = 0;
+    size_t i;
+
+    // Only the apid, tool path, and tree are used by the agent
+    opterr = 0;
+    while ((c = getopt_long(argc, argv, "a:b:cd:e:i:m:p:t:l:w:h", long_opts, &opt_ind)) != -1)
     {
-        if (setenv(PMI_ATTRIBS_DIR_VAR, attribs_path, 1) < 0)
-        {
-            // failure
-            fprintf(stderr, "%s: setenv failed\n", CTI_BE_DAEMON_BINARY);
-            return 1;
+        if ((c == 'a') && (apid_str == NULL)) {
+            apid_str = strdup(optarg);
+        } else if ((c == 'p') && (tool_path == NULL)) {
+            tool_path = strdup(optarg);
+        } else if ((c == AGENT_TREE_OPT) && (tree == NULL)) {
+            tree = strdup(optarg);
+        } else if (c == AGENT_FANOUT_OPT) {
+            fanout = atoi(optarg);
         }
     }
+    opterr = 1;
 
-    // call _cti_adjustPaths so that we chdir to where we shipped stuff over to and setup PATH/LD_LIBRARY_PATH
-    if (_cti_adjustPaths(manifest_path, ld_lib_path))
-    {
-        fprintf(stderr, "%s: Could not adjust paths.\n", CTI_BE_DAEMON_BINARY);
-        free(tool_path);
-        return 1;
+    if ((apid_str == NULL) || (tool_path == NULL)) {
+        fprintf(stderr, "%s: agent requires apid and tool path\n", CTI_BE_DAEMON_BINARY);
+        goto cleanup_run_agent;
     }
 
-    // ensure that binary was provided, otherwise just exit - the caller wanted to stage stuff.
-    if (binary == NULL)
-    {
-        fprintf(stderr, "%s: inst %d: No binary provided. Stage to %s complete.\n", CTI_BE_DAEMON_BINARY, inst, manifest_path);
-        return 0;
+    // Responses are written to stdout, daemon output is discarded by each child
+    signal(SIGPIPE, SIG_IGN);
+
+    // Listen for node-local clients. Another agent for this apid keeps its socket
+    if (asprintf(&socket_path, "%s/%s%s", tool_path, BE_AGENT_SOCKET_PREFIX, apid_str) <= 0) {
+        socket_path = NULL;
+    } else if ((listen_fd = listen_agent_socket(socket_path)) == -2) {
+        fprintf(stderr, "%s: agent already running on %s\n", CTI_BE_DAEMON_BINARY, socket_path);
+        listen_fd = -1;
+        goto cleanup_run_agent;
     }
 
-    // anything after the final "--" in the options string will be passed directly to the exec'ed binary
+    // Start child agents for the rest of the tree
+    num_children = start_agent_children(&children, argv[0], apid_str, tool_path, fanout, tree);
 
-    // create the full path to the binary we are going to exec
-    if (asprintf(&binary_path, "%s/bin/%s", manifest_path, binary) <= 0)
-    {
-        fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
-        return 1;
+    // Synchronous daemons are reaped in the loop once their SIGCHLD is forwarded through
+    // the pipe, so that the agent keeps serving other requests while they run
+    if (pipe2(agent_sigchld_pipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+        perror("pipe2");
+        goto cleanup_run_agent;
     }
+    signal(SIGCHLD, agent_sigchld_handler);
 
-    if (debug_flag)
-    {
-        _cti_write_log(log, "%s: inst %d: Binary path: %s\n", CTI_BE_DAEMON_BINARY, inst, binary_path);
+    // Poll stdin, the SIGCHLD pipe, the listening socket, each client slot, and each
+    // child agent. Request pending on stdin is first, followed by each client's
+    num_pfds = 3 + AGENT_MAX_CLIENTS + num_children;
+    if ((pfds = calloc(num_pfds, sizeof(struct pollfd))) == NULL) {
+        perror("malloc");
+        goto cleanup_run_agent;
+    }
+    for (i = 0; i < 1 + AGENT_MAX_CLIENTS; i++) {
+        pending[i].out_fd = -1;
     }
 
-    // At this point we need to wait on any other previous tool daemons that may
-    // or may not contain depedencies this instance needs. We will try to make
-    // sure each previous instance has a lock file, otherwise we spin until it
-    // gets created. We have no way of knowing for sure if the previous manifest
-    // contains dependencies that we need. This information is not tracked.
-    for (i = inst-1; i > 0; --i)
-    {
-        // reset sCnt
-        sCnt = 0;
+    for (;;) {
+        int conn_fd;
+        struct ucred cred;
+        socklen_t cred_len = sizeof(cred);
+        struct timeval timeout = { AGENT_CLIENT_TIMEOUT, 0 };
+        char drain[64];
 
-        // free the existing lock path
-        free(lock_path);
+        // Stop reading from stdin or a client while its request is pending, and stop
+        // accepting new clients while the client limit is reached
+        pfds[0] = (struct pollfd){ (pending[0].out_fd < 0) ? STDIN_FILENO : -1, POLLIN, 0 };
+        pfds[1] = (struct pollfd){ agent_sigchld_pipe[0], POLLIN, 0 };
+        pfds[2] = (struct pollfd){ (num_clients < AGENT_MAX_CLIENTS) ? listen_fd : -1, POLLIN, 0 };
+        for (i = 0; i < AGENT_MAX_CLIENTS; i++) {
+            pfds[3 + i] = (struct pollfd){ ((i < num_clients) && (pending[1 + i].out_fd < 0)) ? client_fds[i] : -1, POLLIN, 0 };
+        }
+        for (i = 0; i < num_children; i++) {
+            pfds[3 + AGENT_MAX_CLIENTS + i] = (struct pollfd){ children[i].responding ? children[i].from_fd : -1, POLLIN, 0 };
+        }
 
-        // create the path to this instances lock file
-        if (asprintf(&lock_path, "%s/.lock_%s_%d", tool_path, directory, i) <= 0)
-        {
-            fprintf(stderr, "%s: asprintf failed\n", CTI_BE_DAEMON_BINARY);
-            return 1;
+        if (poll(pfds, num_pfds, -1) < 0) {
+            if (errno == EINTR) { continue; }
+            perror("poll");
+            goto cleanup_run_agent;
         }
 
-        // loop until we can stat this lock file
-        while (stat(lock_path, &statbuf))
-        {
-            // print out a message if sCnt is divisible by 100
-            if (debug_flag)
-            {
-                if (sCnt++%100 == 0)
-                {
-                    _cti_write_log(log, "%s: inst %d: Lock file %s not found. Sleeping...\n", CTI_BE_DAEMON_BINARY, inst, lock_path);
-                }
+        // Record exited synchronous daemons, and reap finished asynchronous daemons
+        if (pfds[1].revents & POLLIN) {
+            while (read(agent_sigchld_pipe[0], drain, sizeof(drain)) > 0) {}
+            reap_agent_daemons(pending, 1 + num_clients);
+        }
+
+        // Only requests from stdin are forwarded to child agents
+        for (i = 0; i < num_children; i++) {
+            if (children[i].responding && (pfds[3 + AGENT_MAX_CLIENTS + i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                read_agent_child_response(&pending[0], &children[i]);
             }
+        }
 
-            // sleep until the file is created
-            usleep(10000);
+        // Exit once controlling channel is closed
+        if (finish_agent_request(&pending[0])) {
+            break;
+        }
+        if (pfds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            if (handle_agent_request(STDIN_FILENO, STDOUT_FILENO, listen_fd, argv[0],
+                tool_path, children, num_children, &pending[0])
+             || finish_agent_request(&pending[0])) {
+                break;
+            }
         }
-    }
 
-    if (debug_flag)
-    {
-        _cti_write_log(log, "%s: inst %d: All dependency locks acquired. Ready to exec.\n", CTI_BE_DAEMON_BINARY, inst);
+        // Serve one request from each ready client, and respond to finished requests,
+        // removing clients that disconnected or stalled. Clients are compacted from the
+        // end so that poll results stay aligned
+        for (i = num_clients; i > 0; i--) {
+            if (((pfds[3 + i - 1].revents & (POLLIN | POLLHUP | POLLERR))
+              && handle_agent_request(client_fds[i - 1], client_fds[i - 1], listen_fd, argv[0],
+                tool_path, NULL, 0, &pending[i]))
+             || finish_agent_request(&pending[i])) {
+                close(client_fds[i - 1]);
+                free(pending[i].missed);
+                client_fds[i - 1] = client_fds[--num_clients];
+                pending[i] = pending[1 + num_clients];
+                pending[1 + num_clients].out_fd = -1;
+                pending[1 + num_clients].missed = NULL;
+            }
+        }
+
+        // Only clients owned by this user may run daemons. A client that stops partway
+        // through a request or response times out instead of stalling the agent
+        if ((listen_fd >= 0) && (pfds[2].revents & POLLIN)) {
+            if ((conn_fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC)) < 0) {
+                continue;
+            }
+            if ((getsockopt(conn_fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) == 0)
+             && (cred.uid == geteuid())
+             && (setsockopt(conn_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0)
+             && (setsockopt(conn_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) == 0)) {
+                client_fds[num_clients++] = conn_fd;
+            } else {
+                close(conn_fd);
+            }
+        }
     }
 
-    // At this point it is safe to assume we have all our dependencies.
+    rc = 0;
 
-    // ensure the binary exists
-    if (stat(binary_path, &statbuf) == -1)
-    {
-        fprintf(stderr, "%s: Could not stat %s\n", CTI_BE_DAEMON_BINARY, binary_path);
-        return 1;
+cleanup_run_agent:
+    for (i = 0; i < num_clients; i++) {
+        close(client_fds[i]);
     }
-
-    // ensure it is a regular file
-    if (!S_ISREG(statbuf.st_mode))
-    {
-        fprintf(stderr, "%s: %s is not a regular file!\n", CTI_BE_DAEMON_BINARY, binary_path);
-        return 1;
+    for (i = 0; i < 1 + AGENT_MAX_CLIENTS; i++) {
+        free(pending[i].missed);
+    }
+    free(pfds);
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(socket_path);
+    }
+    signal(SIGCHLD, SIG_DFL);
+    for (i = 0; i < 2; i++) {
+        if (agent_sigchld_pipe[i] >= 0) {
+            close(agent_sigchld_pipe[i]);
+        }
     }
 
-    // setup the new argv array
-    // Note that argv[optind] is the first argument that appears after the "--" terminator
-    // We need to modify what argv[optind - 1] points to so that it follows the standard argv[0]
-    // nomenclature.
-    argv[optind - 1] = binary_path;
-
-    // now we can exec our program
-    execv(binary_path, &argv[optind - 1]);
+    // Closing child agent input shuts down the rest of the tree
+    for (i = 0; i < num_children; i++) {
+        close_agent_child(&children[i]);
+    }
+    for (i = 0; i < num_children; i++) {
+        if (children[i].pid > 0) {
+            while ((waitpid(children[i].pid, NULL, 0) < 0) && (errno == EINTR)) {}
+        }
+    }
+    free(children);
+    free(socket_path);
+    free(tree);
+    free(tool_path);
+    free(apid_str);
 
-    fprintf(stderr, "%s: inst %d: Return from exec!\n", CTI_BE_DAEMON_BINARY, inst);
+    return rc;
+}
 
+int
+main(int argc, char **argv)
+{
+    int i;
 
-    perror("execv");
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--") == 0) {
+            break;
+        }
+        if (strcmp(argv[i], "--agent") == 0) {
+            return run_agent(argc, argv);
+        }
+    }
 
-    return 1;
+    return run_daemon(argc, argv);
 }
 
 /* Noneness functions for wlm proto */
@@ -17,6 +17,8 @@
 #include <assert.h>
 #include <ctype.h>
 
+#include <sys/mman.h>
+
 #include "cti_defs.h"
 #include "cti_be.h"
 
@@ -67,13 +69,12 @@ _cti_be_flux_getLayoutFromFile(void)
 
     slurmLayout_t *layout = NULL;
     char *hostname = NULL;
-    char *file_dir = NULL;
-    char *layout_path = NULL;
-    FILE *layout_file = NULL;
-    slurmLayoutFile_t *layout_contents = NULL;
-    slurmLayoutFileHeader_t layout_header;
+    void *layout_map = NULL;
+    size_t layout_size = 0;
+    slurmLayoutFileHeader_t const *layout_header = NULL;
+    slurmLayoutFile_t const *layout_contents = NULL;
+    slurmLayoutFile_t const *entry = NULL;
     int i;
-    size_t hostname_len;
 
     // Allocate layout storage
     if ((layout = malloc(sizeof(slurmLayout_t))) == NULL) {
@@ -86,91 +87,50 @@ _cti_be_flux_getLayoutFromFile(void)
         fprintf(stderr, "_cti_be_flux_getNodeHostname failed.\n");
         goto cleanup_getLayoutFromFile;
     }
-    hostname_len = strlen(hostname);
-
-    // Get the file directory were we can find the layout file
-    if ((file_dir = cti_be_getFileDir()) == NULL) {
-        fprintf(stderr, "cti_be_getFileDir failed.\n");
-        goto cleanup_getLayoutFromFile;
-    }
 
-    // Create the path to the layout file
-    if (asprintf(&layout_path, "%s/%s", file_dir, SLURM_LAYOUT_FILE) <= 0) {
-        fprintf(stderr, "asprintf failed.\n");
+    // Map the layout file, only the pages holding the search path and our entry
+    // will be read
+    if ((layout_map = _cti_be_mapFile(SLURM_LAYOUT_FILE, &layout_size)) == NULL) {
         goto cleanup_getLayoutFromFile;
     }
 
-    // Open the layout file for reading
-    if ((layout_file = fopen(layout_path, "rb")) == NULL) {
-        fprintf(stderr, "Could not open %s for reading\n", layout_path);
-        goto cleanup_getLayoutFromFile;
-    }
-
-    // Read the header from the file
-    if (fread(&layout_header, sizeof(slurmLayoutFileHeader_t), 1, layout_file) != 1) {
-        fprintf(stderr, "Could not read header from %s\n", layout_path);
-        goto cleanup_getLayoutFromFile;
-    }
-
-    // allocate the layout contents based on the header
-    if ((layout_contents = calloc(layout_header.numNodes, sizeof(slurmLayoutFile_t))) == NULL) {
-        fprintf(stderr, "calloc failed.\n");
-        goto cleanup_getLayoutFromFile;
-    }
-
-    // Read the layout file into contents
-    if (fread(layout_contents, sizeof(slurmLayoutFile_t), layout_header.numNodes, layout_file)
-        != layout_header.numNodes) {
-        fprintf(stderr, "Couldn't read entire layout file at %s\n", layout_path);
+    // Ensure the file holds every entry listed in the header
+    layout_header = layout_map;
+    layout_contents = (slurmLayoutFile_t const*)(layout_header + 1);
+    if ((layout_size < sizeof(slurmLayoutFileHeader_t))
+     || (layout_header->numNodes < 0)
+     || ((layout_size - sizeof(slurmLayoutFileHeader_t)) / sizeof(slurmLayoutFile_t)
+        < (size_t)layout_header->numNodes)) {
+        fprintf(stderr, "Couldn't read entire layout file %s\n", SLURM_LAYOUT_FILE);
         goto cleanup_getLayoutFromFile;
     }
 
     // Find the entry for this nid
-    for (i = 0; i < layout_header.numNodes; ++i) {
-
-        // Check if this entry corresponds to our nid
-        if (strncmp(layout_contents[i].host, hostname, hostname_len) == 0) {
+    entry = _cti_be_findLayoutEntry(layout_contents, layout_header->numNodes,
+        sizeof(slurmLayoutFile_t), hostname);
+    if (entry != NULL) {
 
-            // Hostname is a prefix of the entry, allow if entry is exactly equal,
-            // or if entry is a full domain name (next character is not alphanumeric)
-            if (isalnum(layout_contents[i].host[hostname_len])) {
-                continue;
-            }
+        // Found it
+        layout->PEsHere = entry->PEsHere;
+        layout->firstPE = entry->firstPE;
+        fprintf(stderr, "Found layout for %s: %d PEs, start at %d\n",
+            hostname, layout->PEsHere, layout->firstPE);
 
-            // Found it
-            layout->PEsHere = layout_contents[i].PEsHere;
-            layout->firstPE = layout_contents[i].firstPE;
-            fprintf(stderr, "Found layout for %s: %d PEs, start at %d\n",
-                hostname, layout->PEsHere, layout->firstPE);
+        result = layout;
 
-            result = layout;
-
-            goto cleanup_getLayoutFromFile;
-        }
+        goto cleanup_getLayoutFromFile;
     }
 
     // Didn't find the host in the layout list!
     fprintf(stderr, "Could not find layout entry for hostname %s\n", hostname);
-    for (i = 0; i < layout_header.numNodes; ++i) {
+    for (i = 0; i < layout_header->numNodes; ++i) {
         fprintf(stderr, "%2d: %s\n", i, layout_contents[i].host);
     }
 
 cleanup_getLayoutFromFile:
-    if (layout_contents != NULL) {
-        free(layout_contents);
-        layout_contents = NULL;
-    }
-    if (layout_file != NULL) {
-        fclose(layout_file);
-        layout_file = NULL;
-    }
-    if (layout_path != NULL) {
-        free(layout_path);
-        layout_path = NULL;
-    }
-    if (file_dir != NULL) {
-        free(file_dir);
-        file_dir = NULL;
+    if (layout_map != NULL) {
+        munmap(layout_map, layout_size);
+        layout_map = NULL;
     }
     if (hostname != NULL) {
         free(hostname);
@@ -214,6 +174,7 @@ _cti_be_flux_getPidsFromFile(slurmLayout_t const* layout)
     // Open the PID file for reading
     if ((pid_file = fopen(pid_path, "rb")) == NULL) {
         fprintf(stderr, "Could not open %s for reading\n", pid_path);
+        goto cleanup_getPidsFromFile;
     }
 
     // read the header from the file
@@ -16,6 +16,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
@@ -98,13 +99,13 @@ _cti_be_generic_ssh_fini(void)
 static int
 _cti_be_generic_ssh_getLayout(void)
 {
-    cti_layout_t *          my_layout;
-    char *                  file_dir;
-    char *                  layoutPath;
-    FILE *                  my_file;
-    cti_layoutFileHeader_t  layout_hdr;
-    cti_layoutFile_t *      layout;
-    int                     i;
+    cti_layout_t *                  my_layout;
+    void *                          layout_map;
+    size_t                          layout_size;
+    cti_layoutFileHeader_t const *  layout_hdr;
+    cti_layoutFile_t const *        layout;
+    cti_layoutFile_t const *        entry;
+    int                             i;
 
     // sanity
     if (_cti_layout != NULL)
@@ -119,99 +120,54 @@ _cti_be_generic_ssh_getLayout(void)
         return 1;
     }
 
-    // get the file directory were we can find the layout file
-    if ((file_dir = cti_be_getFileDir()) == NULL)
+    // map the layout file, only the pages holding the search path and our entry
+    // will be read
+    if ((layout_map = _cti_be_mapFile(SSH_LAYOUT_FILE, &layout_size)) == NULL)
     {
         fprintf(stderr, "_cti_be_generic_ssh_getLayout failed.\n");
         free(my_layout);
         return 1;
     }
 
-    // create the path to the layout file
-    if (asprintf(&layoutPath, "%s/%s", file_dir, SSH_LAYOUT_FILE) <= 0)
-    {
-        fprintf(stderr, "asprintf failed.\n");
-        free(my_layout);
-        free(file_dir);
-        return 1;
-    }
-    // cleanup
-    free(file_dir);
-
-    // open the layout file for reading
-    if ((my_file = fopen(layoutPath, "rb")) == NULL)
-    {
-        fprintf(stderr, "Could not open %s for reading\n", layoutPath);
-        free(my_layout);
-        free(layoutPath);
-        return 1;
-    }
-
-    // read the header from the file
-    if (fread(&layout_hdr, sizeof(cti_layoutFileHeader_t), 1, my_file) != 1)
+    // ensure the file holds every entry listed in the header
+    layout_hdr = layout_map;
+    layout = (cti_layoutFile_t const*)(layout_hdr + 1);
+    if ((layout_size < sizeof(cti_layoutFileHeader_t))
+     || (layout_hdr->numNodes < 0)
+     || ((layout_size - sizeof(cti_layoutFileHeader_t)) / sizeof(cti_layoutFile_t) < (size_t)layout_hdr->numNodes))
     {
-        fprintf(stderr, "Could not read %s\n", layoutPath);
+        fprintf(stderr, "Bad data in %s\n", SSH_LAYOUT_FILE);
         free(my_layout);
-        free(layoutPath);
-        fclose(my_file);
+        munmap(layout_map, layout_size);
         return 1;
     }
 
-    // allocate the layout array based on the header
-    if ((layout = calloc(layout_hdr.numNodes, sizeof(cti_layoutFile_t))) == NULL)
-    {
-        fprintf(stderr, "calloc failed.\n");
-        free(my_layout);
-        free(layoutPath);
-        fclose(my_file);
-        return 1;
-    }
-
-    // read the layout info
-    if (fread(layout, sizeof(cti_layoutFile_t), layout_hdr.numNodes, my_file) != layout_hdr.numNodes)
-    {
-        fprintf(stderr, "Bad data in %s\n", layoutPath);
-        free(my_layout);
-        free(layoutPath);
-        fclose(my_file);
-        free(layout);
-        return 1;
-    }
-
-    // done reading the file
-    free(layoutPath);
-    fclose(my_file);
-
     // find the entry for this nid
-    for (i=0; i < layout_hdr.numNodes; ++i)
+    if ((entry = _cti_be_findLayoutEntry(layout, layout_hdr->numNodes, sizeof(cti_layoutFile_t), hostname)) != NULL)
     {
-        // check if this entry corresponds to our nid
-        if (strncmp(layout[i].host, hostname, strlen(hostname)) == 0)
-        {
-            // found it
-            my_layout->PEsHere = layout[i].PEsHere;
-            my_layout->firstPE = layout[i].firstPE;
+        // found it
+        my_layout->PEsHere = entry->PEsHere;
+        my_layout->firstPE = entry->firstPE;
 
-            // cleanup
-            free(layout);
+        // cleanup
+        munmap(layout_map, layout_size);
 
-            // set global value
-            _cti_layout = my_layout;
+        // set global value
+        _cti_layout = my_layout;
 
-            // done
-            return 0;
-        }
+        // done
+        return 0;
     }
 
     // if we get here, we didn't find the host in the layout list!
     fprintf(stderr, "Could not find layout entry for hostname %s\n", hostname);
 
-    for (i=0; i < layout_hdr.numNodes; ++i) {
+    for (i=0; i < layout_hdr->numNodes; ++i) {
         fprintf(stderr, "%2d: %s\n", i, layout[i].host);
     }
 
     free(my_layout);
-    free(layout);
+    munmap(layout_map, layout_size);
     return 1;
 }
 
@@ -20,6 +20,8 @@
 #include <ctype.h>
 #include <dirent.h>
 
+#include <sys/mman.h>
+
 #include "cti_defs.h"
 #include "cti_be.h"
 
@@ -770,123 +772,94 @@ _cti_be_pals_getRanksFromFile(void)
 	cti_pidList_t *result = NULL;
 
 	char *hostname = NULL;
-	char *file_dir = NULL;
-	char *layout_path = NULL;
-	FILE *layout_file = NULL;
-	palsLayoutEntry_t layout_entry;
-	palsLayoutFileHeader_t layout_header;
-	int i;
-	size_t hostname_len;
+	void *layout_map = NULL;
+	size_t layout_size = 0;
+	palsLayoutFileHeader_t const *layout_header = NULL;
+	palsLayoutIndexEntry_t const *layout_index = NULL;
+	palsLayoutIndexEntry_t const *index_entry = NULL;
+	palsLayoutEntry_t const *layout_entry = NULL;
+	uint64_t entry_offset;
+	size_t rankPidSize;
 
 	// Get hostname to look up
 	if ((hostname = _cti_be_pals_getNodeHostname()) == NULL) {
 		fprintf(stderr, "_cti_be_pals_getNodeHostname failed.\n");
 		goto cleanup_getRanksFromFile;
 	}
-	hostname_len = strlen(hostname);
 
-	// Get the file directory were we can find the layout file
-	if ((file_dir = cti_be_getFileDir()) == NULL) {
-		fprintf(stderr, "cti_be_getFileDir failed.\n");
+	// Map the layout file, only the pages holding the index search path and our
+	// entry will be read
+	if ((layout_map = _cti_be_mapFile(SLURM_LAYOUT_FILE, &layout_size)) == NULL) {
 		goto cleanup_getRanksFromFile;
 	}
 
-	// Create the path to the layout file
-	if (asprintf(&layout_path, "%s/%s", file_dir, SLURM_LAYOUT_FILE) <= 0) {
-		fprintf(stderr, "asprintf failed.\n");
+	// Ensure the file holds the header and index
+	layout_header = layout_map;
+	layout_index = (palsLayoutIndexEntry_t const*)(layout_header + 1);
+	if ((layout_size < sizeof(palsLayoutFileHeader_t))
+	 || (layout_header->numNodes < 0)
+	 || ((layout_size - sizeof(palsLayoutFileHeader_t)) / sizeof(palsLayoutIndexEntry_t)
+		< (size_t)layout_header->numNodes)) {
+		fprintf(stderr, "Could not read header from %s\n", SLURM_LAYOUT_FILE);
 		goto cleanup_getRanksFromFile;
 	}
 
-	// Open the layout file for reading
-	if ((layout_file = fopen(layout_path, "rb")) == NULL) {
-		fprintf(stderr, "Could not open %s for reading\n", layout_path);
+	// Find the index entry for this nid
+	index_entry = _cti_be_findLayoutEntry(layout_index, layout_header->numNodes,
+		sizeof(palsLayoutIndexEntry_t), hostname);
+	if (index_entry == NULL) {
+		fprintf(stderr, "Could not find layout entry for hostname %s\n", hostname);
 		goto cleanup_getRanksFromFile;
 	}
 
-	// Read the header from the file
-	if (fread(&layout_header, sizeof(palsLayoutFileHeader_t), 1, layout_file) != 1) {
-		fprintf(stderr, "Could not read header from %s\n", layout_path);
+	// Read the layout entry. Index entries follow the header unaligned, so copy out
+	// the offset
+	memcpy(&entry_offset, &index_entry->offset, sizeof(entry_offset));
+	if ((entry_offset > layout_size)
+	 || ((layout_size - entry_offset) < sizeof(palsLayoutEntry_t))) {
+		fprintf(stderr, "Could not read layout entry for %s from %s\n", hostname, SLURM_LAYOUT_FILE);
 		goto cleanup_getRanksFromFile;
 	}
+	layout_entry = (palsLayoutEntry_t const*)((char const*)layout_map + entry_offset);
 
-	// Find the entry for this nid
-	for (i = 0; i < layout_header.numNodes; ++i) {
-
-		// Read the layout entry
-		if (fread(&layout_entry, sizeof(palsLayoutEntry_t), 1, layout_file) != 1) {
-			fprintf(stderr, "Could not read layout entry %d from %s\n", i, layout_path);
-			goto cleanup_getRanksFromFile;
-		}
-
-		// Get size of rank / pid array
-		if (layout_entry.numRanks <= 0) {
-			fprintf(stderr, "Invalid number of ranks: %d\n", layout_entry.numRanks);
-		}
-		size_t rankPidSize = sizeof(cti_rankPidPair_t) * layout_entry.numRanks;
-
-		// Check if this entry corresponds to our nid
-		if (strncmp(layout_entry.host, hostname, hostname_len) == 0) {
-
-			// Hostname is a prefix of the entry, allow if entry is exactly equal,
-			// or if entry is a full domain name (next character is not alphanumeric)
-			if (isalnum(layout_entry.host[hostname_len])) {
-
-				// Advance to next entry
-				fseek(layout_file, rankPidSize, SEEK_CUR);
-
-				continue;
-			}
-
-			// Found it
-
-			// Allocate rank list
-			if (((result = malloc(sizeof(cti_pidList_t))) == NULL)
-			|| ((result->pids = malloc(rankPidSize)) == NULL)) {
+	// Get size of rank / pid array
+	if (layout_entry->numRanks <= 0) {
+		fprintf(stderr, "Invalid number of ranks: %d\n", layout_entry->numRanks);
+		goto cleanup_getRanksFromFile;
+	}
+	rankPidSize = sizeof(cti_rankPidPair_t) * layout_entry->numRanks;
 
-				fprintf(stderr, "malloc failed.\n");
-				goto cleanup_getRanksFromFile;
-			}
+	// Allocate rank list
+	if (((result = malloc(sizeof(cti_pidList_t))) == NULL)
+	|| ((result->pids = malloc(rankPidSize)) == NULL)) {
 
-			// Read rank list
-			result->numPids = layout_entry.numRanks;
-			if (fread(result->pids, sizeof(cti_rankPidPair_t), layout_entry.numRanks, layout_file) != layout_entry.numRanks) {
-				fprintf(stderr, "Could not read PID list %d of size %d from %s\n", i, layout_entry.numRanks, layout_path);
+		fprintf(stderr, "malloc failed.\n");
+		goto cleanup_getRanksFromFile;
+	}
 
-				// Free invalid PID array
-				if (result->pids) {
-					free(result->pids);
-					result->pids = NULL;
-				}
+	// Read rank list
+	result->numPids = layout_entry->numRanks;
+	if ((layout_size - entry_offset - sizeof(palsLayoutEntry_t)) < rankPidSize) {
+		fprintf(stderr, "Could not read PID list of size %d from %s\n", layout_entry->numRanks, SLURM_LAYOUT_FILE);
 
-				goto cleanup_getRanksFromFile;
-			}
-
-			goto cleanup_getRanksFromFile;
+		// Free invalid PID array
+		if (result->pids) {
+			free(result->pids);
+			result->pids = NULL;
 		}
 
-		// Advance to next entry
-		fseek(layout_file, rankPidSize, SEEK_CUR);
+		goto cleanup_getRanksFromFile;
 	}
-
-	// Didn't find the host in the layout list!
-	fprintf(stderr, "Could not find layout entry for hostname %s\n", hostname);
+	memcpy(result->pids, layout_entry->rankPidPairs, rankPidSize);
 
 cleanup_getRanksFromFile:
 	if (result && (result->pids == NULL)) {
 		free(result);
 		result = NULL;
 	}
-	if (layout_file != NULL) {
-		fclose(layout_file);
-		layout_file = NULL;
-	}
-	if (layout_path != NULL) {
-		free(layout_path);
-		layout_path = NULL;
-	}
-	if (file_dir != NULL) {
-		free(file_dir);
-		file_dir = NULL;
+	if (layout_map != NULL) {
+		munmap(layout_map, layout_size);
+		layout_map = NULL;
 	}
 	if (hostname != NULL) {
 		free(hostname);
@@ -19,8 +19,10 @@
 #include <signal.h>
 #include <ctype.h>
 
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 
 #include "cti_be.h"
 #include "pmi_attribs_parser.h"
@@ -137,14 +139,13 @@ _cti_be_slurm_fini(void)
 static int
 _cti_be_slurm_getLayout(void)
 {
-    slurmLayout_t *         my_layout;
-    char *                  file_dir;
-    char *                  layoutPath;
-    FILE *                  my_file;
-    slurmLayoutFileHeader_t layout_hdr;
-    slurmLayoutFile_t *     layout;
-    int                     i;
-    size_t                  hostname_len;
+    slurmLayout_t *                 my_layout;
+    void *                          layout_map;
+    size_t                          layout_size;
+    slurmLayoutFileHeader_t const * layout_hdr;
+    slurmLayoutFile_t const *       layout;
+    slurmLayoutFile_t const *       entry;
+    int                             i;
 
     // sanity
     if (_cti_layout != NULL)
@@ -156,7 +157,6 @@ _cti_be_slurm_getLayout(void)
         fprintf(stderr, "_cti_be_slurm_getNodeHostname failed.\n");
         return 1;
     }
-    hostname_len = strlen(hostname);
 
     // allocate the slurmLayout_t object
     if ((my_layout = malloc(sizeof(slurmLayout_t))) == NULL)
@@ -165,106 +165,53 @@ _cti_be_slurm_getLayout(void)
         return 1;
     }
 
-    // get the file directory were we can find the layout file
-    if ((file_dir = cti_be_getFileDir()) == NULL)
-    {
-        fprintf(stderr, "cti_be_getFileDir failed.\n");
-        free(my_layout);
-        return 1;
-    }
-
-    // create the path to the layout file
-    if (asprintf(&layoutPath, "%s/%s", file_dir, SLURM_LAYOUT_FILE) <= 0)
-    {
-        fprintf(stderr, "asprintf failed.\n");
-        free(my_layout);
-        free(file_dir);
-        return 1;
-    }
-    // cleanup
-    free(file_dir);
-
-    // open the layout file for reading
-    if ((my_file = fopen(layoutPath, "rb")) == NULL)
-    {
-        fprintf(stderr, "Could not open %s for reading\n", layoutPath);
-        free(my_layout);
-        free(layoutPath);
-        return 1;
-    }
-
-    // read the header from the file
-    if (fread(&layout_hdr, sizeof(slurmLayoutFileHeader_t), 1, my_file) != 1)
-    {
-        fprintf(stderr, "Could not read %s\n", layoutPath);
-        free(my_layout);
-        free(layoutPath);
-        fclose(my_file);
-        return 1;
-    }
-
-    // allocate the layout array based on the header
-    if ((layout = calloc(layout_hdr.numNodes, sizeof(slurmLayoutFile_t))) == NULL)
+    // map the layout file, only the pages holding the search path and our entry
+    // will be read
+    if ((layout_map = _cti_be_mapFile(SLURM_LAYOUT_FILE, &layout_size)) == NULL)
     {
-        fprintf(stderr, "calloc failed.\n");
         free(my_layout);
-        free(layoutPath);
-        fclose(my_file);
         return 1;
     }
 
-    // read the layout info
-    if (fread(layout, sizeof(slurmLayoutFile_t), layout_hdr.numNodes, my_file) != layout_hdr.numNodes)
+    // ensure the file holds every entry listed in the header
+    layout_hdr = layout_map;
+    layout = (slurmLayoutFile_t const*)(layout_hdr + 1);
+    if ((layout_size < sizeof(slurmLayoutFileHeader_t))
+     || (layout_hdr->numNodes < 0)
+     || ((layout_size - sizeof(slurmLayoutFileHeader_t)) / sizeof(slurmLayoutFile_t) < (size_t)layout_hdr->numNodes))
     {
-        fprintf(stderr, "Bad data in %s\n", layoutPath);
+        fprintf(stderr, "Bad data in %s\n", SLURM_LAYOUT_FILE);
         free(my_layout);
-        free(layoutPath);
-        fclose(my_file);
-        free(layout);
+        munmap(layout_map, layout_size);
         return 1;
     }
 
-    // done reading the file
-    free(layoutPath);
-    fclose(my_file);
-
     // find the entry for this nid
-    for (i=0; i < layout_hdr.numNodes; ++i)
+    if ((entry = _cti_be_findLayoutEntry(layout, layout_hdr->numNodes, sizeof(slurmLayoutFile_t), hostname)) != NULL)
     {
-        // check if this entry corresponds to our nid
-        if (strncmp(layout[i].host, hostname, strlen(hostname)) == 0)
-        {
+        // found it
+        my_layout->PEsHere = entry->PEsHere;
+        my_layout->firstPE = entry->firstPE;
 
-            // Hostname is a prefix of the entry, allow if entry is exactly equal,
-            // or if entry is a full domain name (next character is not alphanumeric)
-            if (isalnum(layout[i].host[hostname_len])) {
-                continue;
-            }
-
-            // found it
-            my_layout->PEsHere = layout[i].PEsHere;
-            my_layout->firstPE = layout[i].firstPE;
-
-            // cleanup
-            free(layout);
+        // cleanup
+        munmap(layout_map, layout_size);
 
-            // set global value
-            _cti_layout = my_layout;
+        // set global value
+        _cti_layout = my_layout;
 
-            // done
-            return 0;
-        }
+        // done
+        return 0;
     }
 
     // if we get here, we didn't find the host in the layout list!
     fprintf(stderr, "Could not find layout entry for hostname %s\n", hostname);
 
-    for (i=0; i < layout_hdr.numNodes; ++i) {
+    for (i=0; i < layout_hdr->numNodes; ++i) {
         fprintf(stderr, "%2d: %s\n", i, layout[i].host);
     }
 
     free(my_layout);
-    free(layout);
+    munmap(layout_map, layout_size);
     return 1;
 }
 
@@ -635,6 +582,124 @@ cleanup_file_read_line:
     return result;
 }
 
+static int
+_cti_be_slurm_compareNodeNameEntry(const void* key, const void* entry)
+{
+    return strncmp((char const*)key, ((slurmNodeNameFile_t const*)entry)->host, HOST_NAME_MAX);
+}
+
+/* Check whether the given hostname, up to the first '.', has an entry in
+   the layout file. Layout entries are Slurm node names, so such a hostname
+   is already the node name, and the frontend does not ship node names for
+   it. Returns the short hostname if found, or NULL.
+*/
+
+static char*
+_cti_be_slurm_findLayoutHostname(char const* hostname)
+{
+    char* result = NULL;
+    void* layout_map;
+    size_t layout_size;
+    slurmLayoutFileHeader_t const* layout_hdr;
+    char short_hostname[HOST_NAME_MAX];
+
+    snprintf(short_hostname, sizeof(short_hostname), "%.*s", (int)strcspn(hostname, "."), hostname);
+
+    if ((layout_map = _cti_be_mapFile(SLURM_LAYOUT_FILE, &layout_size)) == NULL) {
+        return NULL;
+    }
+
+    layout_hdr = layout_map;
+    if ((layout_size >= sizeof(slurmLayoutFileHeader_t))
+     && (layout_hdr->numNodes >= 0)
+     && ((layout_size - sizeof(slurmLayoutFileHeader_t)) / sizeof(slurmLayoutFile_t) >= (size_t)layout_hdr->numNodes)
+     && (_cti_be_findLayoutEntry(layout_hdr + 1, layout_hdr->numNodes, sizeof(slurmLayoutFile_t), short_hostname) != NULL)) {
+        result = strdup(short_hostname);
+    }
+
+    munmap(layout_map, layout_size);
+
+    return result;
+}
+
+/* Look up the Slurm node name for the given hostname in the node name
+   file shipped by the frontend. Entries are sorted by hostname, so the
+   file is mapped and searched in place. Returns NULL if the file or
+   the entry is not available.
+*/
+
+static char*
+_cti_be_slurm_lookupNodeName(char const* hostname)
+{
+    char* result = NULL;
+    char* file_dir = NULL;
+    char* nodeNamePath = NULL;
+    int fd = -1;
+    struct stat st;
+    void* file_map = MAP_FAILED;
+    char short_hostname[HOST_NAME_MAX];
+    slurmNodeNameFileHeader_t const* header;
+    slurmNodeNameFile_t const* entry;
+
+    // Entries hold hostnames up to the first '.'
+    snprintf(short_hostname, sizeof(short_hostname), "%.*s", (int)strcspn(hostname, "."), hostname);
+
+    // get the file directory were we can find the node name file
+    if ((file_dir = cti_be_getFileDir()) == NULL) {
+        goto cleanup__cti_be_slurm_lookupNodeName;
+    }
+    if (asprintf(&nodeNamePath, "%s/%s", file_dir, SLURM_NODENAME_FILE) <= 0) {
+        nodeNamePath = NULL;
+        goto cleanup__cti_be_slurm_lookupNodeName;
+    }
+
+    // Not shipped if the frontend could not query node names
+    if ((fd = open(nodeNamePath, O_RDONLY)) < 0) {
+        goto cleanup__cti_be_slurm_lookupNodeName;
+    }
+    if ((fstat(fd, &st) < 0) || ((size_t)st.st_size < sizeof(slurmNodeNameFileHeader_t))) {
+        fprintf(stderr, "Could not read %s\n", nodeNamePath);
+        goto cleanup__cti_be_slurm_lookupNodeName;
+    }
+    if ((file_map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        perror("mmap");
+        goto cleanup__cti_be_slurm_lookupNodeName;
+    }
+
+    header = file_map;
+    if ((header->numNodes < 0) || ((size_t)st.st_size < sizeof(slurmNodeNameFileHeader_t)
+        + (size_t)header->numNodes * sizeof(slurmNodeNameFile_t))) {
+        fprintf(stderr, "Bad data in %s\n", nodeNamePath);
+        goto cleanup__cti_be_slurm_lookupNodeName;
+    }
+
+    entry = bsearch(short_hostname, header + 1, header->numNodes, sizeof(slurmNodeNameFile_t),
+        _cti_be_slurm_compareNodeNameEntry);
+    if (entry != NULL) {
+        result = strndup(entry->nodeName, sizeof(entry->nodeName));
+    }
+
+cleanup__cti_be_slurm_lookupNodeName:
+    if (file_map != MAP_FAILED) {
+        munmap(file_map, st.st_size);
+        file_map = MAP_FAILED;
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    if (nodeNamePath != NULL) {
+        free(nodeNamePath);
+        nodeNamePath = NULL;
+    }
+    if (file_dir != NULL) {
+        free(file_dir);
+        file_dir = NULL;
+    }
+
+    return result;
+}
+
 /* Try to find the current hostname as reported by the system
    on the list of Slurm nodes associated with the given job.
    This is necessary on HPCM Slurm systems where the node ID
@@ -918,6 +983,24 @@ _cti_be_slurm_getNodeHostname()
         return NULL;
     }
 
+    // Hostnames in the layout are already node names
+    char* layout_hostname = _cti_be_slurm_findLayoutHostname(hostname);
+    if (layout_hostname != NULL) {
+        free(hostname);
+        hostname = layout_hostname;
+
+        return strdup(hostname);
+    }
+
+    // Use the node name looked up by the frontend, if available
+    char* shipped_nodename = _cti_be_slurm_lookupNodeName(hostname);
+    if (shipped_nodename != NULL) {
+        free(hostname);
+        hostname = shipped_nodename;
+
+        return strdup(hostname);
+    }
+
     // If job ID is available, query Slurm for current node name
     char const *slurm_job_id = getenv("SLURM_JOB_ID");
     if (slurm_job_id != NULL) {
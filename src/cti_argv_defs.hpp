@@ -16,6 +16,8 @@ struct DaemonArgv : public cti::Argv {
     static constexpr Option Clean { "clean", 'c' };
     static constexpr Option Help  { "help",  'h' };
     static constexpr Option Debug { "debug",  1 };
+    static constexpr Option Agent { "agent",  2 };
+    static constexpr Option DeferClean { "defer", 8 };
 
     static constexpr Parameter ApID           { "apid",      'a' };
     static constexpr Parameter Binary         { "binary",    'b' };
@@ -23,25 +25,41 @@ struct DaemonArgv : public cti::Argv {
     static constexpr Parameter EnvVariable    { "env",       'e' };
     static constexpr Parameter InstSeqNum     { "inst",      'i' };
     static constexpr Parameter ManifestName   { "manifest",  'm' };
+    static constexpr Parameter FileList       { "files",     'F' };
     static constexpr Parameter ToolPath       { "path",      'p' };
     static constexpr Parameter PMIAttribsPath { "apath",     't' };
     static constexpr Parameter LdLibraryPath  { "ldlibpath", 'l' };
     static constexpr Parameter WLMEnum        { "wlm",       'w' };
+    static constexpr Parameter AgentFanout    { "fanout",     3  };
+    static constexpr Parameter AgentTree      { "tree",       4  };
+    static constexpr Parameter BinaryArgc     { "argc",       5  };
+    static constexpr Parameter BinaryEnv      { "binenv",     6  };
+    static constexpr Parameter CleanThreads   { "threads",    7  };
+    static constexpr Parameter FileListData   { "filedata",   9  };
 
     static constexpr GNUOption long_options[] = {
         Clean,
         Help,
         Debug,
+        Agent,
+        DeferClean,
         ApID,
         Binary,
         Directory,
         EnvVariable,
         InstSeqNum,
         ManifestName,
+        FileList,
         ToolPath,
         PMIAttribsPath,
         LdLibraryPath,
         WLMEnum,
+        AgentFanout,
+        AgentTree,
+        BinaryArgc,
+        BinaryEnv,
+        CleanThreads,
+        FileListData,
         long_options_done
     };
 };
@@ -82,11 +100,13 @@ struct CTIFEDaemonArgv : public cti::Argv {
 
     static constexpr Parameter ReadFD  { "read",  'r' };
     static constexpr Parameter WriteFD { "write", 'w' };
+    static constexpr Parameter LibDir  { "libdir", 'l' };
 
     static constexpr GNUOption long_options[] = {
         Help,
         ReadFD,
         WriteFD,
+        LibDir,
         long_options_done
     };
 };
@@ -43,15 +43,42 @@ extern "C" {
 *******************************************************************************/
 #define WLM_DETECT_LIB_NAME "libwlm_detect.so" // wlm_detect library
 #define LD_AUDIT_LIB_NAME       "libctiaudit.so"                       // ld audit library
+#define CTI_MPIR_MODULE_NAME    "libctimpir.so"                        // MPIR support module loaded by frontend daemon
 
 /*******************************************************************************
 ** Backend defines relating to the compute node
 *******************************************************************************/
 // The following needs the 'X' for random char replacement.
 #define STAGE_DIR_PREFIX                    "cti_daemon"            // default directory name for the fake root of the tool daemon
+#define TRASH_DIR_PREFIX                    ".cti_trash_"           // prefix of session directories detached during cleanup, removed in the background
 #define PMI_ATTRIBS_FILE_NAME               "pmi_attribs"           // Name of the pmi_attribs file to find pid info
 #define PMI_ATTRIBS_DEFAULT_FOPEN_TIMEOUT   60ul                    // default timeout in seconds for trying to open pmi_attribs file
 #define PID_FILE                            ".cti_pids"             // Name of the file containing the pids of the tool daemon processes
+#define BE_AGENT_SOCKET_PREFIX              ".cti_agent_"           // Name of the backend daemon agent socket in the tool path, followed by the apid
+
+// Used to send backend daemon invocations to an agent - used on FE and BE
+// Request begins with the following header
+typedef struct
+{
+    uint32_t synchronous;   // wait for daemon to exit before responding
+    uint32_t argc;          // number of daemon arguments, not including argv[0]
+    uint32_t argsLength;    // total length of arguments
+    uint32_t sendFile;      // write file to tool path instead of running daemon
+    uint64_t fileLength;    // length of file data if sending file
+}   cti_beAgentRequest_t;
+// Followed by argc null-terminated daemon arguments. Agent runs the daemon, forwards
+// requests read from stdin to any child agents, and responds with the following. Requests
+// from the agent socket run only on the agent's node. If sending a file, the single
+// argument is the file name, followed by the file data
+typedef struct
+{
+    int32_t status;     // first nonzero daemon exit status in the agent's subtree if synchronous, or 0
+    uint32_t numNodes;  // number of nodes in the agent's subtree that ran the daemon
+    uint32_t numMissed; // number of nodes in the agent's subtree that did not
+}   cti_beAgentResponse_t;
+// Followed by numMissed uint32_t indices of the missed nodes, where the agent's own node is 0
+// and host i of its tree argument is i + 1. A node is missed if its agent could not be reached,
+// the daemon could not be started, or the file could not be written there
 
 /*******************************************************************************
 ** Cray System information
@@ -69,7 +96,8 @@ typedef struct
 {
     int numNodes;
 }   slurmLayoutFileHeader_t;
-// Followed by numNodes of the following:
+// Followed by numNodes of the following, sorted by host so that each node can binary
+// search for its own entry:
 typedef struct
 {
     char    host[HOST_NAME_MAX];    // hostname of this node
@@ -77,6 +105,20 @@ typedef struct
     int     firstPE;    // first PE on this node
 }   slurmLayoutFile_t;
 
+// Used when reading/writing node name file - used on FE and BE
+// Maps the hostname of each node to its Slurm node name, for systems where they differ
+// File will begin with the following header
+typedef struct
+{
+    int numNodes;
+}   slurmNodeNameFileHeader_t;
+// Followed by numNodes of the following, sorted by host:
+typedef struct
+{
+    char    host[HOST_NAME_MAX];        // hostname of this node, up to the first '.'
+    char    nodeName[HOST_NAME_MAX];    // Slurm node name of this node
+}   slurmNodeNameFile_t;
+
 // Used when reading/writing pid file - used on FE and BE
 // File will begin with the following header
 typedef struct
@@ -102,10 +144,12 @@ typedef struct
 #define SLURM_STAGE_DIR         "slurmXXXXXX"                       // directory name for staging slurm specific files to transfer
 #define SLURM_LAYOUT_FILE       "slurm_layout"                      // name of file containing layout information
 #define SLURM_PID_FILE          "slurm_pid"                         // name of file containing pid information
+#define SLURM_NODENAME_FILE     "slurm_nodenames"                   // name of file mapping hostnames to Slurm node names
 #define SLURM_DAEMON_GRES_ENV_VAR "CTI_SLURM_DAEMON_GRES"           // Set to specify `--gres` argument for tool daemon launches (or leave blank to disable)
 #define SLURM_DAEMON_ARGS_ENV_VAR "CTI_SLURM_DAEMON_ARGS"           // Set to specify extra tool daemon launch arguments
 #define SLURM_OVERRIDE_MC_ENV_VAR "CTI_SLURM_OVERRIDE_MC"           // Set to disable Slurm multi-cluster check
 #define SLURM_OVERRIDE_EPROXY_ENV_VAR "CTI_SLURM_OVERRIDE_EPROXY"       // Set to disable Slurm eproxy configuration check
+#define SLURM_DAEMON_NO_MPIR_ENV_VAR "CTI_SLURM_DAEMON_NO_MPIR"      // Set to launch tool daemons without MPIR control (disables Cassini job limit diagnostics)
 #define SLURM_NEVER_PARSE_SCANCEL                                              \
   "CTI_SLURM_NEVER_PARSE_SCANCEL" // Due to a slurm bug
                                   // (https://bugs.schedmd.com/show_bug.cgi?id=16551),
@@ -180,6 +224,12 @@ typedef struct
 {
     int numNodes;
 }   palsLayoutFileHeader_t;
+// Followed by an index of numNodes of the following, sorted by host:
+typedef struct
+{
+    char        host[HOST_NAME_MAX];    // hostname of this node
+    uint64_t    offset;     // file offset of the layout entry for this node
+}   palsLayoutIndexEntry_t;
 // Followed by numNodes of the following:
 typedef struct
 {
@@ -241,7 +291,14 @@ typedef struct
 #define SRUN_APPEND_ARGS_ENV_VAR     "CTI_SRUN_APPEND"      // Frontend: append these arguments to the variable list of SRUN arguments (read)
 #define CTI_HOST_ADDRESS_ENV_VAR     "CTI_HOST_ADDRESS"     // Frontend: override detection of host IP address
 #define CTI_DEDUPLICATE_FILES_ENV_VAR "CTI_DEDUPLICATE_FILES" // Frontend: ship all files to backends, even if available
+#define CTI_DEDUPLICATE_VERIFY_ENV_VAR "CTI_DEDUPLICATE_VERIFY" // Frontend: backend files must match this to be deduplicated, one of none, size, or mtime (size and modification time, default) (read)
 #define CTI_SKIP_LAUNCHER_CHECK_ENV_VAR "CTI_SKIP_LAUNCHER_CHECK" // Frontend: don't try to verify MPIR symbols
+#define CTI_FE_DAEMON_TERM_GRACE_ENV_VAR "CTI_FE_DAEMON_TERM_GRACE" // Frontend: milliseconds to wait for terminated apps / utilities to exit before SIGKILL (read)
+#define CTI_APP_STATE_REFRESH_ENV_VAR "CTI_APP_STATE_REFRESH" // Frontend: minimum milliseconds between WLM queries of app running state (read)
+#define CTI_METRICS_FILE_ENV_VAR "CTI_METRICS_FILE" // Frontend: write FE daemon request metrics JSON to this file on exit (read)
+#define CTI_CLEANUP_THREADS_ENV_VAR "CTI_CLEANUP_THREADS" // Frontend: number of threads each backend daemon uses to remove session files during cleanup (read)
+#define CTI_DEFER_CLEANUP_ENV_VAR "CTI_DEFER_CLEANUP" // Frontend: detach session directories during cleanup and remove them in the background (read)
+#define CTI_SSH_TREE_FANOUT_ENV_VAR "CTI_SSH_TREE_FANOUT" // Frontend: connect GenericSSH backend daemon agents in a tree with this many children per agent, default connects to every node directly (read)
 
 // Backend related env vars
 #define BE_GUARD_ENV_VAR    "CTI_IAMBACKEND"        //Backend: Set by the daemon launcher to ensure proper setup
@@ -258,6 +315,8 @@ typedef struct
 #define PMI_ATTRIBS_DIR_VAR "CTI_PMI_ATTRIBS_DIR"   //Backend: Used to denote where the pmi_attribs file is located (set)
 #define PMI_ATTRIBS_TIMEOUT_VAR "CTI_PMI_FOPEN_TIMEOUT" //Backend: Used to define a sleep timeout period for creation of pmi_attribs file (read)
 #define PMI_EXTRA_SLEEP_VAR "CTI_PMI_EXTRA_SLEEP"   //Backend: Used to sleep a fixed period of time after the pmi_attribs file has been opened (read)
+#define BE_AGENT_RSH_VAR    "CTI_BE_AGENT_RSH"      //Backend: Remote shell command used by a daemon agent to start child agents on other nodes, default "ssh -T -o BatchMode=yes" (read)
+#define BE_EXTRACT_BLOCK_SIZE_VAR "CTI_BE_EXTRACT_BLOCK_SIZE" //Backend: Read block size in bytes used to extract manifest tarballs (read)
 
 #ifdef __cplusplus
 }
@@ -12,6 +12,7 @@
 #include <filesystem>
 #include <algorithm>
 #include <chrono>
+#include <fstream>
 
 #include <sys/types.h>
 #include <assert.h>
@@ -20,6 +21,7 @@
 
 #include <sys/statvfs.h>
 #include <sys/mount.h>
+#include <poll.h>
 #include <errno.h>
 
 // CTI Transfer includes
@@ -1322,12 +1324,30 @@ Frontend::destroy() {
                     // Ignore cleanup exceptions
                 }
             }
+
+            // Report request metrics while the daemon is still running
+            instance->dumpMetrics();
         }
 
         delete instance;
     }
 }
 
+void
+Frontend::dumpMetrics()
+{
+    auto const metrics = m_daemon.getMetricsJson();
+    writeLog("FE daemon request metrics: %s\n", metrics.c_str());
+
+    if (auto const metricsPath = ::getenv(CTI_METRICS_FILE_ENV_VAR)) {
+        if (auto metricsFile = std::ofstream{metricsPath}) {
+            metricsFile << metrics << std::endl;
+        } else {
+            writeLog("failed to write metrics to %s\n", metricsPath);
+        }
+    }
+}
+
 std::vector<std::string>
 Frontend::getDefaultEnvVars() {
     std::vector<std::string> ret;
@@ -1381,7 +1401,7 @@ Frontend::Frontend()
     m_fe_daemon_path = cti::accessiblePath(m_base_dir + "/libexec/" + CTI_FE_DAEMON_BINARY);
     m_be_daemon_path = cti::accessiblePath(m_base_dir + "/libexec/" + CTI_BE_DAEMON_BINARY);
     // init the frontend daemon now that we have the path to the binary
-    m_daemon.initialize(m_fe_daemon_path);
+    m_daemon.initialize(m_fe_daemon_path, m_base_dir + "/lib");
 }
 
 Frontend::~Frontend()
@@ -1514,11 +1534,26 @@ App::App(Frontend& fe, FE_daemon::DaemonAppId daemonAppId)
     , m_daemonAppId{daemonAppId}
     , m_sessions{}
     , m_uniqueBEDaemonName{CTI_BE_DAEMON_BINARY}
+    , m_runningMutex{}
+    , m_exited{false}
+    , m_runningChecked{}
+    , m_runningRefresh{1000}
+    , m_launcherPidFd{-1}
+    , m_launcherPidFdOpened{false}
 {
     // Generate the unique BE daemon name
     for (size_t i = 0; i < 6; i++) {
         m_uniqueBEDaemonName.push_back(m_frontend.Prng().genChar());
     }
+
+    // Read running state refresh interval
+    if (auto const refresh = ::getenv(CTI_APP_STATE_REFRESH_ENV_VAR)) {
+        try {
+            m_runningRefresh = std::chrono::milliseconds{std::stoul(refresh)};
+        } catch (...) {
+            m_frontend.writeLog("invalid " CTI_APP_STATE_REFRESH_ENV_VAR " value: %s\n", refresh);
+        }
+    }
 }
 
 App::App(Frontend& fe)
@@ -1528,6 +1563,65 @@ App::App(Frontend& fe)
     m_daemonAppId = Frontend::inst().Daemon().request_RegisterApp();
 }
 
+App::~App()
+{
+    if (m_launcherPidFd >= 0) {
+        ::close(m_launcherPidFd);
+    }
+}
+
+bool
+App::launcherExited()
+{
+    // Ask FE daemon for the app's local launcher PID on first use
+    if (!m_launcherPidFdOpened) {
+        m_launcherPidFdOpened = true;
+        try {
+            if (auto const launcherPid = m_frontend.Daemon().request_GetAppPID(m_daemonAppId)) {
+                m_launcherPidFd = cti::pidfdOpen(launcherPid);
+            }
+        } catch (std::exception const& ex) {
+            writeLog("failed to watch launcher: %s\n", ex.what());
+        }
+    }
+
+    if (m_launcherPidFd < 0) {
+        return false;
+    }
+
+    struct pollfd pfd = { m_launcherPidFd, POLLIN, 0 };
+    return (::poll(&pfd, 1, 0) > 0) && (pfd.revents & POLLIN);
+}
+
+bool
+App::isRunningCached()
+{
+    auto const lock = std::lock_guard<std::mutex>{m_runningMutex};
+
+    // Apps don't resume after exiting
+    if (m_exited) {
+        return false;
+    }
+
+    // Check event sources that don't need a WLM query
+    if (launcherExited() || exitReported()) {
+        m_exited = true;
+        return false;
+    }
+
+    // Refresh from WLM if cached state is too old
+    auto const now = std::chrono::steady_clock::now();
+    if (!m_runningChecked || ((now - *m_runningChecked) >= m_runningRefresh)) {
+        if (!isRunning()) {
+            m_exited = true;
+            return false;
+        }
+        m_runningChecked = now;
+    }
+
+    return true;
+}
+
 std::weak_ptr<Session>
 App::createSession()
 {
@@ -1547,12 +1641,32 @@ App::removeSession(std::shared_ptr<Session> sess)
     m_sessions.erase(sess);
 }
 
+void
+App::startDaemons(std::vector<char const* const*> const& argvs)
+{
+    for (auto&& argv : argvs) {
+        startDaemon(argv, /* synchronous */ true);
+    }
+}
+
 void
 App::finalize()
 {
-    // tell all sessions to launch cleanup
+    // launch cleanup for all sessions at once
+    auto cleanupArgvs = std::vector<cti::ManagedArgv>{};
     for (auto&& session : m_sessions) {
-        session->finalize();
+        if (auto cleanupArgv = session->getCleanupArgv()) {
+            cleanupArgvs.emplace_back(std::move(*cleanupArgv));
+        }
+    }
+
+    auto argvs = std::vector<char const* const*>{};
+    for (auto&& cleanupArgv : cleanupArgvs) {
+        argvs.push_back(cleanupArgv.get());
+    }
+    if (!argvs.empty()) {
+        writeLog("launching cleanup for %zu sessions\n", argvs.size());
+        startDaemons(argvs);
     }
     m_sessions.clear();
 }
@@ -11,8 +11,10 @@
 #include <unistd.h>
 
 #include <atomic>
+#include <chrono>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <set>
 #include <unordered_set>
@@ -169,6 +171,9 @@ public: // Public interface to generic WLM-agnostic capabilities
     // Remove an app object
     void removeApp(std::shared_ptr<App> app);
 
+    // Write FE daemon request metrics to log, and to metrics file if set
+    void dumpMetrics();
+
     // Accessors
 
     // Get a list of default env vars to forward to BE daemon
@@ -239,6 +244,10 @@ public: // impl.-specific interface that derived type must implement
     // return if launched app is still running
     virtual bool isRunning() const = 0;
 
+    // return if an event source has already reported app exit. must not block, used to
+    // avoid WLM queries in isRunningCached
+    virtual bool exitReported() { return false; }
+
     // retrieve number of PEs in app
     virtual size_t getNumPEs() const = 0;
 
@@ -268,6 +277,10 @@ public: // impl.-specific interface that derived type must implement
     // start backend tool daemon, optionally waiting for completion
     virtual void startDaemon(CArgArray argv, bool synchronous) = 0;
 
+    // start a backend tool daemon for each argument array and wait for all to complete.
+    // WLMs that can launch daemons concurrently will override, default waits for each in turn
+    virtual void startDaemons(std::vector<char const* const*> const& argvs);
+
     // Return which file paths exist on all backends
     virtual std::set<std::string> checkFilesExist(std::set<std::string> const& paths) {
         // WLMs that are capable of checking this will override and return which paths exist
@@ -286,6 +299,18 @@ private:
     std::unordered_set<std::shared_ptr<Session>> m_sessions;
     // Each app will have its own uniquely named BE daemon to prevent collisions
     std::string m_uniqueBEDaemonName;
+    // Cached running state, queried from WLM at most once per refresh interval
+    std::mutex m_runningMutex;
+    bool m_exited;
+    std::optional<std::chrono::steady_clock::time_point> m_runningChecked;
+    std::chrono::milliseconds m_runningRefresh;
+    // Pidfd for local launcher registered with FE daemon, becomes readable on exit
+    int m_launcherPidFd;
+    bool m_launcherPidFdOpened;
+
+private: // Helpers
+    // Return if local launcher exit was detected
+    bool launcherExited();
 
 public:
     // App specific logger
@@ -310,13 +335,18 @@ public: // Public interface to generic WLM-agnostic capabilities
     // Return the unique BE daemon name
     std::string getBEDaemonName() const { return m_uniqueBEDaemonName; }
 
+    // Return if app is running without querying the WLM in the common case. Launcher
+    // exit and WLM events are detected immediately, otherwise isRunning is called at
+    // most once per CTI_APP_STATE_REFRESH milliseconds
+    bool isRunningCached();
+
 public: // Constructor/destructors
     App(Frontend& fe, FE_daemon::DaemonAppId daemonAppId);
 
     // Forwarding constructor for WLM implementations that do not use MPIR
     App(Frontend& fe);
 
-    virtual ~App() = default;
+    virtual ~App();
     App(const App&) = delete;
     App& operator=(const App&) = delete;
     App(App&&) = delete;
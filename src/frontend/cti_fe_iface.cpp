@@ -703,8 +703,8 @@ cti_appIsValid(cti_app_id_t appId) {
         // Get app instance
         auto sp = fe.Iface().getApp(appId);
 
-        // Check if app running
-        if (!sp->isRunning()) {
+        // Check if app running, usually without querying the WLM
+        if (!sp->isRunningCached()) {
             // Remove the app if not running anymore
             fe.removeApp(sp);
             fe.Iface().removeApp(appId);
@@ -1112,6 +1112,21 @@ cti_execToolDaemon(cti_manifest_id_t mid, const char *daemonPath,
     }, FAILURE);
 }
 
+int
+cti_execToolDaemons(cti_manifest_id_t mid, const cti_toolDaemon_t daemons[], int num_daemons)
+{
+    return FE_iface::runSafely(g_iface_mtx, __func__, [&](){
+        if ((daemons == nullptr) || (num_daemons < 1)) {
+            throw std::runtime_error("no tool daemons provided");
+        }
+        auto&& fe = Frontend::inst();
+        auto mp = fe.Iface().getManifest(mid);
+        mp->execManifest(std::vector<cti_toolDaemon_t>{daemons, daemons + num_daemons});
+        fe.Iface().removeManifest(mid);
+        return SUCCESS;
+    }, FAILURE);
+}
+
 int
 cti_setAttribute(cti_attr_type_t attrib, const char *value)
 {
@@ -1195,6 +1210,15 @@ cti_getAttribute(cti_attr_type_t attrib)
     }, (const char*)nullptr);
 }
 
+char*
+cti_getMetrics(void)
+{
+    return FE_iface::runSafely(g_iface_mtx, __func__, [&](){
+        auto&& fe = Frontend::inst();
+        return strdup(fe.Daemon().getMetricsJson().c_str());
+    }, (char*)nullptr);
+}
+
 cti_symbol_result_t
 cti_containsSymbols(char const* binary_path, char const* const* symbols,
     cti_symbol_query_t query)
@@ -17,12 +17,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <poll.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
 #include <future>
+#include <mutex>
+#include <optional>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
@@ -31,7 +43,9 @@
 
 #include "cti_defs.h"
 #include "useful/cti_argv.hpp"
+#include "useful/cti_dlopen.hpp"
 #include "useful/cti_execvp.hpp"
+#include "useful/cti_metrics.hpp"
 #include "useful/cti_wrappers.hpp"
 #include "useful/cti_split.hpp"
 
@@ -39,17 +53,23 @@
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/uuid/random_generator.hpp>
 
-#include "frontend/mpir_iface/MPIRInstance.hpp"
+#include "frontend/mpir_iface/MPIRModule.hpp"
 #include "cti_fe_daemon_iface.hpp"
 
 using DAppId = FE_daemon::DaemonAppId;
 
+using ReqId    = FE_daemon::ReqId;
 using ReqType  = FE_daemon::ReqType;
 using RespType = FE_daemon::RespType;
+using ReqHeader  = FE_daemon::ReqHeader;
+using RespHeader = FE_daemon::RespHeader;
 using OKResp   = FE_daemon::OKResp;
 using IDResp   = FE_daemon::IDResp;
 using StringResp = FE_daemon::StringResp;
 using MPIRResp = FE_daemon::MPIRResp;
+using StatusResp = FE_daemon::StatusResp;
+using MPIRStatus = FE_daemon::MPIRStatus;
+using UtilStatus = FE_daemon::UtilStatus;
 
 cti::Logger&
 getLogger(void)
@@ -76,15 +96,113 @@ getLogger(void)
     return _cti_logger;
 }
 
+// time to wait for terminated processes to exit before sending SIGKILL
+static std::chrono::milliseconds
+getTermGracePeriod()
+{
+    static auto const gracePeriod = []() {
+        if (auto const grace_ms = ::getenv(CTI_FE_DAEMON_TERM_GRACE_ENV_VAR)) {
+            try {
+                return std::chrono::milliseconds{std::stol(grace_ms)};
+            } catch (...) {
+                getLogger().write("invalid %s: %s\n", CTI_FE_DAEMON_TERM_GRACE_ENV_VAR, grace_ms);
+            }
+        }
+        return std::chrono::milliseconds{3000};
+    }();
+    return gracePeriod;
+}
+
+// check for exit of process that has no pidfd, reaping if it is our child
+static bool
+checkExited(pid_t const pid)
+{
+    auto const rc = ::waitpid(pid, nullptr, WNOHANG);
+    if (rc == pid) {
+        return true;
+    } else if ((rc < 0) && (errno == ECHILD)) {
+        return (::kill(pid, 0) < 0) && (errno == ESRCH);
+    }
+    return false;
+}
+
+// send terminate signal to all processes, then SIGKILL any that have not exited once
+// the grace period has elapsed. returns as soon as all processes have exited
 static void
-tryTerm(pid_t const pid, int terminate_signum)
+terminateProcs(std::unordered_map<pid_t, int> const& pidSignals)
 {
-    if (::kill(pid, terminate_signum)) {
-        return;
+    struct Target
+    {
+        pid_t pid;
+        int pidfd;
+    };
+
+    // signal processes, skip those that have already exited
+    auto remaining = std::vector<Target>{};
+    for (auto&& [pid, terminate_signum] : pidSignals) {
+        auto const pidfd = cti::pidfdOpen(pid);
+        if (::kill(pid, terminate_signum)) {
+            if (pidfd >= 0) {
+                ::close(pidfd);
+            }
+            continue;
+        }
+        remaining.push_back(Target{pid, pidfd});
+    }
+
+    auto reap = [](Target const& target) {
+        if (target.pidfd >= 0) {
+            ::close(target.pidfd);
+        }
+        ::waitpid(target.pid, nullptr, WNOHANG);
+    };
+
+    // wait for exits until grace period elapses
+    auto const deadline = std::chrono::steady_clock::now() + getTermGracePeriod();
+    while (!remaining.empty()) {
+        auto const now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            break;
+        }
+
+        // processes without pidfd support are checked periodically
+        auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+        auto pollFds = std::vector<struct pollfd>{};
+        for (auto&& target : remaining) {
+            if (target.pidfd >= 0) {
+                pollFds.push_back({target.pidfd, POLLIN, 0});
+            } else {
+                timeout = std::min(timeout, std::chrono::milliseconds{10});
+            }
+        }
+        if ((::poll(pollFds.data(), pollFds.size(), timeout.count() + 1) < 0) && (errno != EINTR)) {
+            getLogger().write("poll failed: %s\n", strerror(errno));
+            break;
+        }
+
+        // remove exited processes
+        auto pollFd = pollFds.begin();
+        remaining.erase(std::remove_if(remaining.begin(), remaining.end(), [&](Target const& target) {
+            auto const exited = (target.pidfd >= 0)
+                ? ((pollFd++)->revents != 0)
+                : checkExited(target.pid);
+            if (exited) {
+                reap(target);
+            }
+            return exited;
+        }), remaining.end());
+    }
+
+    // escalate to SIGKILL
+    for (auto&& target : remaining) {
+        ::kill(target.pid, SIGKILL);
+    }
+    for (auto&& target : remaining) {
+        if (target.pidfd >= 0) {
+            ::close(target.pidfd);
+        }
+        cti::waitpid(target.pid, nullptr, 0);
     }
-    ::sleep(3);
-    ::kill(pid, SIGKILL);
-    cti::waitpid(pid, nullptr, 0);
 }
 
 /* types */
@@ -101,25 +219,22 @@ struct ProcSet
         moved.m_pidSignals.clear();
     }
 
+    // Only valid to assign to an empty set, existing processes would not be terminated
+    ProcSet& operator=(ProcSet&& moved)
+    {
+        m_pidSignals = std::move(moved.m_pidSignals);
+        moved.m_pidSignals.clear();
+        return *this;
+    }
+
     void clear()
     {
         // copy and clear member
         auto const pidSignals = m_pidSignals;
         m_pidSignals.clear();
 
-        // create futures
-        std::vector<std::future<void>> termFutures;
-        termFutures.reserve(m_pidSignals.size());
-
-        // terminate in parallel
-        for (auto&& [pid, terminate_signum] : pidSignals) {
-            termFutures.emplace_back(std::async(std::launch::async, tryTerm, pid, terminate_signum));
-        }
-
-        // collect
-        for (auto&& future : termFutures) {
-            future.wait();
-        }
+        // terminate together, sharing one grace period
+        terminateProcs(pidSignals);
     }
 
     ~ProcSet()
@@ -133,6 +248,12 @@ struct ProcSet
         m_pidSignals[pid] = terminate_signum;
     }
     void erase(pid_t const pid)    { m_pidSignals.erase(pid);  }
+
+    // Take ownership of processes from other set
+    void merge(ProcSet&& other) {
+        m_pidSignals.merge(other.m_pidSignals);
+        other.m_pidSignals.clear();
+    }
     bool contains(pid_t const pid) { return (m_pidSignals.find(pid) != m_pidSignals.end()); }
 
     // Remove PID from list without ending child process
@@ -154,16 +275,43 @@ auto idPidMap = std::unordered_map<pid_t, DAppId>{};
 auto appCleanupList = ProcSet{};
 auto utilMap = std::unordered_map<DAppId, ProcSet>{};
 
-auto mpirMap     = std::unordered_map<DAppId, std::unique_ptr<MPIRInstance>>{};
+// Instances are shared so that they can be used by worker threads without holding
+// stateMutex, and are destroyed once no longer in use
+auto mpirMap     = std::unordered_map<DAppId, std::shared_ptr<MPIRHandle>>{};
+
+// MPIR instances being run by worker threads, terminated on daemon shutdown
+auto activeInstances = std::unordered_set<std::shared_ptr<MPIRHandle>>{};
+
+// MPIR instances released for WaitMPIRAny / WaitMPIRAll. Each runs to exit on its
+// own thread, exit status is kept until collected by every wait request waiting on it,
+// or by a later wait request if none is
+struct MPIRExitWaiter
+{
+    std::optional<bool> success; // set once instance has exited
+    int numWaiting = 0; // wait requests that will collect the exit status
+    std::future<void> thread;
+};
+auto mpirExitMap = std::unordered_map<DAppId, MPIRExitWaiter>{};
+std::condition_variable mpirExitCv;
+
+// Protects app / util / MPIR state above, which is shared with worker threads
+std::mutex stateMutex;
 
 // communication
 int reqFd  = -1; // incoming request pipe
 int respFd = -1; // outgoing response pipe
+std::string libDir; // CTI library directory resolved by frontend
+int signalPipe[2] = {-1, -1}; // signal handler to main loop
+
+// Responses from main loop and worker threads are written whole under lock
+std::mutex respMutex;
+
+// Time from receiving each request until its response is written
+cti::RequestMetrics reqMetrics;
 
 // threading helpers
 auto main_loop_running = false;
-std::vector<std::future<void>> sigchldThreads;
-std::unique_ptr<MPIRInstance> launchingInstance;
+std::vector<std::future<void>> workerThreads;
 
 /* runtime helpers */
 
@@ -178,28 +326,118 @@ usage(char *name)
         CTIFEDaemonArgv::ReadFD.val, CTIFEDaemonArgv::ReadFD.name);
     fprintf(stdout, "\t-%c, --%s  fd of write control pipe        (required)\n",
         CTIFEDaemonArgv::WriteFD.val, CTIFEDaemonArgv::WriteFD.name);
+    fprintf(stdout, "\t-%c, --%s CTI library directory\n",
+        CTIFEDaemonArgv::LibDir.val, CTIFEDaemonArgv::LibDir.name);
     fprintf(stdout, "\t-%c, --%s  Display this text and exit\n\n",
         CTIFEDaemonArgv::Help.val, CTIFEDaemonArgv::Help.name);
 }
 
+// run long-running request on worker thread so that main loop can continue to handle requests
+template <typename Func>
+static void startWorker(Func&& func)
+{
+    workerThreads.emplace_back(std::async(std::launch::async, std::forward<Func>(func)));
+}
+
+// remove finished worker threads
+static void reapWorkers()
+{
+    workerThreads.erase(std::remove_if(workerThreads.begin(), workerThreads.end(),
+        [](std::future<void> const& worker) {
+            return worker.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+        }), workerThreads.end());
+}
+
+// MPIR support module, loaded on first MPIR request so that daemon startup does not
+// need to load Dyninst
+struct LibMPIR
+{
+    cti::Dlopen::Handle libMPIRHandle;
+    std::function<MPIRModuleLaunchFn> launch;
+    std::function<MPIRModuleAttachFn> attach;
+
+    LibMPIR(std::string const& path)
+        : libMPIRHandle{path}
+        , launch{libMPIRHandle.load<MPIRModuleLaunchFn>(CTI_MPIR_MODULE_LAUNCH)}
+        , attach{libMPIRHandle.load<MPIRModuleAttachFn>(CTI_MPIR_MODULE_ATTACH)}
+    {}
+};
+
+static LibMPIR const& getLibMPIR()
+{
+    // Module is loaded from the library directory resolved by the frontend. If not
+    // provided, fall back to the lib directory alongside daemon's libexec directory.
+    // Never unloaded, as MPIR instances may be destroyed during daemon exit
+    static auto const libMPIR = []() {
+        auto const moduleDir = !libDir.empty()
+            ? std::filesystem::path{libDir}
+            : std::filesystem::read_symlink("/proc/self/exe").parent_path().parent_path() / "lib";
+        auto const path = (moduleDir / CTI_MPIR_MODULE_NAME).string();
+        getLogger().write("Loading MPIR module %s\n", path.c_str());
+        return new LibMPIR{path};
+    }();
+
+    return *libMPIR;
+}
+
+static std::shared_ptr<MPIRHandle> launchMPIRInstance(std::string const& launcher,
+    std::vector<std::string> const& launcherArgv, std::vector<std::string> const& envVars,
+    std::map<int, int> const& remapFds)
+{
+    return std::shared_ptr<MPIRHandle>{getLibMPIR().launch(launcher, launcherArgv, envVars, remapFds)};
+}
+
+static std::shared_ptr<MPIRHandle> attachMPIRInstance(std::string const& attacher, pid_t pid)
+{
+    return std::shared_ptr<MPIRHandle>{getLibMPIR().attach(attacher, pid)};
+}
+
+// Register MPIR instance as in use by a worker thread for the lifetime of this object
+struct ActiveInstance
+{
+    std::shared_ptr<MPIRHandle> m_instance;
+
+    ActiveInstance(std::shared_ptr<MPIRHandle> instance)
+        : m_instance{std::move(instance)}
+    {
+        auto const lock = std::lock_guard<std::mutex>{stateMutex};
+        activeInstances.insert(m_instance);
+    }
+
+    ~ActiveInstance()
+    {
+        auto const lock = std::lock_guard<std::mutex>{stateMutex};
+        activeInstances.erase(m_instance);
+    }
+};
+
+// interrupt worker threads blocking on MPIR launches or waits by ending the launchers.
+// Instances are terminated outside of stateMutex, as ending each launcher can block
+static void terminateActiveInstances()
+{
+    auto instances = std::vector<std::shared_ptr<MPIRHandle>>{};
+    { auto const lock = std::lock_guard<std::mutex>{stateMutex};
+        instances.assign(activeInstances.begin(), activeInstances.end());
+    }
+
+    for (auto&& instance : instances) {
+        getLogger().write("MPIR instance in progress, terminating PID %d\n", instance->getLauncherPid());
+        instance->terminate();
+    }
+}
+
 static void
 terminate_main_loop()
 {
     getLogger().write("Terminating main loop\n");
 
-    // Main loop is blocking on a frontend request from reqFd
     // If the daemon got a SIGHUP, the frontend terminated
-    // without sending a shutdown request. Closing reqFd
-    // will cause the main loop to stop waiting and exit
-    close(reqFd);
+    // without sending a shutdown request. Stop waiting for requests
+    main_loop_running = false;
 
-    // If in the process of an MPIR launch, the main thread
-    // is blocking waiting for MPIR Breakpoint. This will interrupt
-    // the wait by ending the launcher.
-    if (launchingInstance) {
-        getLogger().write("MPIR launch in progress, terminating PID %d\n", launchingInstance->getLauncherPid());
-        launchingInstance->terminate();
-    }
+    // If in the process of MPIR launches, worker threads are blocking
+    // waiting for MPIR Breakpoint
+    terminateActiveInstances();
 }
 
 /* signal handlers */
@@ -212,14 +450,13 @@ sigchld_handler(pid_t const exitedPid)
         return;
     }
 
+    auto const lock = std::lock_guard<std::mutex>{stateMutex};
+
     // regular app termination
     if (appCleanupList.contains(exitedPid)) {
 
         // Reap zombie if available
-        { auto const saved_errno = errno;
-            ::waitpid(exitedPid, 0, WNOHANG);
-            errno = saved_errno;
-        }
+        ::waitpid(exitedPid, 0, WNOHANG);
 
         // app already terminated
         appCleanupList.erase(exitedPid);
@@ -231,32 +468,65 @@ sigchld_handler(pid_t const exitedPid)
         auto const exitedId = pidIdPair->second;
 
         // terminate all of app's utilities
-        if (utilMap.find(exitedId) != utilMap.end()) {
-            sigchldThreads.emplace_back(std::async(std::launch::async,
-                [exitedId](){ utilMap.erase(exitedId); }));
+        auto const idUtilsPair = utilMap.find(exitedId);
+        if (idUtilsPair != utilMap.end()) {
+            startWorker([utilProcs = std::move(idUtilsPair->second)]() mutable {
+                utilProcs.clear();
+            });
+            utilMap.erase(idUtilsPair);
         }
     }
 }
 
-// dispatch to sigchld / term handler
+// signal information forwarded from handler to main loop
+struct SignalEvent
+{
+    int signum;
+    int code;
+    pid_t pid;
+};
+
+// forward sigchld / term to main loop
 static void
 cti_fe_daemon_handler(int sig, siginfo_t *sig_info, void *secret)
 {
-    if (sig == SIGCHLD) {
-        if ((sig_info->si_code == CLD_EXITED) && (sig_info->si_pid > 1)) {
-            sigchld_handler(sig_info->si_pid);
-        }
-    } else if ((sig == SIGTERM) || (sig == SIGHUP)) {
-        terminate_main_loop();
+    if ((sig == SIGCHLD) || (sig == SIGTERM) || (sig == SIGHUP)) {
+        auto const saved_errno = errno;
+        auto const signalEvent = SignalEvent
+            { .signum = sig
+            , .code = sig_info->si_code
+            , .pid = sig_info->si_pid
+        };
+        // Write is atomic, will be dropped if pipe is full
+        (void)::write(signalPipe[1], &signalEvent, sizeof(signalEvent));
+        errno = saved_errno;
     } else {
         // TODO: determine which signals should be relayed to child
     }
 }
 
+// dispatch signals forwarded to main loop
+static void
+handle_signals()
+{
+    auto signalEvent = SignalEvent{};
+    while (::read(signalPipe[0], &signalEvent, sizeof(signalEvent)) == sizeof(signalEvent)) {
+        if (signalEvent.signum == SIGCHLD) {
+            if ((signalEvent.code == CLD_EXITED) && (signalEvent.pid > 1)) {
+                sigchld_handler(signalEvent.pid);
+            }
+        } else if ((signalEvent.signum == SIGTERM) || (signalEvent.signum == SIGHUP)) {
+            terminate_main_loop();
+        }
+    }
+}
+
 /* registration helpers */
 
 static DAppId registerAppPID(pid_t const app_pid)
 {
+    auto const lock = std::lock_guard<std::mutex>{stateMutex};
+
     // Create new app ID without PID
     if (app_pid == 0) {
         auto const appId = newId();
@@ -276,6 +546,8 @@ static DAppId registerAppPID(pid_t const app_pid)
 
 static void registerUtilPID(DAppId const app_id, pid_t const util_pid, int terminate_signum)
 {
+    auto const lock = std::lock_guard<std::mutex>{stateMutex};
+
     // verify app pid
     if (idPidMap.find(app_id) == idPidMap.end()) {
         throw std::runtime_error("invalid app id: " + std::to_string(app_id));
@@ -289,105 +561,147 @@ static void registerUtilPID(DAppId const app_id, pid_t const util_pid, int termi
     }
 }
 
-static void deregisterAppID(DAppId const app_id)
+// remove app ID from registration state, return app PID and app's utilities.
+// utilities must be terminated by caller, outside of state lock
+static pid_t removeAppID(DAppId const app_id, ProcSet& utilProcs)
 {
     auto const idPidPair = idPidMap.find(app_id);
-    if (idPidPair != idPidMap.end()) {
-        auto const app_pid = idPidPair->second;
+    if (idPidPair == idPidMap.end()) {
+        throw std::runtime_error("invalid app id: " + std::to_string(app_id));
+    }
+    auto const app_pid = idPidPair->second;
 
-        // remove from ID list
-        idPidMap.erase(idPidPair);
-        if (app_pid > 0) {
-            pidIdMap.erase(app_pid);
-        }
+    // remove from ID list
+    idPidMap.erase(idPidPair);
+    if (app_pid > 0) {
+        pidIdMap.erase(app_pid);
+    }
 
-        // terminate all of app's utilities
-        auto utilTermFuture = std::async(std::launch::async,
-            [app_id](){ utilMap.erase(app_id); });
+    // take ownership of app's utilities
+    auto const idUtilsPair = utilMap.find(app_id);
+    if (idUtilsPair != utilMap.end()) {
+        utilProcs = std::move(idUtilsPair->second);
+        utilMap.erase(idUtilsPair);
+    }
 
-        // ensure app is terminated
-        if (appCleanupList.contains(app_pid)) {
-            auto appTermFuture = std::async(std::launch::async, [app_pid](){
-                tryTerm(app_pid, SIGTERM);
-            });
-            appCleanupList.erase(app_pid);
-            appTermFuture.wait();
-        }
+    return app_pid;
+}
 
-        // finish util termination
-        utilTermFuture.wait();
-    } else {
-        throw std::runtime_error("invalid app id: " + std::to_string(app_id));
+static void deregisterAppID(DAppId const app_id)
+{
+    auto utilProcs = ProcSet{};
+    auto app_pid = pid_t{};
+    auto terminateApp = false;
+    { auto const lock = std::lock_guard<std::mutex>{stateMutex};
+        app_pid = removeAppID(app_id, utilProcs);
+
+        terminateApp = appCleanupList.contains(app_pid);
+        appCleanupList.erase(app_pid);
+    }
+
+    // terminate all of app's utilities, and ensure app is terminated
+    if (terminateApp) {
+        utilProcs.insert(app_pid, SIGTERM);
     }
+    utilProcs.clear();
 }
 
 static void releaseAppID(DAppId const app_id)
 {
-    auto const idPidPair = idPidMap.find(app_id);
-    if (idPidPair != idPidMap.end()) {
-        auto const app_pid = idPidPair->second;
-
-        // remove from ID list
-        idPidMap.erase(idPidPair);
-        if (app_pid > 0) {
-            pidIdMap.erase(app_pid);
-        }
+    // Application child process will reparent on CTI exit,
+    // utilities launched by CTI for application will be terminated
+    // when utilProcs goes out of scope
+    auto utilProcs = ProcSet{};
+    { auto const lock = std::lock_guard<std::mutex>{stateMutex};
+        auto const app_pid = removeAppID(app_id, utilProcs);
 
-        // Application child process will reparent on CTI exit,
-        // utilities launched by CTI for application will be terminated
         appCleanupList.release(app_pid);
-        utilMap.erase(app_id);
-
-    } else {
-        throw std::runtime_error("invalid app id: " + std::to_string(app_id));
     }
 }
 
 static bool checkAppID(DAppId const app_id)
 {
-    auto const idPidPair = idPidMap.find(app_id);
-    if (idPidPair != idPidMap.end()) {
-        auto const app_pid = idPidPair->second;
-
-        // Assume remote PID is still valid
-        if (app_pid == 0) {
-            return true;
+    auto app_pid = pid_t{};
+    { auto const lock = std::lock_guard<std::mutex>{stateMutex};
+        auto const idPidPair = idPidMap.find(app_id);
+        if (idPidPair == idPidMap.end()) {
+            throw std::runtime_error("invalid app id: " + std::to_string(app_id));
         }
+        app_pid = idPidPair->second;
+    }
 
-        // Check if app's PID is still valid
-        getLogger().write("check pid %d\n", app_pid);
-        if (::kill(app_pid, 0) == 0) {
-            // Check if zombie
-            auto const statusFilePath = "/proc/" + std::to_string(app_pid) + "/status";
-            char const* grepArgv[] = { "grep", "Z (zombie)", statusFilePath.c_str(), nullptr };
-            auto grepOutput = cti::Execvp{"grep", (char* const*)grepArgv, cti::Execvp::stderr::Ignore};
-            auto const grepExitStatus = grepOutput.getExitStatus();
-            auto const pidZombie = (grepExitStatus == 0);
+    // Assume remote PID is still valid
+    if (app_pid == 0) {
+        return true;
+    }
 
-            static int count = 0;
-            getLogger().write("%05d %s: %s\n", count++, statusFilePath.c_str(),
-                pidZombie ? "zombie" : "no zombie");
+    // Check if app's PID is still valid
+    getLogger().write("check pid %d\n", app_pid);
+    if (::kill(app_pid, 0) == 0) {
+        // Check if zombie from process state in stat file
+        auto const statFilePath = "/proc/" + std::to_string(app_pid) + "/stat";
+        auto pidZombie = false;
+        if (auto statFile = std::ifstream{statFilePath}) {
+            auto stat = std::string{};
+            std::getline(statFile, stat);
+
+            // State follows executable name, which can contain spaces and parentheses
+            auto const nameEnd = stat.rfind(')');
+            pidZombie = (nameEnd != std::string::npos) && ((nameEnd + 2) < stat.length())
+                && (stat[nameEnd + 2] == 'Z');
+        }
 
-            return !pidZombie;
-        } else {
-            getLogger().write("kill %d sig 0 failed\n", app_pid);
+        static int count = 0;
+        getLogger().write("%05d %s: %s\n", count++, statFilePath.c_str(),
+            pidZombie ? "zombie" : "no zombie");
 
-            // PID no longer valid
-            return false;
-        }
+        return !pidZombie;
     } else {
+        getLogger().write("kill %d sig 0 failed\n", app_pid);
+
+        // PID no longer valid
+        return false;
+    }
+}
+
+// return PID of local app process, or 0 if app is remote
+static pid_t getAppPID(DAppId const app_id)
+{
+    auto const lock = std::lock_guard<std::mutex>{stateMutex};
+
+    auto const idPidPair = idPidMap.find(app_id);
+    if (idPidPair == idPidMap.end()) {
         throw std::runtime_error("invalid app id: " + std::to_string(app_id));
     }
+
+    return idPidPair->second;
 }
 
 /* protocol helpers */
 
+// launch strings are null-terminated views into the request frame data, or into
+// strings added by the daemon
 struct LaunchData {
     int stdin_fd, stdout_fd, stderr_fd;
-    std::string filepath;
-    std::vector<std::string> argvList;
-    std::vector<std::string> envList;
-    std::vector<std::string> envBlacklist;
+    std::string_view filepath;
+    std::vector<std::string_view> argvList;
+    std::vector<std::string_view> envList;
+    std::vector<std::string_view> envBlacklist;
+
+    // descriptors other than stdin/out/err that the child inherits (not read from request)
+    std::vector<int> inheritFds;
+
+    std::shared_ptr<std::string const> frameData;
+    std::shared_ptr<std::deque<std::string>> addedStrings;
+
+    // store string for the lifetime of the launch data and return view of it
+    std::string_view addString(std::string str)
+    {
+        if (!addedStrings) {
+            addedStrings = std::make_shared<std::deque<std::string>>();
+        }
+        return addedStrings->emplace_back(std::move(str));
+    }
 };
 
 struct ShimData {
@@ -396,139 +710,360 @@ struct ShimData {
     std::string shimmedLauncherPath;
 };
 
-// read stdin/out/err fds, filepath, argv, environment map appended to an app / util / mpir launch request
-static LaunchData readLaunchData(int const reqFd)
+// request data received from client in a single frame, parsed from memory
+class ReqFrame
 {
-    LaunchData result;
+    std::shared_ptr<std::string const> m_data; // shared with views that outlive the frame
+    size_t m_offset;
+    std::vector<int> m_fds; // file descriptors passed with request
+
+public:
+    ReqFrame(std::string&& data, std::vector<int>&& fds)
+        : m_data{std::make_shared<std::string const>(std::move(data))}
+        , m_offset{0}
+        , m_fds{std::move(fds)}
+    {}
+
+    ReqFrame(ReqFrame const&) = delete;
+    ReqFrame& operator=(ReqFrame const&) = delete;
+
+    // close any passed file descriptors that were not used by request handler
+    ~ReqFrame()
+    {
+        for (auto&& fd : m_fds) {
+            ::close(fd);
+        }
+    }
+
+    // reader function for readLoop, throws if reading past end of request data
+    ssize_t operator()(char* buf, size_t capacity)
+    {
+        auto const len = std::min(capacity, m_data->length() - m_offset);
+        if (len == 0) {
+            throw std::runtime_error("read failed: request data too short");
+        }
+        ::memcpy(buf, m_data->data() + m_offset, len);
+        m_offset += len;
+        return ssize_t(len);
+    }
+
+    template <typename T>
+    T read()
+    {
+        return readLoop<T>(*this);
+    }
 
-    // receive a single null-terminated string from stream
-    auto receiveString = [](std::istream& reqStream) {
-        std::string result;
-        if (!std::getline(reqStream, result, '\0')) {
+    // read null-terminated string
+    std::string readString()
+    {
+        auto const end = m_data->find('\0', m_offset);
+        if (end == std::string::npos) {
             throw std::runtime_error("failed to read string");
         }
+        auto result = m_data->substr(m_offset, end - m_offset);
+        m_offset = end + 1;
         return result;
-    };
+    }
+
+    // return view of next len bytes in place, valid while frame data is shared
+    std::string_view readView(size_t len)
+    {
+        if (len > (m_data->length() - m_offset)) {
+            throw std::runtime_error("read failed: request data too short");
+        }
+        auto const result = std::string_view{m_data->data() + m_offset, len};
+        m_offset += len;
+        return result;
+    }
+
+    std::shared_ptr<std::string const> const& sharedData() const { return m_data; }
+
+    // take ownership of next count passed file descriptors
+    std::vector<int> takeFds(size_t count)
+    {
+        auto const end = m_fds.begin() + std::min(count, m_fds.size());
+        auto result = std::vector<int>{m_fds.begin(), end};
+        m_fds.erase(m_fds.begin(), end);
+        return result;
+    }
+};
+
+// reads request frames from the request socket. Each receive reads as many buffered
+// frames as fit, and frames are taken from the buffer along with the number of passed
+// file descriptors given in their header. File descriptors for a frame are attached
+// to its first byte, so are always received no later than its header
+class RequestReader
+{
+    static constexpr auto BufferSize = size_t{64 * 1024};
+
+    // launch requests pass stdin/out/err for each launch
+    static constexpr auto MaxFds = 3 * FE_daemon::MaxBatchLaunches;
+
+    int m_fd;
+    std::vector<char> m_buf;
+    size_t m_begin, m_end; // unread data in buffer
+    std::deque<int> m_fds; // received file descriptors not yet taken by a frame
+
+    // frame larger than buffer, read directly into its data
+    std::optional<ReqHeader> m_largeHeader;
+    std::string m_largeData;
+    size_t m_largeReceived;
 
-    // read and remap stdin/out/err
-    auto const N_FDS = 3;
-    struct {
-        int fd_data[N_FDS];
-        struct cmsghdr cmd_hdr;
-    } buffer;
-
-    // create message buffer for one character
-    struct iovec empty_iovec;
-    char c;
-    empty_iovec.iov_base = &c;
-    empty_iovec.iov_len  = 1;
-
-    // create empty message header with enough space for fds
-    struct msghdr msg_hdr = {};
-    msg_hdr.msg_iov     = &empty_iovec;
-    msg_hdr.msg_iovlen  = 1;
-    msg_hdr.msg_control = &buffer;
-    msg_hdr.msg_controllen = CMSG_SPACE(sizeof(int) * N_FDS);
-
-    // fill in the message header type
-    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg_hdr);
-    cmsg->cmsg_len   = CMSG_LEN(sizeof(int) * N_FDS);
-    cmsg->cmsg_level = SOL_SOCKET;
-    cmsg->cmsg_type  = SCM_RIGHTS;
-
-    // receive remap FD message
-    if (::recvmsg(reqFd, &msg_hdr, 0) < 0) {
+    // receive into buffer, collecting passed file descriptors. Return bytes read
+    ssize_t receive(char* buf, size_t len)
+    {
+        union {
+            char buf[CMSG_SPACE(sizeof(int) * MaxFds)];
+            struct cmsghdr align;
+        } control;
+
+        struct iovec data_iovec;
+        data_iovec.iov_base = buf;
+        data_iovec.iov_len  = len;
+
+        struct msghdr msg_hdr = {};
+        msg_hdr.msg_iov     = &data_iovec;
+        msg_hdr.msg_iovlen  = 1;
+        msg_hdr.msg_control = control.buf;
+        msg_hdr.msg_controllen = sizeof(control.buf);
+
+        auto bytes_read = ssize_t{-1};
+        do {
+            // received fds are not inherited by children launched for other requests
+            bytes_read = ::recvmsg(m_fd, &msg_hdr, MSG_CMSG_CLOEXEC);
+        } while ((bytes_read < 0) && (errno == EINTR));
 
         // reqFd may not have been a domain socket
-        if (errno == ENOTSOCK) {
-            result.stdin_fd = ::open("/dev/null", O_RDONLY);
-            result.stdout_fd = ::open("/dev/null", O_WRONLY);
-            result.stderr_fd = ::open("/dev/null", O_WRONLY);
-        
-        // Other recvmsg failure
-        } else {
-            throw std::runtime_error("failed to receive fds: " + std::string{strerror(errno)});
+        if ((bytes_read < 0) && (errno == ENOTSOCK)) {
+            do {
+                bytes_read = ::read(m_fd, buf, len);
+            } while ((bytes_read < 0) && (errno == EINTR));
         }
 
-    // Successfully read file descriptors
-    } else {
-        auto const fds = (int *)CMSG_DATA(cmsg);
-        result.stdin_fd  = fds[0];
-        result.stdout_fd = fds[1];
-        result.stderr_fd = fds[2];
-    }
+        if (bytes_read < 0) {
+            throw std::runtime_error("failed to receive request: " + std::string{strerror(errno)});
+        } else if (bytes_read == 0) {
+            throw std::runtime_error("read failed: zero bytes read");
+        }
+
+        for (auto cmsg = CMSG_FIRSTHDR(&msg_hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg_hdr, cmsg)) {
+            if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS)) {
+                auto const num_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                auto const cmsg_fds = reinterpret_cast<int const*>(CMSG_DATA(cmsg));
+                m_fds.insert(m_fds.end(), cmsg_fds, cmsg_fds + num_fds);
+            }
+        }
 
-    // set up pipe stream
-    cti::FdBuf reqBuf{dup(reqFd)};
-    std::istream reqStream{&reqBuf};
+        return bytes_read;
+    }
 
-    // read filepath
-    getLogger().write("recv filename\n");
-    result.filepath = receiveString(reqStream);
-    getLogger().write("got file: %s\n", result.filepath.c_str());
+    std::vector<int> takeFds(uint32_t count)
+    {
+        if (count > m_fds.size()) {
+            throw std::runtime_error("request expected " + std::to_string(count)
+                + " fds, received " + std::to_string(m_fds.size()));
+        }
+        auto result = std::vector<int>{m_fds.begin(), m_fds.begin() + count};
+        m_fds.erase(m_fds.begin(), m_fds.begin() + count);
+        return result;
+    }
 
-    // read arguments
+public:
+    RequestReader(int fd)
+        : m_fd{fd}
+        , m_buf(BufferSize)
+        , m_begin{0}
+        , m_end{0}
+        , m_fds{}
+        , m_largeHeader{}
+        , m_largeData{}
+        , m_largeReceived{0}
+    {}
+
+    ~RequestReader()
     {
-        std::stringstream argvLog;
-        const auto argc_str = receiveString(reqStream);
-        size_t end = 0;
-        const auto argc = std::stoi(argc_str, &end, 10);
+        for (auto&& fd : m_fds) {
+            ::close(fd);
+        }
+    }
 
-        if (end != argc_str.size()) {
-            getLogger().write("failed to parse argc %s\n", argc_str.c_str());
-            throw std::runtime_error(std::string("failed to parse argc: ") + argc_str);
+    // receive available request data with a single read. Throw on failure or hangup
+    void receive()
+    {
+        // continue reading large frame in place
+        if (m_largeHeader) {
+            m_largeReceived += receive(m_largeData.data() + m_largeReceived,
+                m_largeData.length() - m_largeReceived);
+            return;
         }
 
-        for (int i = 0; i < argc; i++) {
-            auto const arg = receiveString(reqStream);
-            argvLog << arg << " ";
-            result.argvList.emplace_back(std::move(arg));
+        // move partial frame to start of buffer
+        if (m_begin > 0) {
+            ::memmove(m_buf.data(), m_buf.data() + m_begin, m_end - m_begin);
+            m_end -= m_begin;
+            m_begin = 0;
         }
-        auto const argvString = argvLog.str();
-        getLogger().write("%s\n", argvString.c_str());
+
+        m_end += receive(m_buf.data() + m_end, m_buf.size() - m_end);
     }
 
-    // read env
+    // take next complete frame, return false if more data must be received
+    bool next(ReqHeader& reqHeader, std::string& reqData, std::vector<int>& reqFds)
     {
-        const auto envc_str = receiveString(reqStream);
-        size_t end = 0;
-        const auto envc = std::stoi(envc_str, &end, 10);
+        if (m_largeHeader) {
+            if (m_largeReceived < m_largeData.length()) {
+                return false;
+            }
+            reqHeader = *m_largeHeader;
+            reqData = std::move(m_largeData);
+            m_largeHeader.reset();
+            m_largeData = std::string{};
+            reqFds = takeFds(reqHeader.num_fds);
+            return true;
+        }
 
-        if (end != envc_str.size()) {
-            getLogger().write("failed to parse envc %s\n", envc_str.c_str());
-            throw std::runtime_error(std::string("failed to parse envc: ") + envc_str);
+        if ((m_end - m_begin) < sizeof(ReqHeader)) {
+            return false;
+        }
+        ::memcpy(&reqHeader, m_buf.data() + m_begin, sizeof(reqHeader));
+        auto const available = m_end - m_begin - sizeof(ReqHeader);
+
+        // frame does not fit in buffer, continue receiving directly into its data
+        if ((reqHeader.length > available) && (sizeof(ReqHeader) + reqHeader.length > m_buf.size())) {
+            m_largeHeader = reqHeader;
+            m_largeData.resize(reqHeader.length);
+            ::memcpy(m_largeData.data(), m_buf.data() + m_begin + sizeof(ReqHeader), available);
+            m_largeReceived = available;
+            m_begin = m_end = 0;
+            return next(reqHeader, reqData, reqFds);
         }
 
-        for (int i = 0; i < envc; i++) {
-            auto const envVarVal = receiveString(reqStream);
+        if (reqHeader.length > available) {
+            return false;
+        }
 
-            if (envVarVal.rfind("CTIBLACKLIST_", 0) == 0) {
-                auto&& [blacklistTag, val] = cti::split::string<2>(std::move(envVarVal), '_');
-                if ((val.length() > 0) && (val.back() == '=')) {
-                    val.pop_back();
-                }
-                result.envBlacklist.emplace_back(std::move(val));
+        reqData.assign(m_buf.data() + m_begin + sizeof(ReqHeader), reqHeader.length);
+        m_begin += sizeof(ReqHeader) + reqHeader.length;
+        reqFds = takeFds(reqHeader.num_fds);
+        return true;
+    }
+};
 
-            } else {
-                getLogger().write("got envvar: %s\n", envVarVal.c_str());
-                result.envList.emplace_back(std::move(envVarVal));
+// read stdin/out/err fds, filepath, argv, environment map appended to an app / util / mpir launch request
+static LaunchData readLaunchData(ReqFrame& reqFrame)
+{
+    LaunchData result;
+
+    // take remapped stdin/out/err
+    auto const fds = reqFrame.takeFds(3);
+    if (fds.empty()) {
+
+        // request was not sent over a domain socket
+        result.stdin_fd = ::open("/dev/null", O_RDONLY);
+        result.stdout_fd = ::open("/dev/null", O_WRONLY);
+        result.stderr_fd = ::open("/dev/null", O_WRONLY);
+
+    } else if (fds.size() == 3) {
+        result.stdin_fd  = fds[0];
+        result.stdout_fd = fds[1];
+        result.stderr_fd = fds[2];
+
+    } else {
+        for (auto&& fd : fds) {
+            ::close(fd);
+        }
+        throw std::runtime_error("expected 3 fds, received " + std::to_string(fds.size()));
+    }
+
+    // read string offset table and string data, used in place in the request frame
+    auto const launchStrings = reqFrame.read<FE_daemon::LaunchStrings>();
+    auto const numStrings = size_t{1} + launchStrings.argc + launchStrings.envc;
+    auto const offsetsView = reqFrame.readView(numStrings * sizeof(uint32_t));
+    auto const stringData = reqFrame.readView(launchStrings.strings_length);
+    result.frameData = reqFrame.sharedData();
+
+    // return null-terminated view of string at index in offset table
+    auto getString = [&offsetsView, &stringData](size_t i) {
+        auto offset = uint32_t{0};
+        ::memcpy(&offset, offsetsView.data() + i * sizeof(uint32_t), sizeof(offset));
+        auto const end = stringData.find('\0', offset);
+        if ((offset >= stringData.length()) || (end == std::string_view::npos)) {
+            throw std::runtime_error("invalid launch string offset " + std::to_string(offset));
+        }
+        return stringData.substr(offset, end - offset);
+    };
+
+    result.filepath = getString(0);
+    getLogger().write("got file: %s\n", result.filepath.data());
+
+    result.argvList.reserve(launchStrings.argc);
+    for (size_t i = 0; i < launchStrings.argc; i++) {
+        result.argvList.emplace_back(getString(1 + i));
+        getLogger().write("got arg: %s\n", result.argvList.back().data());
+    }
+
+    result.envList.reserve(launchStrings.envc);
+    for (size_t i = 0; i < launchStrings.envc; i++) {
+        auto envVarVal = getString(1 + launchStrings.argc + i);
+
+        auto const blacklistPrefix = std::string_view{"CTIBLACKLIST_"};
+        if (envVarVal.substr(0, blacklistPrefix.length()) == blacklistPrefix) {
+            auto val = envVarVal.substr(blacklistPrefix.length());
+            if ((val.length() > 0) && (val.back() == '=')) {
+                val.remove_suffix(1);
+                val = result.addString(std::string{val});
             }
+            result.envBlacklist.emplace_back(val);
+
+        } else {
+            getLogger().write("got envvar: %s\n", envVarVal.data());
+            result.envList.emplace_back(envVarVal);
         }
     }
 
     return result;
 }
 
+// write response header and data for request ID to pipe
+static void writeResp(int const respFd, ReqId const reqId, std::string const& respData)
+{
+    reqMetrics.end(reqId);
+
+    auto const lock = std::lock_guard<std::mutex>{respMutex};
+
+    fdWriteLoop(respFd, RespHeader
+        { .id = reqId
+        , .length = respData.length()
+    });
+    fdWriteLoop(respFd, respData.c_str(), respData.length());
+}
+
+// append an object T to response data
+template <typename T>
+static void appendResp(std::string& respData, T const& obj)
+{
+    static_assert(std::is_trivial<T>::value);
+    respData.append(reinterpret_cast<char const*>(&obj), sizeof(T));
+}
+
+// append a null-terminated string to response data
+static void appendResp(std::string& respData, std::string const& str)
+{
+    respData.append(str.c_str(), str.length() + 1);
+}
+
 // if running the function succeeds, write an OK response to pipe
 template <typename Func>
-static void tryWriteOKResp(int const respFd, Func&& func)
+static void tryWriteOKResp(int const respFd, ReqId const reqId, Func&& func)
 {
+    auto respData = std::string{};
+
     try {
         // run the function
         auto const success = func();
 
         // send OK response
-        fdWriteLoop(respFd, OKResp
+        appendResp(respData, OKResp
             { .type = RespType::OK
             , .success = success
         });
@@ -537,23 +1072,27 @@ static void tryWriteOKResp(int const respFd, Func&& func)
         getLogger().write("%s\n", ex.what());
 
         // send failure response
-        fdWriteLoop(respFd, OKResp
+        appendResp(respData, OKResp
             { .type = RespType::OK
             , .success = false
         });
     }
+
+    writeResp(respFd, reqId, respData);
 }
 
 // if running the pid-producing function succeeds, write a PID response to pipe
 template <typename Func>
-static void tryWriteIDResp(int const respFd, Func&& func)
+static void tryWriteIDResp(int const respFd, ReqId const reqId, Func&& func)
 {
+    auto respData = std::string{};
+
     try {
         // run the id-producing function
         auto const id = func();
 
         // send ID response
-        fdWriteLoop(respFd, IDResp
+        appendResp(respData, IDResp
             { .type = RespType::ID
             , .id  = id
         });
@@ -562,49 +1101,58 @@ static void tryWriteIDResp(int const respFd, Func&& func)
         getLogger().write("%s\n", ex.what());
 
         // send failure response
-        fdWriteLoop(respFd, IDResp
+        appendResp(respData, IDResp
             { .type = RespType::ID
             , .id  = DAppId{0}
         });
     }
+
+    writeResp(respFd, reqId, respData);
 }
 
 // if running the function succeeds, write a string response to pipe
 template <typename Func>
-static void tryWriteStringResp(int const respFd, Func&& func)
+static void tryWriteStringResp(int const respFd, ReqId const reqId, Func&& func)
 {
+    auto respData = std::string{};
+
     try {
         // run the string-producing function
         auto const stringData = func();
 
         // send the string data
-        fdWriteLoop(respFd, StringResp
+        appendResp(respData, StringResp
             { .type     = RespType::String
             , .success  = true
         });
-        fdWriteLoop(respFd, stringData.c_str(), stringData.length() + 1);
+        appendResp(respData, stringData);
 
     } catch (std::exception const& ex) {
         getLogger().write("%s\n", ex.what());
 
         // send failure response
-        fdWriteLoop(respFd, StringResp
+        respData.clear();
+        appendResp(respData, StringResp
             { .type     = RespType::String
             , .success  = false
         });
     }
+
+    writeResp(respFd, reqId, respData);
 }
 
 // if running the function succeeds, write an MPIR response to pipe
 template <typename Func>
-static void tryWriteMPIRResp(int const respFd, Func&& func)
+static void tryWriteMPIRResp(int const respFd, ReqId const reqId, Func&& func)
 {
+    auto respData = std::string{};
+
     try {
         // run the mpir-producing function
         auto const mpirData = func();
 
         // send the MPIR data
-        fdWriteLoop(respFd, MPIRResp
+        appendResp(respData, MPIRResp
             { .type     = RespType::MPIR
             , .mpir_id  = mpirData.mpir_id
             , .launcher_pid = mpirData.launcher_pid
@@ -614,9 +1162,9 @@ static void tryWriteMPIRResp(int const respFd, Func&& func)
             , .error_msg_len = 0
         });
         for (auto&& elem : mpirData.proctable) {
-            fdWriteLoop(respFd, elem.pid);
-            fdWriteLoop(respFd, elem.hostname.c_str(), elem.hostname.length() + 1);
-            fdWriteLoop(respFd, elem.executable.c_str(), elem.executable.length() + 1);
+            appendResp(respData, elem.pid);
+            appendResp(respData, elem.hostname);
+            appendResp(respData, elem.executable);
         }
 
     } catch (std::exception const& ex) {
@@ -625,7 +1173,8 @@ static void tryWriteMPIRResp(int const respFd, Func&& func)
         auto const error_msg_len = ::strlen(ex.what()) + 1;
 
         // send failure response
-        fdWriteLoop(respFd, MPIRResp
+        respData.clear();
+        appendResp(respData, MPIRResp
             { .type     = RespType::MPIR
             , .mpir_id  = DAppId{0}
             , .launcher_pid = {}
@@ -636,7 +1185,57 @@ static void tryWriteMPIRResp(int const respFd, Func&& func)
         });
 
         // Send failure message
-        fdWriteLoop(respFd, ex.what(), error_msg_len);
+        appendResp(respData, std::string{ex.what()});
+    }
+
+    writeResp(respFd, reqId, respData);
+}
+
+// if running the status-producing function succeeds, write a status response to pipe
+template <typename Func>
+static void tryWriteStatusResp(int const respFd, ReqId const reqId, Func&& func)
+{
+    auto respData = std::string{};
+
+    try {
+        // run the status-producing function
+        auto const statuses = func();
+
+        // send the status data
+        appendResp(respData, StatusResp
+            { .type     = RespType::Status
+            , .success  = true
+            , .num_statuses = static_cast<int>(statuses.size())
+        });
+        for (auto&& status : statuses) {
+            appendResp(respData, status);
+        }
+
+    } catch (std::exception const& ex) {
+        getLogger().write("%s\n", ex.what());
+
+        // send failure response
+        respData.clear();
+        appendResp(respData, StatusResp
+            { .type     = RespType::Status
+            , .success  = false
+            , .num_statuses = 0
+        });
+    }
+
+    writeResp(respFd, reqId, respData);
+}
+
+// read request data on main thread, capturing any error to be reported
+// when the request is completed by a worker thread
+template <typename Func>
+static auto tryReadRequest(Func&& func)
+{
+    using Data = decltype(func());
+    try {
+        return std::make_pair(func(), std::exception_ptr{});
+    } catch (...) {
+        return std::make_pair(Data{}, std::current_exception());
     }
 }
 
@@ -644,78 +1243,59 @@ static void tryWriteMPIRResp(int const respFd, Func&& func)
 
 static pid_t forkExec(LaunchData const& launchData)
 {
-    // construct argv
-    cti::ManagedArgv argv;
+    // construct argv from null-terminated views
+    auto argv = std::vector<char*>{};
+    argv.reserve(launchData.argvList.size() + 1);
     for (auto&& arg : launchData.argvList) {
-        argv.add(arg);
+        argv.push_back(const_cast<char*>(arg.data()));
     }
+    argv.push_back(nullptr);
 
     // Look up binary in path (will use absolute path if provided)
-    auto binaryPath = cti::findPath(launchData.filepath);
-
-    // parse env
-    std::unordered_map<std::string, std::string> envMap;
-    for (auto&& envVarVal : launchData.envList) {
-        auto const equalsAt = envVarVal.find("=");
-        if (equalsAt == std::string::npos) {
-            throw std::runtime_error("failed to parse env var: " + envVarVal);
-        } else {
-            getLogger().write("got envvar: %s\n", envVarVal.c_str());
-            envMap.emplace(envVarVal.substr(0, equalsAt), envVarVal.substr(equalsAt + 1));
-        }
+    auto binaryPath = cti::findPath(std::string{launchData.filepath});
+
+    // build child environment: set variables with overwrite, unset empty and blacklisted variables
+    auto const childEnvList = cti::buildEnv(environ, launchData.envList, launchData.envBlacklist,
+        cti::EmptyEnvValue::Unset);
+    auto childEnv = std::vector<char*>{};
+    childEnv.reserve(childEnvList.size() + 1);
+    for (auto&& envVarVal : childEnvList) {
+        childEnv.push_back(const_cast<char*>(envVarVal.c_str()));
     }
+    childEnv.push_back(nullptr);
 
     getLogger().write("remap stdin %d stdout %d stderr %d\n",
         launchData.stdin_fd, launchData.stdout_fd, launchData.stderr_fd);
 
-    // fork exec
-    if (auto const forkedPid = fork()) {
-        if (forkedPid < 0) {
-            throw std::runtime_error("fork error: " + std::string{strerror(errno)});
-        }
-
-        // parent case
-
-        return forkedPid;
-    } else {
-        // child case
-
-        // close communication pipes
-        close(reqFd);
-        close(respFd);
-
-        // dup2 all stdin/out/err to provided FDs
-        cti::dup2_or_dev_null(launchData.stdin_fd, STDIN_FILENO);
-        dup2(launchData.stdout_fd, STDOUT_FILENO);
-        dup2(launchData.stderr_fd, STDERR_FILENO);
+    // spawn without copying the daemon's address space
+    auto spawnActions = cti::SpawnActions{};
 
-        // set environment variables with overwrite
-        for (auto const& envVarVal : envMap) {
-            if (!envVarVal.second.empty()) {
-                setenv(envVarVal.first.c_str(), envVarVal.second.c_str(), true);
-            } else {
-                unsetenv(envVarVal.first.c_str());
-            }
-        }
+    // dup2 all stdin/out/err to provided FDs
+    spawnActions.dup2(launchData.stdin_fd, STDIN_FILENO);
+    if (launchData.stdout_fd >= 0) {
+        spawnActions.dup2(launchData.stdout_fd, STDOUT_FILENO);
+    }
+    if (launchData.stderr_fd >= 0) {
+        spawnActions.dup2(launchData.stderr_fd, STDERR_FILENO);
+    }
 
-        // unset blacklisted environment variables
-        for (auto const& var : launchData.envBlacklist) {
-            unsetenv(var.c_str());
-        }
+    // close communication pipes, and don't leak descriptors of other in-flight requests
+    spawnActions.closeInherited(launchData.inheritFds);
 
-        // exec srun
-        getLogger().write("execvp %s\n", binaryPath.c_str());
-        for (auto arg = argv.get(); *arg != nullptr; arg++) {
-            getLogger().write("%s\n", *arg);
-        }
+    getLogger().write("execvp %s\n", binaryPath.c_str());
+    for (auto arg = argv.data(); *arg != nullptr; arg++) {
+        getLogger().write("%s\n", *arg);
+    }
 
-        execvp(binaryPath.c_str(), argv.get());
-        getLogger().write("execvp: %s\n", strerror(errno));
-        _exit(1);
+    auto const spawnedPid = spawnActions.spawnvp(binaryPath.c_str(), argv.data(), childEnv.data());
+    if (spawnedPid < 0) {
+        throw std::runtime_error("failed to launch " + binaryPath + ": " + std::string{strerror(errno)});
     }
+
+    return spawnedPid;
 }
 
-static FE_daemon::MPIRResult extractMPIRResult(std::unique_ptr<MPIRInstance>&& mpirInst)
+static FE_daemon::MPIRResult extractMPIRResult(std::shared_ptr<MPIRHandle>&& mpirInst)
 {
     // create new app ID
     auto const launcherPid = mpirInst->getLauncherPid();
@@ -734,7 +1314,9 @@ static FE_daemon::MPIRResult extractMPIRResult(std::unique_ptr<MPIRInstance>&& m
     auto const proctable = mpirInst->getProctable();
 
     // add to MPIR map for later release
-    mpirMap.emplace(std::make_pair(mpirId, std::move(mpirInst)));
+    { auto const lock = std::lock_guard<std::mutex>{stateMutex};
+        mpirMap.emplace(std::make_pair(mpirId, std::move(mpirInst)));
+    }
 
     return FE_daemon::MPIRResult
         { .mpir_id = mpirId
@@ -745,6 +1327,15 @@ static FE_daemon::MPIRResult extractMPIRResult(std::unique_ptr<MPIRInstance>&& m
     };
 }
 
+// build launcher environment from the daemon's environment with launch settings applied.
+// launchers inherit this environment directly, as setting variables in the daemon's own
+// environment is not safe while other MPIR launches are running
+static std::vector<std::string> buildLauncherEnv(LaunchData const& launchData)
+{
+    return cti::buildEnv(environ, launchData.envList, launchData.envBlacklist,
+        cti::EmptyEnvValue::Keep);
+}
+
 static FE_daemon::MPIRResult launchMPIR(LaunchData const& launchData)
 {
 
@@ -754,63 +1345,20 @@ static FE_daemon::MPIRResult launchMPIR(LaunchData const& launchData)
         , { launchData.stderr_fd, STDERR_FILENO }
     };
 
-    // Restores environment even in exception case
-    struct env_var_restore {
-        std::string var, val;
-        bool clear;
-        env_var_restore(std::string const& var_, std::string const& val_)
-            : var{var_}, val{val_}, clear{false} {}
-        env_var_restore(std::string const& var_)
-            : var{var_}, val{}, clear{true} {}
-        ~env_var_restore() {
-            if (!var.empty()) {
-                if (clear) {
-                    ::unsetenv(var.c_str());
-                } else {
-                    ::setenv(var.c_str(), val.c_str(), true);
-                }
-            }
-        }
-        env_var_restore(env_var_restore&& moved) = default;
-    };
-
-    // Store environment variables that are going to be overwritten
-    auto overwrittenEnv = std::vector<env_var_restore>{};
-    for (auto&& envVarVal : launchData.envList) {
-        // Get variable name and value to set
-        auto const [var, val] = cti::split::string<2>(envVarVal, '=');
-        // If variable is set in current environment, set it to restore on scope exit
-        if (auto const oldVal = ::getenv(var.c_str())) {
-            overwrittenEnv.emplace_back(var, oldVal);
-        // If not set in environment, clear it on scope exit
-        } else {
-            overwrittenEnv.emplace_back(var);
-        }
-        // Set environment variable to inherit in MPIR instance
-        ::setenv(var.c_str(), val.c_str(), true);
-    }
-
-    // unset blacklisted environment variables
-    for (auto const& var : launchData.envBlacklist) {
-        if (auto const oldVal = ::getenv(var.c_str())) {
-            overwrittenEnv.emplace_back(var, oldVal);
-        }
-        unsetenv(var.c_str());
-    }
-
     // Start launcher under MPIR control and run to breakpoint
     // If there are any problems with launcher arguments, they will occur at this point.
     // Then, an error message that the user can interpret will be sent back to the
     // main CTI process.
-    launchingInstance = [](LaunchData const& launchData, std::map<int, int> const& remapFds) {
+    auto launchingInstance = [](LaunchData const& launchData, std::map<int, int> const& remapFds) {
 
         // Look up launcher in path (will use absolute path if provided)
-        auto launcherPath = cti::findPath(launchData.filepath);
+        auto launcherPath = cti::findPath(std::string{launchData.filepath});
         getLogger().write("Starting launcher %s\n", launcherPath.c_str());
 
         try {
-            return std::make_unique<MPIRInstance>(launcherPath,
-                launchData.argvList, std::vector<std::string>{}, remapFds);
+            return launchMPIRInstance(launcherPath,
+                std::vector<std::string>{launchData.argvList.begin(), launchData.argvList.end()},
+                buildLauncherEnv(launchData), remapFds);
         } catch (std::exception const& ex) {
             auto errorMsg = std::stringstream{};
 
@@ -828,14 +1376,16 @@ static FE_daemon::MPIRResult launchMPIR(LaunchData const& launchData)
     }(launchData, remapFds);
 
     // Blocking wait until launcher has reached MPIR Breakpoint
-    launchingInstance->runToMPIRBreakpoint();
+    { auto const activeInstance = ActiveInstance{launchingInstance};
+        launchingInstance->runToMPIRBreakpoint();
+    }
 
-    // Global MPIR launching instance will be reset here upon passing
-    // to extraction function.
     auto mpirResult = extractMPIRResult(std::move(launchingInstance));
 
     // Terminate launched application on daemon exit
-    appCleanupList.insert(mpirResult.launcher_pid, SIGTERM);
+    { auto const lock = std::lock_guard<std::mutex>{stateMutex};
+        appCleanupList.insert(mpirResult.launcher_pid, SIGTERM);
+    }
 
     return mpirResult;
 }
@@ -845,7 +1395,7 @@ static FE_daemon::MPIRResult attachMPIR(std::string const& launcherPath, pid_t c
     // Attach to launcher and attempt to extract MPIR data
     auto mpirInstance = [](std::string const& launcherPath, pid_t const launcherPid) {
         try {
-            return std::make_unique<MPIRInstance>(launcherPath, launcherPid);
+            return attachMPIRInstance(launcherPath, launcherPid);
         } catch (std::exception const& ex) {
             auto errorMsg = std::stringstream{};
 
@@ -862,14 +1412,25 @@ and that the provided PID is present on your local system (" << ex.what() << ")"
     return extractMPIRResult(std::move(mpirInstance));
 }
 
-static void releaseMPIR(DAppId const mpir_id)
+// remove MPIR instance from MPIR map and return it
+static std::shared_ptr<MPIRHandle> takeMPIRInstance(DAppId const mpir_id)
 {
+    auto const lock = std::lock_guard<std::mutex>{stateMutex};
+
     auto const idInstPair = mpirMap.find(mpir_id);
-    if (idInstPair != mpirMap.end()) {
+    if (idInstPair == mpirMap.end()) {
+        return nullptr;
+    }
 
-        // Release from MPIR breakpoint
-        mpirMap.erase(idInstPair);
-    } else {
+    auto result = std::move(idInstPair->second);
+    mpirMap.erase(idInstPair);
+    return result;
+}
+
+static void releaseMPIR(DAppId const mpir_id)
+{
+    // Release from MPIR breakpoint
+    if (takeMPIRInstance(mpir_id) == nullptr) {
         throw std::runtime_error("release mpir id not found: " + std::to_string(mpir_id));
     }
 
@@ -878,46 +1439,167 @@ static void releaseMPIR(DAppId const mpir_id)
 
 static bool waitMPIR(DAppId const mpir_id)
 {
+    auto const mpirInstance = takeMPIRInstance(mpir_id);
+    if (mpirInstance == nullptr) {
+        throw std::runtime_error("release mpir id not found: " + std::to_string(mpir_id));
+    }
+
+    // Release from MPIR breakpoint, wait for completion and check return code
+    auto const activeInstance = ActiveInstance{mpirInstance};
+    if (auto rc = mpirInstance->waitExit()) {
+        getLogger().write("mpir id %d exited with rc %d\n", mpir_id, rc);
+        return false;
+    }
+
+    getLogger().write("successfully released mpir id %d\n", mpir_id);
+    return true;
+}
+
+static std::vector<MPIRStatus> releaseMPIRBatch(std::vector<DAppId> const& mpir_ids)
+{
+    auto result = std::vector<MPIRStatus>{};
+    result.reserve(mpir_ids.size());
+
+    for (auto&& mpir_id : mpir_ids) {
+        auto success = true;
+        try {
+            releaseMPIR(mpir_id);
+        } catch (std::exception const& ex) {
+            getLogger().write("%s\n", ex.what());
+            success = false;
+        }
+        result.push_back(MPIRStatus{mpir_id, success});
+    }
+
+    return result;
+}
+
+// release MPIR instance from breakpoint and run to exit on its own thread.
+// stateMutex must be held
+static void startMPIRExitWaiter(DAppId const mpir_id)
+{
+    // Already released by earlier wait request
+    if (mpirExitMap.find(mpir_id) != mpirExitMap.end()) {
+        return;
+    }
+
     auto const idInstPair = mpirMap.find(mpir_id);
-    if (idInstPair != mpirMap.end()) {
+    if (idInstPair == mpirMap.end()) {
+        throw std::runtime_error("wait mpir id not found: " + std::to_string(mpir_id));
+    }
+    auto mpirInstance = std::move(idInstPair->second);
+    mpirMap.erase(idInstPair);
 
-        // Release from MPIR breakpoint
-        mpirMap.erase(idInstPair);
+    auto& exitWaiter = mpirExitMap[mpir_id];
+    exitWaiter.thread = std::async(std::launch::async,
+        [mpir_id, mpirInstance = std::move(mpirInstance)]() {
 
-        // Wait for completion and check return code
-        if (auto rc = idInstPair->second->waitExit()) {
-            getLogger().write("mpir id %d exited with rc %d\n", mpir_id, rc);
-            return false;
+        auto success = false;
+        try {
+            auto const activeInstance = ActiveInstance{mpirInstance};
+            if (auto rc = mpirInstance->waitExit()) {
+                getLogger().write("mpir id %d exited with rc %d\n", mpir_id, rc);
+            } else {
+                success = true;
+            }
+        } catch (std::exception const& ex) {
+            getLogger().write("%s\n", ex.what());
         }
-        return true;
 
-    } else {
-        throw std::runtime_error("release mpir id not found: " + std::to_string(mpir_id));
+        // Report exit status to wait requests. Entry is only removed once exited,
+        // unless the daemon is shutting down
+        { auto const lock = std::lock_guard<std::mutex>{stateMutex};
+            auto const idWaiterPair = mpirExitMap.find(mpir_id);
+            if (idWaiterPair != mpirExitMap.end()) {
+                idWaiterPair->second.success = success;
+            }
+        }
+        mpirExitCv.notify_all();
+    });
+}
+
+// release MPIR instances from breakpoint and wait for any or all to exit.
+// return exit statuses of all instances that have exited
+static std::vector<MPIRStatus> waitMPIRBatch(std::vector<DAppId> mpir_ids, bool waitAll)
+{
+    auto result = std::vector<MPIRStatus>{};
+    auto finishedThreads = std::vector<std::future<void>>{};
+
+    // Each ID is waited on and collected once per request
+    std::sort(mpir_ids.begin(), mpir_ids.end());
+    mpir_ids.erase(std::unique(mpir_ids.begin(), mpir_ids.end()), mpir_ids.end());
+
+    auto lock = std::unique_lock<std::mutex>{stateMutex};
+
+    // Verify every ID before releasing any, so that no instance is left running
+    // without a wait request to collect it
+    for (auto&& mpir_id : mpir_ids) {
+        if ((mpirExitMap.find(mpir_id) == mpirExitMap.end())
+         && (mpirMap.find(mpir_id) == mpirMap.end())) {
+            throw std::runtime_error("wait mpir id not found: " + std::to_string(mpir_id));
+        }
+    }
+    for (auto&& mpir_id : mpir_ids) {
+        startMPIRExitWaiter(mpir_id);
+        mpirExitMap.at(mpir_id).numWaiting++;
     }
 
-    getLogger().write("successfully released mpir id %d\n", mpir_id);
+    // Entries are kept while this request is waiting on them
+    auto exited = [](DAppId const mpir_id) {
+        return mpirExitMap.at(mpir_id).success.has_value();
+    };
+    mpirExitCv.wait(lock, [&mpir_ids, &exited, waitAll]() {
+        return waitAll
+            ? std::all_of(mpir_ids.begin(), mpir_ids.end(), exited)
+            : std::any_of(mpir_ids.begin(), mpir_ids.end(), exited);
+    });
+
+    // Collect exit statuses. An entry is removed once every request waiting on it has
+    // collected it. Exit threads are finishing and will be joined after unlocking
+    for (auto&& mpir_id : mpir_ids) {
+        auto const idWaiterPair = mpirExitMap.find(mpir_id);
+        auto& exitWaiter = idWaiterPair->second;
+        exitWaiter.numWaiting--;
+        if (exitWaiter.success) {
+            result.push_back(MPIRStatus{mpir_id, *exitWaiter.success});
+            if (exitWaiter.numWaiting == 0) {
+                finishedThreads.emplace_back(std::move(exitWaiter.thread));
+                mpirExitMap.erase(idWaiterPair);
+            }
+        }
+    }
+
+    lock.unlock();
+
+    return result;
 }
 
 static std::string readStringMPIR(DAppId const mpir_id, std::string const& variable)
 {
-    auto const idInstPair = mpirMap.find(mpir_id);
-    if (idInstPair != mpirMap.end()) {
-        return idInstPair->second->readStringAt(variable);
-    } else {
-        throw std::runtime_error("read string mpir id not found: " + std::to_string(mpir_id));
-    }
+    // Read from the inferior without holding stateMutex, the instance is kept alive
+    // by this reference if released concurrently
+    auto const mpirInstance = [mpir_id]() {
+        auto const lock = std::lock_guard<std::mutex>{stateMutex};
+
+        auto const idInstPair = mpirMap.find(mpir_id);
+        if (idInstPair == mpirMap.end()) {
+            throw std::runtime_error("read string mpir id not found: " + std::to_string(mpir_id));
+        }
+        return idInstPair->second;
+    }();
+
+    return mpirInstance->readStringAt(variable);
 }
 
 static void terminateMPIR(DAppId const mpir_id)
 {
-    auto const idInstPair = mpirMap.find(mpir_id);
-    if (idInstPair != mpirMap.end()) {
-        idInstPair->second->terminate();
-        mpirMap.erase(idInstPair);
-    } else {
+    auto const mpirInstance = takeMPIRInstance(mpir_id);
+    if (mpirInstance == nullptr) {
         throw std::runtime_error("terminate mpir id not found: " + std::to_string(mpir_id));
     }
 
+    mpirInstance->terminate();
+
     getLogger().write("successfully terminated mpir id %d\n", mpir_id);
 }
 
@@ -943,7 +1625,7 @@ static FE_daemon::MPIRResult launchMPIRShim(ShimData const& shimData, LaunchData
         (shimBinDir.m_path + "/" + shimmedLauncherName).c_str());
 
     // Look up launcher in path (will use absolute path if provided)
-    auto launcherPath = cti::findPath(launchData.filepath);
+    auto launcherPath = cti::findPath(std::string{launchData.filepath});
     getLogger().write("shimming %s\n", launcherPath.c_str());
 
     // Save original PATH
@@ -982,27 +1664,37 @@ static FE_daemon::MPIRResult launchMPIRShim(ShimData const& shimData, LaunchData
         if (found_directory) {
             auto shimmedPathSetting = "PATH=" + shimmedPath.str();
             getLogger().write("Modifying shimmed %s\n", shimmedPathSetting.c_str());
-            modifiedLaunchData.envList.emplace_back(shimmedPathSetting);
+            modifiedLaunchData.envList.emplace_back(modifiedLaunchData.addString(shimmedPathSetting));
 
         // Launcher directory not in path, fall back to prepending
         } else {
             getLogger().write("Couldn't find %s in path, prepending shim directory\n",
                 launcherScriptDirectory.c_str());
-            modifiedLaunchData.envList.emplace_back("PATH=" + shimBinDir.m_path + (originalPath.empty() ? "" : (":" + originalPath)));
+            modifiedLaunchData.envList.emplace_back(modifiedLaunchData.addString("PATH=" + shimBinDir.m_path + (originalPath.empty() ? "" : (":" + originalPath))));
         }
     }
 
     // Communicate output pipe and real launcher path to shim
-    modifiedLaunchData.envList.emplace_back("CTI_MPIR_SHIM_INPUT_FD="  + std::to_string(shimPipe[0]));
-    modifiedLaunchData.envList.emplace_back("CTI_MPIR_SHIM_OUTPUT_FD=" + std::to_string(shimPipe[1]));
-    modifiedLaunchData.envList.emplace_back("CTI_MPIR_LAUNCHER_PATH="  + shimData.shimmedLauncherPath);
-    modifiedLaunchData.envList.emplace_back("CTI_MPIR_ORIGINAL_PATH="  + originalPath);
-    modifiedLaunchData.envList.emplace_back("CTI_MPIR_STDIN_FD="       + std::to_string(launchData.stdin_fd));
-    modifiedLaunchData.envList.emplace_back("CTI_MPIR_STDOUT_FD="      + std::to_string(launchData.stdout_fd));
-    modifiedLaunchData.envList.emplace_back("CTI_MPIR_STDERR_FD="      + std::to_string(launchData.stderr_fd));
-    modifiedLaunchData.envList.emplace_back("CTI_MPIR_SHIM_TOKEN=" + shimToken);
-
-    modifiedLaunchData.argvList.emplace_back(shimToken);
+    modifiedLaunchData.envList.emplace_back(modifiedLaunchData.addString("CTI_MPIR_SHIM_INPUT_FD="  + std::to_string(shimPipe[0])));
+    modifiedLaunchData.envList.emplace_back(modifiedLaunchData.addString("CTI_MPIR_SHIM_OUTPUT_FD=" + std::to_string(shimPipe[1])));
+    modifiedLaunchData.envList.emplace_back(modifiedLaunchData.addString("CTI_MPIR_LAUNCHER_PATH="  + shimData.shimmedLauncherPath));
+    modifiedLaunchData.envList.emplace_back(modifiedLaunchData.addString("CTI_MPIR_ORIGINAL_PATH="  + originalPath));
+    modifiedLaunchData.envList.emplace_back(modifiedLaunchData.addString("CTI_MPIR_STDIN_FD="       + std::to_string(launchData.stdin_fd)));
+    modifiedLaunchData.envList.emplace_back(modifiedLaunchData.addString("CTI_MPIR_STDOUT_FD="      + std::to_string(launchData.stdout_fd)));
+    modifiedLaunchData.envList.emplace_back(modifiedLaunchData.addString("CTI_MPIR_STDERR_FD="      + std::to_string(launchData.stderr_fd)));
+    modifiedLaunchData.envList.emplace_back(modifiedLaunchData.addString("CTI_MPIR_SHIM_TOKEN=" + shimToken));
+
+    modifiedLaunchData.argvList.emplace_back(modifiedLaunchData.addString(shimToken));
+
+    // Shim remaps stdin / out / err itself after the launcher script runs, so these
+    // must survive both execs
+    modifiedLaunchData.inheritFds = {shimPipe[0], shimPipe[1]};
+    for (auto&& fd : {launchData.stdin_fd, launchData.stdout_fd, launchData.stderr_fd}) {
+        if (fd >= 0) {
+            ::fcntl(fd, F_SETFD, 0);
+            modifiedLaunchData.inheritFds.push_back(fd);
+        }
+    }
 
     forkExec(modifiedLaunchData);
     close(shimPipe[1]);
@@ -1025,7 +1717,7 @@ static FE_daemon::MPIRResult launchMPIRShim(ShimData const& shimData, LaunchData
     // Attach and run to breakpoint
     auto mpirInstance = [](const std::string &launcherName, const pid_t pid) {
         try {
-            return std::make_unique<MPIRInstance>(launcherName, pid);
+            return attachMPIRInstance(launcherName, pid);
         } catch (std::exception const& ex) {
             getLogger().write("Failed to attach to %s, pid %d\n", launcherName.c_str(), pid);
 
@@ -1039,7 +1731,9 @@ static FE_daemon::MPIRResult launchMPIRShim(ShimData const& shimData, LaunchData
     auto mpirResult = extractMPIRResult(std::move(mpirInstance));
 
     // Terminate launched application on daemon exit
-    appCleanupList.insert(mpirResult.launcher_pid, SIGTERM);
+    { auto const lock = std::lock_guard<std::mutex>{stateMutex};
+        appCleanupList.insert(mpirResult.launcher_pid, SIGTERM);
+    }
 
     // MPIR shim stops the launcher with SIGSTOP. The launcher won't start 
     // again, even after ProcControl detaches, unless a SIGCONT is sent at some 
@@ -1050,12 +1744,90 @@ static FE_daemon::MPIRResult launchMPIRShim(ShimData const& shimData, LaunchData
     return mpirResult;
 }
 
+// launch utility and register to app, waiting for exit if synchronous
+static UtilStatus runUtil(DAppId const appId, FE_daemon::RunMode const runMode,
+    LaunchData const& launchData)
+{
+    auto utilPid = pid_t{-1};
+    try {
+        utilPid = forkExec(launchData);
+    } catch (...) {
+        ::close(launchData.stdin_fd);
+        ::close(launchData.stdout_fd);
+        ::close(launchData.stderr_fd);
+        throw;
+    }
+
+    // File descriptors are at this point inherited by the launched process
+    // Close them here so files are properly closed when process exits
+    ::close(launchData.stdin_fd);
+    ::close(launchData.stdout_fd);
+    ::close(launchData.stderr_fd);
+
+    registerUtilPID(appId, utilPid, SIGTERM);
+
+    // If synchronous, wait for return code
+    if (runMode == FE_daemon::Synchronous) {
+        int status;
+        if (cti::waitpid(utilPid, &status, 0) < 0) {
+            getLogger().write("waitpid returned %s\n", strerror(errno));
+            return UtilStatus{utilPid, false, -1};
+        }
+
+        if (WIFEXITED(status)) {
+            getLogger().write("exited with code %d\n", WEXITSTATUS(status));
+            return UtilStatus{utilPid, (WEXITSTATUS(status) == 0), WEXITSTATUS(status)};
+        }
+
+        return UtilStatus{utilPid, false, -1};
+
+    // Otherwise, report successful
+    } else {
+        return UtilStatus{utilPid, true, -1};
+    }
+}
+
+// launch utilities, running at most maxConcurrent synchronous utilities at a time
+static std::vector<UtilStatus> runUtilBatch(DAppId const appId, FE_daemon::RunMode const runMode,
+    std::vector<LaunchData> const& launches, int maxConcurrent)
+{
+    auto result = std::vector<UtilStatus>(launches.size(), UtilStatus{-1, false, -1});
+
+    // Next utility to launch is shared between runner threads
+    auto nextLaunch = std::atomic<size_t>{0};
+    auto runLaunches = [&]() {
+        for (auto i = nextLaunch++; i < launches.size(); i = nextLaunch++) {
+            try {
+                result[i] = runUtil(appId, runMode, launches[i]);
+            } catch (std::exception const& ex) {
+                getLogger().write("%s\n", ex.what());
+            }
+        }
+    };
+
+    // Asynchronous launches return immediately
+    auto const numRunners = (runMode == FE_daemon::Synchronous)
+        ? std::min(launches.size(), (maxConcurrent > 0) ? size_t(maxConcurrent) : launches.size())
+        : size_t{1};
+
+    auto runners = std::vector<std::future<void>>{};
+    for (size_t i = 1; i < numRunners; i++) {
+        runners.emplace_back(std::async(std::launch::async, runLaunches));
+    }
+    runLaunches();
+    for (auto&& runner : runners) {
+        runner.wait();
+    }
+
+    return result;
+}
+
 /* handler implementations */
 
-static void handle_ForkExecvpApp(int const reqFd, int const respFd)
+static void handle_ForkExecvpApp(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
 {
-    tryWriteIDResp(respFd, [reqFd, respFd]() {
-        auto const launchData = readLaunchData(reqFd);
+    tryWriteIDResp(respFd, reqId, [&reqFrame]() {
+        auto const launchData = readLaunchData(reqFrame);
 
         auto const appPid = forkExec(launchData);
 
@@ -1065,84 +1837,126 @@ static void handle_ForkExecvpApp(int const reqFd, int const respFd)
     });
 }
 
-static void handle_ForkExecvpUtil(int const reqFd, int const respFd)
+static void handle_ForkExecvpUtil(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
 {
-    tryWriteOKResp(respFd, [reqFd, respFd]() {
-        auto const appId  = fdReadLoop<DAppId>(reqFd);
-        auto const runMode = fdReadLoop<FE_daemon::RunMode>(reqFd);
-        auto const launchData = readLaunchData(reqFd);
-
-        auto const utilPid = forkExec(launchData);
+    struct UtilData {
+        DAppId appId;
+        FE_daemon::RunMode runMode;
+        LaunchData launchData;
+    };
 
-        registerUtilPID(appId, utilPid, SIGTERM);
+    auto [utilData, readError] = tryReadRequest([&reqFrame]() {
+        auto const appId  = reqFrame.read<DAppId>();
+        auto const runMode = reqFrame.read<FE_daemon::RunMode>();
+        return UtilData{appId, runMode, readLaunchData(reqFrame)};
+    });
 
-        // If synchronous, wait for return code
-        if (runMode == FE_daemon::Synchronous) {
-            int status;
-            if (cti::waitpid(utilPid, &status, 0) < 0) {
-                getLogger().write("waitpid returned %s\n", strerror(errno));
-                return false;
-            }
+    // Synchronous launch will block until utility exits
+    auto const synchronous = !readError && (utilData.runMode == FE_daemon::Synchronous);
 
-            if (WIFEXITED(status)) {
-                getLogger().write("exited with code %d\n", WEXITSTATUS(status));
+    auto launchUtil = [respFd, reqId, utilData = std::move(utilData), readError = readError]() {
+        tryWriteOKResp(respFd, reqId, [&utilData, &readError]() {
+            if (readError) {
+                std::rethrow_exception(readError);
             }
+            auto const& [appId, runMode, launchData] = utilData;
 
-            return bool{WIFEXITED(status) && (WEXITSTATUS(status) == 0)};
+            return runUtil(appId, runMode, launchData).success;
+        });
+    };
 
-        // Otherwise, report successful
-        } else {
+    if (synchronous) {
+        startWorker(std::move(launchUtil));
+    } else {
+        launchUtil();
+    }
+}
 
-            // File descriptors are at this point inherited by the launched process
-            // Close them here so files are properly closed when process exits
-            ::close(launchData.stdin_fd);
-            ::close(launchData.stdout_fd);
-            ::close(launchData.stderr_fd);
+static void handle_ForkExecvpUtilBatch(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
+{
+    struct UtilBatchData {
+        DAppId appId;
+        FE_daemon::RunMode runMode;
+        int maxConcurrent;
+        std::vector<LaunchData> launches;
+    };
 
-            return true;
+    auto [batchData, readError] = tryReadRequest([&reqFrame]() {
+        auto result = UtilBatchData{};
+        result.appId = reqFrame.read<DAppId>();
+        result.runMode = reqFrame.read<FE_daemon::RunMode>();
+        result.maxConcurrent = reqFrame.read<int>();
+        auto const num_launches = reqFrame.read<size_t>();
+        for (size_t i = 0; i < num_launches; i++) {
+            result.launches.emplace_back(readLaunchData(reqFrame));
         }
+        return result;
+    });
+
+    // Synchronous launches will block until utilities exit
+    startWorker([respFd, reqId, batchData = std::move(batchData), readError = readError]() {
+        tryWriteStatusResp(respFd, reqId, [&batchData, &readError]() {
+            if (readError) {
+                std::rethrow_exception(readError);
+            }
+
+            return runUtilBatch(batchData.appId, batchData.runMode, batchData.launches,
+                batchData.maxConcurrent);
+        });
     });
 }
 
-static void handle_LaunchMPIR(int const reqFd, int const respFd)
+static void handle_LaunchMPIR(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
 {
-    tryWriteMPIRResp(respFd, [reqFd, respFd]() {
-        auto const launchData = readLaunchData(reqFd);
+    auto [launchData, readError] = tryReadRequest([&reqFrame]() {
+        return readLaunchData(reqFrame);
+    });
 
-        auto const mpirData = launchMPIR(launchData);
+    startWorker([respFd, reqId, launchData = std::move(launchData), readError = readError]() {
+        tryWriteMPIRResp(respFd, reqId, [&launchData, &readError]() {
+            if (readError) {
+                std::rethrow_exception(readError);
+            }
+
+            auto const mpirData = launchMPIR(launchData);
 
-        return mpirData;
+            return mpirData;
+        });
     });
 }
 
-static void handle_AttachMPIR(int const reqFd, int const respFd)
+static void handle_AttachMPIR(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
 {
-    tryWriteMPIRResp(respFd, [reqFd, respFd]() {
-        // set up pipe stream
-        cti::FdBuf reqBuf{dup(reqFd)};
-        std::istream reqStream{&reqBuf};
-
+    auto [launcherData, readError] = tryReadRequest([&reqFrame]() {
         // read launcher name and pid
-        std::string launcherName;
-        if (!std::getline(reqStream, launcherName, '\0')) {
-            throw std::runtime_error("failed to read launcher path");
-        }
-        auto const launcherPid = fdReadLoop<pid_t>(reqFd);
+        auto const launcherName = reqFrame.readString();
+        auto const launcherPid = reqFrame.read<pid_t>();
 
-        // Look up launcher in path (will use absolute path if provided)
-        auto launcherPath = cti::findPath(launcherName);
-        getLogger().write("Attaching to launcher %s with PID %d\n", launcherPath.c_str(), launcherPid);
+        return std::make_pair(launcherName, launcherPid);
+    });
+
+    startWorker([respFd, reqId, launcherData = std::move(launcherData), readError = readError]() {
+        tryWriteMPIRResp(respFd, reqId, [&launcherData, &readError]() {
+            if (readError) {
+                std::rethrow_exception(readError);
+            }
+            auto const& [launcherName, launcherPid] = launcherData;
+
+            // Look up launcher in path (will use absolute path if provided)
+            auto launcherPath = cti::findPath(launcherName);
+            getLogger().write("Attaching to launcher %s with PID %d\n", launcherPath.c_str(), launcherPid);
 
-        auto const mpirData = attachMPIR(launcherPath, launcherPid);
+            auto const mpirData = attachMPIR(launcherPath, launcherPid);
 
-        return mpirData;
+            return mpirData;
+        });
     });
 }
 
-static void handle_ReleaseMPIR(int const reqFd, int const respFd)
+static void handle_ReleaseMPIR(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
 {
-    tryWriteOKResp(respFd, [reqFd, respFd]() {
-        auto const mpirId = fdReadLoop<DAppId>(reqFd);
+    tryWriteOKResp(respFd, reqId, [&reqFrame]() {
+        auto const mpirId = reqFrame.read<DAppId>();
 
         releaseMPIR(mpirId);
 
@@ -1150,78 +1964,131 @@ static void handle_ReleaseMPIR(int const reqFd, int const respFd)
     });
 }
 
-static void handle_WaitMPIR(int const reqFd, int const respFd)
+static void handle_WaitMPIR(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
+{
+    auto const [mpirId, readError] = tryReadRequest([&reqFrame]() {
+        return reqFrame.read<DAppId>();
+    });
+
+    startWorker([respFd, reqId, mpirId = mpirId, readError = readError]() {
+        tryWriteOKResp(respFd, reqId, [mpirId, &readError]() {
+            if (readError) {
+                std::rethrow_exception(readError);
+            }
+
+            return waitMPIR(mpirId);
+        });
+    });
+}
+
+// read array of MPIR IDs for batch request
+static std::vector<DAppId> readMPIRIds(ReqFrame& reqFrame)
+{
+    auto const num_ids = reqFrame.read<size_t>();
+    auto result = std::vector<DAppId>(num_ids);
+    readLoop(reinterpret_cast<char*>(result.data()), num_ids * sizeof(DAppId), reqFrame);
+    return result;
+}
+
+static void handle_ReleaseMPIRBatch(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
 {
-    tryWriteOKResp(respFd, [reqFd, respFd]() {
-        auto const mpirId = fdReadLoop<DAppId>(reqFd);
+    auto [mpirIds, readError] = tryReadRequest([&reqFrame]() {
+        return readMPIRIds(reqFrame);
+    });
+
+    // Detaching from each launcher can take some time
+    startWorker([respFd, reqId, mpirIds = std::move(mpirIds), readError = readError]() {
+        tryWriteStatusResp(respFd, reqId, [&mpirIds, &readError]() {
+            if (readError) {
+                std::rethrow_exception(readError);
+            }
 
-        return waitMPIR(mpirId);
+            return releaseMPIRBatch(mpirIds);
+        });
     });
 }
 
-static void handle_LaunchMPIRShim(int const reqFd, int const respFd)
+static void handle_WaitMPIRBatch(ReqFrame& reqFrame, int const respFd, ReqId const reqId, bool waitAll)
 {
-    tryWriteMPIRResp(respFd, [reqFd, respFd]() {
-        // set up pipe stream
-        cti::FdBuf reqBuf{dup(reqFd)};
-        std::istream reqStream{&reqBuf};
+    auto [mpirIds, readError] = tryReadRequest([&reqFrame]() {
+        return readMPIRIds(reqFrame);
+    });
+
+    startWorker([respFd, reqId, waitAll, mpirIds = std::move(mpirIds), readError = readError]() {
+        tryWriteStatusResp(respFd, reqId, [waitAll, &mpirIds, &readError]() {
+            if (readError) {
+                std::rethrow_exception(readError);
+            }
+
+            return waitMPIRBatch(mpirIds, waitAll);
+        });
+    });
+}
 
+static void handle_LaunchMPIRShim(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
+{
+    auto [shimLaunchData, readError] = tryReadRequest([&reqFrame]() {
         // Read shim setup data
         ShimData shimData;
-        if (!std::getline(reqStream, shimData.shimBinaryPath, '\0')) {
-            throw std::runtime_error("failed to read shim binary path");
-        }
-        if (!std::getline(reqStream, shimData.temporaryShimBinDir, '\0')) {
-            throw std::runtime_error("failed to read temporary shim directory");
-        }
-        if (!std::getline(reqStream, shimData.shimmedLauncherPath, '\0')) {
-            throw std::runtime_error("failed to read shimmed launcher path");
-        }
+        shimData.shimBinaryPath      = reqFrame.readString();
+        shimData.temporaryShimBinDir = reqFrame.readString();
+        shimData.shimmedLauncherPath = reqFrame.readString();
 
         // Read MPIR launch data
-        auto const launchData = readLaunchData(reqFd);
+        auto launchData = readLaunchData(reqFrame);
+
+        return std::make_pair(std::move(shimData), std::move(launchData));
+    });
+
+    startWorker([respFd, reqId, shimLaunchData = std::move(shimLaunchData), readError = readError]() {
+        tryWriteMPIRResp(respFd, reqId, [&shimLaunchData, &readError]() {
+            if (readError) {
+                std::rethrow_exception(readError);
+            }
+            auto const& [shimData, launchData] = shimLaunchData;
 
-        auto const mpirData = launchMPIRShim(shimData, launchData);
+            auto const mpirData = launchMPIRShim(shimData, launchData);
 
-        return mpirData;
+            return mpirData;
+        });
     });
 }
 
-static void handle_ReadStringMPIR(int const reqFd, int const respFd)
+static void handle_ReadStringMPIR(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
 {
-    tryWriteStringResp(respFd, [reqFd, respFd]() {
-        auto const mpirId = fdReadLoop<DAppId>(reqFd);
-
-        // set up pipe stream
-        cti::FdBuf reqBuf{dup(reqFd)};
-        std::istream reqStream{&reqBuf};
-
-        std::string variable;
-        if (!std::getline(reqStream, variable, '\0')) {
-            throw std::runtime_error("failed to read variable name");
-        }
+    tryWriteStringResp(respFd, reqId, [&reqFrame]() {
+        auto const mpirId = reqFrame.read<DAppId>();
+        auto const variable = reqFrame.readString();
         getLogger().write("read string '%s' from mpir id %d\n", variable.c_str(), mpirId);
 
         return readStringMPIR(mpirId, variable);
     });
 }
 
-static void handle_TerminateMPIR(int const reqFd, int const respFd)
+static void handle_TerminateMPIR(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
 {
-    tryWriteOKResp(respFd, [reqFd, respFd]() {
-        auto const mpirId = fdReadLoop<DAppId>(reqFd);
+    auto const [mpirId, readError] = tryReadRequest([&reqFrame]() {
+        return reqFrame.read<DAppId>();
+    });
 
-        getLogger().write("terminating mpir id %d\n", mpirId);
-        terminateMPIR(mpirId);
+    startWorker([respFd, reqId, mpirId = mpirId, readError = readError]() {
+        tryWriteOKResp(respFd, reqId, [mpirId, &readError]() {
+            if (readError) {
+                std::rethrow_exception(readError);
+            }
 
-        return true;
+            getLogger().write("terminating mpir id %d\n", mpirId);
+            terminateMPIR(mpirId);
+
+            return true;
+        });
     });
 }
 
-static void handle_RegisterApp(int const reqFd, int const respFd)
+static void handle_RegisterApp(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
 {
-    tryWriteIDResp(respFd, [reqFd, respFd]() {
-        auto const appPid = fdReadLoop<pid_t>(reqFd);
+    tryWriteIDResp(respFd, reqId, [&reqFrame]() {
+        auto const appPid = reqFrame.read<pid_t>();
 
         auto const appId = registerAppPID(appPid);
 
@@ -1229,11 +2096,11 @@ static void handle_RegisterApp(int const reqFd, int const respFd)
     });
 }
 
-static void handle_RegisterUtil(int const reqFd, int const respFd)
+static void handle_RegisterUtil(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
 {
-    tryWriteOKResp(respFd, [reqFd, respFd]() {
-        auto const appId   = fdReadLoop<DAppId>(reqFd);
-        auto const utilPid = fdReadLoop<pid_t>(reqFd);
+    tryWriteOKResp(respFd, reqId, [&reqFrame]() {
+        auto const appId   = reqFrame.read<DAppId>();
+        auto const utilPid = reqFrame.read<pid_t>();
 
         registerUtilPID(appId, utilPid, SIGTERM);
 
@@ -1241,11 +2108,11 @@ static void handle_RegisterUtil(int const reqFd, int const respFd)
     });
 }
 
-static void handle_RegisterUtilWithSigkill(int const reqFd, int const respFd)
+static void handle_RegisterUtilWithSigkill(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
 {
-    tryWriteOKResp(respFd, [reqFd, respFd]() {
-        auto const appId   = fdReadLoop<DAppId>(reqFd);
-        auto const utilPid = fdReadLoop<pid_t>(reqFd);
+    tryWriteOKResp(respFd, reqId, [&reqFrame]() {
+        auto const appId   = reqFrame.read<DAppId>();
+        auto const utilPid = reqFrame.read<pid_t>();
 
         registerUtilPID(appId, utilPid, SIGKILL);
 
@@ -1253,67 +2120,187 @@ static void handle_RegisterUtilWithSigkill(int const reqFd, int const respFd)
     });
 }
 
-static void handle_DeregisterApp(int const reqFd, int const respFd)
+static void handle_DeregisterApp(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
 {
-    tryWriteOKResp(respFd, [reqFd, respFd]() {
-        auto const appId = fdReadLoop<DAppId>(reqFd);
+    auto const [appId, readError] = tryReadRequest([&reqFrame]() {
+        return reqFrame.read<DAppId>();
+    });
 
-        deregisterAppID(appId);
+    // Terminating app and utilities can block
+    startWorker([respFd, reqId, appId = appId, readError = readError]() {
+        tryWriteOKResp(respFd, reqId, [appId, &readError]() {
+            if (readError) {
+                std::rethrow_exception(readError);
+            }
 
-        return true;
+            deregisterAppID(appId);
+
+            return true;
+        });
     });
 }
 
-static void handle_ReleaseApp(int const reqFd, int const respFd)
+static void handle_ReleaseApp(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
 {
-    tryWriteOKResp(respFd, [reqFd, respFd]() {
-        auto const appId = fdReadLoop<DAppId>(reqFd);
+    auto const [appId, readError] = tryReadRequest([&reqFrame]() {
+        return reqFrame.read<DAppId>();
+    });
 
-        releaseAppID(appId);
+    // Terminating utilities can block
+    startWorker([respFd, reqId, appId = appId, readError = readError]() {
+        tryWriteOKResp(respFd, reqId, [appId, &readError]() {
+            if (readError) {
+                std::rethrow_exception(readError);
+            }
 
-        return true;
+            releaseAppID(appId);
+
+            return true;
+        });
     });
 }
 
-static void handle_CheckApp(int const reqFd, int const respFd)
+static void handle_CheckApp(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
 {
-    tryWriteOKResp(respFd, [reqFd, respFd]() {
-        auto const appId = fdReadLoop<DAppId>(reqFd);
+    tryWriteOKResp(respFd, reqId, [&reqFrame]() {
+        auto const appId = reqFrame.read<DAppId>();
 
         return checkAppID(appId);
     });
 }
 
-static void handle_Shutdown(int const reqFd, int const respFd)
+static void handle_GetAppPID(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
+{
+    tryWriteIDResp(respFd, reqId, [&reqFrame]() {
+        auto const appId = reqFrame.read<DAppId>();
+
+        return getAppPID(appId);
+    });
+}
+
+static void handle_GetMetrics(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
+{
+    tryWriteStringResp(respFd, reqId, []() {
+        return reqMetrics.toJson();
+    });
+}
+
+static void handle_Shutdown(ReqFrame& reqFrame, int const respFd, ReqId const reqId)
 {
     // send OK response
-    fdWriteLoop(respFd, OKResp
+    auto respData = std::string{};
+    appendResp(respData, OKResp
         { .type = RespType::OK
         , .success = true
     });
+    writeResp(respFd, reqId, respData);
 }
 
-// Return string value of request type for logging
-static auto reqTypeString(ReqType const reqType)
+// Log and run handler for request
+static void dispatchRequest(ReqHeader const& reqHeader, ReqFrame& reqFrame)
 {
+    auto const reqId = reqHeader.id;
+    auto const reqType = reqHeader.type;
+
+    // Request read was successful
+    getLogger().write("Received request %lu type %ld: %s\n", reqId, reqType, FE_daemon::reqTypeString(reqType));
+    reqMetrics.begin(reqId, FE_daemon::reqTypeString(reqType));
+
     switch (reqType) {
-        case ReqType::ForkExecvpApp:  return "ForkExecvpApp";
-        case ReqType::ForkExecvpUtil: return "ForkExecvpUtil";
-        case ReqType::LaunchMPIR:     return "LaunchMPIR";
-        case ReqType::LaunchMPIRShim: return "LaunchMPIRShim";
-        case ReqType::AttachMPIR:     return "AttachMPIR";
-        case ReqType::ReadStringMPIR: return "ReadStringMPIR";
-        case ReqType::ReleaseMPIR:    return "ReleaseMPIR";
-        case ReqType::WaitMPIR:       return "WaitMPIR";
-        case ReqType::TerminateMPIR:  return "TerminateMPIR";
-        case ReqType::RegisterApp:    return "RegisterApp";
-        case ReqType::RegisterUtil:   return "RegisterUtil";
-        case ReqType::RegisterUtilWithSigkill: return "RegisterUtilWithSigkill";
-        case ReqType::DeregisterApp:  return "DeregisterApp";
-        case ReqType::ReleaseApp:     return "ReleaseApp";
-        case ReqType::CheckApp:       return "CheckApp";
-        case ReqType::Shutdown:       return "Shutdown";
-        default: return "(unknown)";
+
+        case ReqType::ForkExecvpApp:
+            handle_ForkExecvpApp(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::ForkExecvpUtil:
+            handle_ForkExecvpUtil(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::ForkExecvpUtilBatch:
+            handle_ForkExecvpUtilBatch(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::LaunchMPIR:
+            handle_LaunchMPIR(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::AttachMPIR:
+            handle_AttachMPIR(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::ReleaseMPIR:
+            handle_ReleaseMPIR(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::WaitMPIR:
+            handle_WaitMPIR(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::ReadStringMPIR:
+            handle_ReadStringMPIR(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::TerminateMPIR:
+            handle_TerminateMPIR(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::ReleaseMPIRBatch:
+            handle_ReleaseMPIRBatch(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::WaitMPIRAny:
+            handle_WaitMPIRBatch(reqFrame, respFd, reqId, false);
+            break;
+
+        case ReqType::WaitMPIRAll:
+            handle_WaitMPIRBatch(reqFrame, respFd, reqId, true);
+            break;
+
+        case ReqType::LaunchMPIRShim:
+            handle_LaunchMPIRShim(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::RegisterApp:
+            handle_RegisterApp(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::RegisterUtil:
+            handle_RegisterUtil(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::RegisterUtilWithSigkill:
+            handle_RegisterUtilWithSigkill(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::DeregisterApp:
+            handle_DeregisterApp(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::ReleaseApp:
+            handle_ReleaseApp(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::CheckApp:
+            handle_CheckApp(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::GetAppPID:
+            handle_GetAppPID(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::GetMetrics:
+            handle_GetMetrics(reqFrame, respFd, reqId);
+            break;
+
+        case ReqType::Shutdown:
+            handle_Shutdown(reqFrame, respFd, reqId);
+            main_loop_running = false;
+            break;
+
+        default:
+            getLogger().write("unknown req type %ld\n", reqType);
+            break;
+
     }
 }
 
@@ -1355,6 +2342,10 @@ main(int argc, char *argv[])
                 respFd = std::stoi(optarg);
                 break;
 
+            case CTIFEDaemonArgv::LibDir.val:
+                libDir = optarg;
+                break;
+
             case CTIFEDaemonArgv::Help.val:
                 usage(argv[0]);
                 exit(0);
@@ -1374,11 +2365,21 @@ main(int argc, char *argv[])
         exit(1);
     }
 
+    // Exit along with the launching frontend. If it exited before this point, the
+    // request socket will already be hung up
+    ::prctl(PR_SET_PDEATHSIG, SIGHUP);
+
     // If response FD is not stdout, hook stdout
     if (respFd != STDOUT_FILENO) {
         getLogger().hook();
     }
 
+    // signal handlers forward signals to main loop through pipe
+    if (::pipe2(signalPipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+        fprintf(stderr, "pipe2: %s\n", strerror(errno));
+        return 1;
+    }
+
     // block all signals except noted
     { sigset_t block_set;
         if (sigfillset(&block_set)) {
@@ -1422,101 +2423,83 @@ main(int argc, char *argv[])
     getLogger().write("%d sending initial ok\n", getpid());
     fdWriteLoop(respFd, getpid());
 
-    // wait for pipe commands
+    // wait for requests and signals
+    auto const epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        fprintf(stderr, "epoll_create1: %s\n", strerror(errno));
+        return 1;
+    }
+    for (auto&& fd : { reqFd, signalPipe[0] }) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            fprintf(stderr, "epoll_ctl %d: %s\n", fd, strerror(errno));
+            return 1;
+        }
+    }
+
+    // Buffers socket requests so that multiple queued requests are read at once
+    auto reqReader = RequestReader{reqFd};
+
+    // Long-running requests are completed on worker threads, so the main loop
+    // can handle other requests in the meantime
     main_loop_running = true;
     while (main_loop_running) {
-        auto reqType = ReqType{};
-
-        // Signal handlers that cause a shutdown outside of normal shutdown requests
-        // will close request file descriptor to end main loop
-        try {
-            reqType = fdReadLoop<ReqType>(reqFd);
-        } catch (std::exception const& ex) {
-            main_loop_running = false;
-            getLogger().write("Main read loop terminated: %s\n", ex.what());
+        struct epoll_event events[2];
+        auto const numEvents = ::epoll_wait(epollFd, events, 2, -1);
+        if (numEvents < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            getLogger().write("Main loop wait failed: %s\n", strerror(errno));
             break;
         }
 
-        // Request read was successful
-        getLogger().write("Received request type %ld: %s\n", reqType, reqTypeString(reqType));
-
-        switch (reqType) {
-
-            case ReqType::ForkExecvpApp:
-                handle_ForkExecvpApp(reqFd, respFd);
-                break;
-
-            case ReqType::ForkExecvpUtil:
-                handle_ForkExecvpUtil(reqFd, respFd);
-                break;
-
-            case ReqType::LaunchMPIR:
-                handle_LaunchMPIR(reqFd, respFd);
-                break;
-
-            case ReqType::AttachMPIR:
-                handle_AttachMPIR(reqFd, respFd);
-                break;
-
-            case ReqType::ReleaseMPIR:
-                handle_ReleaseMPIR(reqFd, respFd);
-                break;
-
-            case ReqType::WaitMPIR:
-                handle_WaitMPIR(reqFd, respFd);
-                break;
-
-            case ReqType::ReadStringMPIR:
-                handle_ReadStringMPIR(reqFd, respFd);
-                break;
-
-            case ReqType::TerminateMPIR:
-                handle_TerminateMPIR(reqFd, respFd);
-                break;
-
-            case ReqType::LaunchMPIRShim:
-                handle_LaunchMPIRShim(reqFd, respFd);
-                break;
-
-            case ReqType::RegisterApp:
-                handle_RegisterApp(reqFd, respFd);
-                break;
-
-            case ReqType::RegisterUtil:
-                handle_RegisterUtil(reqFd, respFd);
-                break;
-
-            case ReqType::RegisterUtilWithSigkill:
-                handle_RegisterUtilWithSigkill(reqFd, respFd);
-                break;
-
-            case ReqType::DeregisterApp:
-                handle_DeregisterApp(reqFd, respFd);
-                break;
-
-            case ReqType::ReleaseApp:
-                handle_ReleaseApp(reqFd, respFd);
-                break;
+        for (int i = 0; (i < numEvents) && main_loop_running; i++) {
 
-            case ReqType::CheckApp:
-                handle_CheckApp(reqFd, respFd);
-                break;
+            // Signal handlers that cause a shutdown outside of normal shutdown requests
+            // will end main loop
+            if (events[i].data.fd == signalPipe[0]) {
+                handle_signals();
+                continue;
+            }
 
-            case ReqType::Shutdown:
-                handle_Shutdown(reqFd, respFd);
+            // Receive once, then handle every complete request that arrived
+            auto reqHeader = ReqHeader{};
+            auto reqData = std::string{};
+            auto reqFds = std::vector<int>{};
+            try {
+                reqReader.receive();
+            } catch (std::exception const& ex) {
                 main_loop_running = false;
+                getLogger().write("Main read loop terminated: %s\n", ex.what());
                 break;
+            }
+            while (main_loop_running) {
+                try {
+                    if (!reqReader.next(reqHeader, reqData, reqFds)) {
+                        break;
+                    }
+                } catch (std::exception const& ex) {
+                    main_loop_running = false;
+                    getLogger().write("Main read loop terminated: %s\n", ex.what());
+                    break;
+                }
+                auto reqFrame = ReqFrame{std::move(reqData), std::move(reqFds)};
 
-            default:
-                getLogger().write("unknown req type %ld\n", reqType);
-                break;
-
+                dispatchRequest(reqHeader, reqFrame);
+            }
         }
+
+        reapWorkers();
     }
 
-    // Close pipes
-    close(reqFd);
-    close(respFd);
+    getLogger().write("Request metrics: %s\n", reqMetrics.toJson().c_str());
+
+    // Interrupt any worker threads still waiting on MPIR launchers
+    terminateActiveInstances();
 
     // Block all signals for cleanup
     { sigset_t block_set;
@@ -1530,22 +2513,33 @@ main(int argc, char *argv[])
         }
     }
 
-    // Terminate all running utilities
-    auto utilTermFuture = std::async(std::launch::async, [](){
+    // Terminate all running utilities and apps
+    { auto runningProcs = ProcSet{};
+        for (auto&& [appId, utilProcs] : utilMap) {
+            runningProcs.merge(std::move(utilProcs));
+        }
         utilMap.clear();
-    });
-
-    // Terminate all running apps
-    auto appTermFuture = std::async(std::launch::async, [](){
-        appCleanupList.clear();
-    });
+        runningProcs.merge(std::move(appCleanupList));
+        runningProcs.clear();
+    }
 
     // Wait for all threads
-    utilTermFuture.wait();
-    appTermFuture.wait();
-    for (auto&& future : sigchldThreads) {
-        future.wait();
+    for (auto&& worker : workerThreads) {
+        worker.wait();
+    }
+    { auto exitWaiters = decltype(mpirExitMap){};
+        { auto const lock = std::lock_guard<std::mutex>{stateMutex};
+            std::swap(exitWaiters, mpirExitMap);
+        }
+        for (auto&& [mpir_id, exitWaiter] : exitWaiters) {
+            exitWaiter.thread.wait();
+        }
     }
 
+    // Close pipes once workers have written their responses
+    close(reqFd);
+    close(respFd);
+    close(epollFd);
+
     exit(0);
 }
@@ -10,127 +10,159 @@
 #include "cti_argv_defs.hpp"
 
 #include <sys/types.h>
-#include <sys/prctl.h>
-#include <sys/resource.h>
-#include <sys/time.h>
 
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 
+#include <algorithm>
+#include <deque>
 #include <stdexcept>
+#include <string_view>
 
 #include "useful/cti_execvp.hpp"
+#include "useful/cti_wrappers.hpp"
 
 #include "cti_fe_daemon_iface.hpp"
 using DaemonAppId = FE_daemon::DaemonAppId;
 
 /* protocol helpers */
 
-// write FD remap control message, binary path, arguments, environment to domain socket
-static void writeLaunchData(int const reqFd, char const* file, char const* const argv[],
-    int stdin_fd, int stdout_fd, int stderr_fd, char const* const env[])
+// standard in / out / err FDs to pass with a launch request. Share standard in / out / err
+// if set to StdFd, /dev/null if CloseFd, or provided FD
+class LaunchFds
 {
-    // verify that reqFd is a domain socket
-    { struct sockaddr sa;
-        auto len = socklen_t{sizeof(sa)};
-        if (::getsockname(reqFd, &sa, &len) < 0) {
-            throw std::runtime_error("getsockname failed: " + std::string{strerror(errno)});
-        }
-        if (sa.sa_family != AF_UNIX) {
-            throw std::runtime_error("daemon request file descriptor must be a domain socket");
+    std::vector<int> m_fds;
+    std::vector<int> m_opened; // /dev/null FDs opened for request, closed once sent
+
+    LaunchFds(LaunchFds const&) = delete;
+    LaunchFds& operator=(LaunchFds const&) = delete;
+
+    int resolve(int fd, int stdFd, int flags)
+    {
+        if (fd == FE_daemon::StdFd) {
+            return stdFd;
+        } else if (fd == FE_daemon::CloseFd) {
+            auto const devNullFd = ::open("/dev/null", flags);
+            if (devNullFd < 0) {
+                throw std::runtime_error("failed to open /dev/null: " + std::string{strerror(errno)});
+            }
+            m_opened.push_back(devNullFd);
+            return devNullFd;
+        } else {
+            return fd;
         }
     }
 
-    // Share standard in / out / err if set to StdFd, closed if CloseFd, or provided FD
-    auto const N_FDS = 3;
-    int fds_source[N_FDS] =
-
-        { (stdin_fd == FE_daemon::StdFd)
-            ? STDIN_FILENO
-            : (stdin_fd == FE_daemon::CloseFd)
-                ? ::open("/dev/null", O_RDONLY)
-                : stdin_fd
-
-        , (stdout_fd == FE_daemon::StdFd)
-            ? STDOUT_FILENO
-            : (stdout_fd == FE_daemon::CloseFd)
-                ? ::open("/dev/null", O_WRONLY)
-                : stdout_fd
-
-        , (stderr_fd == FE_daemon::StdFd)
-            ? STDERR_FILENO
-            : (stderr_fd == FE_daemon::CloseFd)
-                ? ::open("/dev/null", O_WRONLY)
-                : stderr_fd
-    };
+public:
+    LaunchFds(int stdin_fd, int stdout_fd, int stderr_fd)
+        : m_fds{}
+        , m_opened{}
+    {
+        m_fds.push_back(resolve(stdin_fd,  STDIN_FILENO,  O_RDONLY));
+        m_fds.push_back(resolve(stdout_fd, STDOUT_FILENO, O_WRONLY));
+        m_fds.push_back(resolve(stderr_fd, STDERR_FILENO, O_WRONLY));
+    }
 
-    struct {
-        int fd_data[N_FDS];
-        struct cmsghdr cmd_hdr;
-    } buffer;
-    ::memset(&buffer, 0, sizeof(buffer));
+    ~LaunchFds()
+    {
+        for (auto&& fd : m_opened) {
+            ::close(fd);
+        }
+    }
 
-    // create message buffer for one character
-    struct iovec empty_iovec;
-    char c = ' ';
-    empty_iovec.iov_base = &c;
-    empty_iovec.iov_len  = 1;
+    std::vector<int> const& get() const { return m_fds; }
+};
 
-    // create empty message header with enough space for fds
-    struct msghdr msg_hdr = {};
-    msg_hdr.msg_iov     = &empty_iovec;
-    msg_hdr.msg_iovlen  = 1;
-    msg_hdr.msg_control = &buffer;
-    msg_hdr.msg_controllen = CMSG_SPACE(sizeof(int) * N_FDS);
-
-    // fill in the message header type
-    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg_hdr);
-    cmsg->cmsg_len   = CMSG_LEN(sizeof(int) * N_FDS);
-    cmsg->cmsg_level = SOL_SOCKET;
-    cmsg->cmsg_type  = SCM_RIGHTS;
-    for(int i = 0; i < N_FDS; i++) {
-        ((int *)CMSG_DATA(cmsg))[i] = fds_source[i];
+// append launch strings (file path, then arguments, then environment) to launch request
+// data as a single block of strings with an offset table
+static void appendLaunchStrings(std::string& reqData, std::vector<std::string_view> const& strings,
+    size_t argc, size_t envc)
+{
+    auto offsets = std::vector<uint32_t>{};
+    offsets.reserve(strings.size());
+    auto stringsLength = size_t{0};
+    for (auto&& str : strings) {
+        offsets.push_back(stringsLength);
+        stringsLength += str.length() + 1;
     }
-
-    // send remap FD message
-    if (::sendmsg(reqFd, &msg_hdr, 0) < 0) {
-        throw std::runtime_error("failed to receive fds: " + std::string{strerror(errno)});
+    if (stringsLength > UINT32_MAX) {
+        throw std::runtime_error("launch arguments and environment are too large");
     }
 
-    // write filepath string
-    fdWriteLoop(reqFd, file, strlen(file) + 1);
+    appendData(reqData, FE_daemon::LaunchStrings
+        { .argc = uint32_t(argc)
+        , .envc = uint32_t(envc)
+        , .strings_length = uint32_t(stringsLength)
+    });
 
-    // write argument array length and contents
-    auto argc = size_t{0};
-    for (auto arg = argv; *arg != nullptr; arg++) {argc++;};
+    reqData.reserve(reqData.length() + offsets.size() * sizeof(uint32_t) + stringsLength);
+    appendData(reqData, reinterpret_cast<char const*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+    for (auto&& str : strings) {
+        reqData.append(str);
+        reqData.push_back('\0');
+    }
+}
 
-    auto argc_str = std::to_string(argc);
-    fdWriteLoop(reqFd, argc_str.c_str(), argc_str.size() + 1);
+void
+FE_daemon::appendLaunchData(std::string& reqData, char const* file, char const* const argv[],
+    char const* const env[])
+{
+    auto strings = std::vector<std::string_view>{file};
 
-    for (size_t i = 0; i < argc; i++) {
-        fdWriteLoop(reqFd, argv[i], strlen(argv[i]) + 1);
+    auto argc = size_t{0};
+    for (auto arg = argv; *arg != nullptr; arg++) {
+        strings.emplace_back(*arg);
+        argc++;
     }
 
-    // write environment array length and contents
     auto envc = size_t{0};
-    if (env)
-        for (auto var = env; *var != nullptr; var++) {envc++;};
+    for (auto var = env; (env != nullptr) && (*var != nullptr); var++) {
+        strings.emplace_back(*var);
+        envc++;
+    }
+
+    appendLaunchStrings(reqData, strings, argc, envc);
+}
 
-    auto envc_str = std::to_string(envc);
-    fdWriteLoop(reqFd, envc_str.c_str(), envc_str.size() + 1);
+void
+FE_daemon::appendLaunchData(std::string& reqData, UtilLaunch const& launch)
+{
+    auto strings = std::vector<std::string_view>{launch.file};
+    strings.insert(strings.end(), launch.argv.begin(), launch.argv.end());
+    strings.insert(strings.end(), launch.env.begin(), launch.env.end());
 
-    if (env) {
-        for (size_t i = 0; i < envc; i++) {
-            fdWriteLoop(reqFd, env[i], strlen(env[i]) + 1);
-        }
+    appendLaunchStrings(reqData, strings, launch.argv.size(), launch.env.size());
+}
+
+// return metric name for request launching file, such as ForkExecvpUtil_Sync(sbcast)
+static std::string launchMetricName(std::string const& reqName, char const* file)
+{
+    try {
+        return reqName + "(" + cti::cstr::basename(file) + ")";
+    } catch (...) {
+        return reqName;
     }
 }
 
-// return boolean response from pipe
-static bool readOKResp(int const reqFd)
+// return reader function over response data, throws if reading past end of data
+static auto respReader(std::string const& respData)
+{
+    return [&respData, offset = size_t{0}](char* buf, size_t capacity) mutable {
+        auto const len = std::min(capacity, respData.length() - offset);
+        if (len == 0) {
+            throw std::runtime_error("read failed: response data too short");
+        }
+        ::memcpy(buf, respData.data() + offset, len);
+        offset += len;
+        return ssize_t(len);
+    };
+}
+
+// return boolean response
+static bool readOKResp(std::string const& respData)
 {
-    auto const okResp = fdReadLoop<FE_daemon::OKResp>(reqFd);
+    auto const okResp = readLoop<FE_daemon::OKResp>(respReader(respData));
     if (okResp.type != FE_daemon::RespType::OK) {
         throw std::runtime_error("daemon did not send expected OK response type");
     }
@@ -138,17 +170,17 @@ static bool readOKResp(int const reqFd)
 }
 
 // throw if boolean response is not true, indicating failure
-static void verifyOKResp(int const reqFd)
+static void verifyOKResp(std::string const& respData)
 {
-    if (readOKResp(reqFd) == false) {
+    if (readOKResp(respData) == false) {
         throw std::runtime_error("daemon response indicated failure");
     }
 }
 
 // return ID response content, throw if id < 0, indicating failure
-static DaemonAppId readIDResp(int const reqFd)
+static DaemonAppId readIDResp(std::string const& respData)
 {
-    auto const idResp = fdReadLoop<FE_daemon::IDResp>(reqFd);
+    auto const idResp = readLoop<FE_daemon::IDResp>(respReader(respData));
     if ((idResp.type != FE_daemon::RespType::ID) || (idResp.id < 0)) {
         throw std::runtime_error("failed to read DaemonAppID response");
     }
@@ -156,29 +188,57 @@ static DaemonAppId readIDResp(int const reqFd)
 }
 
 // return string data, throw if failure indicated
-static std::string readStringResp(int const reqFd)
+static std::string readStringResp(std::string const& respData)
 {
     // read basic response information
-    auto const stringResp = fdReadLoop<FE_daemon::StringResp>(reqFd);
+    auto const stringResp = readLoop<FE_daemon::StringResp>(respReader(respData));
     if (stringResp.type != FE_daemon::RespType::String) {
         throw std::runtime_error("daemon did not send expected String response type");
     } else if (stringResp.success == false) {
         throw std::runtime_error("daemon failed to read string from memory");
     }
 
-    // set up pipe stream
-    cti::FdBuf respBuf{dup(reqFd)};
-    std::istream respStream{&respBuf};
-
-    // read value
-    std::string result;
-    if (!std::getline(respStream, result, '\0')) {
+    // read null-terminated value following response
+    auto const value = respData.c_str() + sizeof(stringResp);
+    if ((respData.length() <= sizeof(stringResp))
+     || (::memchr(value, '\0', respData.length() - sizeof(stringResp)) == nullptr)) {
         throw std::runtime_error("failed to read string");
     }
 
+    return std::string{value};
+}
+
+// return batch statuses, throw if failure indicated
+template <typename Status>
+static std::vector<Status> readStatusResp(std::string const& respData)
+{
+    auto reader = respReader(respData);
+
+    // read basic response information
+    auto const statusResp = readLoop<FE_daemon::StatusResp>(reader);
+    if (statusResp.type != FE_daemon::RespType::Status) {
+        throw std::runtime_error("daemon did not send expected Status response type");
+    } else if (statusResp.success == false) {
+        throw std::runtime_error("daemon failed to complete batch request");
+    }
+
+    auto result = std::vector<Status>{};
+    result.reserve(statusResp.num_statuses);
+    for (int i = 0; i < statusResp.num_statuses; i++) {
+        result.emplace_back(readLoop<Status>(reader));
+    }
+
     return result;
 }
 
+// append array of MPIR IDs to batch request data
+static void appendMPIRIds(std::string& reqData, std::vector<DaemonAppId> const& mpir_ids)
+{
+    appendData(reqData, mpir_ids.size());
+    appendData(reqData, reinterpret_cast<char const*>(mpir_ids.data()),
+        mpir_ids.size() * sizeof(DaemonAppId));
+}
+
 // return MPIR launch / attach data, throw if MPIR ID < 0, indicating failure
 FE_daemon::MPIRResult FE_daemon::readMPIRResp(int const reqFd)
 {
@@ -271,6 +331,133 @@ FE_daemon::MPIRResult FE_daemon::readMPIRResp(std::function<ssize_t(char*, size_
     return result;
 }
 
+/* request dispatch */
+
+FE_daemon::ReqId
+FE_daemon::sendRequest(ReqType type, std::function<void(std::string&)> const& writer,
+    std::vector<int> const& fds, std::string const& metricName)
+{
+    // Finish daemon startup before the first request
+    awaitReady();
+
+    return sendFrame(type, writer, fds, metricName);
+}
+
+FE_daemon::ReqId
+FE_daemon::sendFrame(ReqType type, std::function<void(std::string&)> const& writer,
+    std::vector<int> const& fds, std::string const& metricName)
+{
+    // Build request data before taking request lock
+    auto frame = std::string(sizeof(ReqHeader), '\0');
+    writer(frame);
+    auto const reqLength = frame.length() - sizeof(ReqHeader);
+
+    // Hold request lock until entire frame is written
+    auto const lock = std::lock_guard<std::mutex>{m_reqMutex};
+
+    auto const reqId = m_nextReqId++;
+    auto const reqHeader = ReqHeader
+        { .id = reqId
+        , .type = type
+        , .length = reqLength
+        , .num_fds = uint32_t(fds.size())
+    };
+    ::memcpy(frame.data(), &reqHeader, sizeof(reqHeader));
+
+    // Start timing before the daemon can respond
+    m_metrics.begin(reqId, metricName.empty() ? reqTypeString(type) : metricName);
+
+    // Write frame in a single message, attaching any file descriptors
+    struct iovec frame_iovec;
+    frame_iovec.iov_base = frame.data();
+    frame_iovec.iov_len  = frame.length();
+
+    struct msghdr msg_hdr = {};
+    msg_hdr.msg_iov    = &frame_iovec;
+    msg_hdr.msg_iovlen = 1;
+
+    auto control = std::vector<char>(CMSG_SPACE(sizeof(int) * fds.size()));
+    if (!fds.empty()) {
+        msg_hdr.msg_control    = control.data();
+        msg_hdr.msg_controllen = control.size();
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg_hdr);
+        cmsg->cmsg_len   = CMSG_LEN(sizeof(int) * fds.size());
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type  = SCM_RIGHTS;
+        ::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+    }
+
+    auto bytes_sent = ssize_t{-1};
+    do {
+        bytes_sent = ::sendmsg(m_req_sock.getWriteFd(), &msg_hdr, 0);
+    } while ((bytes_sent < 0) && (errno == EINTR));
+    if (bytes_sent < 0) {
+        throw std::runtime_error("failed to send request: " + std::string{strerror(errno)});
+    }
+
+    // Finish writing frame if message was only partially sent
+    if (size_t(bytes_sent) < frame.length()) {
+        fdWriteLoop(m_req_sock.getWriteFd(), frame.data() + bytes_sent, frame.length() - bytes_sent);
+    }
+
+    return reqId;
+}
+
+std::string
+FE_daemon::awaitResponse(ReqId reqId)
+{
+    auto lock = std::unique_lock<std::mutex>{m_respMutex};
+
+    while (true) {
+        // Check if response was already received by another thread
+        auto const idRespPair = m_responses.find(reqId);
+        if (idRespPair != m_responses.end()) {
+            auto result = std::move(idRespPair->second);
+            m_responses.erase(idRespPair);
+            m_metrics.end(reqId);
+            return result;
+        }
+
+        // Another thread is reading from the socket, wait for it to hand off a response
+        if (m_respReading) {
+            m_respCv.wait(lock);
+            continue;
+        }
+
+        // Read next response from the socket without holding the lock
+        m_respReading = true;
+        lock.unlock();
+
+        auto respHeader = RespHeader{};
+        auto respData = std::string{};
+        auto readError = std::exception_ptr{};
+        try {
+            respHeader = fdReadLoop<RespHeader>(m_resp_sock.getReadFd());
+            respData.resize(respHeader.length);
+            fdReadLoop(respData.data(), respHeader.length, m_resp_sock.getReadFd());
+        } catch (...) {
+            readError = std::current_exception();
+        }
+
+        // Hand off response and wake waiting threads to check for their response
+        lock.lock();
+        m_respReading = false;
+        m_respCv.notify_all();
+
+        if (readError) {
+            m_metrics.end(reqId);
+            std::rethrow_exception(readError);
+        }
+
+        if (respHeader.id == reqId) {
+            m_metrics.end(reqId);
+            return respData;
+        }
+        m_responses[respHeader.id] = std::move(respData);
+    }
+}
+
 /* interface implementation */
 
 FE_daemon::~FE_daemon()
@@ -284,8 +471,8 @@ FE_daemon::~FE_daemon()
 
             // This should be the only way to call ReqType::Shutdown
             try {
-                fdWriteLoop(m_req_sock.getWriteFd(), ReqType::Shutdown);
-                verifyOKResp(m_resp_sock.getReadFd());
+                auto const reqId = sendRequest(ReqType::Shutdown, [](std::string&) {});
+                verifyOKResp(awaitResponse(reqId));
             } catch (std::exception const& ex) {
                 fprintf(stderr, "warning: %s\n", ex.what());
             }
@@ -295,97 +482,71 @@ FE_daemon::~FE_daemon()
 }
 
 void
-FE_daemon::initialize(std::string const& fe_daemon_bin)
+FE_daemon::initialize(std::string const& fe_daemon_bin, std::string const& lib_dir)
 {
-    // Only fork once!
+    // Only launch once!
     if (m_init) {
         return;
     }
 
-    // Start the frontend daemon
-    if (auto const forkedPid = fork()) {
-        // parent case
+    // Set this PID as the one responsible for cleaning up the daemon
+    m_mainPid = getpid();
 
-        // Set this PID as the one responsible for cleaning up the daemon
-        m_mainPid = getpid();
+    // setup args. Daemon keeps its ends of the req / resp sockets at the same FD numbers
+    using FEDA = CTIFEDaemonArgv;
+    cti::OutgoingArgv<FEDA> fe_daemonArgv{fe_daemon_bin};
+    fe_daemonArgv.add(FEDA::ReadFD,  std::to_string(m_req_sock.getReadFd()));
+    fe_daemonArgv.add(FEDA::WriteFD, std::to_string(m_resp_sock.getWriteFd()));
+    fe_daemonArgv.add(FEDA::LibDir,  lib_dir);
 
-        // set child in own process gorup
-        if (setpgid(forkedPid, forkedPid) < 0) {
-            perror("setpgid");
+    // Spawn daemon in its own process group. Spawning avoids copying the page tables
+    // of a large tool process, and only the daemon's socket FDs are inherited
+    { auto spawnActions = cti::SpawnActions{};
+        spawnActions.setpgroup(0);
 
-            // All exit calls indicating fatal CTI initalization error should be _exit
-            // (exit will run global destructors, but initalization hasn't completed yet)
-            _exit(1);
+        // remap standard FDs
+        spawnActions.dup2(-1, STDIN_FILENO);
+        if (::getenv("CTI_DEBUG") == nullptr) {
+            spawnActions.dup2(-1, STDOUT_FILENO);
+            spawnActions.dup2(-1, STDERR_FILENO);
         }
 
-        // set up fe_daemon req / resp pipe
-        m_req_sock.closeRead();
-        m_resp_sock.closeWrite();
+        spawnActions.closeInherited({m_req_sock.getReadFd(), m_resp_sock.getWriteFd()});
 
-        // wait until fe_daemon set up
-        if (fdReadLoop<pid_t>(m_resp_sock.getReadFd()) != forkedPid) {
-            throw std::runtime_error("fe_daemon launch failed");
+        m_daemonPid = spawnActions.spawnvp(fe_daemon_bin.c_str(), fe_daemonArgv.get());
+        if (m_daemonPid < 0) {
+            throw std::runtime_error("failed to launch " + fe_daemon_bin + ": " + strerror(errno));
         }
     }
-    else {
-        // child case
-
-        // set in own process gorup
-        if (setpgid(0, 0) < 0) {
-            perror("setpgid");
-            _exit(1);
-        }
-
-        // set up death signal
-        prctl(PR_SET_PDEATHSIG, SIGHUP);
 
-        // set up fe_daemon req /resp pipe
-        m_req_sock.closeWrite();
-        m_resp_sock.closeRead();
+    // set up fe_daemon req / resp pipe
+    m_req_sock.closeRead();
+    m_resp_sock.closeWrite();
 
-        // remap standard FDs
-        dup2(open("/dev/null", O_RDONLY), STDIN_FILENO);
-
-        if (::getenv("CTI_DEBUG") == nullptr) {
-            dup2(open("/dev/null", O_WRONLY), STDOUT_FILENO);
-            dup2(open("/dev/null", O_WRONLY), STDERR_FILENO);
-        }
+    // Daemon startup handshake is completed on first request, so that daemon
+    // startup overlaps with the rest of frontend initialization
+    m_init = true;
+}
 
-        // close FDs above pipe FDs
-        auto max_fd = size_t{};
-        { struct rlimit rl;
-            if (getrlimit(RLIMIT_NOFILE, &rl) < 0) {
-                throw std::runtime_error("getrlimit failed.");
-            } else {
-                max_fd = (rl.rlim_max == RLIM_INFINITY) ? 1024 : rl.rlim_max;
-            }
-        }
-        int const min_fd = std::max(m_req_sock.getReadFd(), m_resp_sock.getWriteFd()) + 1;
-        for (size_t i = min_fd; i < max_fd; ++i) {
-            close(i);
+void
+FE_daemon::awaitReady()
+{
+    std::call_once(m_readyOnce, [this]() {
+        // wait until fe_daemon set up
+        if (fdReadLoop<pid_t>(m_resp_sock.getReadFd()) != m_daemonPid) {
+            throw std::runtime_error("fe_daemon launch failed");
         }
-
-        // setup args
-        using FEDA = CTIFEDaemonArgv;
-        cti::OutgoingArgv<FEDA> fe_daemonArgv{fe_daemon_bin};
-        fe_daemonArgv.add(FEDA::ReadFD,  std::to_string(m_req_sock.getReadFd()));
-        fe_daemonArgv.add(FEDA::WriteFD, std::to_string(m_resp_sock.getWriteFd()));
-
-        // exec
-        execvp(fe_daemon_bin.c_str(), fe_daemonArgv.get());
-        _exit(-1);
-    }
-    // Setup in parent was sucessful
-    m_init = true;
+    });
 }
 
 DaemonAppId
 FE_daemon::request_ForkExecvpApp(char const* file,
     char const* const argv[], int stdin_fd, int stdout_fd, int stderr_fd, char const* const env[])
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::ForkExecvpApp);
-    writeLaunchData(m_req_sock.getWriteFd(), file, argv, stdin_fd, stdout_fd, stderr_fd, env);
-    return readIDResp(m_resp_sock.getReadFd());
+    auto const reqId = sendRequest(ReqType::ForkExecvpApp, [&](std::string& reqData) {
+        appendLaunchData(reqData, file, argv, env);
+    }, LaunchFds{stdin_fd, stdout_fd, stderr_fd}.get(), launchMetricName("ForkExecvpApp", file));
+    return readIDResp(awaitResponse(reqId));
 }
 
 bool
@@ -393,71 +554,150 @@ FE_daemon::request_ForkExecvpUtil(DaemonAppId app_id, RunMode runMode,
     char const* file, char const* const argv[], int stdin_fd, int stdout_fd, int stderr_fd,
     char const* const env[])
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::ForkExecvpUtil);
-    fdWriteLoop(m_req_sock.getWriteFd(), app_id);
-    fdWriteLoop(m_req_sock.getWriteFd(), runMode);
-    writeLaunchData(m_req_sock.getWriteFd(), file, argv, stdin_fd, stdout_fd, stderr_fd, env);
+    auto const reqId = sendRequest(ReqType::ForkExecvpUtil, [&](std::string& reqData) {
+        appendData(reqData, app_id);
+        appendData(reqData, runMode);
+        appendLaunchData(reqData, file, argv, env);
+    }, LaunchFds{stdin_fd, stdout_fd, stderr_fd}.get(), launchMetricName((runMode == RunMode::Asynchronous)
+        ? "ForkExecvpUtil_Async" : "ForkExecvpUtil_Sync", file));
 
     // Expect successful async launch
     if (runMode == RunMode::Asynchronous) {
-        verifyOKResp(m_resp_sock.getReadFd());
+        verifyOKResp(awaitResponse(reqId));
         return true;
 
     // Return whether launching the synchronous application was successful
     } else {
-        return readOKResp(m_resp_sock.getReadFd());
+        return readOKResp(awaitResponse(reqId));
+    }
+}
+
+std::vector<FE_daemon::UtilStatus>
+FE_daemon::request_ForkExecvpUtilBatch(DaemonAppId app_id, RunMode runMode,
+    std::vector<UtilLaunch> const& launches, int maxConcurrent)
+{
+    auto result = std::vector<UtilStatus>{};
+    result.reserve(launches.size());
+
+    // Split into requests that stay within the per-message FD limit
+    for (size_t begin = 0; begin < launches.size(); begin += MaxBatchLaunches) {
+        auto const end = std::min(launches.size(), begin + MaxBatchLaunches);
+
+        // Collect stdin / out / err for every utility in request
+        auto launchFds = std::deque<LaunchFds>{};
+        auto fds = std::vector<int>{};
+        for (auto i = begin; i < end; i++) {
+            auto const& launch = launches[i];
+            auto const& utilFds = launchFds.emplace_back(launch.stdin_fd, launch.stdout_fd, launch.stderr_fd);
+            fds.insert(fds.end(), utilFds.get().begin(), utilFds.get().end());
+        }
+
+        auto const reqId = sendRequest(ReqType::ForkExecvpUtilBatch, [&](std::string& reqData) {
+            appendData(reqData, app_id);
+            appendData(reqData, runMode);
+            appendData(reqData, maxConcurrent);
+            appendData(reqData, end - begin);
+            for (auto i = begin; i < end; i++) {
+                appendLaunchData(reqData, launches[i]);
+            }
+        }, fds, launchMetricName((runMode == RunMode::Asynchronous)
+            ? "ForkExecvpUtilBatch_Async" : "ForkExecvpUtilBatch_Sync", launches[begin].file.c_str()));
+
+        auto statuses = readStatusResp<UtilStatus>(awaitResponse(reqId));
+        if (statuses.size() != (end - begin)) {
+            throw std::runtime_error("daemon sent " + std::to_string(statuses.size())
+                + " statuses for batch of " + std::to_string(end - begin) + " utilities");
+        }
+        result.insert(result.end(), statuses.begin(), statuses.end());
     }
+
+    return result;
 }
 
 FE_daemon::MPIRResult
 FE_daemon::request_LaunchMPIR(char const* file,
     char const* const argv[], int stdin_fd, int stdout_fd, int stderr_fd, char const* const env[])
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::LaunchMPIR);
-    writeLaunchData(m_req_sock.getWriteFd(), file, argv, stdin_fd, stdout_fd, stderr_fd, env);
-    return readMPIRResp(m_resp_sock.getReadFd());
+    auto const reqId = sendRequest(ReqType::LaunchMPIR, [&](std::string& reqData) {
+        appendLaunchData(reqData, file, argv, env);
+    }, LaunchFds{stdin_fd, stdout_fd, stderr_fd}.get(), launchMetricName("LaunchMPIR", file));
+    auto const respData = awaitResponse(reqId);
+    return readMPIRResp(respReader(respData));
 }
 
 FE_daemon::MPIRResult
 FE_daemon::request_AttachMPIR(char const* launcher_path, pid_t launcher_pid)
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::AttachMPIR);
-    fdWriteLoop(m_req_sock.getWriteFd(), launcher_path, strlen(launcher_path) + 1);
-    fdWriteLoop(m_req_sock.getWriteFd(), launcher_pid);
-    return readMPIRResp(m_resp_sock.getReadFd());
+    auto const reqId = sendRequest(ReqType::AttachMPIR, [&](std::string& reqData) {
+        appendString(reqData, launcher_path);
+        appendData(reqData, launcher_pid);
+    });
+    auto const respData = awaitResponse(reqId);
+    return readMPIRResp(respReader(respData));
 }
 
 void
 FE_daemon::request_ReleaseMPIR(DaemonAppId mpir_id)
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::ReleaseMPIR);
-    fdWriteLoop(m_req_sock.getWriteFd(), mpir_id);
-    verifyOKResp(m_resp_sock.getReadFd());
+    auto const reqId = sendRequest(ReqType::ReleaseMPIR, [&](std::string& reqData) {
+        appendData(reqData, mpir_id);
+    });
+    verifyOKResp(awaitResponse(reqId));
 }
 
 void
 FE_daemon::request_WaitMPIR(DaemonAppId mpir_id)
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::WaitMPIR);
-    fdWriteLoop(m_req_sock.getWriteFd(), mpir_id);
-    verifyOKResp(m_resp_sock.getReadFd());
+    auto const reqId = sendRequest(ReqType::WaitMPIR, [&](std::string& reqData) {
+        appendData(reqData, mpir_id);
+    });
+    verifyOKResp(awaitResponse(reqId));
+}
+
+std::vector<FE_daemon::MPIRStatus>
+FE_daemon::request_ReleaseMPIRBatch(std::vector<DaemonAppId> const& mpir_ids)
+{
+    auto const reqId = sendRequest(ReqType::ReleaseMPIRBatch, [&](std::string& reqData) {
+        appendMPIRIds(reqData, mpir_ids);
+    });
+    return readStatusResp<MPIRStatus>(awaitResponse(reqId));
+}
+
+std::vector<FE_daemon::MPIRStatus>
+FE_daemon::request_WaitMPIRAny(std::vector<DaemonAppId> const& mpir_ids)
+{
+    auto const reqId = sendRequest(ReqType::WaitMPIRAny, [&](std::string& reqData) {
+        appendMPIRIds(reqData, mpir_ids);
+    });
+    return readStatusResp<MPIRStatus>(awaitResponse(reqId));
+}
+
+std::vector<FE_daemon::MPIRStatus>
+FE_daemon::request_WaitMPIRAll(std::vector<DaemonAppId> const& mpir_ids)
+{
+    auto const reqId = sendRequest(ReqType::WaitMPIRAll, [&](std::string& reqData) {
+        appendMPIRIds(reqData, mpir_ids);
+    });
+    return readStatusResp<MPIRStatus>(awaitResponse(reqId));
 }
 
 std::string
 FE_daemon::request_ReadStringMPIR(DaemonAppId mpir_id, char const* variable)
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::ReadStringMPIR);
-    fdWriteLoop(m_req_sock.getWriteFd(), mpir_id);
-    fdWriteLoop(m_req_sock.getWriteFd(), variable, strlen(variable) + 1);
-    return readStringResp(m_resp_sock.getReadFd());
+    auto const reqId = sendRequest(ReqType::ReadStringMPIR, [&](std::string& reqData) {
+        appendData(reqData, mpir_id);
+        appendString(reqData, variable);
+    });
+    return readStringResp(awaitResponse(reqId));
 }
 
 void
 FE_daemon::request_TerminateMPIR(DaemonAppId mpir_id)
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::TerminateMPIR);
-    fdWriteLoop(m_req_sock.getWriteFd(), mpir_id);
-    verifyOKResp(m_resp_sock.getReadFd());
+    auto const reqId = sendRequest(ReqType::TerminateMPIR, [&](std::string& reqData) {
+        appendData(reqData, mpir_id);
+    });
+    verifyOKResp(awaitResponse(reqId));
 }
 
 FE_daemon::MPIRResult
@@ -466,68 +706,138 @@ FE_daemon::request_LaunchMPIRShim(
     char const* scriptPath, char const* const argv[],
     int stdin_fd, int stdout_fd, int stderr_fd, char const* const env[])
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::LaunchMPIRShim);
-    fdWriteLoop(m_req_sock.getWriteFd(), shimBinaryPath,      strlen(shimBinaryPath)      + 1);
-    fdWriteLoop(m_req_sock.getWriteFd(), temporaryShimBinDir, strlen(temporaryShimBinDir) + 1);
-    fdWriteLoop(m_req_sock.getWriteFd(), shimmedLauncherPath, strlen(shimmedLauncherPath) + 1);
-    writeLaunchData(m_req_sock.getWriteFd(), scriptPath, argv, stdin_fd, stdout_fd, stderr_fd, env);
-    return readMPIRResp(m_resp_sock.getReadFd());
+    auto const reqId = sendRequest(ReqType::LaunchMPIRShim, [&](std::string& reqData) {
+        appendString(reqData, shimBinaryPath);
+        appendString(reqData, temporaryShimBinDir);
+        appendString(reqData, shimmedLauncherPath);
+        appendLaunchData(reqData, scriptPath, argv, env);
+    }, LaunchFds{stdin_fd, stdout_fd, stderr_fd}.get());
+    auto const respData = awaitResponse(reqId);
+    return readMPIRResp(respReader(respData));
 }
 
 DaemonAppId
 FE_daemon::request_RegisterApp()
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::RegisterApp);
-    fdWriteLoop(m_req_sock.getWriteFd(), 0);
-    return readIDResp(m_resp_sock.getReadFd());
+    auto const reqId = sendRequest(ReqType::RegisterApp, [&](std::string& reqData) {
+        appendData(reqData, 0);
+    });
+    return readIDResp(awaitResponse(reqId));
 }
 
 DaemonAppId
 FE_daemon::request_RegisterApp(pid_t app_pid)
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::RegisterApp);
-    fdWriteLoop(m_req_sock.getWriteFd(), app_pid);
-    return readIDResp(m_resp_sock.getReadFd());
+    auto const reqId = sendRequest(ReqType::RegisterApp, [&](std::string& reqData) {
+        appendData(reqData, app_pid);
+    });
+    return readIDResp(awaitResponse(reqId));
 }
 
 void
 FE_daemon::request_RegisterUtil(DaemonAppId app_id, pid_t util_pid)
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::RegisterUtil);
-    fdWriteLoop(m_req_sock.getWriteFd(), app_id);
-    fdWriteLoop(m_req_sock.getWriteFd(), util_pid);
-    verifyOKResp(m_resp_sock.getReadFd());
+    auto const reqId = sendRequest(ReqType::RegisterUtil, [&](std::string& reqData) {
+        appendData(reqData, app_id);
+        appendData(reqData, util_pid);
+    });
+    verifyOKResp(awaitResponse(reqId));
 }
 
 void
 FE_daemon::request_RegisterUtilWithSigkill(DaemonAppId app_id, pid_t util_pid)
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::RegisterUtilWithSigkill);
-    fdWriteLoop(m_req_sock.getWriteFd(), app_id);
-    fdWriteLoop(m_req_sock.getWriteFd(), util_pid);
-    verifyOKResp(m_resp_sock.getReadFd());
+    auto const reqId = sendRequest(ReqType::RegisterUtilWithSigkill, [&](std::string& reqData) {
+        appendData(reqData, app_id);
+        appendData(reqData, util_pid);
+    });
+    verifyOKResp(awaitResponse(reqId));
 }
 
 void
 FE_daemon::request_DeregisterApp(DaemonAppId app_id)
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::DeregisterApp);
-    fdWriteLoop(m_req_sock.getWriteFd(), app_id);
-    verifyOKResp(m_resp_sock.getReadFd());
+    auto const reqId = sendRequest(ReqType::DeregisterApp, [&](std::string& reqData) {
+        appendData(reqData, app_id);
+    });
+    verifyOKResp(awaitResponse(reqId));
 }
 
 void
 FE_daemon::request_ReleaseApp(DaemonAppId app_id)
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::ReleaseApp);
-    fdWriteLoop(m_req_sock.getWriteFd(), app_id);
-    verifyOKResp(m_resp_sock.getReadFd());
+    auto const reqId = sendRequest(ReqType::ReleaseApp, [&](std::string& reqData) {
+        appendData(reqData, app_id);
+    });
+    verifyOKResp(awaitResponse(reqId));
 }
 
 bool
 FE_daemon::request_CheckApp(DaemonAppId app_id)
 {
-    fdWriteLoop(m_req_sock.getWriteFd(), ReqType::CheckApp);
-    fdWriteLoop(m_req_sock.getWriteFd(), app_id);
-    return readOKResp(m_resp_sock.getReadFd());
+    auto const reqId = sendRequest(ReqType::CheckApp, [&](std::string& reqData) {
+        appendData(reqData, app_id);
+    });
+    return readOKResp(awaitResponse(reqId));
+}
+
+pid_t
+FE_daemon::request_GetAppPID(DaemonAppId app_id)
+{
+    auto const reqId = sendRequest(ReqType::GetAppPID, [&](std::string& reqData) {
+        appendData(reqData, app_id);
+    });
+    return readIDResp(awaitResponse(reqId));
+}
+
+std::string
+FE_daemon::request_GetMetrics()
+{
+    auto const reqId = sendRequest(ReqType::GetMetrics, [](std::string&) {});
+    return readStringResp(awaitResponse(reqId));
+}
+
+std::string
+FE_daemon::getMetricsJson()
+{
+    auto daemonJson = std::string{"null"};
+    if (m_init) {
+        try {
+            daemonJson = request_GetMetrics();
+        } catch (std::exception const& ex) {
+            // Report frontend metrics only
+        }
+    }
+
+    return "{\"frontend\":" + m_metrics.toJson() + ",\"daemon\":" + daemonJson + "}";
+}
+
+char const*
+FE_daemon::reqTypeString(ReqType const reqType)
+{
+    switch (reqType) {
+        case ReqType::ForkExecvpApp:  return "ForkExecvpApp";
+        case ReqType::ForkExecvpUtil: return "ForkExecvpUtil";
+        case ReqType::ForkExecvpUtilBatch: return "ForkExecvpUtilBatch";
+        case ReqType::LaunchMPIR:     return "LaunchMPIR";
+        case ReqType::LaunchMPIRShim: return "LaunchMPIRShim";
+        case ReqType::AttachMPIR:     return "AttachMPIR";
+        case ReqType::ReadStringMPIR: return "ReadStringMPIR";
+        case ReqType::ReleaseMPIR:    return "ReleaseMPIR";
+        case ReqType::WaitMPIR:       return "WaitMPIR";
+        case ReqType::TerminateMPIR:  return "TerminateMPIR";
+        case ReqType::ReleaseMPIRBatch: return "ReleaseMPIRBatch";
+        case ReqType::WaitMPIRAny:    return "WaitMPIRAny";
+        case ReqType::WaitMPIRAll:    return "WaitMPIRAll";
+        case ReqType::RegisterApp:    return "RegisterApp";
+        case ReqType::RegisterUtil:   return "RegisterUtil";
+        case ReqType::RegisterUtilWithSigkill: return "RegisterUtilWithSigkill";
+        case ReqType::DeregisterApp:  return "DeregisterApp";
+        case ReqType::ReleaseApp:     return "ReleaseApp";
+        case ReqType::CheckApp:       return "CheckApp";
+        case ReqType::GetAppPID:      return "GetAppPID";
+        case ReqType::GetMetrics:     return "GetMetrics";
+        case ReqType::Shutdown:       return "Shutdown";
+        default: return "(unknown)";
+    }
 }
@@ -10,12 +10,18 @@
 #include <sys/socket.h>
 
 #include <cstring>
+#include <condition_variable>
 #include <functional>
+#include <mutex>
+#include <string>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 #include "frontend/mpir_iface/MPIRProctable.hpp"
 
 #include "useful/cti_execvp.hpp"
+#include "useful/cti_metrics.hpp"
 
 /* fd read / write helpers */
 
@@ -127,6 +133,26 @@ static inline void fdWriteLoop(int const fd, T const& obj)
     fdWriteLoop(fd, reinterpret_cast<char const*>(&obj), sizeof(T));
 }
 
+// append num_bytes from buf to request / response data
+static inline void appendData(std::string& data, char const* buf, size_t num_bytes)
+{
+    data.append(buf, num_bytes);
+}
+
+// append an object T to request / response data
+template <typename T>
+static inline void appendData(std::string& data, T const& obj)
+{
+    static_assert(std::is_trivial<T>::value);
+    appendData(data, reinterpret_cast<char const*>(&obj), sizeof(T));
+}
+
+// append a null-terminated string to request / response data
+static inline void appendString(std::string& data, char const* str)
+{
+    appendData(data, str, std::strlen(str) + 1);
+}
+
 /* protocol helpers for cti_fe_iface
     the frontend implementation in cti_fe_iface.cpp will call these functions, using its internal
     state to provide the file descriptors for the request and response domain sockets
@@ -145,6 +171,34 @@ public: // type definitions
         BinaryRankMap binaryRankMap;
     };
 
+    // completion status of a single MPIR instance in a batch request
+    struct MPIRStatus
+    {
+        DaemonAppId mpir_id;
+        bool success;
+    };
+
+    // launch parameters for a single utility in a batch request
+    struct UtilLaunch
+    {
+        std::string file;
+        std::vector<std::string> argv;
+        int stdin_fd, stdout_fd, stderr_fd;
+        std::vector<std::string> env;
+    };
+
+    // launch / completion status of a single utility in a batch request
+    struct UtilStatus
+    {
+        pid_t pid;       // -1 if launch failed
+        bool success;    // launched, or exited with code 0 if synchronous
+        int exit_status; // exit code if synchronous, otherwise -1
+    };
+
+    // file descriptors for each utility are passed with a batch request,
+    // larger batches are split into multiple requests
+    static constexpr auto MaxBatchLaunches = size_t{64};
+
     // Read and return an MPIRResult from the provided request pipe
     static MPIRResult readMPIRResp(int const reqFd);
 
@@ -152,8 +206,16 @@ public: // type definitions
     // Reader takes a char* result pointer and reads up to size_t bytes
     static MPIRResult readMPIRResp(std::function<ssize_t(char*, size_t)> reader);
 
+    // Append binary path, arguments, environment to launch request data
+    static void appendLaunchData(std::string& reqData, char const* file, char const* const argv[],
+        char const* const env[]);
+    static void appendLaunchData(std::string& reqData, UtilLaunch const& launch);
+
     /* request types */
 
+    // chosen by the client to match a response to its request
+    using ReqId = uint64_t;
+
     static constexpr auto StdFd   = int{-1}; // Map request FD to stdin / stdout / stderr
     static constexpr auto CloseFd = int{-2}; // Close request FD
 
@@ -161,6 +223,7 @@ public: // type definitions
     enum class ReqType : long {
         ForkExecvpApp,
         ForkExecvpUtil,
+        ForkExecvpUtilBatch,
 
         LaunchMPIR,
         LaunchMPIRShim,
@@ -169,6 +232,9 @@ public: // type definitions
         ReleaseMPIR,
         WaitMPIR,
         TerminateMPIR,
+        ReleaseMPIRBatch,
+        WaitMPIRAny,
+        WaitMPIRAll,
 
         RegisterApp,
         RegisterUtil,
@@ -176,6 +242,9 @@ public: // type definitions
         DeregisterApp,
         ReleaseApp,
         CheckApp,
+        GetAppPID,
+
+        GetMetrics,
 
         Shutdown
     };
@@ -187,22 +256,48 @@ public: // type definitions
     };
 
     /* communication protocol
-        before sending any data, send the request type
+        each request is sent as a single frame: a request header with a new request
+        ID, the request type, and the length of the request data, followed by the
+        request data. file descriptors passed with a request are attached to the
+        frame, and their count is sent in the header so the daemon can read several
+        frames at once. requests may be sent while earlier requests are still being handled.
+        the daemon can complete requests out of order, each response is sent as a
+        response header with the request ID followed by the response data.
     */
 
+    struct ReqHeader
+    {
+        ReqId id;
+        ReqType type;
+        size_t length;    // length of request data following this header
+        uint32_t num_fds; // number of file descriptors attached to this frame
+    };
+
+    struct RespHeader
+    {
+        ReqId id;
+        size_t length; // length of response data following this header
+    };
+
     // ForkExecvpApp
     // LaunchMPIR
     /*
         Application launch parameters:
-        send socket control message to share FD access rights
+        attach socket control message to request frame to share FD access rights
         - array of stdin, stdout, stderr FDs
-        then send list of null-terminated strings:
-        - file path string
-        - length of argv
-        - each argv string separated by \0
-        - length of environment variables list
-        - each environment variable string (format VAR=VAL) separated by \0
+        then send a LaunchStrings struct, followed by
+        - table of 1 + argc + envc uint32_t offsets into the string data of the
+          file path, each argv string, and each environment variable string
+          (format VAR=VAL), in that order
+        - string data of `strings_length` bytes, each string null-terminated
+        the daemon uses the strings in place in the request frame
     */
+    struct LaunchStrings
+    {
+        uint32_t argc;
+        uint32_t envc;
+        uint32_t strings_length;
+    };
 
     // ForkExecvpUtil
     /*
@@ -211,6 +306,16 @@ public: // type definitions
         send "Application launch parameters" as for ForkExecvpApp
     */
 
+    // ForkExecvpUtilBatch
+    /*
+        send ID of owning application
+        send RunMode indicating synchronous or asynchronous run
+        send maximum number of utilities to run concurrently (0 for no limit)
+        send number of utilities
+        send "Application launch parameters" as for ForkExecvpApp for each utility,
+        attaching stdin, stdout, stderr FDs for all utilities to the request frame
+    */
+
     // AttachMPIR
     // RegisterApp
     // DeregisterApp
@@ -218,6 +323,12 @@ public: // type definitions
         send PID of target application
     */
 
+    // CheckApp
+    // GetAppPID
+    /*
+        send ID of target application
+    */
+
     // RegisterUtil
     // RegisterUtilWithSigkill
     /*
@@ -237,6 +348,14 @@ public: // type definitions
         send ID provided by LaunchMPIR request
     */
 
+    // ReleaseMPIRBatch
+    // WaitMPIRAny
+    // WaitMPIRAll
+    /*
+        send number of IDs
+        send array of IDs provided by LaunchMPIR requests
+    */
+
     // LaunchMPIRShim
     /*
         send path to shim binary, temporary shim link directory, launcher path to shim
@@ -244,6 +363,7 @@ public: // type definitions
         launcher script will be sent in MPIR launch filepath
     */
 
+    // GetMetrics
     // Shutdown
     /* No data */
 
@@ -254,14 +374,17 @@ public: // type definitions
         // ReleaseApp
         OK,
 
-        // ForkExecvpApp
+        // ForkExecvpApp, GetAppPID
         ID,
 
-        // ReadStringMPIR
+        // ReadStringMPIR, GetMetrics
         String,
 
         // LaunchMPIR, LaunchMPIRShim
-        MPIR
+        MPIR,
+
+        // ReleaseMPIRBatch, WaitMPIRAny, WaitMPIRAll, ForkExecvpUtilBatch
+        Status
     };
 
     struct OKResp
@@ -299,18 +422,69 @@ public: // type definitions
         size_t error_msg_len;
     };
 
+    struct StatusResp
+    {
+        RespType type;
+        bool success;
+        int num_statuses;
+        // after sending this struct, send `num_statuses` MPIRStatus elements (MPIR batch requests)
+        // or UtilStatus elements (ForkExecvpUtilBatch) if successful
+    };
+
 private: // Internal data
     bool      m_init;
     pid_t     m_mainPid; // Main CTI PID that is responsible for daemon cleanup
+    pid_t     m_daemonPid;
+    std::once_flag m_readyOnce; // Daemon startup handshake is read before first request
     cti::FdPair m_req_sock;
     cti::FdPair m_resp_sock;
 
+    // Requests from multiple threads are written whole under the request lock
+    std::mutex m_reqMutex;
+    ReqId      m_nextReqId;
+
+    // One waiting thread at a time reads responses from the socket and hands
+    // off responses for other requests to their waiting threads
+    std::mutex m_respMutex;
+    std::condition_variable m_respCv;
+    bool       m_respReading;
+    std::unordered_map<ReqId, std::string> m_responses;
+
+    // Time from sending each request until its response is received
+    cti::RequestMetrics m_metrics;
+
+private: // Internal helpers
+    // Write request frame with request data produced by writer and any file descriptors
+    // to pass to the daemon, return request ID. Request latency is recorded under
+    // metricName, or the request type name if empty
+    ReqId sendRequest(ReqType type, std::function<void(std::string&)> const& writer,
+        std::vector<int> const& fds = {}, std::string const& metricName = {});
+
+    // Write request frame without waiting for daemon startup to complete
+    ReqId sendFrame(ReqType type, std::function<void(std::string&)> const& writer,
+        std::vector<int> const& fds = {}, std::string const& metricName = {});
+
+    // Read daemon startup handshake if not already done
+    void awaitReady();
+
+    // Block until the response for the request ID is received, return response data
+    std::string awaitResponse(ReqId reqId);
+
 public:
     FE_daemon()
     : m_init{false}
-    , m_mainPid{-1} // Set during daemon fork/exec
+    , m_mainPid{-1} // Set during daemon launch
+    , m_daemonPid{-1}
+    , m_readyOnce{}
     , m_req_sock{}
     , m_resp_sock{}
+    , m_reqMutex{}
+    , m_nextReqId{1}
+    , m_respMutex{}
+    , m_respCv{}
+    , m_respReading{false}
+    , m_responses{}
+    , m_metrics{}
     {
         // Set up communication through Unix domain sockets
         m_req_sock.socketpair(AF_UNIX, SOCK_STREAM, 0);
@@ -319,9 +493,9 @@ public:
     ~FE_daemon();
 
     // This must only be called once. It is to workaround an issue in Frontend
-    // construction with initialization ordering. Plus we might want to someday
-    // delay starting the fe daemon process until it is actually needed.
-    void initialize(std::string const& fe_daemon_bin);
+    // construction with initialization ordering. The daemon is launched immediately,
+    // but the startup handshake is not awaited until the first request.
+    void initialize(std::string const& fe_daemon_bin, std::string const& lib_dir);
 
     /*
     ** FE daemon interface
@@ -332,6 +506,8 @@ public:
     ** In this situation, the app or utility that was to be registered can continue running
     ** indefinitely see protocol notes in cti_fe_daemon.hpp for information on indeterminate-length
     ** requests such as the null-terminated argument / environment arrays.
+    ** Requests may be made concurrently from multiple threads. Long-running requests such as
+    ** MPIR launches and waits do not block requests made from other threads.
     */
 
     // fe_daemon will fork and execvp a binary and register it as an app
@@ -353,6 +529,15 @@ private:
                                 int stdin_fd, int stdout_fd, int stderr_fd,
                                 char const* const env[] );
 public:
+    // fe_daemon will fork and execvp each binary and register it as a utility belonging to app_id.
+    // If synchronous, at most maxConcurrent utilities run at a time (0 for no limit), and the
+    // call returns once all have exited.
+    // Write a batch utility launch request to pipe, return launch / exit status of each utility
+    std::vector<UtilStatus> request_ForkExecvpUtilBatch(DaemonAppId app_id,
+                                                        RunMode runMode,
+                                                        std::vector<UtilLaunch> const& launches,
+                                                        int maxConcurrent = 0);
+
     // Helper functions for request_ForkExecvpUtil
     void request_ForkExecvpUtil_Async(DaemonAppId app_id,
                                       char const* file,
@@ -398,6 +583,21 @@ public:
     // Write an mpir release request to pipe, verify response
     void request_WaitMPIR(DaemonAppId mpir_id);
 
+    // fe_daemon will release each binary under mpir control from its breakpoint.
+    // Write an mpir batch release request to pipe, return release status for each ID
+    std::vector<MPIRStatus> request_ReleaseMPIRBatch(std::vector<DaemonAppId> const& mpir_ids);
+
+    // fe_daemon will release each binary under mpir control from its breakpoint
+    // and wait for completion of at least one of them.
+    // Write an mpir wait request to pipe, return exit status of each completed ID.
+    // Binaries that have not yet completed can be waited on in a later request
+    std::vector<MPIRStatus> request_WaitMPIRAny(std::vector<DaemonAppId> const& mpir_ids);
+
+    // fe_daemon will release each binary under mpir control from its breakpoint
+    // and wait for completion of all of them.
+    // Write an mpir wait request to pipe, return exit status of each ID
+    std::vector<MPIRStatus> request_WaitMPIRAll(std::vector<DaemonAppId> const& mpir_ids);
+
     // fe_daemon will read the value of a variable from memory under MPIR control.
     // Write an mpir string read request to pipe, return value
     std::string request_ReadStringMPIR(DaemonAppId mpir_id, char const* variable);
@@ -443,4 +643,17 @@ public:
 
     // Write an app run check request to pipe, return response
     bool request_CheckApp(DaemonAppId app_id);
+
+    // Write an app PID request to pipe, return PID of local app process or 0 if remote
+    pid_t request_GetAppPID(DaemonAppId app_id);
+
+    // Write a metrics request to pipe, return daemon's request metrics as a JSON object
+    std::string request_GetMetrics();
+
+    // Return JSON object with request metrics recorded by this process under "frontend"
+    // and by the daemon under "daemon", or null if the daemon could not be reached
+    std::string getMetricsJson();
+
+    // Return request type name for logging and metrics
+    static char const* reqTypeString(ReqType reqType);
 };
@@ -9,6 +9,7 @@
 #include "cti_defs.h"
 #include "cti_argv_defs.hpp"
 
+#include <algorithm>
 #include <memory>
 #include <thread>
 #include <variant>
@@ -38,6 +39,7 @@
 #include <boost/iostreams/stream.hpp>
 
 #include "useful/cti_execvp.hpp"
+#include "useful/cti_file_check.hpp"
 #include "useful/cti_hostname.hpp"
 #include "useful/cti_split.hpp"
 
@@ -349,21 +351,35 @@ createNodeLayoutFile(std::vector<FluxFrontend::HostPlacement> const& hostsPlacem
         return layout_entry;
     };
 
+    // Create a Layout entry using node information from each host placement.
+    // PE numbering follows placement order.
+    auto layout_entries = std::vector<slurmLayoutFile_t>{};
+    auto first_pe = 0;
+    for (auto&& placement : hostsPlacement) {
+        layout_entries.push_back(make_layoutFileEntry(placement.hostname,
+            first_pe, placement.numPEs));
+        first_pe += placement.numPEs;
+    }
+
+    // Sort entries by hostname so that each backend can binary search the mapped
+    // file for its own entry. Entries for the same host keep their original order.
+    std::stable_sort(layout_entries.begin(), layout_entries.end(),
+        [](slurmLayoutFile_t const& lhs, slurmLayoutFile_t const& rhs) {
+            return strncmp(lhs.host, rhs.host, sizeof(lhs.host)) < 0;
+        });
+
     // Create the file path, write the file using the Step Layout
     auto const layoutPath = std::string{stagePath + "/" + SLURM_LAYOUT_FILE};
     if (auto const layoutFile = cti::file::open(layoutPath, "wb")) {
 
         // Write the Layout header.
         cti::file::writeT(layoutFile.get(), slurmLayoutFileHeader_t
-            { .numNodes = (int)hostsPlacement.size()
+            { .numNodes = (int)layout_entries.size()
         });
 
-        // Write a Layout entry using node information from each Slurm Node Layout entry.
-        auto first_pe = 0;
-        for (auto&& placement : hostsPlacement) {
-            cti::file::writeT(layoutFile.get(), make_layoutFileEntry(placement.hostname,
-                first_pe, placement.numPEs));
-            first_pe += placement.numPEs;
+        // Write the sorted Layout entries.
+        for (auto&& layout_entry : layout_entries) {
+            cti::file::writeT(layoutFile.get(), layout_entry);
         }
 
         return layoutPath;
@@ -724,6 +740,34 @@ FluxApp::isRunning() const
     return (state == FLUX_JOB_STATE_RUN);
 }
 
+bool
+FluxApp::exitReported()
+{
+    // Consume eventlog entries that have already arrived without blocking
+    while ((m_eventlogWatch != nullptr)
+        && (m_libFluxRef.flux_future_wait_for(m_eventlogWatch, 0.0) == 0)) {
+
+        char const* event = nullptr;
+        if (m_libFluxRef.flux_job_event_watch_get(m_eventlogWatch, &event) < 0) {
+
+            // Watch has ended, running state checks will fall back to job queries
+            m_libFluxRef.flux_future_destroy(m_eventlogWatch);
+            m_eventlogWatch = nullptr;
+            break;
+        }
+
+        auto const eventName = parse_json(event).get<std::string>("name");
+        m_libFluxRef.flux_future_reset(m_eventlogWatch);
+
+        // Job has stopped running once finish event is posted
+        if ((eventName == "finish") || (eventName == "clean")) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 std::vector<std::string>
 FluxApp::getHostnameList() const
 {
@@ -997,19 +1041,26 @@ FluxApp::startDaemon(const char* const args[], bool synchronous)
 std::set<std::string>
 FluxApp::checkFilesExist(std::set<std::string> const& paths)
 {
-    auto result = std::set<std::string>{};
+    auto fileCheck = cti::FileCheck{paths};
+    if (fileCheck.size() == 0) {
+        return {};
+    }
 
     // Send daemon if not already shipped
     if (!m_beDaemonSent) {
         shipDaemon();
     }
 
+    // Ship path list to be checked by each daemon
+    auto listHandle = cti::temp_file_handle{m_stagePath + "/filesXXXXXX"};
+    fileCheck.writeList(listHandle.get(),
+        cti::FileCheck::parseVerify(::getenv(CTI_DEDUPLICATE_VERIFY_ENV_VAR)));
+    shipPackage(listHandle.get());
+
     // Build daemon launcher arguments, exclude broker node
     auto launcherArgv = cti::ManagedArgv{"flux", "exec", "-x", "0",
-        m_toolPath + "/" + getBEDaemonName()};
-    for (auto&& path : paths) {
-        launcherArgv.add("--file=" + path);
-    }
+        m_toolPath + "/" + getBEDaemonName(),
+        "--" + std::string{DaemonArgv::FileList.name} + "=" + m_toolPath + "/" + cti::cstr::basename(listHandle.get())};
 
     // Launch duplicate checker
     auto filesOutput = cti::Execvp{"flux", (char* const*)launcherArgv.get(),
@@ -1026,35 +1077,21 @@ FluxApp::checkFilesExist(std::set<std::string> const& paths)
             }
         }
     }
-    auto pathCountMap = std::map<std::string, size_t>{};
 
-    // Read out all paths from daemon
-    auto exit_count = num_nodes;
+    // Combine bitmap of present files from each daemon. Lines that are not bitmaps,
+    // such as library version warnings from the Flux utility, are ignored
     auto line = std::string{};
-    while ((exit_count > 0) && std::getline(filesStream, line)) {
-
-        // Daemons will print an empty line when output is completed
-        if (line.empty()) {
-            exit_count--;
-
-        // Ignore library version warning from Flux utility
-        } else if (line.find("no version information") != std::string::npos) {
-            continue;
-
-        // Received path from daemon
-        } else {
-
-            // Increment count for path
-            pathCountMap[line]++;
+    while ((fileCheck.numResponses() < num_nodes) && std::getline(filesStream, line)) {
+        fileCheck.addResponse(line);
+    }
 
-            // Add path to duplicate list if all nodes have file
-            if (pathCountMap[line] == num_nodes) {
-                result.emplace(std::move(line));
-            }
-        }
+    // Files are only duplicates if every node has them
+    if (fileCheck.numResponses() < num_nodes) {
+        writeLog("File check received %zu of %zu responses\n", fileCheck.numResponses(), num_nodes);
+        return {};
     }
 
-    return result;
+    return fileCheck.result();
 }
 
 FluxApp::FluxApp(FluxFrontend& fe, FluxFrontend::LaunchInfo&& launchInfo)
@@ -1080,11 +1117,19 @@ FluxApp::FluxApp(FluxFrontend& fe, FluxFrontend::LaunchInfo&& launchInfo)
     , m_atBarrier{launchInfo.atBarrier}
 
     , m_daemonJobIds{}
+
+    , m_eventlogWatch{nullptr}
 {
     // Get API access information for this job
     std::tie(m_leaderRank, m_rpcService) = get_rpc_service(m_libFluxRef, m_fluxHandle, m_jobId);
     writeLog("extracted job info: leader rank %d, service key %s\n", m_leaderRank, m_rpcService.c_str());
 
+    // Watch main job eventlog, running state checks will fall back to job queries on failure
+    m_eventlogWatch = m_libFluxRef.flux_job_event_watch(m_fluxHandle, m_jobId, "eventlog", 0);
+    if (m_eventlogWatch == nullptr) {
+        writeLog("failed to watch job eventlog: %s\n", strerror(errno));
+    }
+
     // Start resource spec query
     { auto lookupRequest = std::stringstream{};
         lookupRequest
@@ -1259,6 +1304,11 @@ FluxApp::~FluxApp()
     }
 
     try {
+        // Stop watching job eventlog
+        if (m_eventlogWatch != nullptr) {
+            m_libFluxRef.flux_future_destroy(m_eventlogWatch);
+        }
+
         // Terminate utilities launched by CTI
         for (auto&& id : m_daemonJobIds) {
             (void)cancel_job(m_libFluxRef, m_fluxHandle, id, "controlling application is terminating");
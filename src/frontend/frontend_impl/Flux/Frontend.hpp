@@ -128,6 +128,8 @@ private: // variables
 
     std::vector<uint64_t> m_daemonJobIds; // Daemon IDs to be cleaned up on exit
 
+    struct flux_future* m_eventlogWatch; // Job eventlog watch to detect exit without a job query
+
 private: // member helpers
     void shipDaemon();
 
@@ -140,6 +142,7 @@ public: // app interaction interface
     std::vector<std::string> getExtraFiles() const override { return m_extraFiles; }
 
     bool   isRunning()       const override;
+    bool   exitReported()          override;
     size_t getNumPEs()       const override { return m_numPEs; }
     size_t getNumHosts()     const override { return m_hostsPlacement.size(); }
     std::vector<std::string> getHostnameList()   const override;
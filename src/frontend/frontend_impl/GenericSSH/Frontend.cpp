@@ -13,6 +13,7 @@
 #include <thread>
 #include <future>
 #include <algorithm>
+#include <atomic>
 
 // Pull in manifest to properly define all the forward declarations
 #include "transfer/Manifest.hpp"
@@ -22,6 +23,45 @@
 #include "daemon/cti_fe_daemon_iface.hpp"
 #include "SSHSession/SSHSession.hpp"
 
+// Maximum number of SSH sessions opened in parallel
+static constexpr auto MaxParallelSessions = size_t{32};
+
+// Run func on each index in [0, count) using at most MaxParallelSessions threads.
+// The first exception thrown is rethrown once every index has been run
+template <typename Func>
+static void runParallel(size_t count, Func&& func)
+{
+    auto nextIdx = std::atomic<size_t>{0};
+    auto runIndices = [&nextIdx, count, &func]() {
+        for (auto i = nextIdx++; i < count; i = nextIdx++) {
+            func(i);
+        }
+    };
+
+    auto runners = std::vector<std::future<void>>{};
+    for (size_t i = 1; i < std::min(count, MaxParallelSessions); i++) {
+        runners.push_back(std::async(std::launch::async, runIndices));
+    }
+    auto firstError = std::exception_ptr{};
+    try {
+        runIndices();
+    } catch (...) {
+        firstError = std::current_exception();
+    }
+    for (auto&& runner : runners) {
+        try {
+            runner.get();
+        } catch (...) {
+            if (!firstError) {
+                firstError = std::current_exception();
+            }
+        }
+    }
+    if (firstError) {
+        std::rethrow_exception(firstError);
+    }
+}
+
 
 GenericSSHApp::GenericSSHApp(GenericSSHFrontend& fe, FE_daemon::MPIRResult&& mpirData)
     : App(fe, mpirData.mpir_id)
@@ -54,6 +94,11 @@ GenericSSHApp::~GenericSSHApp()
 {
     if (!Frontend::isOriginalInstance()) {
         writeLog("~GenericSSHApp: forked PID %d exiting without cleanup\n", getpid());
+
+        // SSH sessions are shared with the original instance, don't close them
+        for (auto&& agent : m_beAgents) {
+            (void)agent.release();
+        }
         return;
     }
 
@@ -152,10 +197,59 @@ GenericSSHApp::shipPackage(std::string const& tarPath) const
     auto const destination = m_toolPath + "/" + packageName;
     writeLog("GenericSSH shipping %s to '%s'\n", tarPath.c_str(), destination.c_str());
 
-    // Send the package to each of the hosts using SCP
-    for (auto&& node : m_stepLayout.nodes) {
-        SSHSession(node.hostname, m_username, m_homeDir).sendRemoteFile(tarPath.c_str(), destination.c_str(), S_IRWXU | S_IRWXG | S_IRWXO);
+    // Packages are sent through the agent tree, so the frontend only sends to the
+    // root of each subtree
+    startBEAgents();
+
+    // Send the package to every host in a subtree through its root agent. Return the
+    // hosts that may not have received it
+    auto sendAgentPackage = [this, &tarPath, &packageName](size_t agentIdx) {
+        auto const [beginIdx, endIdx] = m_beAgentNodes[agentIdx];
+        auto const& hostname = m_stepLayout.nodes[beginIdx].hostname;
+
+        auto& agent = m_beAgents[agentIdx];
+        if (agent) {
+            try {
+                auto const response = agent->sendFile(tarPath.c_str(), packageName);
+                if (response.status != 0) {
+                    writeLog("GenericSSH agent tree at %s sent package to %u of %u nodes with status %d\n",
+                        hostname.c_str(), response.numNodes, agent->m_numNodes, response.status);
+                }
+                return agentMissedNodes(agentIdx, response.missedNodes);
+
+            } catch (std::exception const& ex) {
+                writeLog("GenericSSH agent on %s failed: %s\n", hostname.c_str(), ex.what());
+                agent.reset();
+            }
+        }
+
+        return subtreeNodes(agentIdx);
+    };
+
+    auto agentFallbackNodes = std::vector<std::vector<size_t>>(m_beAgents.size());
+    runParallel(m_beAgents.size(), [&agentFallbackNodes, &sendAgentPackage](size_t agentIdx) {
+        agentFallbackNodes[agentIdx] = sendAgentPackage(agentIdx);
+    });
+
+    // Resending replaces the package, so every host that may have missed it is sent
+    // the package directly
+    auto fallbackNodes = std::vector<size_t>{};
+    for (auto&& nodeIdxs : agentFallbackNodes) {
+        fallbackNodes.insert(fallbackNodes.end(), nodeIdxs.begin(), nodeIdxs.end());
     }
+    sendPackageDirect(tarPath, fallbackNodes);
+}
+
+void
+GenericSSHApp::sendPackageDirect(std::string const& tarPath, std::vector<size_t> const& nodeIdxs) const
+{
+    auto const destination = m_toolPath + "/" + cti::cstr::basename(tarPath);
+
+    // Send the package to each of the hosts using SCP
+    runParallel(nodeIdxs.size(), [this, &tarPath, &destination, &nodeIdxs](size_t i) {
+        SSHSession(m_stepLayout.nodes[nodeIdxs[i]].hostname, m_username, m_homeDir).sendRemoteFile(
+            tarPath.c_str(), destination.c_str(), S_IRWXU | S_IRWXG | S_IRWXO);
+    });
 }
 
 void
@@ -166,6 +260,110 @@ GenericSSHApp::startDaemon(const char* const args[], bool synchronous)
         throw std::runtime_error("args array is empty!");
     }
 
+    // Daemons are run by a persistent agent on each node once it has been started
+    startBEAgents();
+
+    // Use location of existing launcher binary on compute node
+    std::string const launcherPath{m_toolPath + "/" + getBEDaemonName()};
+
+    // Prepare the launcher arguments
+    cti::ManagedArgv launcherArgv { launcherPath };
+
+    // Copy provided launcher arguments
+    launcherArgv.add(args);
+
+    // Run the launcher on a host by executing a remote command
+    auto runRemoteCommand = [this, &launcherArgv, synchronous](size_t nodeIdx) {
+        auto session = SSHSession{m_stepLayout.nodes[nodeIdx].hostname, m_username, m_homeDir};
+        session.executeRemoteCommand(launcherArgv.get(), nullptr, synchronous);
+    };
+
+    // Run the launcher on every host in a subtree through its root agent. Return the
+    // hosts it did not run on, so that remote commands are used for them instead
+    auto runAgentDaemon = [this, &launcherArgv, synchronous](size_t agentIdx) {
+        auto const [beginIdx, endIdx] = m_beAgentNodes[agentIdx];
+        auto const& hostname = m_stepLayout.nodes[beginIdx].hostname;
+
+        auto& agent = m_beAgents[agentIdx];
+        if (agent) {
+            try {
+                auto const response = agent->runDaemon(launcherArgv.get() + 1, synchronous);
+                if (response.status != 0) {
+                    writeLog("GenericSSH daemon in tree at %s exited with status %d\n", hostname.c_str(), response.status);
+                }
+                agent->m_responded = true;
+
+                // Hosts whose child agent exited did not start the daemon
+                if (!response.missedNodes.empty()) {
+                    writeLog("GenericSSH agent tree at %s ran daemon on %u of %u nodes\n",
+                        hostname.c_str(), response.numNodes, agent->m_numNodes);
+                }
+                return agentMissedNodes(agentIdx, response.missedNodes);
+
+            } catch (std::exception const& ex) {
+                writeLog("GenericSSH agent on %s failed: %s\n", hostname.c_str(), ex.what());
+
+                // Daemon may have already run if the agent failed after responding before
+                auto const responded = agent->m_responded;
+                agent.reset();
+                if (responded) {
+                    throw;
+                }
+            }
+        }
+
+        return subtreeNodes(agentIdx);
+    };
+
+    // Launches run in parallel. Asynchronous launches continue to run after they are
+    // started. Hosts the agents did not reach are launched afterwards
+    auto agentFallbackNodes = std::vector<std::vector<size_t>>(m_beAgents.size());
+    runParallel(m_beAgents.size(), [&agentFallbackNodes, &runAgentDaemon](size_t agentIdx) {
+        agentFallbackNodes[agentIdx] = runAgentDaemon(agentIdx);
+    });
+
+    auto fallbackNodes = std::vector<size_t>{};
+    for (auto&& nodeIdxs : agentFallbackNodes) {
+        fallbackNodes.insert(fallbackNodes.end(), nodeIdxs.begin(), nodeIdxs.end());
+    }
+    runParallel(fallbackNodes.size(), [&fallbackNodes, &runRemoteCommand](size_t i) {
+        runRemoteCommand(fallbackNodes[i]);
+    });
+}
+
+std::vector<size_t>
+GenericSSHApp::subtreeNodes(size_t agentIdx) const
+{
+    auto result = std::vector<size_t>{};
+    for (auto nodeIdx = m_beAgentNodes[agentIdx].first; nodeIdx < m_beAgentNodes[agentIdx].second; nodeIdx++) {
+        result.push_back(nodeIdx);
+    }
+    return result;
+}
+
+std::vector<size_t>
+GenericSSHApp::agentMissedNodes(size_t agentIdx, std::vector<uint32_t> const& missedNodes) const
+{
+    // Agent's tree holds its subtree's hosts in order, so tree index i is node begin + i
+    auto const [beginIdx, endIdx] = m_beAgentNodes[agentIdx];
+    auto result = std::vector<size_t>{};
+    for (auto&& treeIdx : missedNodes) {
+        if ((beginIdx + treeIdx) >= endIdx) {
+            throw std::runtime_error("backend daemon agent tree at " + m_stepLayout.nodes[beginIdx].hostname
+                + " missed invalid node " + std::to_string(treeIdx));
+        }
+        result.push_back(beginIdx + treeIdx);
+    }
+    return result;
+}
+
+void
+GenericSSHApp::startBEAgents() const
+{
+    if (!m_beAgentNodes.empty()) {
+        return;
+    }
+
     // Send daemon if not already shipped
     if (!m_beDaemonSent) {
         // Get the location of the backend daemon
@@ -190,49 +388,65 @@ GenericSSHApp::startDaemon(const char* const args[], bool synchronous)
             throw std::runtime_error("failed to link " + sourcePath + " to " + destinationPath);
         }
 
-        // Ship the unique backend daemon
-        shipPackage(destinationPath);
+        // Agents run the backend daemon, so it is sent to every host directly
+        auto allNodes = std::vector<size_t>(m_stepLayout.nodes.size());
+        for (size_t i = 0; i < allNodes.size(); i++) {
+            allNodes[i] = i;
+        }
+        sendPackageDirect(destinationPath, allNodes);
         // set transfer to true
         m_beDaemonSent = true;
     }
 
     // Use location of existing launcher binary on compute node
-    std::string const launcherPath{m_toolPath + "/" + getBEDaemonName()};
-
-    // Prepare the launcher arguments
-    cti::ManagedArgv launcherArgv { launcherPath };
-
-    // Copy provided launcher arguments
-    launcherArgv.add(args);
-
-    // Execute the launcher on each of the hosts using SSH
-    auto executeRemoteCommand = [](std::string const& hostname, std::string const& username,
-        std::string const& homeDir, char const* const* argv, bool synchronous) {
-        auto session = SSHSession{hostname, username, homeDir};
-        session.executeRemoteCommand(argv, nullptr, synchronous);
-    };
-
-    if (synchronous) {
-
-        // Synchronous launches run in parallel as future tasks
-        auto launchFutures = std::vector<std::future<void>>{};
-        for (auto&& node : m_stepLayout.nodes) {
-            launchFutures.push_back(std::async(std::launch::async, executeRemoteCommand,
-                node.hostname, m_username, m_homeDir, launcherArgv.get(),
-                /* synchronous */ true));
-        }
-        for (auto&& future : launchFutures) {
-            future.get();
+    auto const launcherPath = m_toolPath + "/" + getBEDaemonName();
+
+    // By default the frontend connects an agent directly to every node. If a tree
+    // fanout is set, nodes are split into that many contiguous subtrees of nearly equal
+    // size. Each agent connected to the root of a subtree starts child agents for the
+    // rest of it, splitting in the same way
+    auto const numNodes = m_stepLayout.nodes.size();
+    auto fanout = numNodes;
+    if (auto const fanoutStr = ::getenv(CTI_SSH_TREE_FANOUT_ENV_VAR)) {
+        fanout = std::max(std::strtoul(fanoutStr, nullptr, 10), 1ul);
+    }
+    if (fanout > numNodes) {
+        fanout = numNodes;
+    }
+    for (size_t i = 0; i < fanout; i++) {
+        auto const beginIdx = (i * numNodes) / fanout;
+        auto const endIdx = ((i + 1) * numNodes) / fanout;
+        if (beginIdx < endIdx) {
+            m_beAgentNodes.emplace_back(beginIdx, endIdx);
         }
+    }
 
-    } else {
+    // Agents that fail to start are left empty, and daemons on those hosts are
+    // started with remote commands instead
+    m_beAgents.resize(m_beAgentNodes.size());
+    runParallel(m_beAgentNodes.size(), [this, &launcherPath, fanout](size_t agentIdx) {
+        auto const [beginIdx, endIdx] = m_beAgentNodes[agentIdx];
+        auto const& hostname = m_stepLayout.nodes[beginIdx].hostname;
+        try {
+            auto agentArgv = cti::OutgoingArgv<DaemonArgv>{launcherPath};
+            agentArgv.add(DaemonArgv::Agent);
+            agentArgv.add(DaemonArgv::ApID,     getJobId());
+            agentArgv.add(DaemonArgv::ToolPath, m_toolPath);
+            if ((endIdx - beginIdx) > 1) {
+                auto tree = m_stepLayout.nodes[beginIdx + 1].hostname;
+                for (auto i = beginIdx + 2; i < endIdx; i++) {
+                    tree += "," + m_stepLayout.nodes[i].hostname;
+                }
+                agentArgv.add(DaemonArgv::AgentFanout, std::to_string(fanout));
+                agentArgv.add(DaemonArgv::AgentTree,   tree);
+            }
 
-        // Asynchronous launches can be started in parallel and continued to run
-        for (auto&& node : m_stepLayout.nodes) {
-            executeRemoteCommand(node.hostname, m_username, m_homeDir, launcherArgv.get(),
-                /* asynchronous */ false);
+            m_beAgents[agentIdx] = std::make_unique<RemoteBEAgent>(SSHSession{hostname, m_username, m_homeDir},
+                agentArgv.get(), endIdx - beginIdx);
+        } catch (std::exception const& ex) {
+            writeLog("GenericSSH failed to start agent on %s: %s\n", hostname.c_str(), ex.what());
         }
-    }
+    });
 }
 
 /* SSH frontend implementation */
@@ -393,18 +607,31 @@ GenericSSHFrontend::createNodeLayoutFile(GenericSSHFrontend::StepLayout const& s
         return layout_entry;
     };
 
+    // Create a Layout entry using node information from each SSH Node Layout entry.
+    auto layout_entries = std::vector<cti_layoutFile_t>{};
+    for (auto const& node : stepLayout.nodes) {
+        layout_entries.push_back(make_layoutFileEntry(node));
+    }
+
+    // Sort entries by hostname so that each backend can binary search the mapped
+    // file for its own entry. Entries for the same host keep their original order.
+    std::stable_sort(layout_entries.begin(), layout_entries.end(),
+        [](cti_layoutFile_t const& lhs, cti_layoutFile_t const& rhs) {
+            return strncmp(lhs.host, rhs.host, sizeof(lhs.host)) < 0;
+        });
+
     // Create the file path, write the file using the Step Layout
     auto const layoutPath = std::string{stagePath + "/" + SSH_LAYOUT_FILE};
     if (auto const layoutFile = cti::file::open(layoutPath, "wb")) {
 
         // Write the Layout header.
         cti::file::writeT(layoutFile.get(), cti_layoutFileHeader_t
-            { .numNodes = (int)stepLayout.nodes.size()
+            { .numNodes = (int)layout_entries.size()
         });
 
-        // Write a Layout entry using node information from each SSH Node Layout entry.
-        for (auto const& node : stepLayout.nodes) {
-            cti::file::writeT(layoutFile.get(), make_layoutFileEntry(node));
+        // Write the sorted Layout entries.
+        for (auto&& layout_entry : layout_entries) {
+            cti::file::writeT(layoutFile.get(), layout_entry);
         }
 
         return layoutPath;
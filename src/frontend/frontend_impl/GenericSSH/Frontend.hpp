@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include <stdint.h>
@@ -80,6 +81,8 @@ public: // constructor / destructor interface
 
 /* Types used here */
 
+struct RemoteBEAgent;
+
 class GenericSSHApp : public App
 {
 private: // variables
@@ -89,12 +92,24 @@ private: // variables
     pid_t      m_launcherPid; // job launcher PID
     std::map<std::string, std::vector<int>> m_binaryRankMap; // Binary to rank ID map
     GenericSSHFrontend::StepLayout m_stepLayout; // SSH Layout of job step
-    bool       m_beDaemonSent; // Have we already shipped over the backend daemon?
+    mutable bool m_beDaemonSent; // Have we already shipped over the backend daemon?
 
     std::string m_toolPath;    // Backend path where files are unpacked
     std::string m_attribsPath; // Backend Cray-specific directory
     std::string m_stagePath;   // Local directory where files are staged before transfer to BE
     std::vector<std::string> m_extraFiles; // List of extra support files to transfer to BE
+    mutable std::vector<std::unique_ptr<RemoteBEAgent>> m_beAgents; // Backend daemon agent at the root of each subtree, if running
+    mutable std::vector<std::pair<size_t, size_t>> m_beAgentNodes; // Range of node indices in each agent's subtree
+
+    // Ship backend daemon and start backend daemon agent tree if not already started,
+    // with an agent connected directly to each node unless a tree fanout is set
+    void startBEAgents() const;
+    // Node indices in the subtree of the agent at agentIdx
+    std::vector<size_t> subtreeNodes(size_t agentIdx) const;
+    // Node indices of the hosts missed by the agent at agentIdx, given by their index in its tree
+    std::vector<size_t> agentMissedNodes(size_t agentIdx, std::vector<uint32_t> const& missedNodes) const;
+    // Send package to each node in nodeIdxs directly from the frontend
+    void sendPackageDirect(std::string const& tarPath, std::vector<size_t> const& nodeIdxs) const;
 
 public: // app interaction interface
     std::string getJobId()            const override;
@@ -23,6 +23,7 @@
 
 #include "PALS/Frontend.hpp"
 
+#include "useful/cti_file_check.hpp"
 #include "useful/cti_hostname.hpp"
 #include "useful/cti_split.hpp"
 #include "frontend/mpir_iface/Inferior.hpp"
@@ -1061,6 +1062,21 @@ createNodeLayoutFile(MPIRProctable const& mpirProctable, std::string const& stag
             { .numNodes = (int)hostLayouts.size()
         });
 
+        // Write the index of Layout entry offsets. Entries vary in size with the number
+        // of ranks, so the index lets each backend binary search for its own entry.
+        // Hosts are already sorted by the map.
+        auto offset = uint64_t{sizeof(palsLayoutFileHeader_t)
+            + hostLayouts.size() * sizeof(palsLayoutIndexEntry_t)};
+        for (auto const& [hostname, rankPidPairs] : hostLayouts) {
+            auto index_entry = palsLayoutIndexEntry_t{};
+            index_entry.offset = offset;
+            memcpy(index_entry.host, hostname.c_str(),
+                std::min(hostname.size() + 1, sizeof(index_entry.host)));
+            cti::file::writeT(layoutFile.get(), index_entry);
+
+            offset += sizeof(palsLayoutEntry_t) + rankPidPairs.size() * sizeof(cti_rankPidPair_t);
+        }
+
         // Write a Layout entry using node information from each Slurm Node Layout entry.
         for (auto const& [hostname, rankPidPairs] : hostLayouts) {
             cti::file::writeT(layoutFile.get(), make_layoutFileEntry(hostname, rankPidPairs));
@@ -1271,6 +1287,12 @@ PALSApp::releaseBarrier()
 
 void
 PALSApp::shipPackage(std::string const& tarPath) const
+{
+    shipPackage(tarPath, {});
+}
+
+void
+PALSApp::shipPackage(std::string const& tarPath, std::vector<FE_daemon::UtilLaunch> launches) const
 {
     auto const destinationName = cti::cstr::basename(tarPath);
 
@@ -1319,25 +1341,46 @@ PALSApp::shipPackage(std::string const& tarPath) const
     // Host file generation completed
     hostFile.close();
 
-    auto palscpArgv = cti::ManagedArgv{"palscp", "-l", hostFileHandle.get(),
-        "-f", tarPath, "-d", destinationName, m_apId};
-
-    if (!m_frontend.Daemon().request_ForkExecvpUtil_Sync(
-        m_daemonAppId, "palscp", palscpArgv.get(),
-        FE_daemon::CloseFd, FE_daemon::CloseFd, FE_daemon::CloseFd,
-        nullptr)) {
-        throw std::runtime_error("failed to ship " + tarPath + " using palscp");
-    }
+    auto const numPrepared = launches.size();
+    launches.push_back(FE_daemon::UtilLaunch
+        { .file = "palscp"
+        , .argv = { "palscp", "-l", hostFileHandle.get(),
+            "-f", tarPath, "-d", destinationName, m_apId }
+        , .stdin_fd = FE_daemon::CloseFd
+        , .stdout_fd = FE_daemon::CloseFd
+        , .stderr_fd = FE_daemon::CloseFd
+        , .env = {}
+    });
 
     // Move shipped file from noexec filesystem to toolpath directory
     auto const palscpDestination = "/var/run/palsd/" + m_apId + "/files/" + destinationName;
-    auto palscmdArgv = cti::ManagedArgv { "palscmd", "-n", m_execHost, m_apId,
-            "mv", palscpDestination, m_toolPath };
+    launches.push_back(FE_daemon::UtilLaunch
+        { .file = "palscmd"
+        , .argv = { "palscmd", "-n", m_execHost, m_apId,
+            "mv", palscpDestination, m_toolPath }
+        , .stdin_fd = FE_daemon::CloseFd
+        , .stdout_fd = FE_daemon::CloseFd
+        , .stderr_fd = FE_daemon::CloseFd
+        , .env = {}
+    });
+
+    // Run each step in order in one daemon request. Steps after a failed one fail as
+    // well, so report the first failure
+    auto const statuses = m_frontend.Daemon().request_ForkExecvpUtilBatch(
+        m_daemonAppId, FE_daemon::Synchronous, launches, 1);
+    auto const failed = std::find_if(statuses.begin(), statuses.end(),
+        [](auto&& status) { return !status.success; });
+    if (failed == statuses.end()) {
+        return;
+    }
 
-    if (!m_frontend.Daemon().request_ForkExecvpUtil_Sync(
-        m_daemonAppId, "palscmd", palscmdArgv.get(),
-        FE_daemon::CloseFd, FE_daemon::CloseFd, FE_daemon::CloseFd,
-        nullptr)) {
+    auto const failedIdx = size_t(failed - statuses.begin());
+    if (failedIdx < numPrepared) {
+        throw std::runtime_error("failed to run " + launches[failedIdx].file
+            + " before shipping " + tarPath);
+    } else if (failedIdx == numPrepared) {
+        throw std::runtime_error("failed to ship " + tarPath + " using palscp");
+    } else {
         throw std::runtime_error("failed to move shipped package for apid " + m_apId);
     }
 }
@@ -1361,21 +1404,16 @@ PALSApp::startDaemon(const char* const args[], bool synchronous)
         auto const sourcePath = m_frontend.getBEDaemonPath();
         auto const destinationPath = m_frontend.getCfgDir() + "/" + getBEDaemonName();
 
-        // Create the args for copy
-        auto copyArgv = cti::ManagedArgv {
-            "cp", sourcePath.c_str(), destinationPath.c_str()
+        // Copy and ship the unique backend daemon in one daemon request
+        auto copyLaunch = FE_daemon::UtilLaunch
+            { .file = "cp"
+            , .argv = { "cp", sourcePath, destinationPath }
+            , .stdin_fd = FE_daemon::CloseFd
+            , .stdout_fd = FE_daemon::CloseFd
+            , .stderr_fd = FE_daemon::CloseFd
+            , .env = {}
         };
-
-        // Run copy command
-        if (!m_frontend.Daemon().request_ForkExecvpUtil_Sync(
-            m_daemonAppId, "cp", copyArgv.get(),
-            FE_daemon::CloseFd, FE_daemon::CloseFd, FE_daemon::CloseFd,
-            nullptr)) {
-            throw std::runtime_error("failed to copy " + sourcePath + " to " + destinationPath);
-        }
-
-        // Ship the unique backend daemon
-        shipPackage(destinationPath);
+        shipPackage(destinationPath, { std::move(copyLaunch) });
         // set transfer to true
         m_beDaemonSent = true;
     }
@@ -1466,11 +1504,14 @@ PALSApp::startDaemon(const char* const args[], bool synchronous)
 std::set<std::string>
 PALSApp::checkFilesExist(std::set<std::string> const& paths)
 {
-    auto result = std::set<std::string>{};
+    auto fileCheck = cti::FileCheck{paths};
+    if (fileCheck.size() == 0) {
+        return {};
+    }
 
     // Create arguments for file check launch
     auto num_nodes = m_hosts.size();
-    writeLog("Checking for duplicate files on %zu nodes\n", num_nodes);
+    writeLog("Checking for %zu duplicate files on %zu nodes\n", fileCheck.size(), num_nodes);
 
     auto mpiexecArgv = cti::ManagedArgv{
         "mpiexec", "--envnone", "--mem-bind=none", "--ppn=1", "-n", std::to_string(num_nodes),
@@ -1480,9 +1521,19 @@ PALSApp::checkFilesExist(std::set<std::string> const& paths)
         // will ship it automatically during launch.
         m_frontend.getBEDaemonPath()
     };
-    for (auto&& path : paths) {
-        mpiexecArgv.add("--file=" + path);
+
+    // The check runs as a new application, which can't rely on files shipped to the
+    // original, so the path list is passed as arguments. Each argument must fit in
+    // Linux MAX_ARG_STRLEN including its option name and terminator
+    auto const fileListOpt = "--" + std::string{DaemonArgv::FileListData.name} + "=";
+    auto constexpr maxArgLength = size_t{32 * 4096};
+    auto const fileListData = fileCheck.listData(
+        cti::FileCheck::parseVerify(::getenv(CTI_DEDUPLICATE_VERIFY_ENV_VAR)),
+        maxArgLength - fileListOpt.length() - 1);
+    for (auto&& listPiece : fileListData) {
+        mpiexecArgv.add(fileListOpt + listPiece);
     }
+    writeLog("Passing file list in %zu arguments\n", fileListData.size());
 
     auto stdoutPipe = cti::Pipe{};
 
@@ -1499,32 +1550,23 @@ PALSApp::checkFilesExist(std::set<std::string> const& paths)
     auto stdoutBuf = cti::FdBuf{stdoutPipe.getReadFd()};
     auto stdoutStream = std::istream{&stdoutBuf};
 
-    // Track number of present files
-    auto pathCountMap = std::map<std::string, size_t>{};
-
-    // Read out all paths from daemon
-    auto exit_count = num_nodes;
+    // Combine bitmap of present files from each daemon
     auto line = std::string{};
-    while ((exit_count > 0) && std::getline(stdoutStream, line)) {
-
-        // Daemons will print an empty line when output is completed
-        if (line.empty()) {
-            writeLog("Nodes left to check: %zu\n", exit_count);
-            exit_count--;
-
-        // Received path from daemon
-        } else {
-
-            // Increment count for path and add to duplicate list if all nodes have file
-            if (++pathCountMap[line] == num_nodes) {
-                result.emplace(std::move(line));
-            }
+    while ((fileCheck.numResponses() < num_nodes) && std::getline(stdoutStream, line)) {
+        if (fileCheck.addResponse(line)) {
+            writeLog("Nodes left to check: %zu\n", num_nodes - fileCheck.numResponses());
         }
     }
 
+    // Files are only duplicates if every node has them
+    if (fileCheck.numResponses() < num_nodes) {
+        writeLog("File check received %zu of %zu responses\n", fileCheck.numResponses(), num_nodes);
+        return {};
+    }
+
     writeLog("Finished checking all nodes\n");
 
-    return result;
+    return fileCheck.result();
 }
 
 void PALSApp::kill(int signum)
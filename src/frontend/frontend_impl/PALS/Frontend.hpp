@@ -117,6 +117,9 @@ class PALSApp : public App
     bool m_atBarrier; // At startup barrier or not
     bool m_pmix; // Using PMIx mode
 
+    // Ship package with palscp, running the utilities in launches first, in order,
+    // within the same FE daemon request
+    void shipPackage(std::string const& tarPath, std::vector<FE_daemon::UtilLaunch> launches) const;
 
 public:
     PALSApp(PALSFrontend& fe, PALSFrontend::PalsLaunchInfo&& palsLaunchInfo);
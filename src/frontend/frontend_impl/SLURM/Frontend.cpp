@@ -37,6 +37,7 @@
 
 #include "useful/cti_argv.hpp"
 #include "useful/cti_execvp.hpp"
+#include "useful/cti_file_check.hpp"
 #include "useful/cti_split.hpp"
 #include "useful/cti_hostname.hpp"
 #include "useful/cti_wrappers.hpp"
@@ -992,6 +993,12 @@ SLURMApp::SLURMApp(SLURMFrontend& fe, FE_daemon::MPIRResult&& mpirData, std::str
     , m_extraFiles  { fe.createNodeLayoutFile(m_stepLayout, m_stagePath) }
 
 {
+    // Backends look up their Slurm node name here instead of each querying Slurm
+    auto nodeNamePath = fe.createNodeNameFile(m_stepLayout, m_stagePath);
+    if (!nodeNamePath.empty()) {
+        m_extraFiles.push_back(std::move(nodeNamePath));
+    }
+
     // Ensure there are running nodes in the job.
     for (auto&& [jobId, layout] : m_stepLayout) {
         if (layout.nodes.empty()) {
@@ -1435,14 +1442,21 @@ void SLURMApp::shipPackage(std::string const& tarPath) const {
 MPIRProctable SLURMApp::reparentProctable(MPIRProctable const& procTable,
     std::string const& wrapperBinary)
 {
-    // Run first child utility on each supplied PID on remote host
-    auto getFirstChildInformation = [this](std::string const& reparentUtilityPath,
-        std::string const& hostname, std::set<pid_t> const& pids) {
+    auto& slurmFrontend = dynamic_cast<SLURMFrontend&>(m_frontend);
 
-        // Start adding the args to the launcher argv array
-        auto& slurmFrontend = dynamic_cast<SLURMFrontend&>(m_frontend);
+    // Build launch of first child utility on each supplied PID on remote host
+    auto getFirstChildLaunch = [this, &slurmFrontend](std::string const& reparentUtilityPath,
+        std::string const& hostname, std::set<pid_t> const& pids, int outputFd) {
 
-        auto launcherArgv = cti::ManagedArgv{slurmFrontend.getLauncherName()};
+        // Start adding the args to the launcher argv array
+        auto launch = FE_daemon::UtilLaunch
+            { .file = slurmFrontend.getLauncherName()
+            , .argv = { slurmFrontend.getLauncherName() }
+            , .stdin_fd = FE_daemon::CloseFd
+            , .stdout_fd = outputFd
+            , .stderr_fd = FE_daemon::CloseFd
+            , .env = {}
+        };
 
         auto first = true;
         for (auto&& [id, layout] : m_stepLayout) {
@@ -1451,45 +1465,39 @@ MPIRProctable SLURMApp::reparentProctable(MPIRProctable const& procTable,
             if (first) {
                 first = false;
             } else {
-                launcherArgv.add(":");
+                launch.argv.emplace_back(":");
             }
 
-            launcherArgv.add("--jobid=" + id);
-            launcherArgv.add("--nodes=" + std::to_string(layout.nodes.size()));
-            launcherArgv.add("--nodelist=" + hostname);
+            launch.argv.emplace_back("--jobid=" + id);
+            launch.argv.emplace_back("--nodes=" + std::to_string(layout.nodes.size()));
+            launch.argv.emplace_back("--nodelist=" + hostname);
 
             // Add daemon launch arguments, except for output redirection
             for (auto&& arg : slurmFrontend.getSrunDaemonArgs()) {
                 if (arg != "--output=none") {
-                    launcherArgv.add(arg);
+                    launch.argv.emplace_back(arg);
                 }
             }
 
             // Add utility command and each PID
-            launcherArgv.add(reparentUtilityPath);
+            launch.argv.emplace_back(reparentUtilityPath);
             for (auto&& pid : pids) {
-                launcherArgv.add(std::to_string(pid));
+                launch.argv.emplace_back(std::to_string(pid));
             }
         }
 
         // Build environment from blacklist
-        cti::ManagedArgv launcherEnv;
         for (auto&& envVar : slurmFrontend.getSrunEnvBlacklist()) {
-            launcherEnv.add("CTIBLACKLIST_" + envVar + "=");
+            launch.env.emplace_back("CTIBLACKLIST_" + envVar + "=");
         }
 
-        // Capture lines of output from srun
-        auto outputPipe = cti::Pipe{};
-        auto outputPipeBuf = cti::FdBuf{outputPipe.getReadFd()};
-        auto outputStream = std::istream{&outputPipeBuf};
+        return launch;
+    };
 
-        // Tell FE Daemon to launch srun
-        m_frontend.Daemon().request_ForkExecvpUtil_Async(
-            m_daemonAppId, dynamic_cast<SLURMFrontend&>(m_frontend).getLauncherName().c_str(),
-            launcherArgv.get(),
-            ::open("/dev/null", O_RDONLY), outputPipe.getWriteFd(), ::open("/dev/null", O_WRONLY),
-            launcherEnv.get() );
-        outputPipe.closeWrite();
+    // Read PID / child PID / executable output from first child utility
+    auto readFirstChildInformation = [this](int outputFd) {
+        auto outputPipeBuf = cti::FdBuf{outputFd};
+        auto outputStream = std::istream{&outputPipeBuf};
 
         // Read and store output from remote tool launch
         auto result = std::vector<std::tuple<pid_t, pid_t, std::string>>{};
@@ -1515,7 +1523,6 @@ MPIRProctable SLURMApp::reparentProctable(MPIRProctable const& procTable,
                 continue;
             }
         }
-        outputPipe.closeRead();
 
         return result;
     };
@@ -1547,11 +1554,31 @@ MPIRProctable SLURMApp::reparentProctable(MPIRProctable const& procTable,
     using PidExecutablePair = std::pair<pid_t, std::string>;
     auto singularityChildMap = std::map<HostnamePidPair, PidExecutablePair>{};
 
-    // Query wrappers' child information on each host
+    // Query wrappers' child information on all hosts in one daemon request
+    auto outputPipes = std::vector<cti::Pipe>(hostSingularityMap.size());
+    auto launches = std::vector<FE_daemon::UtilLaunch>{};
+    { auto outputPipe = outputPipes.begin();
+        for (auto&& [hostname, pids] : hostSingularityMap) {
+            writeLog("Querying %lu PIDs on %s\n", pids.size(), hostname.c_str());
+            launches.emplace_back(getFirstChildLaunch(destinationPath, hostname, pids,
+                (outputPipe++)->getWriteFd()));
+        }
+    }
+    auto const statuses = m_frontend.Daemon().request_ForkExecvpUtilBatch(
+        m_daemonAppId, FE_daemon::Asynchronous, launches);
+
+    // Collect output from each host
+    auto outputPipe = outputPipes.begin();
+    auto status = statuses.begin();
     for (auto&& [hostname, pids] : hostSingularityMap) {
-        writeLog("Querying %lu PIDs on %s\n", pids.size(), hostname.c_str());
+        outputPipe->closeWrite();
+        if (!(status++)->success) {
+            writeLog("failed to launch reparenting utility on %s\n", hostname.c_str());
+            outputPipe++;
+            continue;
+        }
 
-        auto pidExeMappings = getFirstChildInformation(destinationPath, hostname, pids);
+        auto pidExeMappings = readFirstChildInformation(::dup((outputPipe++)->getReadFd()));
         for (auto&& [pid, child_pid, executable] : pidExeMappings) {
             singularityChildMap[{hostname, pid}] = {child_pid, std::move(executable)};
         }
@@ -1572,6 +1599,70 @@ MPIRProctable SLURMApp::reparentProctable(MPIRProctable const& procTable,
 }
 
 void SLURMApp::startDaemon(const char* const args[], bool synchronous)
+{
+    auto const mpirId = launchDaemon(args, synchronous);
+
+    // Daemon was launched directly or over SSH, which handled completion and release
+    if (!mpirId) {
+        return;
+    }
+
+    if (synchronous) {
+        m_frontend.Daemon().request_WaitMPIR(*mpirId);
+    } else {
+        m_frontend.Daemon().request_ReleaseMPIR(*mpirId);
+    }
+}
+
+void SLURMApp::startDaemons(std::vector<char const* const*> const& argvs)
+{
+    // Nothing to batch for a single daemon
+    if (argvs.size() < 2) {
+        App::startDaemons(argvs);
+        return;
+    }
+
+    // Launch each daemon srun to its MPIR breakpoint, then release and wait for all of
+    // them in one request rather than one round trip per daemon
+    auto mpirIds = std::vector<FE_daemon::DaemonAppId>{};
+    try {
+        for (auto&& argv : argvs) {
+            if (auto const mpirId = launchDaemon(argv, /* synchronous */ true)) {
+                mpirIds.push_back(*mpirId);
+            }
+        }
+    } catch (...) {
+        // Don't leave daemons that were already launched stopped at their breakpoints
+        if (!mpirIds.empty()) {
+            try {
+                m_frontend.Daemon().request_ReleaseMPIRBatch(mpirIds);
+            } catch (std::exception const& ex) {
+                writeLog("failed to release tool daemons: %s\n", ex.what());
+            }
+        }
+        throw;
+    }
+
+    if (mpirIds.empty()) {
+        return;
+    }
+
+    auto numFailed = size_t{0};
+    for (auto&& mpirStatus : m_frontend.Daemon().request_WaitMPIRAll(mpirIds)) {
+        if (!mpirStatus.success) {
+            writeLog("tool daemon mpir id %d failed\n", mpirStatus.mpir_id);
+            numFailed++;
+        }
+    }
+    if (numFailed > 0) {
+        throw std::runtime_error(std::to_string(numFailed) + " of "
+            + std::to_string(mpirIds.size()) + " tool daemon launches failed on job "
+            + getJobId());
+    }
+}
+
+std::optional<FE_daemon::DaemonAppId>
+SLURMApp::launchDaemon(const char* const args[], bool synchronous)
 {
     // sanity check
     if (args == nullptr) {
@@ -1616,6 +1707,42 @@ void SLURMApp::startDaemon(const char* const args[], bool synchronous)
     // Find the path to the launcher
     auto launcherPath = cti::findPath(slurmFrontend.getLauncherName());
 
+    // Launch srun directly if MPIR control is not needed
+    if (::getenv(SLURM_DAEMON_NO_MPIR_ENV_VAR)) {
+        if (synchronous) {
+            // srun output is only read after it exits, so send it to an unlinked
+            // temporary file rather than a pipe that srun could fill and block on
+            auto stderrFile = cti::take_pointer_ownership(::tmpfile(), ::fclose);
+            if (stderrFile == nullptr) {
+                throw std::runtime_error("failed to create temporary file: " + std::string{strerror(errno)});
+            }
+
+            auto const success = m_frontend.Daemon().request_ForkExecvpUtil_Sync(
+                m_daemonAppId, launcherPath.c_str(), launcherArgv.get(),
+                FE_daemon::CloseFd, FE_daemon::CloseFd, ::fileno(stderrFile.get()),
+                launcherEnv.get());
+
+            if (!success) {
+                auto srunOutput = std::string{};
+                ::rewind(stderrFile.get());
+                char buf[4096];
+                while (auto const len = ::fread(buf, 1, sizeof(buf), stderrFile.get())) {
+                    srunOutput.append(buf, len);
+                }
+
+                throw std::runtime_error("failed to launch tool daemon on job "
+                    + getJobId() + ". srun output:\n" + srunOutput);
+            }
+        } else {
+            m_frontend.Daemon().request_ForkExecvpUtil_Async(
+                m_daemonAppId, launcherPath.c_str(), launcherArgv.get(),
+                FE_daemon::CloseFd, FE_daemon::CloseFd, FE_daemon::CloseFd,
+                launcherEnv.get());
+        }
+
+        return std::nullopt;
+    }
+
     // tell FE Daemon to launch srun
     auto used_ssh = false;
     auto result = srunMPIR(m_frontend.Daemon(), launcherPath.c_str(), launcherArgv.get(), launcherEnv.get(),
@@ -1662,32 +1789,34 @@ void SLURMApp::startDaemon(const char* const args[], bool synchronous)
 
     // SSH handled completion and release of daemon
     if (used_ssh) {
-        return;
+        return std::nullopt;
     }
 
-    if (synchronous) {
-        m_frontend.Daemon().request_WaitMPIR(result.mpir_id);
-    } else {
-        m_frontend.Daemon().request_ReleaseMPIR(result.mpir_id);
-    }
+    return result.mpir_id;
 }
 
 std::set<std::string>
 SLURMApp::checkFilesExist(std::set<std::string> const& paths)
 {
-    auto result = std::set<std::string>{};
+    auto fileCheck = cti::FileCheck{paths};
+    if (fileCheck.size() == 0) {
+        return {};
+    }
 
     // Send daemon if not already shipped
     if (!m_beDaemonSent) {
         shipDaemon();
     }
 
+    // Ship path list to be checked by each daemon
+    auto listHandle = cti::temp_file_handle{m_stagePath + "/filesXXXXXX"};
+    fileCheck.writeList(listHandle.get(),
+        cti::FileCheck::parseVerify(::getenv(CTI_DEDUPLICATE_VERIFY_ENV_VAR)));
+    shipPackage(listHandle.get());
+
     // Build daemon launcher arguments
-    auto launcherArgs = cti::ManagedArgv{};
-    launcherArgs.add(m_toolPath + "/" + getBEDaemonName());
-    for (auto&& path : paths) {
-        launcherArgs.add("--file=" + path);
-    }
+    auto launcherArgs = cti::OutgoingArgv<DaemonArgv>{m_toolPath + "/" + getBEDaemonName()};
+    launcherArgs.add(DaemonArgv::FileList, m_toolPath + "/" + cti::cstr::basename(listHandle.get()));
 
     // Generate the final launcher argv array
     auto launcherArgv = generateDaemonLauncherArgv(launcherArgs.get());
@@ -1712,33 +1841,20 @@ SLURMApp::checkFilesExist(std::set<std::string> const& paths)
     auto stdoutBuf = cti::FdBuf{stdoutPipe.getReadFd()};
     auto stdoutStream = std::istream{&stdoutBuf};
 
-    // Track number of present files
+    // Combine bitmap of present files from each daemon
     auto num_nodes = getNumHosts();
-    auto pathCountMap = std::map<std::string, size_t>{};
-
-    // Read out all paths from daemon
-    auto exit_count = num_nodes;
     auto line = std::string{};
-    while ((exit_count > 0) && std::getline(stdoutStream, line)) {
-
-        // Daemons will print an empty line when output is completed
-        if (line.empty()) {
-            exit_count--;
-
-        // Received path from daemon
-        } else {
-
-            // Increment count for path
-            pathCountMap[line]++;
+    while ((fileCheck.numResponses() < num_nodes) && std::getline(stdoutStream, line)) {
+        fileCheck.addResponse(line);
+    }
 
-            // Add path to duplicate list if all nodes have file
-            if (pathCountMap[line] == num_nodes) {
-                result.emplace(std::move(line));
-            }
-        }
+    // Files are only duplicates if every node has them
+    if (fileCheck.numResponses() < num_nodes) {
+        writeLog("File check received %zu of %zu responses\n", fileCheck.numResponses(), num_nodes);
+        return {};
     }
 
-    return result;
+    return fileCheck.result();
 }
 
 /* SLURM frontend implementation */
@@ -2184,9 +2300,22 @@ SLURMFrontend::createNodeLayoutFile(std::map<std::string, StepLayout> const& idL
         return layout_entry;
     };
 
-    // Get total number of nodes across all jobs
-    auto total_nodes = std::accumulate(idLayouts.begin(), idLayouts.end(), 0, 
-        [](size_t sum, auto const& idLayoutPair) { return sum + idLayoutPair.second.nodes.size(); });
+    // Create a Layout entry using node information from each Slurm Node Layout entry
+    // across all jobs.
+    auto layout_entries = std::vector<slurmLayoutFile_t>{};
+    for (auto&& [id, layout] : idLayouts) {
+        for (auto const& node : layout.nodes) {
+            layout_entries.push_back(make_layoutFileEntry(node));
+        }
+    }
+
+    // Sort entries by hostname so that each backend can binary search the mapped
+    // file for its own entry instead of reading every node's entry. Entries for the
+    // same host keep their original order.
+    std::stable_sort(layout_entries.begin(), layout_entries.end(),
+        [](slurmLayoutFile_t const& lhs, slurmLayoutFile_t const& rhs) {
+            return strncmp(lhs.host, rhs.host, sizeof(lhs.host)) < 0;
+        });
 
     // Create the file path, write the file using the Step Layout
     auto const layoutPath = std::string{stagePath + "/" + SLURM_LAYOUT_FILE};
@@ -2194,14 +2323,12 @@ SLURMFrontend::createNodeLayoutFile(std::map<std::string, StepLayout> const& idL
 
         // Write the Layout header.
         cti::file::writeT(layoutFile.get(), slurmLayoutFileHeader_t
-            { .numNodes = (int)total_nodes
+            { .numNodes = (int)layout_entries.size()
         });
 
-        // Write a Layout entry using node information from each Slurm Node Layout entry.
-        for (auto&& [id, layout] : idLayouts) {
-            for (auto const& node : layout.nodes) {
-                cti::file::writeT(layoutFile.get(), make_layoutFileEntry(node));
-            }
+        // Write the sorted Layout entries.
+        for (auto&& layout_entry : layout_entries) {
+            cti::file::writeT(layoutFile.get(), layout_entry);
         }
 
         return layoutPath;
@@ -2210,6 +2337,93 @@ SLURMFrontend::createNodeLayoutFile(std::map<std::string, StepLayout> const& idL
     }
 }
 
+std::string
+SLURMFrontend::createNodeNameFile(std::map<std::string, StepLayout> const& idLayouts,
+    std::string const& stagePath)
+{
+    // Node lists are kept well under the Linux limit of 128KiB for a single argument
+    static constexpr auto maxNodeListLength = size_t{64 * 1024};
+
+    auto hostNodeNames = std::map<std::string, std::string>{};
+
+    // Add hostnames of the nodes in nodeList to hostNodeNames
+    auto queryNodeHostNames = [&hostNodeNames](std::string const& nodeList) {
+        char const* scontrol_argv[] = {"scontrol", "show", "node", nodeList.c_str(), nullptr};
+
+        // Run scontrol
+        auto scontrolOutput = cti::Execvp{"scontrol", (char* const*)scontrol_argv,
+            cti::Execvp::stderr::Ignore};
+
+        // Read scontrol output
+        auto& scontrolStream = scontrolOutput.stream();
+        hostNodeNames.merge(detail::parse_node_host_names(scontrolStream));
+
+        // Consume rest of scontrol output and ignore errors
+        scontrolStream.ignore(std::numeric_limits<std::streamsize>::max());
+        (void)scontrolOutput.getExitStatus();
+    };
+
+    auto nodeNames = std::set<std::string>{};
+    for (auto&& [id, layout] : idLayouts) {
+        for (auto const& node : layout.nodes) {
+            nodeNames.insert(node.hostname);
+        }
+    }
+    if (nodeNames.empty()) {
+        return {};
+    }
+
+    try {
+        // Backends find hostnames that are already node names in the layout file. Naming
+        // is uniform across a system, so if the first node's hostname is its node name,
+        // the rest of the nodes are not queried
+        auto const& firstNodeName = *nodeNames.begin();
+        queryNodeHostNames(firstNodeName);
+        auto const firstHost = firstNodeName.substr(0, firstNodeName.find('.'));
+        auto const firstHostNodeName = hostNodeNames.find(firstHost);
+        if ((firstHostNodeName != hostNodeNames.end()) && (firstHostNodeName->second == firstNodeName)) {
+            writeLog("Node %s hostname matches node name, not shipping node names\n", firstNodeName.c_str());
+            return {};
+        }
+
+        // Query the rest in batches that fit in a single argument
+        nodeNames.erase(nodeNames.begin());
+        for (auto&& nodeList : detail::batch_node_lists(nodeNames, maxNodeListLength)) {
+            queryNodeHostNames(nodeList);
+        }
+
+    } catch (std::exception const& ex) {
+        writeLog("Node name query failed: %s\n", ex.what());
+    }
+
+    // Backends will query Slurm themselves
+    if (hostNodeNames.empty()) {
+        return {};
+    }
+
+    // Create the file path, write the file sorted by hostname for lookup
+    auto const nodeNamePath = std::string{stagePath + "/" + SLURM_NODENAME_FILE};
+    if (auto const nodeNameFile = cti::file::open(nodeNamePath, "wb")) {
+
+        // Write the Node Name header.
+        cti::file::writeT(nodeNameFile.get(), slurmNodeNameFileHeader_t
+            { .numNodes = (int)hostNodeNames.size()
+        });
+
+        // Write a Node Name entry for each host
+        for (auto&& [host, nodeName] : hostNodeNames) {
+            auto entry = slurmNodeNameFile_t{};
+            memcpy(entry.host, host.c_str(), host.size() + 1);
+            memcpy(entry.nodeName, nodeName.c_str(), nodeName.size() + 1);
+            cti::file::writeT(nodeNameFile.get(), entry);
+        }
+
+        return nodeNamePath;
+    } else {
+        throw std::runtime_error("failed to open node name file path " + nodeNamePath);
+    }
+}
+
 std::string
 SLURMFrontend::createPIDListFile(MPIRProctable const& procTable, std::string const& stagePath)
 {
@@ -2234,6 +2448,59 @@ SLURMFrontend::createPIDListFile(MPIRProctable const& procTable, std::string con
     }
 }
 
+std::map<std::string, std::string>
+SLURMFrontend::detail::parse_node_host_names(std::istream& scontrolStream)
+{
+    auto result = std::map<std::string, std::string>{};
+
+    // NodeName always appears before NodeHostName in each node record
+    auto nodeName = std::string{};
+    auto scontrolLine = std::string{};
+    while (std::getline(scontrolStream, scontrolLine)) {
+        auto lineStream = std::istringstream{scontrolLine};
+        auto field = std::string{};
+        while (lineStream >> field) {
+            if (field.rfind("NodeName=", 0) == 0) {
+                nodeName = field.substr(strlen("NodeName="));
+
+            } else if ((field.rfind("NodeHostName=", 0) == 0) && !nodeName.empty()) {
+                auto host = field.substr(strlen("NodeHostName="));
+                host = host.substr(0, host.find('.'));
+
+                // Skip names that don't fit in a file entry
+                if (!host.empty() && (host.size() < sizeof(slurmNodeNameFile_t::host))
+                 && (nodeName.size() < sizeof(slurmNodeNameFile_t::nodeName))) {
+                    result[host] = nodeName;
+                }
+                nodeName.clear();
+            }
+        }
+    }
+
+    return result;
+}
+
+std::vector<std::string>
+SLURMFrontend::detail::batch_node_lists(std::set<std::string> const& nodeNames, size_t maxLength)
+{
+    auto result = std::vector<std::string>{};
+
+    auto nodeList = std::string{};
+    for (auto&& nodeName : nodeNames) {
+        // Trailing comma is accepted by scontrol
+        if (!nodeList.empty() && ((nodeList.length() + nodeName.length() + 1) > maxLength)) {
+            result.push_back(std::move(nodeList));
+            nodeList.clear();
+        }
+        nodeList += nodeName + ",";
+    }
+    if (!nodeList.empty()) {
+        result.push_back(std::move(nodeList));
+    }
+
+    return result;
+}
+
 void SLURMFrontend::detail::add_quoted_args(cti::ManagedArgv& args, std::string const& quotedArgs)
 {
     const auto view = std::string_view{quotedArgs};
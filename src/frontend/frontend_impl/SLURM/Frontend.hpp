@@ -152,6 +152,12 @@ public: // slurm specific interface
     std::string createNodeLayoutFile(std::map<std::string, StepLayout> const& idLayout,
         std::string const& stagePath);
 
+    // Query Slurm once for the hostname of each node in a Slurm Step Layout and create the SLURM Node Name
+    // file inside the staging directory. Return the new path, or empty if the hostnames could not be queried
+    // or already match the node names.
+    std::string createNodeNameFile(std::map<std::string, StepLayout> const& idLayouts,
+        std::string const& stagePath);
+
     // Use an MPIR ProcTable to create the SLURM PID List file inside the staging directory, return the new path.
     std::string createPIDListFile(MPIRProctable const& procTable, std::string const& stagePath);
 
@@ -180,6 +186,10 @@ struct detail
 {
     static std::string get_gres_setting(char const* const* launcher_argv);
     static void add_quoted_args(cti::ManagedArgv& args, std::string const& quotedArgs);
+    // Map each NodeHostName, up to the first '.', to its NodeName in `scontrol show node` output
+    static std::map<std::string, std::string> parse_node_host_names(std::istream& scontrolStream);
+    // Split node names into comma-separated node lists of at most maxLength characters
+    static std::vector<std::string> batch_node_lists(std::set<std::string> const& nodeNames, size_t maxLength);
 };
 
 };
@@ -206,6 +216,9 @@ private: // variables
 private: // member helpers
     void shipDaemon();
     cti::ManagedArgv generateDaemonLauncherArgv(char const* const* launcher_args);
+    // Launch tool daemon, return MPIR ID to release or wait on, or nullopt if the
+    // daemon was launched without MPIR control
+    std::optional<FE_daemon::DaemonAppId> launchDaemon(const char* const args[], bool synchronous);
 
 public: // app interaction interface
     std::string getJobId()            const override;
@@ -226,6 +239,7 @@ public: // app interaction interface
     void kill(int signal) override;
     void shipPackage(std::string const& tarPath) const override;
     void startDaemon(const char* const args[], bool synchronous) override;
+    void startDaemons(std::vector<char const* const*> const& argvs) override;
     std::set<std::string> checkFilesExist(std::set<std::string> const& paths) override;
 
 public: // slurm specific interface
@@ -8,9 +8,12 @@
 // This pulls in config.h
 #include "cti_defs.h"
 
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
+#include <mutex>
+
 #include "Inferior.hpp"
 
 #include "useful/cti_wrappers.hpp"
@@ -35,6 +38,43 @@ static inline void log(const char* format, ...)
     }
 }
 
+/* dyninst lock */
+
+std::mutex DyninstLock::s_mutex;
+thread_local int DyninstLock::s_depth = 0;
+
+DyninstLock::DyninstLock()
+{
+    if (s_depth++ == 0) {
+        s_mutex.lock();
+    }
+}
+
+DyninstLock::~DyninstLock()
+{
+    if (--s_depth == 0) {
+        s_mutex.unlock();
+    }
+}
+
+int DyninstLock::release()
+{
+    auto const depth = s_depth;
+    if (depth > 0) {
+        s_depth = 0;
+        s_mutex.unlock();
+    }
+    return depth;
+}
+
+void DyninstLock::reacquire(int depth)
+{
+    if (depth > 0) {
+        s_mutex.lock();
+        s_depth = depth;
+    }
+}
+
 /* process management helpers */
 
 static Dyninst::ProcControlAPI::FollowFork::follow_t disableGlobalFollowFork() {
@@ -97,6 +137,52 @@ stop_on_breakpoint(Dyninst::ProcControlAPI::Event::const_ptr genericEv) {
     return Dyninst::ProcControlAPI::Process::cbProcStop;
 }
 
+// Event callbacks are registered globally, so only remove the breakpoint
+// callback once no inferiors remain
+static std::mutex breakpointCallbackMutex;
+static size_t breakpointCallbackRefs = 0;
+
+static void register_breakpoint_callback() {
+    auto const lock = std::lock_guard<std::mutex>{breakpointCallbackMutex};
+    if (breakpointCallbackRefs++ == 0) {
+        log("Setting event breakpoint handler\n");
+        Dyninst::ProcControlAPI::Process::registerEventCallback(
+            Dyninst::ProcControlAPI::EventType::Breakpoint, stop_on_breakpoint);
+    }
+}
+
+static void remove_breakpoint_callback() {
+    auto const lock = std::lock_guard<std::mutex>{breakpointCallbackMutex};
+    if (--breakpointCallbackRefs == 0) {
+        Dyninst::ProcControlAPI::Process::removeEventCallback(
+            Dyninst::ProcControlAPI::EventType::Breakpoint, stop_on_breakpoint);
+    }
+}
+
+/* event helpers */
+
+// Process::handleEvents handles events for all processes, not only the
+// caller's. When multiple inferiors are run from different threads, each thread
+// waits on Dyninst's event notification descriptor with the Dyninst lock
+// released, then handles any pending events and checks whether its own
+// inferior has stopped.
+template <typename Pred>
+static void handle_events_until(Pred&& stopped) {
+    auto const lock = DyninstLock{};
+    auto const notifyFd = Dyninst::ProcControlAPI::evNotify()->getFD();
+    while (!stopped()) {
+        if (Dyninst::ProcControlAPI::Process::handleEvents(false)) {
+            continue;
+        }
+
+        // Time out periodically in case another thread handled our event
+        DyninstLock::unlocked([notifyFd]() {
+            struct pollfd pollFd = { notifyFd, POLLIN, 0 };
+            return ::poll(&pollFd, 1, 100);
+        });
+    }
+}
+
 /* inferior implementations */
 
 Inferior::Inferior(std::string const& launcher,
@@ -122,8 +208,7 @@ Inferior::Inferior(std::string const& launcher,
     }
 
     /* prepare breakpoint callback */
-    log("Setting event breakpoint handler\n");
-    Process::registerEventCallback(Dyninst::ProcControlAPI::EventType::Breakpoint, stop_on_breakpoint);
+    register_breakpoint_callback();
 }
 
 static size_t numArgv(char const* const argv[])
@@ -163,12 +248,11 @@ Inferior::Inferior(std::string const& launcher, pid_t pid)
     }
 
     /* prepare breakpoint callback */
-    log("Setting event breakpoint handler\n");
-    Process::registerEventCallback(Dyninst::ProcControlAPI::EventType::Breakpoint, stop_on_breakpoint);
+    register_breakpoint_callback();
 }
 
 Inferior::~Inferior() {
-    Process::removeEventCallback(Dyninst::ProcControlAPI::EventType::Breakpoint, stop_on_breakpoint);
+    remove_breakpoint_callback();
 
     if (!isTerminated()) {
         m_proc->detach();
@@ -181,19 +265,26 @@ pid_t Inferior::getPid() {
 
 /* symbol / breakpoint manipulation */
 void Inferior::continueRun() {
+    auto const lock = DyninstLock{};
+
     /* note that can only read on stopped thread */
-    do {
-        m_proc->continueProc();
-        Process::handleEvents(true); // blocks til event received
-    } while (!isTerminated() && !m_proc->hasStoppedThread());
+    m_proc->continueProc();
+    handle_events_until([this]() {
+        return isTerminated() || m_proc->hasStoppedThread();
+    });
 }
 
 void Inferior::terminate() {
+    auto const lock = DyninstLock{};
     if (!isTerminated()) {
         auto const pid = m_proc->getPid();
         m_proc->detach();
-        ::kill(pid, SIGTERM);
-        cti::waitpid(pid, nullptr, 0);
+
+        // Other inferiors can be used while the launcher exits
+        DyninstLock::unlocked([pid]() {
+            ::kill(pid, SIGTERM);
+            return cti::waitpid(pid, nullptr, 0);
+        });
     }
 }
 
@@ -10,6 +10,7 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <type_traits>
 
 #include <signal.h>
@@ -24,6 +25,37 @@
 #include <Event.h>
 #include <PlatFeatures.h>
 
+/* DyninstLock: Dyninst is not thread-safe, so inferiors used from multiple threads
+   must hold this lock around every call. It can be taken recursively by one thread,
+   and is released while waiting for inferior events */
+
+class DyninstLock {
+    static std::mutex s_mutex;
+    static thread_local int s_depth;
+
+    // fully release lock if held by this thread, return depth to restore
+    static int release();
+    static void reacquire(int depth);
+
+public:
+    DyninstLock();
+    ~DyninstLock();
+
+    DyninstLock(DyninstLock const&) = delete;
+    DyninstLock& operator=(DyninstLock const&) = delete;
+
+    // run func with lock released, such as while blocking on something other than Dyninst
+    template <typename Func>
+    static auto unlocked(Func&& func) {
+        struct Reacquire {
+            int depth;
+            ~Reacquire() { reacquire(depth); }
+        } const reacquireOnExit{release()};
+
+        return func();
+    }
+};
+
 /* inferior: manages dyninst process info, symbols, breakpoints */
 
 class Inferior {
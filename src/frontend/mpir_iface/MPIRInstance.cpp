@@ -9,8 +9,11 @@
 #include "cti_defs.h"
 
 #include <sstream>
+#include <algorithm>
 // POSIX extensions enabled by autoconf
 #include <limits.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "MPIRInstance.hpp"
 
@@ -18,6 +21,15 @@
 
 using Symbol  = Inferior::Symbol;
 
+// Upper bound on a single remote read when fetching one string
+static constexpr size_t MaxStringChunk = 256;
+
+static size_t page_size()
+{
+    static const auto _page_size = size_t(::sysconf(_SC_PAGESIZE));
+    return _page_size;
+}
+
 static inline bool debug_enabled()
 {
     static const auto _enabled = []() {
@@ -40,7 +52,8 @@ static inline void log(const char* format, ...)
 MPIRInstance::MPIRInstance(std::string const& launcher,
     std::vector<std::string> const& launcherArgv,
     std::vector<std::string> envVars, std::map<int, int> remapFds) :
-    m_inferior{launcher, launcherArgv, envVars, remapFds} {
+    m_inferior{launcher, launcherArgv, envVars, remapFds},
+    m_stringCache{} {
 
     /* read symbols, set breakpoints, etc. */
     setupMPIRStandard();
@@ -48,13 +61,14 @@ MPIRInstance::MPIRInstance(std::string const& launcher,
 
 /* attach to process given pid */
 MPIRInstance::MPIRInstance(std::string const& launcher, pid_t pid) :
-    m_inferior{launcher, pid} {
+    m_inferior{launcher, pid},
+    m_stringCache{} {
 
     setupMPIRStandard();
 
     /* wait until proctable has been filled */
     while (m_inferior.readVariable<int>("MPIR_proctable_size") == 0) {
-        m_inferior.continueRun();
+        continueRun();
 
         /* ensure execution wasn't stopped due to termination */
         if (m_inferior.isTerminated()) {
@@ -81,11 +95,17 @@ void MPIRInstance::setupMPIRStandard() {
 
 /* instance implementations */
 
+void MPIRInstance::continueRun() {
+    // inferior memory may change once it runs again
+    m_stringCache.clear();
+    m_inferior.continueRun();
+}
+
 void MPIRInstance::runToMPIRBreakpoint() {
     log("running inferior til MPIR_Breakpoint\n");
 
     while (true) {
-        m_inferior.continueRun();
+        continueRun();
 
         if (m_inferior.isTerminated()) {
             throw std::runtime_error("MPIR launch target terminated before MPIR_Breakpoint");
@@ -112,7 +132,7 @@ int MPIRInstance::waitExit() {
     log("running inferior til exit\n");
 
     while (true) {
-        m_inferior.continueRun();
+        continueRun();
 
         // Exited normally
         if (m_inferior.isExited()) {
@@ -134,27 +154,82 @@ int MPIRInstance::waitExit() {
     }
 }
 
-template <typename T>
-static T readArrayElem(Inferior& inf, std::string const& symName, size_t idx) {
-    Inferior::Address elem_addr;
-    { auto array_start = inf.readVariable<Inferior::Address>(symName);
-        elem_addr = array_start + idx * sizeof(T);
-    }
-    return inf.readMemory<T>(elem_addr);
-}
-
 void MPIRInstance::readAt(std::string const& symName, char* buf, size_t len)
 {
     m_inferior.readToBuf(buf, symName, len);
 }
 
+std::string MPIRInstance::fetchStringAt(MPIRInstance::Address strAddress) {
+    auto result = std::string{};
+
+    char buf[MaxStringChunk];
+    while (true) {
+        // don't read across page boundary, next page may not be mapped
+        auto const len = std::min(MaxStringChunk, page_size() - (strAddress % page_size()));
+        m_inferior.readToBuf(buf, strAddress, len);
+
+        if (auto const end = static_cast<char const*>(::memchr(buf, '\0', len))) {
+            result.append(buf, end - buf);
+            return result;
+        }
+
+        result.append(buf, len);
+        strAddress += len;
+    }
+}
+
+size_t MPIRInstance::fetchStringsAt(std::vector<MPIRInstance::Address> strAddresses) {
+    /* deduplicate and drop addresses already in cache */
+    std::sort(strAddresses.begin(), strAddresses.end());
+    strAddresses.erase(std::unique(strAddresses.begin(), strAddresses.end()), strAddresses.end());
+    strAddresses.erase(std::remove_if(strAddresses.begin(), strAddresses.end(),
+        [this](Address addr) { return m_stringCache.count(addr) > 0; }), strAddresses.end());
+
+    /* launchers usually allocate proctable strings close together, so read
+       each run of addresses sharing a page with a single remote read */
+    auto buf = std::vector<char>(page_size());
+    auto numReads = size_t{0};
+    for (auto runBegin = strAddresses.begin(); runBegin != strAddresses.end(); ) {
+        auto const runBase = *runBegin;
+        auto const pageEnd = runBase - (runBase % page_size()) + page_size();
+
+        auto runEnd = std::find_if(runBegin, strAddresses.end(),
+            [pageEnd](Address addr) { return addr >= pageEnd; });
+        auto const len = std::min(pageEnd, *(runEnd - 1) + MaxStringChunk) - runBase;
+
+        m_inferior.readToBuf(buf.data(), runBase, len);
+        numReads++;
+
+        for (auto it = runBegin; it != runEnd; it++) {
+            auto const offset = *it - runBase;
+            auto const str = buf.data() + offset;
+            if (auto const end = static_cast<char const*>(::memchr(str, '\0', len - offset))) {
+                m_stringCache.emplace(*it, std::string{str, size_t(end - str)});
+            } else {
+                // string runs past the batched read, finish it separately
+                m_stringCache.emplace(*it, fetchStringAt(*it));
+                numReads++;
+            }
+        }
+
+        runBegin = runEnd;
+    }
+
+    log("fetched %zu strings in %zu reads\n", strAddresses.size(), numReads);
+
+    return strAddresses.size();
+}
+
 std::string MPIRInstance::readStringAt(MPIRInstance::Address strAddress) {
-    /* read string */
-    std::string result;
-    while (char c = m_inferior.readMemory<char>(strAddress++)) {
-        result.push_back(c);
+    auto const cached = m_stringCache.find(strAddress);
+    if (cached != m_stringCache.end()) {
+        return cached->second;
     }
 
+    /* read string */
+    auto result = fetchStringAt(strAddress);
+    m_stringCache.emplace(strAddress, result);
+
     return result;
 }
 
@@ -168,14 +243,8 @@ std::string MPIRInstance::readStringAt(std::string const& symName) {
 
 std::string MPIRInstance::readCharArrayAt(std::string const& symName)
 {
-    auto result = std::string{};
-
     auto arrayAddress = m_inferior.getAddress(symName);
-    while (char c = m_inferior.readMemory<char>(arrayAddress++)) {
-        result.push_back(c);
-    }
-
-    return result;
+    return fetchStringAt(arrayAddress);
 }
 
 MPIRProctable MPIRInstance::getProctable() {
@@ -186,11 +255,32 @@ MPIRProctable MPIRInstance::getProctable() {
         throw std::runtime_error("launcher MPIR_proctable_size is 0");
     }
 
+    /* read entire proctable array */
+    auto procDescs = std::vector<MPIR_ProcDescElem>(num_pids);
+    { auto const array_start = m_inferior.readVariable<Address>("MPIR_proctable");
+        m_inferior.readToBuf(reinterpret_cast<char*>(procDescs.data()), array_start,
+            num_pids * sizeof(MPIR_ProcDescElem));
+    }
+
+    /* launchers typically reuse string pointers for every rank on a node, so
+       only fetch the distinct hostname and executable strings */
+    auto const numLookups = 2 * size_t(num_pids);
+    auto numFetched = size_t{0};
+    { auto strAddresses = std::vector<Address>{};
+        strAddresses.reserve(2 * num_pids);
+        for (auto&& procDesc : procDescs) {
+            strAddresses.push_back(procDesc.host_name);
+            strAddresses.push_back(procDesc.executable_name);
+        }
+        numFetched = fetchStringsAt(std::move(strAddresses));
+    }
+
     MPIRProctable proctable;
+    proctable.reserve(num_pids);
 
     /* copy elements */
     for (int i = 0; i < num_pids; i++) {
-        auto procDesc = readArrayElem<MPIR_ProcDescElem>(m_inferior, "MPIR_proctable", i);
+        auto const& procDesc = procDescs[i];
 
         /* read hostname and executable */
         auto hostname = readStringAt(procDesc.host_name);
@@ -201,5 +291,9 @@ MPIRProctable MPIRInstance::getProctable() {
         proctable.emplace_back(MPIRProctableElem{procDesc.pid, std::move(hostname), std::move(executable)});
     }
 
+    log("string cache: %zu lookups, %zu hits, %zu misses (%.1f%% hit rate)\n",
+        numLookups, numLookups - numFetched, numFetched,
+        100.0 * (numLookups - numFetched) / numLookups);
+
     return proctable;
 }
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 
 #include "Inferior.hpp"
 #include "MPIRProctable.hpp"
@@ -34,8 +35,20 @@ private: // types
 private: // variables
     Inferior m_inferior;
 
+    // memoized c-strings keyed by inferior address. only valid while the
+    // inferior is stopped, cleared whenever it is continued
+    std::unordered_map<Address, std::string> m_stringCache;
+
 private: // helpers
     void setupMPIRStandard();
+    void continueRun();
+
+    // read c-string at address, bypassing cache
+    std::string fetchStringAt(Address strAddress);
+
+    // fill string cache for all uncached addresses, reading nearby strings together.
+    // returns number of strings fetched from inferior
+    size_t fetchStringsAt(std::vector<Address> strAddresses);
 
 public: // interface
 
@@ -59,7 +72,7 @@ public: // interface
     // read bytes starting at symbol
     void readAt(std::string const& symName, char* buf, size_t len);
 
-    // read c-string at address
+    // read c-string at address (cached until inferior continues)
     std::string readStringAt(Address strAddress);
 
     // read c-string pointed to by symbol
@@ -0,0 +1,90 @@
+/******************************************************************************\
+ * MPIRModule.cpp - loadable module entry points wrapping MPIRInstance
+ *
+ * Copyright 2024 Hewlett Packard Enterprise Development LP.
+ * SPDX-License-Identifier: Linux-OpenIB
+ ******************************************************************************/
+
+#include <memory>
+
+#include "MPIRInstance.hpp"
+#include "MPIRModule.hpp"
+
+namespace {
+
+// Instances are used from multiple daemon threads, so each call into the instance
+// is made holding the Dyninst lock. Blocking waits release it while waiting
+class ModuleInstance final : public MPIRHandle {
+    std::unique_ptr<MPIRInstance> m_instance;
+
+public:
+    template <typename... Args>
+    ModuleInstance(Args&&... args)
+    {
+        auto const lock = DyninstLock{};
+        m_instance = std::make_unique<MPIRInstance>(std::forward<Args>(args)...);
+    }
+
+    ~ModuleInstance() override
+    {
+        auto const lock = DyninstLock{};
+        m_instance.reset();
+    }
+
+    void runToMPIRBreakpoint() override
+    {
+        auto const lock = DyninstLock{};
+        m_instance->runToMPIRBreakpoint();
+    }
+
+    MPIRProctable getProctable() override
+    {
+        auto const lock = DyninstLock{};
+        return m_instance->getProctable();
+    }
+
+    pid_t getLauncherPid() override
+    {
+        auto const lock = DyninstLock{};
+        return m_instance->getLauncherPid();
+    }
+
+    void terminate() override
+    {
+        auto const lock = DyninstLock{};
+        m_instance->terminate();
+    }
+
+    int waitExit() override
+    {
+        auto const lock = DyninstLock{};
+        return m_instance->waitExit();
+    }
+
+    std::string readStringAt(std::string const& symName) override
+    {
+        auto const lock = DyninstLock{};
+        return m_instance->readStringAt(symName);
+    }
+};
+
+} // namespace
+
+extern "C" {
+
+MPIRHandle* cti_mpir_launch(std::string const& launcher,
+    std::vector<std::string> const& launcherArgv, std::vector<std::string> const& envVars,
+    std::map<int, int> const& remapFds)
+{
+    return std::make_unique<ModuleInstance>(launcher, launcherArgv, envVars, remapFds).release();
+}
+
+MPIRHandle* cti_mpir_attach(std::string const& attacher, pid_t pid)
+{
+    return std::make_unique<ModuleInstance>(attacher, pid).release();
+}
+
+} // extern "C"
+
+static_assert(std::is_same<decltype(cti_mpir_launch), MPIRModuleLaunchFn>::value);
+static_assert(std::is_same<decltype(cti_mpir_attach), MPIRModuleAttachFn>::value);
@@ -0,0 +1,44 @@
+/******************************************************************************\
+ * MPIRModule.hpp - MPIR support as a loadable module, so that Dyninst is only
+ *   loaded into a process once it launches or attaches to an MPIR launcher
+ *
+ * Copyright 2024 Hewlett Packard Enterprise Development LP.
+ * SPDX-License-Identifier: Linux-OpenIB
+ ******************************************************************************/
+#pragma once
+
+#include <sys/types.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "MPIRProctable.hpp"
+
+/* MPIR launcher instance created by the module */
+class MPIRHandle {
+public:
+    virtual ~MPIRHandle() = default;
+
+    /* MPIR standard functions */
+    virtual void runToMPIRBreakpoint() = 0;
+    virtual MPIRProctable getProctable() = 0;
+
+    /* inferior access functions */
+    virtual pid_t getLauncherPid() = 0;
+    virtual void terminate() = 0;
+    virtual int waitExit() = 0;
+
+    // read c-string pointed to by symbol
+    virtual std::string readStringAt(std::string const& symName) = 0;
+};
+
+/* module entry points, same arguments as MPIRInstance constructors. caller owns
+   the returned instance. throw on failure */
+using MPIRModuleLaunchFn = MPIRHandle*(std::string const& launcher,
+    std::vector<std::string> const& launcherArgv, std::vector<std::string> const& envVars,
+    std::map<int, int> const& remapFds);
+using MPIRModuleAttachFn = MPIRHandle*(std::string const& attacher, pid_t pid);
+
+#define CTI_MPIR_MODULE_LAUNCH "cti_mpir_launch"
+#define CTI_MPIR_MODULE_ATTACH "cti_mpir_attach"
@@ -152,6 +152,11 @@ Manifest::execManifest(const char * const daemon, const char * const daemonArgs[
         daemon, daemonArgs, envVars);
 }
 
+void
+Manifest::execManifest(std::vector<cti_toolDaemon_t> const& daemons) {
+    getOwningSession()->execManifest(shared_from_this(), daemons);
+}
+
 Manifest::Manifest(std::shared_ptr<Session> owningSession)
     : m_sessionPtr{owningSession}
     , m_instance{owningSession->nextManifestCount()}
@@ -10,6 +10,9 @@
 
 #include <string>
 #include <stdexcept>
+#include <vector>
+
+#include "common_tools_fe.h"
 
 // pointer management
 #include <memory>
@@ -83,6 +86,9 @@ public: // interface
     void execManifest(const char * const daemon, const char * const daemonArgs[],
         const char * const envVars[]);
 
+    // Ship a manifest and execute several tool daemons contained within.
+    void execManifest(std::vector<cti_toolDaemon_t> const& daemons);
+
     // Called by the session when it ships the manifest. This denotes that the manifest
     // is no longer modifyable
     void finalize() { m_isValid = false; }
@@ -49,10 +49,25 @@ std::shared_ptr<Session> Session::make_Session(std::shared_ptr<App> owningApp)
 }
 
 void Session::finalize() {
+    auto cleanupArgv = getCleanupArgv();
+    if (!cleanupArgv) {
+        return;
+    }
+    // call cleanup function with DaemonArgv
+    writeLog("launchCleanup: launching daemon for cleanup\n");
+    try {
+        getOwningApp()->startDaemon(cleanupArgv->get(), /* synchronous */ true);
+    } catch (std::exception const& ex) {
+        writeLog("launchCleanup: failed to launch daemon: %s\n", ex.what());
+        throw;
+    }
+}
+
+std::optional<cti::ManagedArgv> Session::getCleanupArgv() {
     // Check to see if we need to try cleanup on compute nodes. We bypass the
     // cleanup if we never shipped a manifest.
     if (m_seqNum == 0) {
-        return;
+        return std::nullopt;
     }
     // Get owning app
     auto app = getOwningApp();
@@ -71,20 +86,22 @@ void Session::finalize() {
     daemonArgv.add(DaemonArgv::Directory,           m_stageName);
     daemonArgv.add(DaemonArgv::InstSeqNum,          std::to_string(m_seqNum));
     daemonArgv.add(DaemonArgv::Clean);
+    if (auto clean_threads = ::getenv(CTI_CLEANUP_THREADS_ENV_VAR)) {
+        daemonArgv.add(DaemonArgv::CleanThreads,    clean_threads);
+    }
+    auto defer_cleanup = ::getenv(CTI_DEFER_CLEANUP_ENV_VAR);
+    if ((defer_cleanup != nullptr) && (strcmp(defer_cleanup, "0") != 0)) {
+        daemonArgv.add(DaemonArgv::DeferClean);
+    }
     if (fe.m_debug) { daemonArgv.add(DaemonArgv::Debug); };
     auto env_vars = fe.getDefaultEnvVars();
     for (auto i : env_vars) {
         daemonArgv.add(DaemonArgv::EnvVariable, i);
     }
-    // call cleanup function with DaemonArgv
-    // wlm_startDaemon adds the argv[0] automatically, so argv.get() + 1 for arguments.
-    writeLog("launchCleanup: launching daemon for cleanup\n");
-    try {
-        app->startDaemon(daemonArgv.get() + 1, /* synchronous */ true);
-    } catch (std::exception const& ex) {
-        writeLog("launchCleanup: failed to launch daemon: %s\n", ex.what());
-        throw;
-    }
+    // wlm_startDaemon adds the argv[0] automatically, so drop argv[0] from the arguments.
+    auto result = cti::ManagedArgv{};
+    result.add(daemonArgv.get() + 1);
+    return result;
 }
 
 std::weak_ptr<Manifest>
@@ -248,10 +265,25 @@ Session::sendManifest(std::shared_ptr<Manifest> const& mani) {
 void
 Session::execManifest(std::shared_ptr<Manifest> const& mani, const char * const daemon,
         const char * const daemonArgs[], const char * const envVars[]) {
+    execManifest(mani, { cti_toolDaemon_t{daemon, daemonArgs, envVars} });
+}
+
+void
+Session::execManifest(std::shared_ptr<Manifest> const& mani,
+        std::vector<cti_toolDaemon_t> const& daemons) {
     verifyOwnership(mani);
 
-    // Add daemon to the manifest
-    mani->addBinary(daemon);
+    if (daemons.empty()) {
+        throw std::runtime_error("no tool daemons provided");
+    }
+
+    // Add daemons to the manifest
+    for (auto&& daemon : daemons) {
+        if (daemon.fstr == nullptr) {
+            throw std::runtime_error("tool daemon binary is null");
+        }
+        mani->addBinary(daemon.fstr);
+    }
     // Get the owning app
     auto app = getOwningApp();
     // Get frontend reference
@@ -265,10 +297,8 @@ Session::execManifest(std::shared_ptr<Manifest> const& mani, const char * const
         // No need to ship an empty manifest.
         removeManifest(mani);
     }
-    // get real name of daemon binary
-    const std::string binaryName(cti::cstr::basename(cti::findPath(daemon)));
     // create DaemonArgv
-    writeLog("execManifest: creating daemonArgv for %s\n", daemon);
+    writeLog("execManifest: creating daemonArgv for %s and %zu more\n", daemons[0].fstr, daemons.size() - 1);
     cti::OutgoingArgv<DaemonArgv> daemonArgv(CTI_BE_DAEMON_BINARY);
     daemonArgv.add(DaemonArgv::ApID,                app->getJobId());
     daemonArgv.add(DaemonArgv::ToolPath,            app->getToolPath());
@@ -283,7 +313,23 @@ Session::execManifest(std::shared_ptr<Manifest> const& mani, const char * const
     if (!archiveName.empty()) {
         daemonArgv.add(DaemonArgv::ManifestName,    archiveName);
     }
-    daemonArgv.add(DaemonArgv::Binary,              binaryName);
+    // One daemon launch starts every binary, after a single extraction and
+    // dependency lock wait on each node
+    for (size_t i = 0; i < daemons.size(); i++) {
+        // get real name of daemon binary
+        daemonArgv.add(DaemonArgv::Binary, cti::cstr::basename(cti::findPath(daemons[i].fstr)));
+
+        // arguments of all but the last binary are counted to split them
+        if ((i + 1) < daemons.size()) {
+            auto binaryArgc = size_t{0};
+            if (daemons[i].args != nullptr) {
+                for (auto arg = daemons[i].args; *arg != nullptr; arg++) {
+                    binaryArgc++;
+                }
+            }
+            daemonArgv.add(DaemonArgv::BinaryArgc, std::to_string(binaryArgc));
+        }
+    }
     daemonArgv.add(DaemonArgv::Directory,           m_stageName);
     daemonArgv.add(DaemonArgv::InstSeqNum,          std::to_string(m_seqNum));
     if (fe.m_debug) { daemonArgv.add(DaemonArgv::Debug); };
@@ -292,20 +338,31 @@ Session::execManifest(std::shared_ptr<Manifest> const& mani, const char * const
         daemonArgv.add(DaemonArgv::EnvVariable, i);
     }
 
-    // add env vars
-    if (envVars != nullptr) {
-        cti::enforceValidEnvStrings(envVars);
-        for (const char* const* var = envVars; *var != nullptr; var++) {
-            daemonArgv.add(DaemonArgv::EnvVariable, *var);
+    // add env vars. A single tool daemon's environment is set for the BE daemon,
+    // otherwise it is only set for its own binary
+    for (size_t i = 0; i < daemons.size(); i++) {
+        if (daemons[i].env != nullptr) {
+            cti::enforceValidEnvStrings(daemons[i].env);
+            for (const char* const* var = daemons[i].env; *var != nullptr; var++) {
+                if (daemons.size() == 1) {
+                    daemonArgv.add(DaemonArgv::EnvVariable, *var);
+                } else {
+                    daemonArgv.add(DaemonArgv::BinaryEnv, std::to_string(i) + ":" + *var);
+                }
+            }
         }
     }
 
     // add daemon arguments
     cti::ManagedArgv rawArgVec(daemonArgv.eject());
-    if (daemonArgs != nullptr) {
-        rawArgVec.add("--");
-        for (const char* const* var = daemonArgs; *var != nullptr; var++) {
-            rawArgVec.add(*var);
+    auto argsStarted = false;
+    for (auto&& daemon : daemons) {
+        if (daemon.args != nullptr) {
+            if (!argsStarted) {
+                rawArgVec.add("--");
+                argsStarted = true;
+            }
+            rawArgVec.add(daemon.args);
         }
     }
     // call launch function with DaemonArgv
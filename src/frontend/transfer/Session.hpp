@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -17,6 +18,7 @@
 #include <memory>
 
 #include "frontend/Frontend.hpp"
+#include "useful/cti_argv.hpp"
 
 #include "Manifest.hpp"
 
@@ -69,6 +71,11 @@ private: // friend shared with Manifest
     friend void Manifest::execManifest(const char * const daemon, const char * const daemonArgs[],
         const char * const envVars[]);
 
+    // Used to ship a manifest and execute several tool daemons contained within in
+    // a single launch.
+    void execManifest(std::shared_ptr<Manifest> const& mani, std::vector<cti_toolDaemon_t> const& daemons);
+    friend void Manifest::execManifest(std::vector<cti_toolDaemon_t> const& daemons);
+
 public: // interface
     std::shared_ptr<App> getOwningApp() {
         if (auto app = m_AppPtr.lock()) { return app; }
@@ -95,6 +102,9 @@ public: // interface
 
     // launch daemon to cleanup remote files. this must be called outside App destructor
     void finalize();
+    // daemon arguments to cleanup remote files, not including argv[0]. empty if no
+    // manifest was shipped and there is nothing to clean up
+    std::optional<cti::ManagedArgv> getCleanupArgv();
 
 private:
     // shared_from_this is used in implementation, must enforce that Session is shared_ptr-only
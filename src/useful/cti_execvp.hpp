@@ -1,5 +1,5 @@
 /*********************************************************************************\
- * cti_execvp.hpp - fork / execvp a program and read its output as an istream
+ * cti_execvp.hpp - spawn / execvp a program and read its output as an istream
  *
  * Copyright 2014-2020 Hewlett Packard Enterprise Development LP.
  * SPDX-License-Identifier: Linux-OpenIB
@@ -13,9 +13,20 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <string.h>
+#include <signal.h>
+#include <spawn.h>
+#include <dirent.h>
+#include <stdlib.h>
 
+#include <algorithm>
 #include <sstream>
 #include <streambuf>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace cti {
 
@@ -164,7 +175,202 @@ struct Pipe : public FdPair
     }
 };
 
-/* Execvp - fork / execvp a program and read its output as an istream */
+/* buildEnv - build the complete environment for a child process in a single pass.
+   Variables in base (such as environ) are kept in order unless blacklisted or replaced
+   by an entry of the same name in overrides, remaining overrides are appended. Later
+   overrides replace earlier ones. An override with an empty value unsets the variable
+   if emptyValue is Unset, otherwise sets it to the empty string. Throws if an override
+   is not of the form VAR=VAL. Overrides and blacklist may hold strings or string views */
+enum class EmptyEnvValue { Unset, Keep };
+template <typename Overrides = std::vector<std::string>, typename Blacklist = std::vector<std::string>>
+static inline std::vector<std::string> buildEnv(char const* const* base,
+    Overrides const& overrides, Blacklist const& blacklist, EmptyEnvValue emptyValue)
+{
+    // Map override names to their final VAR=VAL entry
+    auto overrideMap = std::unordered_map<std::string_view, std::string_view>{};
+    overrideMap.reserve(overrides.size());
+    for (auto&& envVarVal : overrides) {
+        auto const equalsAt = envVarVal.find('=');
+        if (equalsAt == std::string::npos) {
+            throw std::runtime_error("failed to parse env var: " + std::string{envVarVal});
+        }
+        overrideMap.insert_or_assign(std::string_view{envVarVal}.substr(0, equalsAt), envVarVal);
+    }
+
+    // Names already written or excluded from result
+    auto done = std::unordered_set<std::string_view>{blacklist.begin(), blacklist.end()};
+
+    auto result = std::vector<std::string>{};
+    auto emitOverride = [&result, emptyValue](std::string_view envVarVal, size_t equalsAt) {
+        if ((emptyValue == EmptyEnvValue::Keep) || (equalsAt + 1 < envVarVal.length())) {
+            result.emplace_back(envVarVal);
+        }
+    };
+
+    for (auto envVarVal = base; (base != nullptr) && (*envVarVal != nullptr); envVarVal++) {
+        auto const var = std::string_view{*envVarVal};
+        auto const equalsAt = var.find('=');
+        if (equalsAt == std::string_view::npos) {
+            continue;
+        }
+
+        auto const name = var.substr(0, equalsAt);
+        if (!done.insert(name).second) {
+            continue;
+        }
+
+        auto const nameOverridePair = overrideMap.find(name);
+        if (nameOverridePair != overrideMap.end()) {
+            emitOverride(nameOverridePair->second, equalsAt);
+        } else {
+            result.emplace_back(var);
+        }
+    }
+
+    for (auto&& envVarVal : overrides) {
+        auto const equalsAt = envVarVal.find('=');
+        auto const name = std::string_view{envVarVal}.substr(0, equalsAt);
+
+        // Only the final entry for each name is used
+        if ((overrideMap[name].data() == envVarVal.data()) && done.insert(name).second) {
+            emitOverride(envVarVal, equalsAt);
+        }
+    }
+
+    return result;
+}
+
+/* SpawnActions - launch a program with posix_spawn. The child shares the parent's
+   address space until exec, so launch latency does not grow with the size of the
+   parent process as it does with fork. File descriptor remapping is recorded as
+   spawn file actions, and the child starts with an empty signal mask */
+class SpawnActions {
+    posix_spawn_file_actions_t m_fileActions;
+    posix_spawnattr_t m_attr;
+    short m_flags = POSIX_SPAWN_SETSIGMASK;
+
+public:
+    SpawnActions()
+    {
+        if (::posix_spawn_file_actions_init(&m_fileActions)) {
+            throw std::runtime_error("posix_spawn_file_actions_init failed");
+        }
+        if (::posix_spawnattr_init(&m_attr)) {
+            ::posix_spawn_file_actions_destroy(&m_fileActions);
+            throw std::runtime_error("posix_spawnattr_init failed");
+        }
+
+        // Don't inherit signals blocked by the launching thread
+        sigset_t empty_set;
+        sigemptyset(&empty_set);
+        ::posix_spawnattr_setsigmask(&m_attr, &empty_set);
+        ::posix_spawnattr_setflags(&m_attr, m_flags);
+    }
+
+    ~SpawnActions()
+    {
+        ::posix_spawnattr_destroy(&m_attr);
+        ::posix_spawn_file_actions_destroy(&m_fileActions);
+    }
+
+    SpawnActions(SpawnActions const&) = delete;
+    SpawnActions& operator=(SpawnActions const&) = delete;
+
+    // Duplicate fd onto targetFd in child, or open /dev/null if fd is negative
+    SpawnActions& dup2(int fd, int targetFd)
+    {
+        auto const rc = (fd >= 0)
+            ? ::posix_spawn_file_actions_adddup2(&m_fileActions, fd, targetFd)
+            : ::posix_spawn_file_actions_addopen(&m_fileActions, targetFd, "/dev/null",
+                (targetFd == STDIN_FILENO) ? O_RDONLY : O_WRONLY, 0);
+        if (rc) {
+            throw std::runtime_error("failed to add spawn file action: " + std::string{strerror(rc)});
+        }
+
+        return *this;
+    }
+
+    // Close fd in child
+    SpawnActions& close(int fd)
+    {
+        if (auto const rc = ::posix_spawn_file_actions_addclose(&m_fileActions, fd)) {
+            throw std::runtime_error("failed to add spawn file action: " + std::string{strerror(rc)});
+        }
+
+        return *this;
+    }
+
+    // Place child in process group pgroup, or its own process group if 0
+    SpawnActions& setpgroup(pid_t pgroup)
+    {
+        if (auto const rc = ::posix_spawnattr_setpgroup(&m_attr, pgroup)) {
+            throw std::runtime_error("failed to set spawn process group: " + std::string{strerror(rc)});
+        }
+        m_flags |= POSIX_SPAWN_SETPGROUP;
+        ::posix_spawnattr_setflags(&m_attr, m_flags);
+
+        return *this;
+    }
+
+    // Close all file descriptors above stderr in child, except for those in keepFds.
+    // Must be added after any remapping
+    SpawnActions& closeInherited(std::vector<int> const& keepFds = {})
+    {
+        auto const kept = [&keepFds](int fd) {
+            return std::find(keepFds.begin(), keepFds.end(), fd) != keepFds.end();
+        };
+
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 34)
+        // Close individually up to the highest kept descriptor, then the rest of the range at once
+        auto const maxKeptFd = keepFds.empty()
+            ? STDERR_FILENO
+            : std::max(STDERR_FILENO, *std::max_element(keepFds.begin(), keepFds.end()));
+        for (int fd = STDERR_FILENO + 1; fd < maxKeptFd; fd++) {
+            if (!kept(fd) && (::fcntl(fd, F_GETFD) >= 0)) {
+                close(fd);
+            }
+        }
+        if (auto const rc = ::posix_spawn_file_actions_addclosefrom_np(&m_fileActions, maxKeptFd + 1)) {
+            throw std::runtime_error("failed to add spawn file action: " + std::string{strerror(rc)});
+        }
+#else
+        // Close each currently open descriptor instead of the entire descriptor range
+        if (auto fdDir = ::opendir("/proc/self/fd")) {
+            while (auto entry = ::readdir(fdDir)) {
+                auto const fd = ::atoi(entry->d_name);
+                if ((fd > STDERR_FILENO) && (fd != ::dirfd(fdDir)) && !kept(fd)) {
+                    close(fd);
+                }
+            }
+            ::closedir(fdDir);
+        } else {
+            auto const open_fdlimit = (int)::sysconf(_SC_OPEN_MAX);
+            for (int fd = STDERR_FILENO + 1; fd < open_fdlimit; fd++) {
+                if (!kept(fd)) {
+                    close(fd);
+                }
+            }
+        }
+#endif
+
+        return *this;
+    }
+
+    // Search PATH for file and launch with provided environment.
+    // Return child PID, or -1 with errno set if child could not be launched
+    pid_t spawnvp(char const* file, char* const argv[], char* const envp[] = environ)
+    {
+        auto pid = pid_t{-1};
+        if (auto const rc = ::posix_spawnp(&pid, file, &m_fileActions, &m_attr, argv, envp)) {
+            errno = rc;
+            return -1;
+        }
+
+        return pid;
+    }
+};
+
+/* Execvp - spawn / execvp a program and read its output as an istream */
 // Right now the only constructor is to read output as an istream, but this could
 // be extended in the future to accept different types of constructors.
 class Execvp {
@@ -184,28 +390,21 @@ public:
     Execvp(const char *binaryName, char* const* argv, stderr stderr_behavior)
         : pipeInBuf(p.getReadFd())
         , pipein(&pipeInBuf)
-        , child(fork())
+        , child(-1)
     {
-        if (child < 0) {
-            throw std::runtime_error(std::string("fork() for ") + binaryName + " failed!");
-        } else if (child == 0) { // child side of fork
+        { auto spawnActions = SpawnActions{};
+
             /* prepare the output pipe */
-            p.closeRead();
-            dup2(p.getWriteFd(), Pipe::stdout);
-            auto const stderr_fd = (stderr_behavior == stderr::Ignore)
-                ? open("/dev/null", O_WRONLY)
-                : p.getWriteFd();
-            dup2(stderr_fd, Pipe::stderr);
-            p.closeWrite();
-
-           // Close inherited file descriptors
-            auto open_fdlimit = (int)sysconf(_SC_OPEN_MAX);
-            for (int i = Pipe::stderr + 1; i < open_fdlimit; i++) {
-                close(i);
-            }
+            spawnActions.dup2(p.getWriteFd(), Pipe::stdout);
+            spawnActions.dup2((stderr_behavior == stderr::Ignore) ? -1 : p.getWriteFd(), Pipe::stderr);
+
+            // Close inherited file descriptors, including both pipe ends
+            spawnActions.closeInherited();
 
-            execvp(binaryName, argv);
-            _exit(-1);
+            child = spawnActions.spawnvp(binaryName, argv);
+            if ((child < 0) && spawnFailed(errno)) {
+                throw std::runtime_error(std::string("posix_spawn() for ") + binaryName + " failed!");
+            }
         }
 
         /* create istream from output pipe */
@@ -213,6 +412,11 @@ public:
     }
 
     int getExitStatus() {
+        // Program could not be executed
+        if (child < 0) {
+            return ExecFailedStatus;
+        }
+
         int status = 0;
         while (true) {
             auto const rc = ::waitpid(child, &status, 0);
@@ -230,18 +434,30 @@ public:
 
     std::istream& stream() { return pipein; }
 
+private:
+    // Exit status reported when the program could not be executed, matching
+    // the status of a forked child that failed to exec
+    static constexpr auto ExecFailedStatus = int{255};
+
+    // Distinguish failure to create a child process from failure to exec the program
+    static bool spawnFailed(int err) {
+        return (err == EAGAIN) || (err == ENOMEM);
+    }
+
+public:
+
     static int runExitStatus(const char *binaryName, char* const* argv) {
-        auto const child = fork();
+        auto spawnActions = SpawnActions{};
+        spawnActions.dup2(-1, STDIN_FILENO);
+        spawnActions.dup2(-1, STDOUT_FILENO);
+        spawnActions.dup2(-1, STDERR_FILENO);
 
+        auto const child = spawnActions.spawnvp(binaryName, argv);
         if (child < 0) {
-            throw std::runtime_error(std::string("fork() for ") + binaryName + " failed!");
-        } else if (child == 0) { // child side of fork
-            dup2(open("/dev/null", O_RDONLY), STDIN_FILENO);
-            dup2(open("/dev/null", O_WRONLY), STDOUT_FILENO);
-            dup2(open("/dev/null", O_WRONLY), STDERR_FILENO);
-
-            execvp(binaryName, argv);
-            _exit(-1);
+            if (spawnFailed(errno)) {
+                throw std::runtime_error(std::string("posix_spawn() for ") + binaryName + " failed!");
+            }
+            return ExecFailedStatus;
         }
 
         int status = 0;
@@ -0,0 +1,181 @@
+/*********************************************************************************\
+ * cti_file_check.hpp - check which files are present and identical on backend nodes
+ *
+ * Copyright 2024 Hewlett Packard Enterprise Development LP.
+ * SPDX-License-Identifier: Linux-OpenIB
+ ******************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace cti {
+
+/* FileCheck - the list of paths to check is written to a file that is shipped to
+   each backend daemon. Every record is "<size> <mtime> <path>\0", with -1 in place
+   of attributes that are not checked. Each daemon responds with one line holding a
+   hex bitmap, where bit i of byte i / 8 is set if path i is present with matching
+   attributes. Responses are combined with AND, so paths present on every node are
+   found in time proportional to the number of paths. Where a file can't be shipped
+   ahead of the check, the list is passed as arguments instead, with records ending
+   in newlines */
+class FileCheck {
+public:
+    enum class Verify {
+        None,      // path exists
+        Size,      // path exists with same size
+        SizeMtime  // path exists with same size and modification time
+    };
+
+private:
+    std::vector<std::string> m_paths;
+    std::vector<uint8_t> m_present; // AND of all responses received
+    size_t m_numResponses;
+
+    static int hexValue(char c)
+    {
+        if ((c >= '0') && (c <= '9')) { return c - '0'; }
+        if ((c >= 'a') && (c <= 'f')) { return c - 'a' + 10; }
+        if ((c >= 'A') && (c <= 'F')) { return c - 'A' + 10; }
+        return -1;
+    }
+
+public:
+    FileCheck(std::set<std::string> const& paths)
+        : m_paths{paths.begin(), paths.end()}
+        , m_present((m_paths.size() + 7) / 8, 0xff)
+        , m_numResponses{0}
+    {}
+
+    // Parse verification setting, defaulting to size and modification time
+    static Verify parseVerify(char const* setting)
+    {
+        if (setting == nullptr) {
+            return Verify::SizeMtime;
+        } else if (strcmp(setting, "none") == 0) {
+            return Verify::None;
+        } else if (strcmp(setting, "size") == 0) {
+            return Verify::Size;
+        } else if (strcmp(setting, "mtime") == 0) {
+            return Verify::SizeMtime;
+        }
+        throw std::runtime_error("invalid file verification setting: " + std::string{setting});
+    }
+
+    size_t size() const { return m_paths.size(); }
+
+    // Write each record with attributes of the local files, ending in separator
+    void writeRecords(std::ostream& out, Verify verify, char separator) const
+    {
+        for (auto&& path : m_paths) {
+            auto size = (long long)-1;
+            auto mtime = (long long)-1;
+
+            // Paths that can't be read locally only need to exist
+            struct stat st;
+            if ((verify != Verify::None) && (::stat(path.c_str(), &st) == 0)) {
+                size = st.st_size;
+                if (verify == Verify::SizeMtime) {
+                    mtime = st.st_mtime;
+                }
+            }
+
+            // Paths containing the separator are left empty, so they are never present
+            if (path.find(separator) != std::string::npos) {
+                out << size << ' ' << mtime << ' ' << separator;
+            } else {
+                out << size << ' ' << mtime << ' ' << path << separator;
+            }
+        }
+    }
+
+    // Write path list with attributes of the local files
+    void writeList(std::string const& listPath, Verify verify) const
+    {
+        auto listFile = std::ofstream{listPath, std::ios::binary};
+        writeRecords(listFile, verify, '\0');
+
+        if (!listFile.good()) {
+            throw std::runtime_error("failed to write file list to " + listPath);
+        }
+    }
+
+    // Path list with attributes of the local files, to be passed as arguments. The list
+    // is split between records into pieces of at most maxLength bytes
+    std::vector<std::string> listData(Verify verify, size_t maxLength) const
+    {
+        auto listData = std::stringstream{};
+        writeRecords(listData, verify, '\n');
+        auto const data = listData.str();
+
+        auto result = std::vector<std::string>{};
+        for (size_t begin = 0; begin < data.length(); ) {
+            auto end = data.length();
+            if ((end - begin) > maxLength) {
+                // End piece after the last record that fits
+                auto const lastNewline = data.rfind('\n', begin + maxLength - 1);
+                if ((lastNewline == std::string::npos) || (lastNewline < begin)) {
+                    throw std::runtime_error("file list record longer than " + std::to_string(maxLength) + " bytes");
+                }
+                end = lastNewline + 1;
+            }
+            result.emplace_back(data.substr(begin, end - begin));
+            begin = end;
+        }
+
+        return result;
+    }
+
+    // Combine a response line from a backend daemon. Return false if the line is not
+    // a response, such as a launcher warning
+    bool addResponse(std::string const& line)
+    {
+        if (line.length() != (m_present.size() * 2)) {
+            return false;
+        }
+
+        auto bitmap = std::vector<uint8_t>(m_present.size());
+        for (size_t i = 0; i < bitmap.size(); i++) {
+            auto const hi = hexValue(line[2 * i]);
+            auto const lo = hexValue(line[2 * i + 1]);
+            if ((hi < 0) || (lo < 0)) {
+                return false;
+            }
+            bitmap[i] = (hi << 4) | lo;
+        }
+
+        for (size_t i = 0; i < bitmap.size(); i++) {
+            m_present[i] &= bitmap[i];
+        }
+        m_numResponses++;
+
+        return true;
+    }
+
+    size_t numResponses() const { return m_numResponses; }
+
+    // Paths present on every node that responded
+    std::set<std::string> result() const
+    {
+        auto result = std::set<std::string>{};
+        if (m_numResponses == 0) {
+            return result;
+        }
+        for (size_t i = 0; i < m_paths.size(); i++) {
+            if (m_present[i / 8] & (1 << (i % 8))) {
+                result.insert(m_paths[i]);
+            }
+        }
+        return result;
+    }
+};
+
+} /* namespace cti */
@@ -0,0 +1,210 @@
+/*********************************************************************************\
+ * cti_metrics.hpp - per-request-type counters, latency histograms and in-flight gauges
+ *
+ * Copyright 2024 Hewlett Packard Enterprise Development LP.
+ * SPDX-License-Identifier: Linux-OpenIB
+ ******************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace cti {
+
+/* RequestMetrics - track requests by ID from begin to end, and aggregate counts and
+   latencies under a name per request kind. Latencies are kept in a log-scale histogram
+   with eight buckets per power of two nanoseconds, so percentiles are reported
+   within 12.5% in constant space */
+class RequestMetrics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Latency summary for one request kind
+    struct Summary {
+        uint64_t count;
+        uint64_t inFlight;
+        uint64_t maxInFlight;
+        double totalMs;
+        double minMs;
+        double p50Ms;
+        double p95Ms;
+        double p99Ms;
+        double maxMs;
+    };
+
+private:
+    static constexpr auto SubBuckets = 8;
+    static constexpr auto SubBucketBits = 3;
+    static constexpr auto NumBuckets = 64 * SubBuckets;
+
+    struct Histogram {
+        uint64_t count = 0;
+        uint64_t inFlight = 0;
+        uint64_t maxInFlight = 0;
+        uint64_t totalNs = 0;
+        uint64_t minNs = UINT64_MAX;
+        uint64_t maxNs = 0;
+        std::array<uint32_t, NumBuckets> buckets = {};
+    };
+
+    struct Pending {
+        std::string name;
+        Clock::time_point start;
+    };
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Histogram> m_histograms;
+    std::unordered_map<uint64_t, Pending> m_pending;
+
+    // Values below SubBuckets map directly, larger values by most significant
+    // bit followed by the next SubBucketBits bits
+    static size_t bucketIndex(uint64_t ns)
+    {
+        if (ns < SubBuckets) {
+            return ns;
+        }
+        auto const msb = 63 - __builtin_clzll(ns);
+        auto const sub = (ns >> (msb - SubBucketBits)) & (SubBuckets - 1);
+        return (msb - SubBucketBits + 1) * SubBuckets + sub;
+    }
+
+    // Largest value that maps to bucket
+    static uint64_t bucketUpperBound(size_t index)
+    {
+        if (index < SubBuckets) {
+            return index;
+        }
+        auto const shift = index / SubBuckets - 1;
+        auto const sub = index % SubBuckets;
+        return ((uint64_t{SubBuckets + sub + 1} << shift) - 1);
+    }
+
+    static double percentileMs(Histogram const& hist, double fraction)
+    {
+        auto const target = std::max(uint64_t{1}, uint64_t(fraction * hist.count + 0.5));
+        auto seen = uint64_t{0};
+        for (size_t i = 0; i < NumBuckets; i++) {
+            seen += hist.buckets[i];
+            if (seen >= target) {
+                return std::min(bucketUpperBound(i), hist.maxNs) / 1e6;
+            }
+        }
+        return hist.maxNs / 1e6;
+    }
+
+    static void appendJsonString(std::string& json, std::string const& str)
+    {
+        json.push_back('"');
+        for (auto&& c : str) {
+            if ((c == '"') || (c == '\\')) {
+                json.push_back('\\');
+                json.push_back(c);
+            } else if ((unsigned char)c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                json.append(buf);
+            } else {
+                json.push_back(c);
+            }
+        }
+        json.push_back('"');
+    }
+
+public:
+    // Start timing request under name
+    void begin(uint64_t id, std::string name)
+    {
+        auto const lock = std::lock_guard<std::mutex>{m_mutex};
+
+        auto& hist = m_histograms[name];
+        hist.inFlight++;
+        hist.maxInFlight = std::max(hist.maxInFlight, hist.inFlight);
+
+        m_pending[id] = Pending{std::move(name), Clock::now()};
+    }
+
+    // Finish timing request, ignoring IDs that were not started
+    void end(uint64_t id)
+    {
+        auto const now = Clock::now();
+        auto const lock = std::lock_guard<std::mutex>{m_mutex};
+
+        auto const idPendingPair = m_pending.find(id);
+        if (idPendingPair == m_pending.end()) {
+            return;
+        }
+
+        auto const ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now - idPendingPair->second.start).count());
+
+        auto& hist = m_histograms[idPendingPair->second.name];
+        hist.inFlight--;
+        hist.count++;
+        hist.totalNs += ns;
+        hist.minNs = std::min(hist.minNs, ns);
+        hist.maxNs = std::max(hist.maxNs, ns);
+        hist.buckets[bucketIndex(ns)]++;
+
+        m_pending.erase(idPendingPair);
+    }
+
+    std::map<std::string, Summary> summarize() const
+    {
+        auto const lock = std::lock_guard<std::mutex>{m_mutex};
+
+        auto result = std::map<std::string, Summary>{};
+        for (auto&& [name, hist] : m_histograms) {
+            auto const completed = (hist.count > 0);
+            result[name] = Summary
+                { .count = hist.count
+                , .inFlight = hist.inFlight
+                , .maxInFlight = hist.maxInFlight
+                , .totalMs = hist.totalNs / 1e6
+                , .minMs = completed ? (hist.minNs / 1e6) : 0.0
+                , .p50Ms = completed ? percentileMs(hist, 0.50) : 0.0
+                , .p95Ms = completed ? percentileMs(hist, 0.95) : 0.0
+                , .p99Ms = completed ? percentileMs(hist, 0.99) : 0.0
+                , .maxMs = hist.maxNs / 1e6
+            };
+        }
+
+        return result;
+    }
+
+    // JSON object keyed by request name
+    std::string toJson() const
+    {
+        auto json = std::string{"{"};
+        auto first = true;
+        for (auto&& [name, summary] : summarize()) {
+            if (!first) {
+                json.push_back(',');
+            }
+            first = false;
+
+            appendJsonString(json, name);
+
+            char buf[512];
+            snprintf(buf, sizeof(buf), ":{\"count\":%lu,\"in_flight\":%lu,\"max_in_flight\":%lu,"
+                "\"total_ms\":%.3f,\"min_ms\":%.3f,\"p50_ms\":%.3f,\"p95_ms\":%.3f,\"p99_ms\":%.3f,"
+                "\"max_ms\":%.3f}",
+                summary.count, summary.inFlight, summary.maxInFlight,
+                summary.totalMs, summary.minMs, summary.p50Ms, summary.p95Ms, summary.p99Ms,
+                summary.maxMs);
+            json.append(buf);
+        }
+        json.push_back('}');
+
+        return json;
+    }
+};
+
+} /* namespace cti */
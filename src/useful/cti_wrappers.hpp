@@ -20,6 +20,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/syscall.h>
 #include <pwd.h>
 
 #include <dirent.h>
@@ -65,6 +66,17 @@ inline static auto getenvOrDefault(char const* env_var, char const* default_valu
     return default_value;
 };
 
+// Pollable file descriptor that becomes readable when pid exits, -1 if not supported
+static inline int pidfdOpen(pid_t const pid)
+{
+#ifdef SYS_pidfd_open
+    return ::syscall(SYS_pidfd_open, pid, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
 /* cstring wrappers */
 namespace cstr {
     // lifted asprintf
@@ -89,6 +89,10 @@ MockApp::MockApp(MockFrontend& fe, pid_t launcherPid, MockFrontend::LaunchBarrie
             m_atBarrier = false;
         })));
 
+    // describe behavior of mock isRunning
+    ON_CALL(*this, isRunning())
+        .WillByDefault(Return(true));
+
     // describe behavior of mock getToolPath
     ON_CALL(*this, getToolPath())
         .WillByDefault(Return("/mock/"));
@@ -64,7 +64,7 @@ public: // inherited interface
 
     MOCK_CONST_METHOD0(getExtraFiles, std::vector<std::string>(void));
 
-    bool isRunning() const { return true; }
+    MOCK_CONST_METHOD0(isRunning, bool(void));
     MOCK_CONST_METHOD0(getNumPEs,   size_t(void));
     MOCK_CONST_METHOD0(getNumHosts, size_t(void));
     MOCK_CONST_METHOD0(getHostnameList,   std::vector<std::string>(void));
@@ -10,8 +10,17 @@
 
 #include <unordered_set>
 #include <fstream>
+#include <iterator>
 #include <algorithm>
 #include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "useful/cti_path.h"
+#include "useful/cti_wrappers.hpp"
 
 #include "cti_be_unit_test.hpp"
 #include "common_tools_version.h"
@@ -123,3 +132,246 @@ TEST_F(CTIBeUnitTest, cti_be_getFileDirNone)
 {
     ASSERT_EQ(cti_be_getTmpDir(), nullptr);
 }*/
+
+/******************************************
+*          BE DAEMON AGENT TESTS          *
+******************************************/
+
+TEST_F(CTIBeUnitTest, cti_be_daemon_agentTree)
+{
+    // Local stand-in for a cluster: each host is a directory, and the remote shell
+    // runs the command in that host's directory with the tool path moved into it
+    ASSERT_EQ(access(BE_DAEMON_PATH, X_OK), 0) << BE_DAEMON_PATH;
+    auto const base = cti::cstr::mkdtemp("/tmp/cti-agent-XXXXXX");
+    auto const numHosts = 7;
+    for (int i = 0; i < numHosts; i++) {
+        ASSERT_EQ(mkdir((base + "/n" + std::to_string(i)).c_str(), S_IRWXU), 0);
+    }
+
+    // Daemon sets permissions on its own binary, so run a copy
+    auto const daemonPath = base + "/" + CTI_BE_DAEMON_BINARY;
+    { auto daemon = std::ofstream{daemonPath, std::ios::binary};
+        daemon << std::ifstream{BE_DAEMON_PATH, std::ios::binary}.rdbuf();
+    }
+    ASSERT_EQ(chmod(daemonPath.c_str(), S_IRWXU), 0);
+
+    auto const rshPath = base + "/rsh";
+    { auto rsh = std::ofstream{rshPath};
+        rsh << "#!/bin/sh\n"
+            << "host=$1; shift\n"
+            << "cd " << base << "/$host || exit 1\n"
+            << "cmd=$1; shift\n"
+            << "for arg; do\n"
+            << "  case \"$arg\" in --path=*) set -- \"$@\" \"--path=$PWD\";; *) set -- \"$@\" \"$arg\";; esac\n"
+            << "  shift\n"
+            << "done\n"
+            << "exec \"$cmd\" \"$@\"\n";
+    }
+    ASSERT_EQ(chmod(rshPath.c_str(), S_IRWXU), 0);
+
+    // Every host but n4 has a file list, so that one daemon in the tree fails
+    for (int i = 0; i < numHosts; i++) {
+        if (i != 4) {
+            std::ofstream{base + "/n" + std::to_string(i) + "/list"} << "-1 -1 /" << '\0';
+        }
+    }
+
+    // Root agent on n0 starts child agents on the rest of the hosts, two per agent.
+    // Host nx does not exist, so the child agent started for it exits
+    int toAgent[2], fromAgent[2];
+    ASSERT_EQ(pipe(toAgent), 0);
+    ASSERT_EQ(pipe(fromAgent), 0);
+    auto const agentPid = fork();
+    ASSERT_GE(agentPid, 0);
+    if (agentPid == 0) {
+        dup2(toAgent[0], STDIN_FILENO);
+        dup2(fromAgent[1], STDOUT_FILENO);
+        close(toAgent[1]);
+        close(fromAgent[0]);
+        setenv(BE_AGENT_RSH_VAR, rshPath.c_str(), 1);
+        if (chdir((base + "/n0").c_str()) < 0) {
+            _exit(1);
+        }
+        auto const pathArg = "--path=" + base + "/n0";
+        execl(daemonPath.c_str(), daemonPath.c_str(), "--agent", "--apid=1", pathArg.c_str(),
+            "--fanout=2", "--tree=n1,n2,n3,n4,n5,n6,nx", nullptr);
+        _exit(1);
+    }
+    close(toAgent[0]);
+    close(fromAgent[1]);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Run daemon with args on every node, or send fileData to every node if provided.
+    // Return response and the tree indices of missed nodes
+    auto runDaemon = [&](std::vector<std::string> const& args, std::string const& fileData = "") {
+        auto argsData = std::string{};
+        for (auto&& arg : args) {
+            argsData.append(arg.c_str(), arg.length() + 1);
+        }
+        auto const req = cti_beAgentRequest_t
+            { .synchronous = 1
+            , .argc = uint32_t(args.size())
+            , .argsLength = uint32_t(argsData.length())
+            , .sendFile = !fileData.empty()
+            , .fileLength = fileData.length()
+        };
+        auto resp = cti_beAgentResponse_t{-1, 0, 0};
+        auto missed = std::vector<uint32_t>{};
+        if ((write(toAgent[1], &req, sizeof(req)) != sizeof(req))
+         || (write(toAgent[1], argsData.data(), argsData.length()) != ssize_t(argsData.length()))
+         || (write(toAgent[1], fileData.data(), fileData.length()) != ssize_t(fileData.length()))
+         || (read(fromAgent[0], &resp, sizeof(resp)) != sizeof(resp))) {
+            ADD_FAILURE() << "agent request failed";
+            return std::make_pair(resp, missed);
+        }
+        missed.resize(resp.numMissed);
+        auto const missedLength = ssize_t(missed.size() * sizeof(uint32_t));
+        if ((missedLength > 0) && (read(fromAgent[0], missed.data(), missedLength) != missedLength)) {
+            ADD_FAILURE() << "agent response truncated";
+        }
+        std::sort(missed.begin(), missed.end());
+        return std::make_pair(resp, missed);
+    };
+
+    // Every node runs the daemon and is counted, except for nx, which is reported by
+    // its index in the tree
+    auto [resp, missed] = runDaemon({"--file=/"});
+    EXPECT_EQ(resp.status, 0);
+    EXPECT_EQ(resp.numNodes, uint32_t(numHosts));
+    EXPECT_EQ(missed, std::vector<uint32_t>{numHosts});
+
+    // Failure on one node is reported in the aggregated status
+    std::tie(resp, missed) = runDaemon({"--files=list"});
+    EXPECT_EQ(resp.status, 1);
+    EXPECT_EQ(resp.numNodes, uint32_t(numHosts));
+    EXPECT_EQ(missed, std::vector<uint32_t>{numHosts});
+
+    // File lists are removed once checked
+    for (int i = 0; i < numHosts; i++) {
+        EXPECT_NE(access((base + "/n" + std::to_string(i) + "/list").c_str(), F_OK), 0) << i;
+    }
+
+    // Files sent through the tree are written to every node's tool path
+    auto const fileData = std::string(100000, 'x');
+    std::tie(resp, missed) = runDaemon({"package.tar"}, fileData);
+    EXPECT_EQ(resp.status, 0);
+    EXPECT_EQ(resp.numNodes, uint32_t(numHosts));
+    EXPECT_EQ(missed, std::vector<uint32_t>{numHosts});
+    for (int i = 0; i < numHosts; i++) {
+        auto received = std::ifstream{base + "/n" + std::to_string(i) + "/package.tar"};
+        EXPECT_EQ(std::string(std::istreambuf_iterator<char>{received}, {}), fileData) << i;
+    }
+
+    // File names may not leave the tool path, so no node receives the file
+    std::tie(resp, missed) = runDaemon({"../package.tar"}, fileData);
+    EXPECT_EQ(resp.status, 1);
+    EXPECT_EQ(resp.numNodes, uint32_t(0));
+    EXPECT_EQ(missed.size(), size_t(numHosts + 1));
+
+    // Requests from node-local clients run only on the agent's own node
+    { auto const clientFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        ASSERT_GE(clientFd, 0);
+        auto addr = sockaddr_un{};
+        addr.sun_family = AF_UNIX;
+        auto const socketPath = base + "/n0/" + BE_AGENT_SOCKET_PREFIX + "1";
+        ASSERT_LT(socketPath.length(), sizeof(addr.sun_path));
+        strcpy(addr.sun_path, socketPath.c_str());
+        ASSERT_EQ(connect(clientFd, (sockaddr*)&addr, sizeof(addr)), 0);
+
+        auto const arg = std::string{"--file=/"};
+        auto const req = cti_beAgentRequest_t
+            { .synchronous = 1
+            , .argc = 1
+            , .argsLength = uint32_t(arg.length() + 1)
+            , .sendFile = 0
+            , .fileLength = 0
+        };
+        auto clientResp = cti_beAgentResponse_t{-1, 0, 0};
+        ASSERT_EQ(write(clientFd, &req, sizeof(req)), ssize_t(sizeof(req)));
+        ASSERT_EQ(write(clientFd, arg.c_str(), arg.length() + 1), ssize_t(arg.length() + 1));
+        ASSERT_EQ(read(clientFd, &clientResp, sizeof(clientResp)), ssize_t(sizeof(clientResp)));
+        EXPECT_EQ(clientResp.status, 0);
+        EXPECT_EQ(clientResp.numNodes, uint32_t(1));
+        EXPECT_EQ(clientResp.numMissed, uint32_t(0));
+        close(clientFd);
+    }
+
+    // Tree still serves stdin after the client request
+    std::tie(resp, missed) = runDaemon({"--file=/"});
+    EXPECT_EQ(resp.status, 0);
+    EXPECT_EQ(resp.numNodes, uint32_t(numHosts));
+    EXPECT_EQ(missed, std::vector<uint32_t>{numHosts});
+
+    // Closing the root agent's input shuts down the tree
+    close(toAgent[1]);
+    int status = -1;
+    ASSERT_EQ(waitpid(agentPid, &status, 0), agentPid);
+    EXPECT_TRUE(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+    close(fromAgent[0]);
+
+    _cti_removeDirectory(base.c_str());
+}
+
+TEST_F(CTIBeUnitTest, cti_be_daemon_multipleBinaries)
+{
+    ASSERT_EQ(access(BE_DAEMON_PATH, X_OK), 0) << BE_DAEMON_PATH;
+    auto const toolPath = cti::cstr::mkdtemp("/tmp/cti-binaries-XXXXXX");
+    auto const sessionPath = toolPath + "/session";
+    for (auto&& dir : {"", "/bin", "/lib", "/tmp"}) {
+        ASSERT_EQ(mkdir((sessionPath + dir).c_str(), S_IRWXU), 0);
+    }
+
+    // Daemon sets permissions on its own binary, so run a copy
+    auto const daemonPath = toolPath + "/" + CTI_BE_DAEMON_BINARY;
+    { auto daemon = std::ofstream{daemonPath, std::ios::binary};
+        daemon << std::ifstream{BE_DAEMON_PATH, std::ios::binary}.rdbuf();
+    }
+    ASSERT_EQ(chmod(daemonPath.c_str(), S_IRWXU), 0);
+
+    // Helpers record their parent and arguments. The main binary runs until they have
+    // written them, so that they would still be its children if not detached
+    { auto helper = std::ofstream{sessionPath + "/bin/helper"};
+        helper << "#!/bin/sh\n"
+               << "echo $PPID $2 > $1.tmp && mv $1.tmp $1\n";
+    }
+    { auto main = std::ofstream{sessionPath + "/bin/main"};
+        main << "#!/bin/sh\n"
+             << "for f; do\n"
+             << "  i=0; while [ ! -e $f ] && [ $i -lt 50 ]; do sleep 0.1; i=$((i + 1)); done\n"
+             << "done\n";
+    }
+    ASSERT_EQ(chmod((sessionPath + "/bin/helper").c_str(), S_IRWXU), 0);
+    ASSERT_EQ(chmod((sessionPath + "/bin/main").c_str(), S_IRWXU), 0);
+
+    auto const daemonPid = fork();
+    ASSERT_GE(daemonPid, 0);
+    if (daemonPid == 0) {
+        auto const wlmArg = "--wlm=" + std::to_string(CTI_WLM_LOCALHOST);
+        auto const pathArg = "--path=" + toolPath;
+        auto const firstPath = toolPath + "/first";
+        auto const secondPath = toolPath + "/second";
+        execl(daemonPath.c_str(), daemonPath.c_str(), wlmArg.c_str(), "--apid=1", pathArg.c_str(),
+            "--directory=session", "--inst=1",
+            "--binary=helper", "--binary=helper", "--binary=main", "--argc=2", "--argc=2", "--",
+            firstPath.c_str(), "a", secondPath.c_str(), "b", firstPath.c_str(), secondPath.c_str(), nullptr);
+        _exit(1);
+    }
+
+    // Main process execs the last binary, which exits once the helpers have run
+    int status = -1;
+    ASSERT_EQ(waitpid(daemonPid, &status, 0), daemonPid);
+    EXPECT_TRUE(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+
+    // Helpers are not children of the main process, and each receives its own arguments
+    for (auto&& [name, arg] : {std::make_pair("first", "a"), std::make_pair("second", "b")}) {
+        auto const helperOutput = toolPath + "/" + name;
+        auto ppid = pid_t{-1};
+        auto helperArg = std::string{};
+        std::ifstream{helperOutput} >> ppid >> helperArg;
+        EXPECT_GT(ppid, 0) << name;
+        EXPECT_NE(ppid, daemonPid) << name;
+        EXPECT_EQ(helperArg, arg) << name;
+    }
+
+    _cti_removeDirectory(toolPath.c_str());
+}
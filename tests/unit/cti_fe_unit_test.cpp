@@ -138,6 +138,19 @@ TEST_F(CTIFEUnitTest, SetAttribute)
     ASSERT_EQ(cti_setAttribute(CTI_ATTR_STAGE_DEPENDENCIES, "1"), SUCCESS);
 }
 
+// char *       cti_getMetrics(void);
+// Tests that the frontend will return request metrics for itself and the daemon
+TEST_F(CTIFEUnitTest, GetMetrics)
+{
+    // run the test
+    auto const rawMetrics = cti::take_pointer_ownership(cti_getMetrics(), std::free);
+    ASSERT_TRUE(rawMetrics != nullptr) << cti_error_str();
+
+    auto const metrics = std::string{rawMetrics.get()};
+    EXPECT_EQ(metrics.find("{\"frontend\":{"), 0);
+    EXPECT_NE(metrics.find(",\"daemon\":"), std::string::npos);
+}
+
 TEST_F(CTIFEUnitTest, ContainsSymbols)
 {
     { char const* symbols[] = {"main", "_start", nullptr};
@@ -291,6 +304,19 @@ TEST_F(CTIAppUnitTest, AppIsValid)
     EXPECT_EQ(cti_appIsValid(appId), true) << cti_error_str();
 }
 
+// Tests that repeated validity checks reuse the cached running state
+TEST_F(CTIAppUnitTest, AppIsValidCached)
+{
+    // describe behavior of mock isRunning
+    EXPECT_CALL(*mockApp, isRunning())
+        .Times(1)
+        .WillOnce(Return(true));
+
+    // run the test
+    EXPECT_EQ(cti_appIsValid(appId), true) << cti_error_str();
+    EXPECT_EQ(cti_appIsValid(appId), true) << cti_error_str();
+}
+
 // cti_app_id_t cti_launchApp(const char * const [], int, int, const char *, const char *, const char * const []);
 // void         cti_deregisterApp(cti_app_id_t);
 // Tests that the interface will call the Frontend to launch an App
@@ -798,6 +824,66 @@ TEST_F(CTIAppUnitTest, ExecToolDaemon)
     EXPECT_EQ(cti_destroySession(sessionId), SUCCESS) << cti_error_str();
 }
 
+// int cti_execToolDaemons(cti_manifest_id_t mid, const cti_toolDaemon_t daemons[],
+//  int num_daemons);
+// Tests that the interface can exec multiple tool daemons in one launch
+TEST_F(CTIAppUnitTest, ExecToolDaemons)
+{
+    auto const sessionId = cti_createSession(appId);
+    ASSERT_NE(sessionId, SESSION_ERROR) << cti_error_str();
+
+    // run the test
+    auto const manifestId = cti_createManifest(sessionId);
+    ASSERT_NE(manifestId, MANIFEST_ERROR) << cti_error_str();
+
+    // capture daemon arguments
+    auto daemonArgs = std::vector<std::string>{};
+    EXPECT_CALL(*mockApp, startDaemon(_, false))
+        .WillOnce(Invoke([&daemonArgs](char const* const args[], bool) {
+            for (auto arg = args; *arg != nullptr; arg++) {
+                daemonArgs.emplace_back(*arg);
+            }
+        }));
+
+    // finalize manifest and run tooldaemons
+    char const* const helperArgs[] = {"-a", "-b", nullptr};
+    char const* const helperEnv[] = {"HELPER=1", nullptr};
+    char const* const mainArgs[] = {"-c", nullptr};
+    cti_toolDaemon_t const daemons[] =
+        { { "../test_support/one_socket", helperArgs, helperEnv }
+        , { "/usr/bin/true", mainArgs, nullptr }
+    };
+    ASSERT_EQ(cti_execToolDaemons(manifestId, daemons, 2), SUCCESS) << cti_error_str();
+
+    // check for both binaries
+    auto const shippedFilePaths = mockApp->getShippedFilePaths();
+    ASSERT_TRUE(!shippedFilePaths.empty());
+
+    auto const tarRoot = shippedFilePaths[0].substr(0, shippedFilePaths[0].find("/") + 1);
+    for (auto&& path : { tarRoot + "bin/one_socket", tarRoot + "bin/true" }) {
+        EXPECT_TRUE(std::find(shippedFilePaths.begin(), shippedFilePaths.end(), path)
+            != shippedFilePaths.end()) << "Could not find " << path;
+    }
+
+    // binaries are launched together, with arguments split by count and environment
+    // set for its own binary
+    auto hasArg = [&daemonArgs](std::string const& arg) {
+        return std::find(daemonArgs.begin(), daemonArgs.end(), arg) != daemonArgs.end();
+    };
+    EXPECT_TRUE(hasArg("--binary=one_socket"));
+    EXPECT_TRUE(hasArg("--binary=true"));
+    EXPECT_TRUE(hasArg("--argc=2"));
+    EXPECT_TRUE(hasArg("--binenv=0:HELPER=1"));
+
+    auto const terminator = std::find(daemonArgs.begin(), daemonArgs.end(), "--");
+    ASSERT_NE(terminator, daemonArgs.end());
+    EXPECT_EQ(std::vector<std::string>(terminator + 1, daemonArgs.end()),
+        (std::vector<std::string>{"-a", "-b", "-c"}));
+
+    // cleanup
+    EXPECT_EQ(cti_destroySession(sessionId), SUCCESS) << cti_error_str();
+}
+
 TEST_F(CTIAppUnitTest, ManifestLibraryConflict)
 {
     auto const sessionId = cti_createSession(appId);
@@ -868,6 +954,41 @@ TEST(SlurmFrontendTest, GetGresSetting)
     }
 }
 
+TEST(SlurmFrontendTest, ParseNodeHostNames)
+{
+    auto scontrolStream = std::istringstream{
+        "NodeName=x1000c0s0b0n0 Arch=x86_64 CoresPerSocket=64\n"
+        "   NodeAddr=nid000001 NodeHostName=nid000001.local Version=23.02\n"
+        "   OS=Linux\n"
+        "\n"
+        "NodeName=x1000c0s0b0n1 Arch=x86_64 CoresPerSocket=64\n"
+        "   NodeAddr=nid000002 NodeHostName=nid000002 Version=23.02\n"
+        "\n"
+        "   NodeHostName=orphan\n"};
+
+    auto const hostNodeNames = SLURMFrontend::detail::parse_node_host_names(scontrolStream);
+    ASSERT_EQ(hostNodeNames.size(), 2);
+    EXPECT_EQ(hostNodeNames.at("nid000001"), "x1000c0s0b0n0");
+    EXPECT_EQ(hostNodeNames.at("nid000002"), "x1000c0s0b0n1");
+}
+
+TEST(SlurmFrontendTest, BatchNodeLists)
+{
+    auto const nodeNames = std::set<std::string>{"nid1", "nid2", "nid3", "nid4", "nid5"};
+
+    // Every list fits in the limit, and every node appears once
+    auto const nodeLists = SLURMFrontend::detail::batch_node_lists(nodeNames, 10);
+    ASSERT_EQ(nodeLists.size(), 3);
+    EXPECT_EQ(nodeLists[0], "nid1,nid2,");
+    EXPECT_EQ(nodeLists[1], "nid3,nid4,");
+    EXPECT_EQ(nodeLists[2], "nid5,");
+
+    // Names longer than the limit are still queried on their own
+    EXPECT_EQ(SLURMFrontend::detail::batch_node_lists(nodeNames, 2).size(), 5);
+    EXPECT_EQ(SLURMFrontend::detail::batch_node_lists(nodeNames, 1024).size(), 1);
+    EXPECT_TRUE(SLURMFrontend::detail::batch_node_lists({}, 1024).empty());
+}
+
 TEST(SlurmFrontendTest, AddQuotedArgs)
 {
     { auto args = cti::ManagedArgv{};
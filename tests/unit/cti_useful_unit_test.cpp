@@ -17,7 +17,12 @@
 #include <unordered_set>
 #include <fstream>
 #include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <vector>
 #include <fcntl.h>
+#include <sys/wait.h>
 #include "useful/cti_split.hpp"
 
 #include "cti_useful_unit_test.hpp"
@@ -272,6 +277,164 @@ TEST_F(CTIUsefulUnitTest, cti_execvp_execvp_success)
     ASSERT_EQ(test.getExitStatus(), 0);
 }
 
+TEST_F(CTIUsefulUnitTest, cti_execvp_SpawnActions)
+{
+    // test that spawned child output is remapped to pipe
+    auto outputPipe = cti::Pipe{};
+    std::initializer_list<std::string const> strlist {"echo", "-n", "T"};
+    cti::ManagedArgv argv(strlist);
+
+    auto spawnActions = cti::SpawnActions{};
+    spawnActions.dup2(-1, STDIN_FILENO);
+    spawnActions.dup2(outputPipe.getWriteFd(), STDOUT_FILENO);
+    spawnActions.closeInherited();
+    auto const child = spawnActions.spawnvp("echo", argv.get());
+    ASSERT_GT(child, 0);
+    outputPipe.closeWrite();
+
+    char result = '\0';
+    ASSERT_EQ(::read(outputPipe.getReadFd(), &result, 1), 1);
+    EXPECT_EQ(result, 'T');
+
+    int status = 0;
+    ASSERT_EQ(::waitpid(child, &status, 0), child);
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    // test that launch failure is reported
+    EXPECT_LT(cti::SpawnActions{}.spawnvp("/this/will/fail", argv.get()), 0);
+}
+
+// Spawn latency microbenchmark, comparing fork / exec with posix_spawn as the
+// parent's resident set grows. Run with --gtest_also_run_disabled_tests
+TEST_F(CTIUsefulUnitTest, DISABLED_cti_execvp_spawn_latency)
+{
+    std::initializer_list<std::string const> strlist {"true"};
+    cti::ManagedArgv argv(strlist);
+    auto const iterations = 50;
+
+    auto timeLaunches = [&](auto&& launch) {
+        auto const start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            auto const child = launch();
+            ASSERT_GT(child, 0);
+            ::waitpid(child, nullptr, 0);
+        }
+        auto const elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / iterations
+                  << " us";
+    };
+
+    auto resident = std::vector<char>{};
+    for (auto rss_mb : {0, 256, 1024, 4096}) {
+
+        // Touch every page so it is resident in parent
+        resident.assign(size_t(rss_mb) << 20, 1);
+
+        std::cout << "rss " << rss_mb << " MB: fork / exec ";
+        timeLaunches([&]() {
+            auto const child = ::fork();
+            if (child == 0) {
+                ::execvp("true", argv.get());
+                ::_exit(-1);
+            }
+            return child;
+        });
+        std::cout << ", posix_spawn ";
+        timeLaunches([&]() {
+            return cti::SpawnActions{}.spawnvp("true", argv.get());
+        });
+        std::cout << std::endl;
+    }
+}
+
+// Compare buildEnv with building the environment through a map of the base environment,
+// which is the behavior of setting each override and unsetting each blacklisted variable
+TEST_F(CTIUsefulUnitTest, cti_execvp_buildEnv)
+{
+    char const* base[] =
+        { "HOME=/home/user"
+        , "PATH=/usr/bin:/bin"
+        , "LD_LIBRARY_PATH=/opt/lib"
+        , "EMPTY_BASE="
+        , "EQUALS=a=b"
+        , "NO_EQUALS"
+        , "SLURM_JOBID=1234"
+        , "KEEP=1"
+        , nullptr
+    };
+    auto const overrides = std::vector<std::string>
+        { "PATH=/opt/bin:/usr/bin:/bin" // replaced
+        , "NEW_VAR=value"               // added
+        , "LD_LIBRARY_PATH="            // empty value
+        , "NOT_IN_BASE="                // empty value, not in base
+        , "SLURM_JOBID=5678"            // overridden, but blacklisted
+        , "EQUALS=c=d"
+    };
+    auto const blacklist = std::vector<std::string>{ "SLURM_JOBID", "HOME" };
+
+    auto referenceEnv = [&](bool unsetEmpty) {
+        auto envMap = std::map<std::string, std::string>{};
+        for (auto var = base; *var != nullptr; var++) {
+            auto const envVarVal = std::string{*var};
+            auto const equalsAt = envVarVal.find('=');
+            if (equalsAt != std::string::npos) {
+                envMap[envVarVal.substr(0, equalsAt)] = envVarVal.substr(equalsAt + 1);
+            }
+        }
+        for (auto&& envVarVal : overrides) {
+            auto const equalsAt = envVarVal.find('=');
+            auto const name = envVarVal.substr(0, equalsAt);
+            auto const value = envVarVal.substr(equalsAt + 1);
+            if (unsetEmpty && value.empty()) {
+                envMap.erase(name);
+            } else {
+                envMap[name] = value;
+            }
+        }
+        for (auto&& var : blacklist) {
+            envMap.erase(var);
+        }
+
+        auto result = std::vector<std::string>{};
+        for (auto&& [var, val] : envMap) {
+            result.emplace_back(var + "=" + val);
+        }
+        return result;
+    };
+
+    auto sorted = [](std::vector<std::string> env) {
+        std::sort(env.begin(), env.end());
+        return env;
+    };
+
+    // Empty values unset variables, as for app and utility launches
+    EXPECT_EQ(sorted(cti::buildEnv(base, overrides, blacklist, cti::EmptyEnvValue::Unset)),
+        referenceEnv(true));
+
+    // Empty values are set, as for MPIR launches
+    EXPECT_EQ(sorted(cti::buildEnv(base, overrides, blacklist, cti::EmptyEnvValue::Keep)),
+        referenceEnv(false));
+
+    // Base order is kept, replaced variables stay in place, new variables are appended
+    auto const env = cti::buildEnv(base, overrides, blacklist, cti::EmptyEnvValue::Unset);
+    EXPECT_EQ(env, (std::vector<std::string>
+        { "PATH=/opt/bin:/usr/bin:/bin"
+        , "EMPTY_BASE="
+        , "EQUALS=c=d"
+        , "KEEP=1"
+        , "NEW_VAR=value"
+    }));
+
+    // Later overrides replace earlier ones
+    EXPECT_EQ(cti::buildEnv(nullptr, {"A=1", "B=2", "A=3"}, {}, cti::EmptyEnvValue::Unset),
+        (std::vector<std::string>{"B=2", "A=3"}));
+    EXPECT_EQ(cti::buildEnv(base, {"KEEP=2", "KEEP="}, {}, cti::EmptyEnvValue::Unset).size(), 6);
+
+    // Malformed overrides are rejected
+    EXPECT_THROW(cti::buildEnv(base, {"NO_EQUALS"}, {}, cti::EmptyEnvValue::Unset),
+        std::runtime_error);
+}
+
 /******************************************
 *             CTI_LOG TESTS               *
 ******************************************/
@@ -347,6 +510,65 @@ TEST_F(CTIUsefulUnitTest, cti_log_cti_log_hookstdoe)
     close(ferr);
 }
 
+/******************************************
+*            CTI_METRICS TESTS            *
+******************************************/
+
+TEST_F(CTIUsefulUnitTest, cti_metrics_Summary)
+{
+    auto metrics = cti::RequestMetrics{};
+
+    // Overlapping requests are counted in flight until they end
+    metrics.begin(1, "Sync(sbcast)");
+    metrics.begin(2, "Sync(sbcast)");
+    metrics.begin(3, "LaunchMPIR");
+    ASSERT_EQ(metrics.summarize()["Sync(sbcast)"].inFlight, 2);
+
+    usleep(2000);
+    metrics.end(1);
+    usleep(2000);
+    metrics.end(2);
+
+    // Unknown IDs are ignored
+    metrics.end(4);
+
+    auto const summary = metrics.summarize();
+    ASSERT_EQ(summary.size(), 2);
+
+    auto const& sbcast = summary.at("Sync(sbcast)");
+    EXPECT_EQ(sbcast.count, 2);
+    EXPECT_EQ(sbcast.inFlight, 0);
+    EXPECT_EQ(sbcast.maxInFlight, 2);
+    EXPECT_GE(sbcast.minMs, 2.0);
+    EXPECT_GE(sbcast.maxMs, 4.0);
+    EXPECT_LE(sbcast.minMs, sbcast.p50Ms);
+    EXPECT_LE(sbcast.p50Ms, sbcast.p95Ms);
+    EXPECT_LE(sbcast.p95Ms, sbcast.p99Ms);
+    EXPECT_LE(sbcast.p99Ms, sbcast.maxMs);
+    EXPECT_DOUBLE_EQ(sbcast.p99Ms, sbcast.maxMs);
+
+    // Request still running has no latency yet
+    auto const& launch = summary.at("LaunchMPIR");
+    EXPECT_EQ(launch.count, 0);
+    EXPECT_EQ(launch.inFlight, 1);
+    EXPECT_EQ(launch.p50Ms, 0.0);
+}
+
+TEST_F(CTIUsefulUnitTest, cti_metrics_Json)
+{
+    auto metrics = cti::RequestMetrics{};
+    ASSERT_EQ(metrics.toJson(), "{}");
+
+    // Names are escaped
+    metrics.begin(1, "quote\"backslash\\");
+    metrics.end(1);
+
+    auto const json = metrics.toJson();
+    EXPECT_EQ(json.find("{\"quote\\\"backslash\\\\\":{\"count\":1,\"in_flight\":0,"), 0);
+    EXPECT_NE(json.find("\"p99_ms\":"), std::string::npos);
+    EXPECT_EQ(json.back(), '}');
+}
+
 /******************************************
 *             CTI_PATH TESTS              *
 ******************************************/
@@ -370,6 +592,74 @@ TEST_F(CTIUsefulUnitTest, cti_path_adjustPaths)
     ASSERT_EQ(_cti_adjustPaths("/DOESNOTEXIST", nullptr), 1);
 }
 
+/******************************************
+*          CTI_FILE_CHECK TESTS           *
+******************************************/
+
+TEST_F(CTIUsefulUnitTest, cti_file_check_list)
+{
+    auto const listPath = std::string{"/tmp/cti_file_check_list"};
+    auto fileCheck = cti::FileCheck{{"/nonexistent", "/bin/sh"}};
+
+    // Records are sorted by path with local size and modification time
+    struct stat st;
+    ASSERT_EQ(::stat("/bin/sh", &st), 0);
+    fileCheck.writeList(listPath, cti::FileCheck::Verify::SizeMtime);
+    auto listFile = std::ifstream{listPath, std::ios::binary};
+    auto list = std::string{std::istreambuf_iterator<char>{listFile}, {}};
+    EXPECT_EQ(list, std::to_string(st.st_size) + " " + std::to_string(st.st_mtime) + " /bin/sh" + '\0'
+        + "-1 -1 /nonexistent" + '\0');
+
+    // Attributes are not checked without verification
+    fileCheck.writeList(listPath, cti::FileCheck::Verify::None);
+    listFile = std::ifstream{listPath, std::ios::binary};
+    list = std::string{std::istreambuf_iterator<char>{listFile}, {}};
+    EXPECT_EQ(list, std::string{"-1 -1 /bin/sh"} + '\0' + "-1 -1 /nonexistent" + '\0');
+
+    ::remove(listPath.c_str());
+
+    // Records passed as arguments end in newlines, and paths with newlines are left empty
+    auto newlineCheck = cti::FileCheck{{"/bin/sh", "/new\nline"}};
+    EXPECT_EQ(newlineCheck.listData(cti::FileCheck::Verify::None, 4096),
+        (std::vector<std::string>{"-1 -1 /bin/sh\n-1 -1 \n"}));
+
+    // Long lists are split between records
+    EXPECT_EQ(newlineCheck.listData(cti::FileCheck::Verify::None, 14),
+        (std::vector<std::string>{"-1 -1 /bin/sh\n", "-1 -1 \n"}));
+    EXPECT_EQ(newlineCheck.listData(cti::FileCheck::Verify::None, 20),
+        (std::vector<std::string>{"-1 -1 /bin/sh\n", "-1 -1 \n"}));
+    EXPECT_THROW(newlineCheck.listData(cti::FileCheck::Verify::None, 13), std::runtime_error);
+
+    EXPECT_EQ(cti::FileCheck::parseVerify(nullptr), cti::FileCheck::Verify::SizeMtime);
+    EXPECT_EQ(cti::FileCheck::parseVerify("size"), cti::FileCheck::Verify::Size);
+    EXPECT_THROW(cti::FileCheck::parseVerify("hash"), std::runtime_error);
+}
+
+TEST_F(CTIUsefulUnitTest, cti_file_check_responses)
+{
+    auto paths = std::set<std::string>{};
+    for (int i = 0; i < 10; i++) {
+        paths.insert("/path" + std::to_string(i));
+    }
+    auto fileCheck = cti::FileCheck{paths};
+
+    // No responses, no files present
+    EXPECT_TRUE(fileCheck.result().empty());
+
+    // Two bytes of bitmap for ten paths
+    EXPECT_FALSE(fileCheck.addResponse(""));
+    EXPECT_FALSE(fileCheck.addResponse("ff"));
+    EXPECT_FALSE(fileCheck.addResponse("ffxx"));
+    EXPECT_FALSE(fileCheck.addResponse("no version information"));
+    EXPECT_EQ(fileCheck.numResponses(), 0);
+
+    // Paths are present only if present in every response
+    EXPECT_TRUE(fileCheck.addResponse("0f03"));
+    EXPECT_TRUE(fileCheck.addResponse("FD02"));
+    EXPECT_EQ(fileCheck.numResponses(), 2);
+    EXPECT_EQ(fileCheck.result(), (std::set<std::string>{"/path0", "/path2", "/path3", "/path9"}));
+}
+
 /******************************************
 *             CTI_SPLIT TESTS             *
 ******************************************/
@@ -17,7 +17,9 @@
 #include "useful/cti_argv.hpp"
 #include "useful/cti_dlopen.hpp"
 #include "useful/cti_execvp.hpp"
+#include "useful/cti_file_check.hpp"
 #include "useful/cti_log.h"
+#include "useful/cti_metrics.hpp"
 #include "useful/cti_path.h"
 #include "useful/cti_stack.h"
 #include "useful/cti_wrappers.hpp"